@@ -0,0 +1,508 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// Times scene graph traversals and file I/O on synthetic scenes, from
+// one thread and from several threads at once. See the README file
+// in this directory for how to run it.
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/SbString.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/actions/SoRayPickAction.h>
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+#include <Inventor/threads/SbBarrier.h>
+#include <Inventor/threads/SbThread.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// *************************************************************************
+
+enum LeafType {
+  LEAF_CUBE,
+  LEAF_SPHERE,
+  LEAF_FACESET
+};
+
+struct Options {
+  int depth;
+  int fanout;
+  LeafType leaf;
+  int gridsize;
+  int iterations;
+  SbList<int> threadcounts;
+  SbList<SbString> benchmarks;
+  SbBool privatescenes;
+  const char * outputfile;
+};
+
+static const char * benchmarknames[] = {
+  "bbox", "raypick", "callback", "search", "write", "read"
+};
+static const int numbenchmarks = sizeof(benchmarknames) / sizeof(benchmarknames[0]);
+
+static const char * leafnames[] = { "cube", "sphere", "faceset" };
+
+// *************************************************************************
+// synthetic scenes
+
+// A grid of gridsize x gridsize quads in the xy plane, centered on
+// the origin and one unit wide.
+static SoSeparator *
+create_faceset(const int gridsize)
+{
+  SoSeparator * sep = new SoSeparator;
+  SoCoordinate3 * coords = new SoCoordinate3;
+  SoIndexedFaceSet * ifs = new SoIndexedFaceSet;
+
+  const int n = gridsize + 1;
+  coords->point.setNum(n * n);
+  SbVec3f * pts = coords->point.startEditing();
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < n; x++) {
+      pts[y * n + x].setValue(float(x) / gridsize - 0.5f,
+                              float(y) / gridsize - 0.5f, 0.0f);
+    }
+  }
+  coords->point.finishEditing();
+
+  ifs->coordIndex.setNum(gridsize * gridsize * 5);
+  int32_t * idx = ifs->coordIndex.startEditing();
+  for (int y = 0; y < gridsize; y++) {
+    for (int x = 0; x < gridsize; x++) {
+      *idx++ = y * n + x;
+      *idx++ = y * n + x + 1;
+      *idx++ = (y + 1) * n + x + 1;
+      *idx++ = (y + 1) * n + x;
+      *idx++ = -1;
+    }
+  }
+  ifs->coordIndex.finishEditing();
+
+  sep->addChild(coords);
+  sep->addChild(ifs);
+  return sep;
+}
+
+// Builds a tree with the given depth and fanout. The children of each
+// group are laid out along the x axis at even levels and along the y
+// axis at odd levels, so the leaves end up in a grid.
+static SoSeparator *
+create_scene(const Options & opts, const int level, int & numnodes)
+{
+  SoSeparator * sep = new SoSeparator;
+  numnodes++;
+
+  if (level == opts.depth) {
+    SoMaterial * mat = new SoMaterial;
+    mat->diffuseColor.setValue(float(numnodes % 7) / 7.0f, 0.5f, 0.5f);
+    sep->addChild(mat);
+    switch (opts.leaf) {
+    case LEAF_CUBE: sep->addChild(new SoCube); break;
+    case LEAF_SPHERE: sep->addChild(new SoSphere); break;
+    case LEAF_FACESET: sep->addChild(create_faceset(opts.gridsize)); numnodes += 3; break;
+    }
+    numnodes += 2;
+    return sep;
+  }
+
+  // the size of a subtree, in leaves, along the axis we lay out on
+  int spacing = 1;
+  for (int i = level + 2; i < opts.depth; i += 2) spacing *= opts.fanout;
+  const float step = 2.5f * spacing;
+
+  for (int i = 0; i < opts.fanout; i++) {
+    SoTranslation * t = new SoTranslation;
+    const float offset = (i == 0) ? -step * (opts.fanout - 1) / 2.0f : step;
+    if (level % 2) t->translation.setValue(0.0f, offset, 0.0f);
+    else t->translation.setValue(offset, 0.0f, 0.0f);
+    sep->addChild(t);
+    sep->addChild(create_scene(opts, level + 1, numnodes));
+    numnodes++;
+  }
+  return sep;
+}
+
+// *************************************************************************
+// the benchmarks, each run a number of times by every thread
+
+struct ThreadData {
+  const char * benchmark;
+  SoSeparator * root;
+  SbBox3f bbox;
+  const char * filebuffer;
+  size_t filebuffersize;
+  int iterations;
+  SbBarrier * barrier;
+  int result;
+  SbTime start, end;
+};
+
+static void
+count_triangles(void * userdata, SoCallbackAction *,
+                const SoPrimitiveVertex *, const SoPrimitiveVertex *,
+                const SoPrimitiveVertex *)
+{
+  (*((int *) userdata))++;
+}
+
+static void *
+realloc_cb(void * ptr, size_t size)
+{
+  return realloc(ptr, size);
+}
+
+static void
+run_benchmark(ThreadData * data)
+{
+  const SbViewportRegion vp(512, 512);
+  const char * name = data->benchmark;
+  int result = 0;
+
+  if (strcmp(name, "bbox") == 0) {
+    SoGetBoundingBoxAction action(vp);
+    for (int i = 0; i < data->iterations; i++) {
+      action.apply(data->root);
+      if (!action.getBoundingBox().isEmpty()) result++;
+    }
+  }
+  else if (strcmp(name, "raypick") == 0) {
+    // shoot rays down the z axis, spread over the scene
+    SoRayPickAction action(vp);
+    SbVec3f min, max;
+    data->bbox.getBounds(min, max);
+    const int numrays = 61;
+    for (int i = 0; i < data->iterations; i++) {
+      const float fx = float(i % numrays) / (numrays - 1);
+      const float fy = float((i * 7) % numrays) / (numrays - 1);
+      const SbVec3f start(min[0] + fx * (max[0] - min[0]),
+                          min[1] + fy * (max[1] - min[1]),
+                          max[2] + 1.0f);
+      action.setRay(start, SbVec3f(0.0f, 0.0f, -1.0f));
+      action.apply(data->root);
+      if (action.getPickedPoint()) result++;
+    }
+  }
+  else if (strcmp(name, "callback") == 0) {
+    SoCallbackAction action(vp);
+    action.addTriangleCallback(SoShape::getClassTypeId(), count_triangles, &result);
+    for (int i = 0; i < data->iterations; i++) {
+      action.apply(data->root);
+    }
+  }
+  else if (strcmp(name, "search") == 0) {
+    SoSearchAction action;
+    action.setType(SoMaterial::getClassTypeId());
+    action.setInterest(SoSearchAction::ALL);
+    for (int i = 0; i < data->iterations; i++) {
+      action.apply(data->root);
+      result += action.getPaths().getLength();
+      action.reset();
+    }
+  }
+  else if (strcmp(name, "write") == 0) {
+    for (int i = 0; i < data->iterations; i++) {
+      SoOutput out;
+      out.setBuffer(malloc(1024), 1024, realloc_cb);
+      SoWriteAction action(&out);
+      action.apply(data->root);
+      void * buf;
+      size_t size;
+      out.getBuffer(buf, size);
+      result += (size > 0) ? 1 : 0;
+      free(buf);
+    }
+  }
+  else if (strcmp(name, "read") == 0) {
+    for (int i = 0; i < data->iterations; i++) {
+      SoInput in;
+      in.setBuffer(data->filebuffer, data->filebuffersize);
+      SoSeparator * root = SoDB::readAll(&in);
+      if (root) {
+        root->ref();
+        root->unref();
+        result++;
+      }
+    }
+  }
+  data->result = result;
+}
+
+static void *
+thread_cb(void * closure)
+{
+  ThreadData * data = (ThreadData *) closure;
+  // start all the threads at the same time
+  data->barrier->enter();
+  data->start = SbTime::getTimeOfDay();
+  run_benchmark(data);
+  data->end = SbTime::getTimeOfDay();
+  return NULL;
+}
+
+// *************************************************************************
+
+static void
+usage(const char * argv0)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --depth N          depth of the scene graph (default 4)\n"
+          "  --fanout N         children per group (default 6)\n"
+          "  --leaf TYPE        leaf shape: cube, sphere or faceset (default faceset)\n"
+          "  --gridsize N       faceset leaves are N x N quads (default 8)\n"
+          "  --iterations N     runs of each benchmark per thread (default 20)\n"
+          "  --threads N[,N..]  thread counts to run with (default 1,4)\n"
+          "  --benchmark NAME   run only this benchmark, can be repeated\n"
+          "                     (bbox, raypick, callback, search, write, read)\n"
+          "  --private-scenes   give each thread its own copy of the scene\n"
+          "  --output FILE      write results to FILE instead of stdout\n",
+          argv0);
+}
+
+static SbBool
+parse_options(int argc, char ** argv, Options & opts)
+{
+  opts.depth = 4;
+  opts.fanout = 6;
+  opts.leaf = LEAF_FACESET;
+  opts.gridsize = 8;
+  opts.iterations = 20;
+  opts.privatescenes = FALSE;
+  opts.outputfile = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char * arg = argv[i];
+    const char * value = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (strcmp(arg, "--private-scenes") == 0) {
+      opts.privatescenes = TRUE;
+      continue;
+    }
+    if (value == NULL) return FALSE;
+    i++;
+    if (strcmp(arg, "--depth") == 0) opts.depth = atoi(value);
+    else if (strcmp(arg, "--fanout") == 0) opts.fanout = atoi(value);
+    else if (strcmp(arg, "--gridsize") == 0) opts.gridsize = atoi(value);
+    else if (strcmp(arg, "--iterations") == 0) opts.iterations = atoi(value);
+    else if (strcmp(arg, "--output") == 0) opts.outputfile = value;
+    else if (strcmp(arg, "--benchmark") == 0) opts.benchmarks.append(value);
+    else if (strcmp(arg, "--leaf") == 0) {
+      int leaf;
+      for (leaf = 0; leaf < 3; leaf++) {
+        if (strcmp(value, leafnames[leaf]) == 0) break;
+      }
+      if (leaf == 3) return FALSE;
+      opts.leaf = (LeafType) leaf;
+    }
+    else if (strcmp(arg, "--threads") == 0) {
+      const char * p = value;
+      while (*p) {
+        const int n = atoi(p);
+        if (n < 1) return FALSE;
+        opts.threadcounts.append(n);
+        p = strchr(p, ',');
+        if (p == NULL) break;
+        p++;
+      }
+    }
+    else return FALSE;
+  }
+
+  if (opts.threadcounts.getLength() == 0) {
+    opts.threadcounts.append(1);
+    opts.threadcounts.append(4);
+  }
+  if (opts.benchmarks.getLength() == 0) {
+    for (int i = 0; i < numbenchmarks; i++) opts.benchmarks.append(benchmarknames[i]);
+  }
+  for (int i = 0; i < opts.benchmarks.getLength(); i++) {
+    int b;
+    for (b = 0; b < numbenchmarks; b++) {
+      if (opts.benchmarks[i] == benchmarknames[b]) break;
+    }
+    if (b == numbenchmarks) return FALSE;
+  }
+  return (opts.depth >= 0) && (opts.fanout > 0) &&
+    (opts.gridsize > 0) && (opts.iterations > 0);
+}
+
+int
+main(int argc, char ** argv)
+{
+  Options opts;
+  if (!parse_options(argc, argv, opts)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  SoDB::init();
+
+#ifndef COIN_BENCHMARKS_THREADSAFE
+  // Without COIN_THREADSAFE, traversals from several threads may
+  // update the caches of a shared scene at the same time.
+  if (!opts.privatescenes) {
+    for (int i = 0; i < opts.threadcounts.getLength(); i++) {
+      if (opts.threadcounts[i] > 1) opts.privatescenes = TRUE;
+    }
+    if (opts.privatescenes) {
+      fprintf(stderr, "Coin is not built with COIN_THREADSAFE, "
+              "so each thread gets its own copy of the scene.\n");
+    }
+  }
+#endif // !COIN_BENCHMARKS_THREADSAFE
+
+  FILE * out = stdout;
+  if (opts.outputfile) {
+    out = fopen(opts.outputfile, "w");
+    if (out == NULL) {
+      fprintf(stderr, "Could not open %s for writing.\n", opts.outputfile);
+      return 1;
+    }
+  }
+
+  int maxthreads = 1;
+  for (int i = 0; i < opts.threadcounts.getLength(); i++) {
+    maxthreads = SbMax(maxthreads, opts.threadcounts[i]);
+  }
+
+  int numnodes = 0;
+  SbList<SoSeparator *> scenes;
+  const int numscenes = opts.privatescenes ? maxthreads : 1;
+  for (int i = 0; i < numscenes; i++) {
+    numnodes = 0;
+    SoSeparator * root = create_scene(opts, 0, numnodes);
+    root->ref();
+    scenes.append(root);
+  }
+
+  // the file read back by the "read" benchmark
+  SoOutput fileout;
+  fileout.setBuffer(malloc(1024), 1024, realloc_cb);
+  SoWriteAction wa(&fileout);
+  wa.apply(scenes[0]);
+  void * filebuffer;
+  size_t filebuffersize;
+  fileout.getBuffer(filebuffer, filebuffersize);
+
+  SoGetBoundingBoxAction bba(SbViewportRegion(512, 512));
+  bba.apply(scenes[0]);
+  const SbBox3f bbox = bba.getBoundingBox();
+
+  fprintf(stderr, "Scene: depth %d, fanout %d, %s leaves, %d nodes, %lu bytes as ASCII\n",
+          opts.depth, opts.fanout, leafnames[opts.leaf], numnodes,
+          (unsigned long) filebuffersize);
+
+  for (int b = 0; b < opts.benchmarks.getLength(); b++) {
+    // one untimed run first, so that all the runs find the caches
+    // in the scene set up
+    for (int i = 0; i < numscenes; i++) {
+      ThreadData warmup;
+      warmup.benchmark = opts.benchmarks[b].getString();
+      warmup.root = scenes[i];
+      warmup.bbox = bbox;
+      warmup.filebuffer = (const char *) filebuffer;
+      warmup.filebuffersize = filebuffersize;
+      warmup.iterations = 1;
+      warmup.barrier = NULL;
+      run_benchmark(&warmup);
+    }
+
+    for (int t = 0; t < opts.threadcounts.getLength(); t++) {
+      const int numthreads = opts.threadcounts[t];
+      SbBarrier barrier(numthreads + 1);
+      ThreadData * data = new ThreadData[numthreads];
+      SbThread ** threads = new SbThread*[numthreads];
+      for (int i = 0; i < numthreads; i++) {
+        data[i].benchmark = opts.benchmarks[b].getString();
+        data[i].root = scenes[i % numscenes];
+        data[i].bbox = bbox;
+        data[i].filebuffer = (const char *) filebuffer;
+        data[i].filebuffersize = filebuffersize;
+        data[i].iterations = opts.iterations;
+        data[i].barrier = &barrier;
+        data[i].result = 0;
+        threads[i] = SbThread::create(thread_cb, &data[i]);
+      }
+
+      barrier.enter();
+      // from when the first thread started until the last finished
+      SbTime start = SbTime::maxTime(), end = SbTime::zero();
+      for (int i = 0; i < numthreads; i++) {
+        threads[i]->join();
+        SbThread::destroy(threads[i]);
+        if (data[i].start < start) start = data[i].start;
+        if (data[i].end > end) end = data[i].end;
+      }
+      const double seconds = (end - start).getValue();
+      const int result = data[0].result;
+      delete[] threads;
+      delete[] data;
+
+      const double ops = double(numthreads) * opts.iterations;
+      fprintf(out,
+              "{\"benchmark\": \"%s\", \"threads\": %d, \"iterations\": %d, "
+              "\"depth\": %d, \"fanout\": %d, \"leaf\": \"%s\", \"nodes\": %d, "
+              "\"private_scenes\": %s, \"seconds\": %.6f, "
+              "\"ops_per_second\": %.3f, \"result\": %d, \"coin_version\": \"%s\"}\n",
+              opts.benchmarks[b].getString(), numthreads, opts.iterations,
+              opts.depth, opts.fanout, leafnames[opts.leaf], numnodes,
+              opts.privatescenes ? "true" : "false", seconds,
+              ops / seconds, result, SoDB::getVersion());
+      fflush(out);
+
+      fprintf(stderr, "%-10s %3d threads: %10.3f ms per run, %10.1f runs per second\n",
+              opts.benchmarks[b].getString(), numthreads,
+              seconds * 1000.0 / opts.iterations, ops / seconds);
+    }
+  }
+
+  free(filebuffer);
+  for (int i = 0; i < scenes.getLength(); i++) scenes[i]->unref();
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -64,6 +64,7 @@ public:
   static SbBool read(SoInput * input, SoNode *& rootnode);
   static SoSeparator * readAll(SoInput * input);
   static SoVRMLGroup * readAllVRML(SoInput * input);
+  static SoNode * readNamedNode(SoInput * input, const SbName & name);
   static SbBool isValidHeader(const char * teststring);
   static SbBool registerHeader(const SbString & headerstring,
                                SbBool isbinary,
@@ -103,6 +104,9 @@ public:
   static SbBool isNotifying(void);
   static void endNotify(void);
 
+  static void beginNotificationBatch(void);
+  static void endNotificationBatch(void);
+
   typedef SbBool ProgressCallbackType(const SbName & itemid, float fraction,
                                       SbBool interruptible, void * userdata);
   static void addProgressCallback(ProgressCallbackType * func, void * userdata);
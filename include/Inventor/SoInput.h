@@ -54,8 +54,14 @@ class SoInput_FileInfo;
 class SoProto;
 class SoField;
 class SoFieldContainer;
+class SoGroup;
+class SoNode;
+class SoInput;
 class SoInputP;
 
+typedef void SoInputReadCB(void * userdata, SoInput * in,
+                           SoNode * node, SoGroup * parent);
+
 // *************************************************************************
 
 class COIN_DLL_API SoInput {
@@ -86,6 +92,11 @@ public:
   virtual const char * getCurFileName(void) const;
   virtual void setBuffer(const void * bufpointer, size_t bufsize);
           void setStringArray(const char * strings[]);
+  void setMemoryMapping(const SbBool onoff);
+  SbBool isMemoryMapping(void) const;
+  void setPrefetchThreads(const int numthreads);
+  int getPrefetchThreads(void) const;
+  void setReadCallback(SoInputReadCB * func, void * userdata);
   virtual size_t getNumBytesRead(void) const;
   virtual SbString getHeader(void);
   virtual float getIVVersion(void);
@@ -66,6 +66,8 @@ public:
   SbBool setCompression(const SbName & compmethod,
                         const float level = 0.5f);
   static const SbName * getAvailableCompressionMethods(unsigned int & num);
+  void setCompressionThreads(const int numthreads);
+  int getCompressionThreads(void) const;
 
   virtual void setBuffer(void * bufPointer, size_t initSize,
                          SoOutputReallocCB * reallocFunc, int32_t offset = 0);
@@ -74,6 +76,8 @@ public:
   virtual void resetBuffer(void);
   virtual void setBinary(const SbBool flag);
   virtual SbBool isBinary(void) const;
+  void setIndexed(const SbBool flag);
+  SbBool isIndexed(void) const;
   virtual void setHeaderString(const SbString & str);
   virtual void resetHeaderString(void);
   virtual void setFloatPrecision(const int precision);
@@ -158,6 +162,10 @@ private:
   friend class SoBase; // Need to be able to remove items from dict.
   friend class SoWriterefCounter; // ditto
   void removeSoBase2IdRef(const SoBase * base);
+
+  friend class SoWriteAction; // Writes the index, see setIndexed().
+  void addIndexEntry(const SbName & name);
+  void writeIndex(void);
 };
 
 #endif // !COIN_SOOUTPUT_H
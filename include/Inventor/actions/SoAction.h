@@ -160,6 +160,7 @@ private:
 
 private:
   SbPimplPtr<SoActionP> pimpl;
+  friend class SoChildList; // for traversalMethods
 
   // NOT IMPLEMENTED:
   SoAction(const SoAction & rhs);
@@ -43,6 +43,7 @@
 #include <Inventor/actions/SoHandleEventAction.h>
 #include <Inventor/actions/SoPickAction.h>
 #include <Inventor/actions/SoRayPickAction.h>
+#include <Inventor/actions/SoMultiRayPickAction.h>
 #include <Inventor/actions/SoSearchAction.h>
 #include <Inventor/actions/SoReorganizeAction.h>
 #include <Inventor/actions/SoWriteAction.h>
@@ -135,6 +135,9 @@ public:
   SbBool isRenderingTranspPaths(void) const;
   SbBool isRenderingTranspBackfaces(void) const;
 
+  void setNumCacheThreads(const int numthreads);
+  int getNumCacheThreads(void) const;
+
 protected:
   friend class SoGLRenderActionP; // calls beginTraversal
   virtual void beginTraversal(SoNode * node);
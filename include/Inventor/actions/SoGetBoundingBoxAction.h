@@ -84,6 +84,9 @@ public:
   SbBool isCenterSet(void) const;
   void resetCenter(void);
 
+  void setNumThreads(const int numthreads);
+  int getNumThreads(void) const;
+
 protected:
   virtual void beginTraversal(SoNode * node);
 
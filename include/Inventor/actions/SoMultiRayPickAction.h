@@ -0,0 +1,79 @@
+#ifndef COIN_SOMULTIRAYPICKACTION_H
+#define COIN_SOMULTIRAYPICKACTION_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#include <Inventor/actions/SoRayPickAction.h>
+
+class SbVec2s;
+class SbVec3f;
+class SbViewportRegion;
+class SoPickedPoint;
+class SoPickedPointList;
+class SoMultiRayPickActionP;
+
+class COIN_DLL_API SoMultiRayPickAction : public SoRayPickAction {
+  typedef SoRayPickAction inherited;
+
+  SO_ACTION_HEADER(SoMultiRayPickAction);
+
+public:
+  SoMultiRayPickAction(const SbViewportRegion & viewportregion);
+  virtual ~SoMultiRayPickAction();
+  static void initClass(void);
+
+  void clearRays(void);
+  int addPoint(const SbVec2s & viewportpoint);
+  void addPointGrid(const SbVec2s & origin, const SbVec2s & step,
+                    const SbVec2s & count);
+  int addRay(const SbVec3f & start, const SbVec3f & direction,
+             float neardistance = -1.0,
+             float fardistance = -1.0);
+  int getNumRays(void) const;
+
+  const SoPickedPointList & getPickedPointList(const int ray) const;
+  SoPickedPoint * getPickedPoint(const int ray, const int index = 0) const;
+
+protected:
+  virtual void beginTraversal(SoNode * node);
+
+private:
+  SbPimplPtr<SoMultiRayPickActionP> pimpl;
+  friend class SoMultiRayPickActionP;
+
+  // NOT IMPLEMENTED:
+  SoMultiRayPickAction(const SoMultiRayPickAction & rhs);
+  SoMultiRayPickAction & operator = (const SoMultiRayPickAction & rhs);
+}; // SoMultiRayPickAction
+
+#endif // !COIN_SOMULTIRAYPICKACTION_H
@@ -95,6 +95,8 @@ protected:
 
 private:
   SbPimplPtr<SoRayPickActionP> pimpl;
+  friend class SoMultiRayPickActionP;
+  friend class SoRayPickActionP;
 
   // NOT IMPLEMENTED:
   SoRayPickAction(const SoRayPickAction & rhs);
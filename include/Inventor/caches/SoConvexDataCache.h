@@ -76,6 +76,7 @@ public:
   int getNumTexIndices(void) const;
 
 private:
+  friend class SoConvexDataCacheP; // for pimpl
   SoConvexDataCacheP * pimpl;
 };
 
@@ -104,6 +104,7 @@ public:
                           const SbBool ccw);
 
 private:
+  friend class SoNormalCacheP; // for pimpl
   SoNormalCacheP * pimpl;
   void clearGenerator(void);
 };
@@ -50,6 +50,10 @@ public:
 
   void evaluateWrapper(void);
 
+  static void evaluateDirtyEngines(void);
+  static void setNumThreads(const int num);
+  static int getNumThreads(void);
+
   virtual int getOutputs(SoEngineOutputList & l) const;
   SoEngineOutput * getOutput(const SbName & outputname) const;
   SbBool getOutputName(const SoEngineOutput * output, SbName & outputname) const;
@@ -87,7 +91,8 @@ private:
 
   enum InternalEngineFlags {
     FLAG_ISNOTIFYING = (1 << 0),
-    FLAG_ISDIRTY = (1 << 1)
+    FLAG_ISDIRTY = (1 << 1),
+    FLAG_ISQUEUED = (1 << 2)
   };
 
   unsigned int flags;
@@ -169,8 +169,10 @@ private:
     FLAG_DONOTIFY = 0x0200,
     FLAG_ISDESTRUCTING = 0x0400,
     FLAG_ISEVALUATING = 0x0800,
-    FLAG_ISNOTIFIED = 0x1000
+    FLAG_ISNOTIFIED = 0x1000,
+    FLAG_SHAREDVALUES = 0x2000 // value array may be shared (SoMField only)
   };
+  friend class SoMField;
 
   void evaluateField(void) const;
   void extendStorageIfNecessary(void);
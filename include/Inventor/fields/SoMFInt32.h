@@ -47,6 +47,7 @@ public:
   static void initClass(void);
 
 private:
+  virtual SbBool readBinaryValues(SoInput * in, int num);
   virtual int getNumValuesPerLine(void) const;
 };
 
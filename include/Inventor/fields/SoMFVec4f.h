@@ -54,6 +54,10 @@ public:
   void setValue(float x, float y, float z, float w);
   void setValue(const float xyzw[4]);
 
+
+private:
+  virtual SbBool readBinaryValues(SoInput * in, int num);
+
 }; // SoMFVec4f
 
 #endif // !COIN_SOMFVEC4F_H
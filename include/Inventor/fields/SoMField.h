@@ -58,6 +58,9 @@ public:
 
   static void initClass(void);
 
+  static void enableValueSharing(const SbBool onoff);
+  static SbBool isValueSharingEnabled(void);
+
   virtual void enableDeleteValues(void);
   virtual SbBool isDeleteValuesEnabled(void) const;
 
@@ -70,6 +73,11 @@ protected:
   virtual void * valuesPtr(void) = 0;
   virtual void setValuesPtr(void * ptr) = 0;
   virtual void allocValues(int num);
+
+  SbBool shareValues(const SoMField & field);
+  void detachValues(void);
+  SbBool hasSharedValues(void);
+  SbBool releaseSharedValues(void);
 #endif // DOXYGEN_SKIP_THIS
 
   virtual SoNotRec createNotRec(SoBase * container);
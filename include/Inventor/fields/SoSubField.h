@@ -263,7 +263,7 @@ public: \
   _valref_ operator=(_valref_ val) { this->setValue(val); return val; } \
   SbBool operator==(const _class_ & field) const; \
   SbBool operator!=(const _class_ & field) const { return !operator==(field); } \
-  _valtype_ * startEditing(void) { this->evaluate(); return this->values; } \
+  _valtype_ * startEditing(void) { this->evaluate(); this->detachValues(); return this->values; } \
   void finishEditing(void) { this->valueChanged(); }
 
 #define SO_MFIELD_DERIVED_VALUE_HEADER(_class_, _valtype_, _valref_) \
@@ -329,6 +329,12 @@ PRIVATE_EQUALITY_SOURCE(_class_); \
 const _class_ & \
 _class_::operator=(const _class_ & field) \
 { \
+  /* Large value arrays are shared until one of the fields is */ \
+  /* changed, see SoMField::shareValues(). */ \
+  if (this->shareValues(field)) { \
+    this->valueChanged(); \
+    return *this; \
+  } \
   /* The allocValues() call is needed, as setValues() doesn't */ \
   /* necessarily make the field's getNum() size become the same */ \
   /* as the second argument (only if it expands on the old size). */ \
@@ -372,6 +378,7 @@ _class_::find(_valref_ value, SbBool addifnotfound) \
 void \
 _class_::setValues(const int start, const int numarg, const _valtype_ * newvals) \
 { \
+  this->detachValues(); \
   if (start+numarg > this->maxNum) this->allocValues(start+numarg); \
   else if (start+numarg > this->num) this->num = start+numarg; \
  \
@@ -385,6 +392,7 @@ _class_::setValues(const int start, const int numarg, const _valtype_ * newvals)
 void \
 _class_::set1Value(const int idx, _valref_ value) \
 { \
+  this->detachValues(); \
   if (idx+1 > this->maxNum) this->allocValues(idx+1); \
   else if (idx+1 > this->num) this->num = idx+1; \
   this->values[idx] = value; \
@@ -443,16 +451,20 @@ _class_::allocValues(int newnum) \
   int i; \
   int oldmaxnum; \
   _valtype_ * newblock; \
+  SbBool shared; \
   assert(newnum >= 0); \
+ \
+  /* A shared array is never changed, so it is always reallocated. */ \
+  shared = this->hasSharedValues(); \
  \
   this->setChangedIndices(); \
   if (newnum == 0) { \
-    if (!this->userDataIsUsed) delete[] this->values; /* don't fetch pointer through valuesPtr() (avoids void* cast) */ \
+    if (!this->userDataIsUsed && !this->releaseSharedValues()) delete[] this->values; /* don't fetch pointer through valuesPtr() (avoids void* cast) */ \
     this->setValuesPtr(NULL); \
     this->maxNum = 0; \
     this->userDataIsUsed = FALSE; \
   } \
-  else if (newnum > this->maxNum || newnum < this->num) { \
+  else if (shared || newnum > this->maxNum || newnum < this->num) { \
     if (this->valuesPtr()) { \
  \
       /* Allocation strategy is to repeatedly double the size of the */ \
@@ -466,13 +478,13 @@ _class_::allocValues(int newnum) \
       while (newnum > this->maxNum) this->maxNum *= 2; \
       while ((this->maxNum / 2) >= newnum) this->maxNum /= 2; \
  \
-      if (oldmaxnum != this->maxNum) { \
+      if (shared || oldmaxnum != this->maxNum) { \
         newblock = new _valtype_[this->maxNum]; \
  \
         for (i=0; i < SbMin(this->num, newnum); i++) \
           newblock[i] = this->values[i]; \
  \
-        delete[] this->values; /* don't fetch pointer through valuesPtr() (avoids void* cast) */ \
+        if (!this->releaseSharedValues()) delete[] this->values; /* don't fetch pointer through valuesPtr() (avoids void* cast) */ \
         this->setValuesPtr(newblock); \
         this->userDataIsUsed = FALSE; \
       } \
@@ -69,6 +69,7 @@ public:
 private:
   SoNode * parent;
   SbList<SoPath *> auditors;
+  SbList<int> methodindices;
 };
 
 #endif // !COIN_SOCHILDLIST_H
@@ -73,6 +73,9 @@ public:
   const SbVec3f & getNormal(const int32_t i) const;
   void setNormal(const int32_t index, const SbVec3f &normal);
 
+  static void setNumThreads(const int num);
+  static int getNumThreads(void);
+
 private:
   SbBSPTree bsp;
   SbList <int> vertexList;
@@ -85,6 +88,9 @@ private:
   int currFaceStart;
 
   SbVec3f calcFaceNormal();
+  int addPoint(const SbVec3f & pt);
+  void generateVertexNormals(const float threshold, const int32_t * vertices,
+                             const int numvertices);
 };
 
 #endif // !COIN_SONORMALGENERATOR_H
@@ -94,6 +94,7 @@ private:
   static int numrendercaches;
 
   SbPimplPtr<SoSeparatorP> pimpl;
+  friend class SoSeparatorP;
 
   // NOT IMPLEMENTED
   SoSeparator(const SoSeparator & rhs);
@@ -84,6 +84,7 @@ protected:
   void readUnlockNormalCache(void);
 
 private:
+  friend class SoVertexShapeP; // for pimpl
   void writeLockNormalCache(void);
   void writeUnlockNormalCache(void);
   SoVertexShapeP * pimpl;
@@ -418,6 +418,7 @@ SoAction::initClasses(void)
   SoHandleEventAction::initClass();
   SoPickAction::initClass();
   SoRayPickAction::initClass();
+  SoMultiRayPickAction::initClass();
   SoSearchAction::initClass();
   SoWriteAction::initClass();
   SoAudioRenderAction::initClass();
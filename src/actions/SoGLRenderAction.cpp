@@ -562,6 +562,7 @@ public:
   SbList<float> sorttranspobjdistances;
   SoGLRenderAction::TransparentDelayedObjectRenderType transpdelayedrendertype;
   SbBool renderingtranspbackfaces;
+  int numcachethreads;
 
   boost::scoped_ptr<SoGetBoundingBoxAction> bboxaction;
   SbVec2f updateorigin, updatesize;
@@ -608,6 +609,16 @@ public:
   void setupFragmentProgram();
   void renderSortedLayersFP(const SoState * state);
 
+  static int defaultNumCacheThreads(void) {
+    static int threads = -1;
+    if (threads == -1) {
+      const char * env = coin_getenv("COIN_SOGLRENDERACTION_CACHE_THREADS");
+      threads = env ? atoi(env) : 0;
+      if (threads < 0) { threads = 0; }
+    }
+    return threads;
+  }
+
   void setupBlending(SoState * state, const SoGLRenderAction::TransparencyType newtype);
   void render(SoNode * node);
   void renderMulti(SoNode * node);
@@ -734,6 +745,7 @@ SoGLRenderAction::SoGLRenderAction(const SbViewportRegion & viewportregion)
   PRIVATE(this)->transpobjdepthwrite = FALSE;
   PRIVATE(this)->transpdelayedrendertype = ONE_PASS;
   PRIVATE(this)->renderingtranspbackfaces = FALSE;
+  PRIVATE(this)->numcachethreads = SoGLRenderActionP::defaultNumCacheThreads();
 
   PRIVATE(this)->sortedobjectstrategy = BBOX_CENTER;
   PRIVATE(this)->sortedobjectcb = NULL;
@@ -2017,6 +2029,55 @@ SoGLRenderAction::isRenderingTranspBackfaces(void) const
   return PRIVATE(this)->renderingtranspbackfaces;
 }
 
+/*!
+  Sets the number of worker threads used to rebuild shape caches
+  which have been invalidated.
+
+  With one or more threads, a shape whose normal cache or
+  tessellation cache (SoNormalCache, SoConvexDataCache) is invalid
+  goes on rendering with the old cache while the new one is built on
+  a worker thread. The node is touched when the new cache is ready,
+  so that it is picked up by the next redraw. This avoids stalls
+  when the coordinates of big shapes are animated or streamed in,
+  at the price of rendering with normals and triangles which lag
+  behind the coordinates for a frame or a few.
+
+  The old cache is only used if the shape's own fields and the
+  number of coordinates are the same as when it was built. Otherwise,
+  and the first time a shape is rendered, the cache is built before
+  rendering as usual. Primitive vertex caches (used for sorted
+  transparency and bump mapping) are always built before rendering,
+  since they are made from the full traversal state.
+
+  Set to 0 to build all caches before rendering, which is the default
+  unless the COIN_SOGLRENDERACTION_CACHE_THREADS environment variable
+  is set. Has no effect unless Coin was built with \c COIN_THREADSAFE,
+  since a finished job schedules a sensor from its worker thread.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.1
+*/
+void
+SoGLRenderAction::setNumCacheThreads(const int numthreads)
+{
+  PRIVATE(this)->numcachethreads = SbMax(numthreads, 0);
+}
+
+/*!
+  Returns the number of threads used to rebuild shape caches.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setNumCacheThreads()
+  \since Coin 4.1
+*/
+int
+SoGLRenderAction::getNumCacheThreads(void) const
+{
+  return PRIVATE(this)->numcachethreads;
+}
+
 /*!
   Sets the render type of delayed or sorted transparent objects. Default is ONE_PASS.
 
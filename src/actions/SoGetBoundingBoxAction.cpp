@@ -88,6 +88,9 @@
 #include <Inventor/lists/SoEnabledElementsList.h>
 #include <Inventor/misc/SoState.h>
 #include <Inventor/nodes/SoNode.h>
+#include <Inventor/C/tidbits.h> // coin_getenv()
+
+#include <cstdlib> // atoi()
 
 #if COIN_DEBUG
 #include <Inventor/errors/SoDebugError.h>
@@ -220,8 +223,25 @@
 
 class SoGetBoundingBoxActionP {
 public:
+  SoGetBoundingBoxActionP(void) {
+    this->numthreads = SoGetBoundingBoxActionP::defaultNumThreads();
+  }
+
+  int numthreads;
+
+  static int defaultNumThreads(void) {
+    static int threads = -1;
+    if (threads == -1) {
+      const char * env = coin_getenv("COIN_SOGETBOUNDINGBOXACTION_THREADS");
+      threads = env ? atoi(env) : 0;
+      if (threads < 0) { threads = 0; }
+    }
+    return threads;
+  }
 };
 
+#define PRIVATE(obj) ((obj)->pimpl)
+
 SO_ACTION_SOURCE(SoGetBoundingBoxAction);
 
 
@@ -590,6 +610,50 @@ SoGetBoundingBoxAction::resetCenter(void)
   this->center.setValue(0.0f, 0.0f, 0.0f);
 }
 
+/*!
+  Sets the number of threads used to calculate bounding boxes.
+
+  With one or more threads, an SoSeparator which needs to recalculate
+  its bounding box cache first splits its subgraph into independent
+  child separators, and builds their bounding box caches in parallel.
+  The separator's own traversal then picks up the cached results.
+  This makes the first bounding box calculation on a big scene
+  considerably faster, while results for unchanged scenes come
+  straight from the caches as before.
+
+  Subgraphs which share nodes with other parts of the scene, or which
+  contain field connections, are always traversed on the calling
+  thread.
+
+  Set to 0 to do all the work on the calling thread, which is the
+  default unless the COIN_SOGETBOUNDINGBOXACTION_THREADS environment
+  variable is set. Has no effect if Coin was built without support for
+  threads.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.1
+*/
+void
+SoGetBoundingBoxAction::setNumThreads(const int numthreads)
+{
+  PRIVATE(this)->numthreads = SbMax(numthreads, 0);
+}
+
+/*!
+  Returns the number of threads used to calculate bounding boxes.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setNumThreads()
+  \since Coin 4.1
+*/
+int
+SoGetBoundingBoxAction::getNumThreads(void) const
+{
+  return PRIVATE(this)->numthreads;
+}
+
 // Documented in superclass. Overridden to reset center point and
 // bounding box before traversal starts.
 void
@@ -601,3 +665,78 @@ SoGetBoundingBoxAction::beginTraversal(SoNode * node)
   SoViewportRegionElement::set(this->getState(), this->vpregion);
   inherited::beginTraversal(node);
 }
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoTranslation.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoPointSet.h>
+
+static SoSeparator *
+create_bbox_scene(SoTranslation *& movable)
+{
+  SoSeparator * root = new SoSeparator;
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->point.set1Value(0, SbVec3f(-20, 0, 0));
+  coords->point.set1Value(1, SbVec3f(0, 30, 0));
+  root->addChild(coords);
+
+  SoSeparator * shared = new SoSeparator;
+  shared->addChild(new SoCube);
+
+  SoGroup * group = new SoGroup;
+  root->addChild(group);
+  for (int i = 0; i < 16; i++) {
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * t = new SoTranslation;
+    t->translation = SbVec3f(float(i), float(i % 4), 0.0f);
+    sep->addChild(t);
+    if (i == 7) { movable = t; }
+    // uses the coordinates from outside the subgraph
+    sep->addChild((i % 3) ? (SoNode *) new SoCube : (SoNode *) new SoPointSet);
+    if (i % 5 == 0) { sep->addChild(shared); }
+    group->addChild(sep);
+  }
+  return root;
+}
+
+BOOST_AUTO_TEST_CASE(parallelBoundingBox)
+{
+  SoTranslation * t1 = NULL, * t2 = NULL;
+  SoSeparator * serialroot = create_bbox_scene(t1);
+  SoSeparator * threadedroot = create_bbox_scene(t2);
+  serialroot->ref();
+  threadedroot->ref();
+
+  SbViewportRegion vp(100, 100);
+  SoGetBoundingBoxAction serial(vp);
+  serial.setNumThreads(0);
+  SoGetBoundingBoxAction threaded(vp);
+  threaded.setNumThreads(4);
+  BOOST_CHECK_EQUAL(threaded.getNumThreads(), 4);
+
+  for (int i = 0; i < 3; i++) {
+    if (i == 2) {
+      t1->translation = SbVec3f(100, 0, 0);
+      t2->translation = SbVec3f(100, 0, 0);
+    }
+    serial.apply(serialroot);
+    threaded.apply(threadedroot);
+    const SbBox3f a = serial.getBoundingBox();
+    const SbBox3f b = threaded.getBoundingBox();
+    BOOST_CHECK_MESSAGE(a.getMin() == b.getMin() && a.getMax() == b.getMax(),
+                        "bounding box calculated on threads differs");
+    BOOST_CHECK_MESSAGE(serial.getCenter() == threaded.getCenter(),
+                        "center calculated on threads differs");
+  }
+
+  serialroot->unref();
+  threadedroot->unref();
+}
+
+#endif // COIN_TEST_SUITE
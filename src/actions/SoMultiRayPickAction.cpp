@@ -0,0 +1,825 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+/*!
+  \class SoMultiRayPickAction SoMultiRayPickAction.h Inventor/actions/SoMultiRayPickAction.h
+  \brief The SoMultiRayPickAction class intersects many rays with a scene graph in one traversal.
+
+  \ingroup coin_actions
+
+  Picking with many rays, like when sampling what is visible under a
+  grid of viewport points, is expensive with SoRayPickAction, as the
+  scene graph must be traversed once for each ray, and the primitives
+  of every shape a ray might hit are generated over and over again.
+
+  SoMultiRayPickAction traverses the scene graph once for all the rays
+  added with addPoint(), addPointGrid() and addRay(). SoSeparator
+  nodes with pick culling enabled only pass on the rays which
+  intersect their bounding box, and shapes which pick the primitives
+  they generate (i.e. which do not override SoShape::rayPick()) only
+  generate them once, testing each triangle against all their rays in
+  a single loop. Other shapes are picked one ray at a time. The
+  result for each ray is the same as for an SoRayPickAction with the
+  same settings, and is available from getPickedPointList(ray).
+
+  \code
+  SoMultiRayPickAction rp(viewer->getViewportRegion());
+  rp.addPointGrid(SbVec2s(0, 0), SbVec2s(8, 8), SbVec2s(80, 60));
+  rp.apply(root);
+  for (int i = 0; i < rp.getNumRays(); i++) {
+    SoPickedPoint * pp = rp.getPickedPoint(i);
+    // pp is NULL if ray i did not hit anything
+  }
+  \endcode
+
+  setRadius() and setPickAll() apply to all the rays. The
+  setPoint(), setNormalizedPoint() and setRay() methods inherited
+  from SoRayPickAction should not be used with this action, and the
+  inherited getPickedPointList() and getPickedPoint() methods
+  without a ray argument return no picked points.
+
+  \since Coin 4.1
+*/
+
+#include <Inventor/actions/SoMultiRayPickAction.h>
+
+#include <cfloat>
+#include <cmath>
+
+#include <Inventor/SbLine.h>
+#include <Inventor/SbXfBox3f.h>
+#include <Inventor/SbViewVolume.h>
+#include <Inventor/caches/SoBoundingBoxCache.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/lists/SoPickedPointList.h>
+#include <Inventor/misc/SoState.h>
+#include <Inventor/nodes/SoCamera.h>
+#include <Inventor/nodes/SoShape.h>
+
+#include "actions/SoSubActionP.h"
+#include "actions/SoRayPickActionP.h"
+#include "actions/SoMultiRayPickActionP.h"
+#include "caches/SoRayPickCache.h"
+#include "SbBasicP.h"
+
+#define PRIVATE(obj) ((obj)->pimpl)
+
+// *************************************************************************
+
+SO_ACTION_SOURCE(SoMultiRayPickAction);
+
+/*!
+  \copydetails SoAction::initClass(void)
+*/
+void
+SoMultiRayPickAction::initClass(void)
+{
+  SO_ACTION_INTERNAL_INIT_CLASS(SoMultiRayPickAction, SoRayPickAction);
+}
+
+/*!
+  Constructor. See SoRayPickAction::SoRayPickAction() for a
+  description of \a viewportregion.
+*/
+SoMultiRayPickAction::SoMultiRayPickAction(const SbViewportRegion & viewportregion)
+  : inherited(viewportregion)
+{
+  PRIVATE(this)->owner = this;
+
+  SO_ACTION_CONSTRUCTOR(SoMultiRayPickAction);
+}
+
+/*!
+  Destructor.
+*/
+SoMultiRayPickAction::~SoMultiRayPickAction()
+{
+}
+
+/*!
+  Removes all rays, and the points picked by them.
+*/
+void
+SoMultiRayPickAction::clearRays(void)
+{
+  PRIVATE(this)->cleanupRays();
+  PRIVATE(this)->raydefs.truncate(0);
+}
+
+/*!
+  Adds a ray through the viewport-space point \a viewportpoint, from
+  the near clipping plane to the far clipping plane of the camera, like
+  SoRayPickAction::setPoint() does. Returns the index of the ray.
+*/
+int
+SoMultiRayPickAction::addPoint(const SbVec2s & viewportpoint)
+{
+  SoMultiRayPickActionP::RayDef ray;
+  ray.ispoint = TRUE;
+  ray.point = viewportpoint;
+  ray.neardistance = ray.fardistance = -1.0f;
+  PRIVATE(this)->raydefs.append(ray);
+  return PRIVATE(this)->raydefs.getLength() - 1;
+}
+
+/*!
+  Adds rays through a grid of \a count[0] times \a count[1]
+  viewport-space points, starting at \a origin, with \a step pixels
+  between the points. The rays are added row by row, starting with
+  the row at \a origin, so the ray through the point
+  (origin[0] + i * step[0], origin[1] + j * step[1]) gets index
+  getNumRays() + j * count[0] + i, where getNumRays() is the number
+  of rays before this call.
+*/
+void
+SoMultiRayPickAction::addPointGrid(const SbVec2s & origin, const SbVec2s & step,
+                                   const SbVec2s & count)
+{
+  for (int j = 0; j < count[1]; j++) {
+    for (int i = 0; i < count[0]; i++) {
+      this->addPoint(SbVec2s(short(origin[0] + i * step[0]),
+                             short(origin[1] + j * step[1])));
+    }
+  }
+}
+
+/*!
+  Adds a ray in world space coordinates, like SoRayPickAction::setRay()
+  does. Returns the index of the ray.
+*/
+int
+SoMultiRayPickAction::addRay(const SbVec3f & start, const SbVec3f & direction,
+                             float neardistance, float fardistance)
+{
+  SoMultiRayPickActionP::RayDef ray;
+  ray.ispoint = FALSE;
+  ray.start = start;
+  ray.direction = direction;
+  ray.neardistance = neardistance;
+  ray.fardistance = fardistance;
+  PRIVATE(this)->raydefs.append(ray);
+  return PRIVATE(this)->raydefs.getLength() - 1;
+}
+
+/*!
+  Returns the number of rays.
+*/
+int
+SoMultiRayPickAction::getNumRays(void) const
+{
+  return PRIVATE(this)->raydefs.getLength();
+}
+
+/*!
+  Returns the list of points picked by \a ray, sorted by distance
+  like SoRayPickAction::getPickedPointList().
+*/
+const SoPickedPointList &
+SoMultiRayPickAction::getPickedPointList(const int ray) const
+{
+  assert(ray >= 0 && ray < PRIVATE(this)->raydefs.getLength());
+  static SoPickedPointList * emptylist = NULL;
+  if (ray >= PRIVATE(this)->raystates.getLength()) {
+    // the action has not been applied since the ray was added
+    if (emptylist == NULL) emptylist = new SoPickedPointList;
+    return *emptylist;
+  }
+  SoRayPickActionP * state = PRIVATE(this)->getRayState(ray);
+  state->sortPickedPoints();
+  return state->pickedpointlist;
+}
+
+/*!
+  Returns the point with \a index in the list of points picked by \a
+  ray, or \c NULL if less than \a index + 1 points were picked.
+*/
+SoPickedPoint *
+SoMultiRayPickAction::getPickedPoint(const int ray, const int index) const
+{
+  assert(index >= 0);
+  const SoPickedPointList & list = this->getPickedPointList(ray);
+  if (index < list.getLength()) return list[index];
+  return NULL;
+}
+
+// Documented in superclass.
+void
+SoMultiRayPickAction::beginTraversal(SoNode * node)
+{
+  PRIVATE(this)->setupRays();
+  if (PRIVATE(this)->raystates.getLength() > 0) {
+    inherited::beginTraversal(node);
+  }
+  PRIVATE(this)->finishRays();
+}
+
+// *************************************************************************
+
+SoMultiRayPickActionP::SoMultiRayPickActionP(void)
+  : currentray(-1),
+    batchshape(NULL),
+    batched(FALSE),
+    osrays(NULL),
+    rayhits(NULL),
+    foundrays(NULL),
+    found(NULL),
+    numosrays(0),
+    osraysstart(0),
+    numallocated(0),
+    usetriangles(FALSE),
+    owner(NULL)
+{
+}
+
+SoMultiRayPickActionP::~SoMultiRayPickActionP()
+{
+  this->cleanupRays();
+  delete[] this->osrays;
+  delete[] this->rayhits;
+  delete[] this->foundrays;
+}
+
+SoMultiRayPickActionP *
+SoMultiRayPickActionP::get(SoAction * action)
+{
+  if (!action->isOfType(SoMultiRayPickAction::getClassTypeId())) return NULL;
+  return &PRIVATE(static_cast<SoMultiRayPickAction *>(action)).get();
+}
+
+// The SoRayPickAction state of the current ray is kept in the action
+// itself, and the state of the other rays in raystates. The picked
+// points are owned by whichever state holds the pointers, so the
+// lists are moved rather than copied when switching rays.
+SoRayPickActionP *
+SoMultiRayPickActionP::getRayState(const int ray) const
+{
+  if (ray == this->currentray) {
+    return &PRIVATE(static_cast<SoRayPickAction *>(this->owner)).get();
+  }
+  return this->raystates[ray];
+}
+
+SbBool
+SoMultiRayPickActionP::selectRay(const int ray)
+{
+  if (ray == this->currentray) return FALSE;
+  SoRayPickActionP * rp = &PRIVATE(static_cast<SoRayPickAction *>(this->owner)).get();
+  SoRayPickActionP * prev = this->raystates[this->currentray];
+  SoRayPickActionP * next = this->raystates[ray];
+  // the shape pick state belongs to the action, not to a ray
+  void * shapepickstate = rp->shapepickstate;
+  *prev = *rp;
+  *rp = *next;
+  rp->shapepickstate = shapepickstate;
+  // SbPList::truncate() does not delete the picked points
+  static_cast<SbPList &>(next->pickedpointlist).truncate(0);
+  next->ppdistance.truncate(0);
+  this->currentray = ray;
+  return TRUE;
+}
+
+void
+SoMultiRayPickActionP::setupRays(void)
+{
+  this->cleanupRays();
+
+  const int numrays = this->raydefs.getLength();
+  if (numrays == 0) return;
+
+  SoRayPickAction * ra = this->owner;
+  SoRayPickActionP * rp = &PRIVATE(ra).get();
+  rp->cleanupPickedPoints();
+
+  // let SoRayPickAction set up the state for each ray
+  for (int i = 0; i < numrays; i++) {
+    const RayDef & def = this->raydefs[i];
+    if (def.ispoint) ra->setPoint(def.point);
+    else ra->setRay(def.start, def.direction, def.neardistance, def.fardistance);
+    this->raystates.append(new SoRayPickActionP(*rp));
+    this->worldrays.append(WorldRay());
+  }
+  *rp = *this->raystates[0];
+  this->currentray = 0;
+
+  for (int i = 0; i < numrays; i++) {
+    this->activerays.append(i);
+    this->updateWorldRay(i);
+  }
+  this->activestart.push(0);
+
+  if (numrays > this->numallocated) {
+    delete[] this->osrays;
+    delete[] this->rayhits;
+    delete[] this->foundrays;
+    this->osrays = new double[numrays * 6];
+    this->rayhits = new unsigned char[numrays];
+    this->foundrays = new int[numrays];
+    this->numallocated = numrays;
+  }
+}
+
+void
+SoMultiRayPickActionP::finishRays(void)
+{
+  if (this->currentray < 0) return;
+  SoRayPickActionP * rp = &PRIVATE(static_cast<SoRayPickAction *>(this->owner)).get();
+  *this->raystates[this->currentray] = *rp;
+  static_cast<SbPList &>(rp->pickedpointlist).truncate(0);
+  rp->ppdistance.truncate(0);
+  this->currentray = -1;
+  this->activerays.truncate(0);
+  this->activestart.truncate(0);
+}
+
+void
+SoMultiRayPickActionP::cleanupRays(void)
+{
+  this->finishRays();
+  for (int i = 0; i < this->raystates.getLength(); i++) {
+    delete this->raystates[i];
+  }
+  this->raystates.truncate(0);
+  this->worldrays.truncate(0);
+}
+
+void
+SoMultiRayPickActionP::updateWorldRay(const int ray)
+{
+  const SoRayPickActionP * state = this->getRayState(ray);
+  WorldRay & wr = this->worldrays[ray];
+  wr.valid = state->isFlagSet(SoRayPickActionP::WS_RAY_SET |
+                              SoRayPickActionP::WS_RAY_COMPUTED);
+  // SoRayPickAction::intersect() picks boxes with a cone around rays
+  // calculated from a viewport point
+  wr.cone = !state->isFlagSet(SoRayPickActionP::WS_RAY_SET);
+  wr.start = state->raystart;
+  wr.direction = state->raydirection;
+  wr.radiusstart = state->rayradiusstart;
+  wr.radiusdelta = state->rayradiusdelta;
+}
+
+SbBool
+SoMultiRayPickActionP::pushRays(SoState * state, const SbXfBox3f & box)
+{
+  if (box.isEmpty()) return FALSE;
+
+  // a world space box containing the box is good enough for culling
+  SbXfBox3f xfbox(box);
+  xfbox.transform(SoModelMatrixElement::get(state));
+  const SbBox3f wsbox = xfbox.project();
+  SbVec3d bmin, bmax;
+  bmin.setValue(wsbox.getMin());
+  bmax.setValue(wsbox.getMax());
+  const SbVec3d center = (bmin + bmax) * 0.5;
+  const double halfdiag = (bmax - bmin).length() * 0.5;
+
+  const int start = this->activestart[this->activestart.getLength() - 1];
+  const int end = this->activerays.getLength();
+  for (int i = start; i < end; i++) {
+    const int ray = this->activerays[i];
+    const WorldRay & wr = this->worldrays[ray];
+    SbBool hit = TRUE;
+    if (wr.valid) {
+      double pad = 0.0;
+      if (wr.cone) {
+        // the cone is never wider than at the point of the box
+        // farthest from the start of the ray
+        const double dist = (center - wr.start).length() + halfdiag;
+        pad = wr.radiusstart + wr.radiusdelta * dist;
+      }
+      double tmin = -DBL_MAX;
+      double tmax = DBL_MAX;
+      for (int axis = 0; axis < 3 && hit; axis++) {
+        const double lo = bmin[axis] - pad;
+        const double hi = bmax[axis] + pad;
+        const double o = wr.start[axis];
+        const double d = wr.direction[axis];
+        if (d == 0.0) {
+          hit = o >= lo && o <= hi;
+        }
+        else {
+          double t0 = (lo - o) / d;
+          double t1 = (hi - o) / d;
+          if (t0 > t1) { const double tmp = t0; t0 = t1; t1 = tmp; }
+          if (t0 > tmin) tmin = t0;
+          if (t1 < tmax) tmax = t1;
+          hit = tmin <= tmax;
+        }
+      }
+    }
+    if (hit) this->activerays.append(ray);
+  }
+  if (this->activerays.getLength() == end) return FALSE;
+  this->activestart.push(end);
+  return TRUE;
+}
+
+void
+SoMultiRayPickActionP::popRays(void)
+{
+  this->activerays.truncate(this->activestart.pop());
+}
+
+int
+SoMultiRayPickActionP::getNumActiveRays(void) const
+{
+  if (this->activestart.getLength() == 0) return 0;
+  return this->activerays.getLength() -
+    this->activestart[this->activestart.getLength() - 1];
+}
+
+const int *
+SoMultiRayPickActionP::getActiveRays(void) const
+{
+  return this->activerays.getArrayPtr() +
+    this->activestart[this->activestart.getLength() - 1];
+}
+
+SbBool
+SoMultiRayPickActionP::claimShape(const SoNode * shape)
+{
+  if (this->batchshape != shape) return FALSE;
+  this->batchshape = NULL;
+  this->batched = TRUE;
+  return TRUE;
+}
+
+void
+SoMultiRayPickActionP::setObjectSpaceRays(SoState * state)
+{
+  const SbDPMatrix world2obj =
+    SbDPMatrix(SoModelMatrixElement::get(state)).inverse();
+
+  const int num = this->getNumActiveRays();
+  const int * rays = this->getActiveRays();
+  const int stride = this->numallocated;
+  double * ox = this->osrays;
+
+  for (int i = 0; i < num; i++) {
+    const WorldRay & wr = this->worldrays[rays[i]];
+    SbVec3d start(0.0, 0.0, 0.0);
+    SbVec3d dir(0.0, 0.0, 0.0); // will not hit anything
+    if (wr.valid) {
+      world2obj.multVecMatrix(wr.start, start);
+      world2obj.multDirMatrix(wr.direction, dir);
+    }
+    for (int c = 0; c < 3; c++) {
+      ox[c * stride + i] = start[c];
+      ox[(c + 3) * stride + i] = dir[c];
+    }
+  }
+  this->numosrays = num;
+  this->osraysstart = this->activestart[this->activestart.getLength() - 1];
+  this->usetriangles = FALSE;
+}
+
+SbBool
+SoMultiRayPickActionP::findTriangles(const SoRayPickCache * cache)
+{
+  const int num = this->numosrays;
+  const int stride = this->numallocated;
+  const double * ox = this->osrays;
+  const int * rays = this->activerays.getArrayPtr() + this->osraysstart;
+
+  // the candidates for each ray are appended after each other
+  SbList<int> candidates;
+  SbList<int> raystart(num + 1);
+  for (int i = 0; i < num; i++) {
+    raystart.append(candidates.getLength());
+    const SbVec3f start(float(ox[i]), float(ox[stride + i]), float(ox[2 * stride + i]));
+    const SbVec3f dir(float(ox[3 * stride + i]), float(ox[4 * stride + i]),
+                      float(ox[5 * stride + i]));
+    if (dir == SbVec3f(0.0f, 0.0f, 0.0f)) continue;
+    cache->findTriangles(SbLine(start, start + dir), candidates);
+  }
+  raystart.append(candidates.getLength());
+  if (candidates.getLength() == 0) return FALSE;
+
+  // sort the candidates by triangle
+  const int numtriangles = cache->getNumTriangles();
+  this->trianglestart.truncate(0);
+  for (int i = 0; i <= numtriangles; i++) this->trianglestart.append(0);
+  int * start = const_cast<int *>(this->trianglestart.getArrayPtr());
+  for (int i = 0; i < candidates.getLength(); i++) start[candidates[i] + 1]++;
+  for (int i = 0; i < numtriangles; i++) start[i + 1] += start[i];
+
+  this->trianglerays.truncate(0);
+  for (int i = 0; i < candidates.getLength(); i++) this->trianglerays.append(0);
+  int * trianglerays = const_cast<int *>(this->trianglerays.getArrayPtr());
+  for (int i = 0; i < num; i++) {
+    for (int j = raystart[i]; j < raystart[i + 1]; j++) {
+      trianglerays[start[candidates[j]]++] = rays[i];
+    }
+  }
+  // shift the starts back after using them as insertion points
+  for (int i = numtriangles; i > 0; i--) start[i] = start[i - 1];
+  start[0] = 0;
+
+  this->usetriangles = TRUE;
+  return TRUE;
+}
+
+// Möller-Trumbore ray/triangle test for all the object space rays,
+// like SoRayPickAction::intersect() does it for one ray, but without
+// the divisions and with some slack, so that no ray that
+// SoRayPickAction::intersect() would accept is missed. The loop has no
+// branches, so that it can be vectorized.
+int
+SoMultiRayPickActionP::findRays(const int triangle, const SbVec3f & v0,
+                                const SbVec3f & v1, const SbVec3f & v2)
+{
+  if (this->usetriangles) {
+    if (triangle + 1 >= this->trianglestart.getLength()) return 0;
+    const int first = this->trianglestart[triangle];
+    this->found = this->trianglerays.getArrayPtr() + first;
+    return this->trianglestart[triangle + 1] - first;
+  }
+
+  const double v0x = v0[0], v0y = v0[1], v0z = v0[2];
+  const double e1x = double(v1[0]) - v0x;
+  const double e1y = double(v1[1]) - v0y;
+  const double e1z = double(v1[2]) - v0z;
+  const double e2x = double(v2[0]) - v0x;
+  const double e2y = double(v2[1]) - v0y;
+  const double e2z = double(v2[2]) - v0z;
+
+  const int num = this->numosrays;
+  const int stride = this->numallocated;
+  const double * ox = this->osrays;
+  const double * oy = ox + stride;
+  const double * oz = oy + stride;
+  const double * dx = oz + stride;
+  const double * dy = dx + stride;
+  const double * dz = dy + stride;
+  unsigned char * hits = this->rayhits;
+
+  for (int i = 0; i < num; i++) {
+    const double px = dy[i] * e2z - dz[i] * e2y;
+    const double py = dz[i] * e2x - dx[i] * e2z;
+    const double pz = dx[i] * e2y - dy[i] * e2x;
+    const double det = e1x * px + e1y * py + e1z * pz;
+
+    const double tx = ox[i] - v0x;
+    const double ty = oy[i] - v0y;
+    const double tz = oz[i] - v0z;
+    const double qx = ty * e1z - tz * e1y;
+    const double qy = tz * e1x - tx * e1z;
+    const double qz = tx * e1y - ty * e1x;
+
+    // u and v scaled by det, with the sign of det
+    const double sign = det < 0.0 ? -1.0 : 1.0;
+    const double u = (tx * px + ty * py + tz * pz) * sign;
+    const double v = (dx[i] * qx + dy[i] * qy + dz[i] * qz) * sign;
+    const double absdet = det * sign;
+    const double slack = absdet * 1.0e-6;
+
+    hits[i] = (unsigned char)
+      ((absdet > 0.0) & (u >= -slack) & (v >= -slack) & (u + v <= absdet + slack));
+  }
+
+  const int * rays = this->activerays.getArrayPtr() + this->osraysstart;
+  int numfound = 0;
+  for (int i = 0; i < num; i++) {
+    if (hits[i]) this->foundrays[numfound++] = rays[i];
+  }
+  this->found = this->foundrays;
+  return numfound;
+}
+
+const int *
+SoMultiRayPickActionP::getFoundRays(void) const
+{
+  return this->found;
+}
+
+// Calculates the world space rays for all the active rays, not only
+// for the current one like SoCamera::rayPick() does.
+void
+SoMultiRayPickActionP::cameraS(SoAction * action, SoNode * node)
+{
+  SoMultiRayPickActionP * thisp = SoMultiRayPickActionP::get(action);
+  SoRayPickAction * ra = static_cast<SoRayPickAction *>(action);
+  const int num = thisp->getNumActiveRays();
+  if (num == 0) return;
+  const int start = thisp->activestart[thisp->activestart.getLength() - 1];
+
+  thisp->selectRay(thisp->activerays[start]);
+  SoNode::rayPickS(action, node);
+
+  SoCamera * camera = coin_assert_cast<SoCamera *>(node);
+  SbViewVolume vv = camera->getViewVolume(1.0f);
+  if (vv.getDepth() != 0.0f &&
+      vv.getWidth() != 0.0f &&
+      vv.getHeight() != 0.0f) {
+    for (int i = 1; i < num; i++) {
+      thisp->selectRay(thisp->activerays[start + i]);
+      ra->computeWorldSpaceRay();
+    }
+  }
+  for (int i = 0; i < num; i++) {
+    thisp->updateWorldRay(thisp->activerays[start + i]);
+  }
+}
+
+// Picks a shape with all the active rays which intersect its bounding
+// box. SoShape::rayPick() claims the shape to pick all the rays at
+// once, and shapes with their own rayPick() are picked once for each
+// ray.
+void
+SoMultiRayPickActionP::shapeS(SoAction * action, SoNode * node)
+{
+  SoMultiRayPickActionP * thisp = SoMultiRayPickActionP::get(action);
+  if (thisp->getNumActiveRays() == 0) return;
+
+  SoState * state = action->getState();
+  const SoBoundingBoxCache * bboxcache =
+    coin_assert_cast<SoShape *>(node)->getBoundingBoxCache();
+  SbBool pushed = FALSE;
+  if (bboxcache && bboxcache->isValid(state)) {
+    if (!thisp->pushRays(state, bboxcache->getProjectedBox())) return;
+    pushed = TRUE;
+  }
+
+  const int num = thisp->getNumActiveRays();
+  const int start = thisp->activestart[thisp->activestart.getLength() - 1];
+
+  thisp->selectRay(thisp->activerays[start]);
+  thisp->batchshape = node;
+  thisp->batched = FALSE;
+  SoNode::rayPickS(action, node);
+  thisp->batchshape = NULL;
+
+  if (!thisp->batched) {
+    for (int i = 1; i < num; i++) {
+      thisp->selectRay(thisp->activerays[start + i]);
+      SoNode::rayPickS(action, node);
+    }
+  }
+  thisp->batched = FALSE;
+
+  if (pushed) thisp->popRays();
+}
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SoPath.h>
+#include <Inventor/SoPickedPoint.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoLineSet.h>
+#include <Inventor/nodes/SoOrthographicCamera.h>
+#include <Inventor/nodes/SoTranslation.h>
+#include <Inventor/VRMLnodes/SoVRMLBox.h>
+#include <Inventor/VRMLnodes/SoVRMLGroup.h>
+#include <Inventor/VRMLnodes/SoVRMLShape.h>
+#include <Inventor/VRMLnodes/SoVRMLSphere.h>
+#include <Inventor/VRMLnodes/SoVRMLTransform.h>
+
+BOOST_AUTO_TEST_CASE(matchesRayPickAction)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoOrthographicCamera * camera = new SoOrthographicCamera;
+  root->addChild(camera);
+
+  // a grid with holes, to be picked by the triangle tests
+  SoSeparator * gridsep = new SoSeparator;
+  root->addChild(gridsep);
+  SoCoordinate3 * coords = new SoCoordinate3;
+  const int N = 20;
+  for (int y = 0; y < N; y++) {
+    for (int x = 0; x < N; x++) {
+      coords->point.set1Value(y * N + x, SbVec3f(float(x) - N / 2, float(y) - N / 2, 0.0f));
+    }
+  }
+  gridsep->addChild(coords);
+  SoIndexedFaceSet * grid = new SoIndexedFaceSet;
+  int idx = 0;
+  for (int y = 0; y < N - 1; y++) {
+    for (int x = 0; x < N - 1; x++) {
+      if ((x + y) % 3 == 0) continue;
+      const int32_t face[] = { y * N + x, y * N + x + 1, (y + 1) * N + x + 1, (y + 1) * N + x, -1 };
+      grid->coordIndex.setValues(idx, 5, face);
+      idx += 5;
+    }
+  }
+  gridsep->addChild(grid);
+
+  // shapes which do their own picking, and a line set
+  SoSeparator * cubesep = new SoSeparator;
+  root->addChild(cubesep);
+  SoTranslation * t = new SoTranslation;
+  t->translation = SbVec3f(3.0f, 2.0f, 2.0f);
+  cubesep->addChild(t);
+  cubesep->addChild(new SoCube);
+  SoCoordinate3 * linecoords = new SoCoordinate3;
+  linecoords->point.set1Value(0, SbVec3f(-8.0f, -4.0f, 1.0f));
+  linecoords->point.set1Value(1, SbVec3f(8.0f, -3.0f, 1.0f));
+  cubesep->addChild(linecoords);
+  cubesep->addChild(new SoLineSet);
+
+  // VRML groups, which cull the rays against their bounding boxes
+  SoVRMLGroup * vrmlgroup = new SoVRMLGroup;
+  root->addChild(vrmlgroup);
+  for (int k = 0; k < 3; k++) {
+    SoVRMLTransform * vrmltransform = new SoVRMLTransform;
+    vrmltransform->translation = SbVec3f(-6.0f + k * 4.0f, 6.0f, 1.0f);
+    SoVRMLShape * box = new SoVRMLShape;
+    box->geometry = new SoVRMLBox;
+    vrmltransform->addChild(box);
+    SoVRMLGroup * inner = new SoVRMLGroup;
+    SoVRMLShape * sphere = new SoVRMLShape;
+    sphere->geometry = new SoVRMLSphere;
+    inner->addChild(sphere);
+    SoVRMLTransform * offset = new SoVRMLTransform;
+    offset->translation = SbVec3f(0.0f, -3.0f, 0.5f);
+    offset->addChild(inner);
+    vrmltransform->addChild(offset);
+    vrmlgroup->addChild(vrmltransform);
+  }
+
+  SbViewportRegion vp(100, 100);
+  camera->viewAll(root, vp);
+
+  SoMultiRayPickAction multi(vp);
+  SoRayPickAction single(vp);
+  for (int j = 0; j < 25; j++) {
+    for (int i = 0; i < 25; i++) {
+      BOOST_CHECK_EQUAL(multi.addPoint(SbVec2s(short(2 + i * 4), short(2 + j * 4))), j * 25 + i);
+    }
+  }
+  multi.addRay(SbVec3f(3.2f, 2.1f, 10.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+  BOOST_CHECK_EQUAL(multi.getNumRays(), 25 * 25 + 1);
+
+  for (int pickall = 0; pickall < 2; pickall++) {
+    multi.setPickAll(pickall);
+    single.setPickAll(pickall);
+    multi.apply(root);
+
+    int numhits = 0;
+    int numdiffs = 0;
+    for (int r = 0; r < multi.getNumRays(); r++) {
+      if (r < 25 * 25) single.setPoint(SbVec2s(short(2 + (r % 25) * 4), short(2 + (r / 25) * 4)));
+      else single.setRay(SbVec3f(3.2f, 2.1f, 10.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+      single.apply(root);
+
+      const SoPickedPointList & expected = single.getPickedPointList();
+      const SoPickedPointList & result = multi.getPickedPointList(r);
+      if (expected.getLength() != result.getLength()) {
+        numdiffs++;
+        continue;
+      }
+      for (int i = 0; i < expected.getLength(); i++) {
+        numhits++;
+        if ((expected[i]->getPoint() - result[i]->getPoint()).length() > 1e-5f ||
+            *expected[i]->getPath() != *result[i]->getPath()) {
+          numdiffs++;
+        }
+      }
+    }
+    BOOST_CHECK_MESSAGE(numhits > 100, "too few points were picked");
+    BOOST_CHECK_EQUAL(numdiffs, 0);
+    BOOST_CHECK(multi.getPickedPoint(25 * 25) != NULL);
+  }
+
+  multi.clearRays();
+  BOOST_CHECK_EQUAL(multi.getNumRays(), 0);
+  multi.apply(root);
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
@@ -0,0 +1,160 @@
+#ifndef COIN_SOMULTIRAYPICKACTIONP_H
+#define COIN_SOMULTIRAYPICKACTIONP_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+// *************************************************************************
+
+#include <Inventor/SbVec2s.h>
+#include <Inventor/SbVec3d.h>
+#include <Inventor/SbVec3f.h>
+#include <Inventor/lists/SbList.h>
+
+class SbXfBox3f;
+class SoAction;
+class SoMultiRayPickAction;
+class SoNode;
+class SoRayPickActionP;
+class SoRayPickCache;
+class SoState;
+
+// *************************************************************************
+
+// The private data for the SoMultiRayPickAction. Separators and shapes
+// use it to narrow down the rays to test while traversing, and to
+// switch the SoRayPickAction state between rays.
+
+class SoMultiRayPickActionP {
+public:
+  SoMultiRayPickActionP(void);
+  ~SoMultiRayPickActionP();
+
+  // Returns the private data of action if it is an
+  // SoMultiRayPickAction, or NULL.
+  static SoMultiRayPickActionP * get(SoAction * action);
+
+  // Makes ray the one SoRayPickAction works with. Returns TRUE if
+  // this was not already the case, meaning that the object space ray
+  // must be recalculated.
+  SbBool selectRay(const int ray);
+
+  // Narrows the active rays down to the ones intersecting box, which
+  // is in the current object space. Returns FALSE, and leaves the
+  // active rays as they were, if none of them do. Otherwise the rays
+  // must be restored with popRays() afterwards.
+  SbBool pushRays(SoState * state, const SbXfBox3f & box);
+  void popRays(void);
+  int getNumActiveRays(void) const;
+  const int * getActiveRays(void) const;
+
+  // Returns TRUE if SoShape::rayPick() should pick all the active rays
+  // for shape at once, instead of being called for each ray.
+  SbBool claimShape(const SoNode * shape);
+
+  // Transforms the active rays into the current object space, and
+  // finds the rays which might intersect a triangle, either by testing
+  // all of them, or by looking up the rays for which cache found the
+  // triangle in findTriangles(). Returns FALSE if there are no such
+  // triangles. The rays found must be verified with
+  // SoRayPickAction::intersect().
+  void setObjectSpaceRays(SoState * state);
+  SbBool findTriangles(const SoRayPickCache * cache);
+  int findRays(const int triangle,
+               const SbVec3f & v0, const SbVec3f & v1, const SbVec3f & v2);
+  const int * getFoundRays(void) const;
+
+  void setupRays(void);
+  void finishRays(void);
+  void cleanupRays(void);
+  SoRayPickActionP * getRayState(const int ray) const;
+  void updateWorldRay(const int ray);
+
+  static void cameraS(SoAction * action, SoNode * node);
+  static void shapeS(SoAction * action, SoNode * node);
+
+  struct RayDef {
+    SbBool ispoint;
+    SbVec2s point;
+    SbVec3f start;
+    SbVec3f direction;
+    float neardistance;
+    float fardistance;
+  };
+  struct WorldRay {
+    SbVec3d start;
+    SbVec3d direction;
+    double radiusstart;
+    double radiusdelta;
+    SbBool valid;
+    SbBool cone;
+  };
+
+  SbList<RayDef> raydefs;
+  SbList<SoRayPickActionP *> raystates;
+  SbList<WorldRay> worldrays;
+  int currentray;
+
+  // the active rays for each level of culling are stored after each
+  // other, with the start of each level in activestart
+  SbList<int> activerays;
+  SbList<int> activestart;
+
+  const SoNode * batchshape;
+  SbBool batched;
+
+  // object space rays for the current shape, stored as separate
+  // arrays of coordinates to let the compiler vectorize findRays()
+  double * osrays;
+  unsigned char * rayhits;
+  int * foundrays;
+  const int * found;
+  int numosrays;
+  int osraysstart;
+  int numallocated;
+
+  // the rays for each triangle found by findTriangles(), with the
+  // start of the rays for each triangle in trianglestart
+  SbList<int> trianglestart;
+  SbList<int> trianglerays;
+  SbBool usetriangles;
+
+  SoMultiRayPickAction * owner;
+};
+
+// *************************************************************************
+
+#endif // !COIN_SOMULTIRAYPICKACTIONP_H
@@ -121,6 +121,16 @@
   \code
   SoNode * realroot = viewer->getSceneManager()->getSceneGraph();
   \endcode
+
+  Shapes which are picked more than once without changing keep their
+  triangles in a bounding volume hierarchy, so that rays which miss
+  all the triangles of a shape can be rejected without generating its
+  primitives, and only the triangles close to the ray are tested
+  otherwise. This can be disabled by setting the
+  COIN_SOSHAPE_RAYPICK_CACHE environment variable to 0.
+
+  To pick with many rays at once, use SoMultiRayPickAction, which
+  traverses the scene graph only once for all the rays.
 */
 // FIXME: in the class doc, also mention how one can use
 // SoRayPickAction from within an SoHandleEventAction callback with
@@ -160,80 +170,55 @@
 #endif // COIN_DEBUG
 
 #include "actions/SoSubActionP.h"
+#include "actions/SoRayPickActionP.h"
 
 
 
 // *************************************************************************
 
-// The private data for the SoRayPickAction.
-
-class SoRayPickActionP {
-public:
-  SoRayPickActionP(void) : owner(NULL) { }
-
-  // Hidden private methods.
-
-  SbBool isBetweenPlanesWS(const SbVec3d & intersection,
-                           const SoClipPlaneElement * planes) const;
-  void cleanupPickedPoints(void);
-  void setFlag(const unsigned int flag);
-  void clearFlag(const unsigned int flag);
-  SbBool isFlagSet(const unsigned int flag) const;
-  void calcObjectSpaceData(SoState * ownerstate);
-  void calcMatrices(SoState * ownerstate);
-  void setPickStyleFlags(SoState * ownerstate);
-
-  // Hidden private variables.
-
-  SbViewVolume osvolume;
-  SbViewVolume wsvolume;
-  SbLine osline_sp;
-
-  // use double precision types to increase picking precision
-  SbDPLine osline;
-  SbDPPlane nearplane;
-  SbVec2s vppoint;
-  SbVec2f normvppoint;
-  SbVec3d raystart;
-  SbVec3d raydirection;
-  double rayradiusstart;
-  double rayradiusdelta;
-  double raynear;
-  double rayfar;
-  float radiusinpixels;
-
-  SbDPLine wsline;
-  SbDPMatrix obj2world;
-  SbDPMatrix world2obj;
-  SbDPMatrix extramatrix;
-
-  SoPickedPointList pickedpointlist;
-  SbList <double> ppdistance;
-
-  unsigned int flags;
-  SbBool objectspacevalid; // FIXME: why not a flag?
-
-  enum {
-    WS_RAY_SET =         0x0001, // ray set by setRay()
-    WS_RAY_COMPUTED =    0x0002, // ray computed in computeWorldSpaceRay()
-    PICK_ALL =           0x0004, // return all picked objects, or just closest
-    NORM_POINT =         0x0008, // is normalized vppoint calculated
-    CLIP_NEAR =          0x0010, // clip ray at near plane?
-    CLIP_FAR =           0x0020, // clip ray at far plane?
-    EXTRA_MATRIX =       0x0040, // is extra matrix supplied in setObjectSpace()
-    PPLIST_IS_SORTED =   0x0080, // did we sort pickedpointslist ?
-    OSVOLUME_DIRTY =     0x0100, // did we calculate osvolume?
-    PUSH_PICK_TO_FRONT = 0x0200, // should pick go in front?
-    CULL_BACKFACES =     0x0400  // should backface picks be ignored?
-  };
-
-  SoRayPickAction * owner;
-};
-
 #define PRIVATE(obj) ((obj)->pimpl)
 
 // *************************************************************************
 
+SoRayPickActionP *
+SoRayPickActionP::get(SoRayPickAction * action)
+{
+  return &PRIVATE(action).get();
+}
+
+SoRayPickActionP &
+SoRayPickActionP::operator=(const SoRayPickActionP & other)
+{
+  this->osvolume = other.osvolume;
+  this->wsvolume = other.wsvolume;
+  this->osline_sp = other.osline_sp;
+  this->osline = other.osline;
+  this->nearplane = other.nearplane;
+  this->vppoint = other.vppoint;
+  this->normvppoint = other.normvppoint;
+  this->raystart = other.raystart;
+  this->raydirection = other.raydirection;
+  this->rayradiusstart = other.rayradiusstart;
+  this->rayradiusdelta = other.rayradiusdelta;
+  this->raynear = other.raynear;
+  this->rayfar = other.rayfar;
+  this->radiusinpixels = other.radiusinpixels;
+  this->wsline = other.wsline;
+  this->obj2world = other.obj2world;
+  this->world2obj = other.world2obj;
+  this->extramatrix = other.extramatrix;
+  static_cast<SbPList &>(this->pickedpointlist) =
+    static_cast<const SbPList &>(other.pickedpointlist);
+  this->ppdistance = other.ppdistance;
+  this->flags = other.flags;
+  this->objectspacevalid = other.objectspacevalid;
+  this->owner = other.owner;
+  this->shapepickstate = other.shapepickstate;
+  return *this;
+}
+
+// *************************************************************************
+
 SO_ACTION_SOURCE(SoRayPickAction);
 
 
@@ -433,35 +418,9 @@ SoRayPickAction::isPickAll(void) const
 const SoPickedPointList &
 SoRayPickAction::getPickedPointList(void) const
 {
-  int n = PRIVATE(this)->pickedpointlist.getLength();
-  if (!PRIVATE(this)->isFlagSet(SoRayPickActionP::PPLIST_IS_SORTED) && n > 1) {
-    SoPickedPoint ** pparray = reinterpret_cast<SoPickedPoint **>(PRIVATE(this)->pickedpointlist.getArrayPtr());
-    double * darray = const_cast<double*>(PRIVATE(this)->ppdistance.getArrayPtr());
-
-    int i, j, distance;
-    SoPickedPoint * pptmp;
-    double dtmp;
-
-    // shell sort algorithm (O(nlog(n))
-    for (distance = 1; distance <= n/9; distance = 3*distance + 1) ;
-    for (; distance > 0; distance /= 3) {
-      for (i = distance; i < n; i++) {
-        dtmp = darray[i];
-        pptmp = pparray[i];
-        j = i;
-        while (j >= distance && darray[j-distance] > dtmp) {
-          darray[j] = darray[j-distance];
-          pparray[j] = pparray[j-distance];
-          j -= distance;
-        }
-        darray[j] = dtmp;
-        pparray[j] = pptmp;
-      }
-    }
-    SoRayPickActionP * thisp =
-      const_cast<SoRayPickActionP *>(&PRIVATE(this).get());
-    thisp->setFlag(SoRayPickActionP::PPLIST_IS_SORTED);
-  }
+  SoRayPickActionP * thisp =
+    const_cast<SoRayPickActionP *>(&PRIVATE(this).get());
+  thisp->sortPickedPoints();
 
   return PRIVATE(this)->pickedpointlist;
 }
@@ -1094,6 +1053,38 @@ SoRayPickActionP::cleanupPickedPoints(void)
   this->clearFlag(PPLIST_IS_SORTED);
 }
 
+void
+SoRayPickActionP::sortPickedPoints(void)
+{
+  int n = this->pickedpointlist.getLength();
+  if (!this->isFlagSet(PPLIST_IS_SORTED) && n > 1) {
+    SoPickedPoint ** pparray = reinterpret_cast<SoPickedPoint **>(this->pickedpointlist.getArrayPtr());
+    double * darray = const_cast<double *>(this->ppdistance.getArrayPtr());
+
+    int i, j, distance;
+    SoPickedPoint * pptmp;
+    double dtmp;
+
+    // shell sort algorithm (O(nlog(n))
+    for (distance = 1; distance <= n/9; distance = 3*distance + 1) ;
+    for (; distance > 0; distance /= 3) {
+      for (i = distance; i < n; i++) {
+        dtmp = darray[i];
+        pptmp = pparray[i];
+        j = i;
+        while (j >= distance && darray[j-distance] > dtmp) {
+          darray[j] = darray[j-distance];
+          pparray[j] = pparray[j-distance];
+          j -= distance;
+        }
+        darray[j] = dtmp;
+        pparray[j] = pptmp;
+      }
+    }
+    this->setFlag(PPLIST_IS_SORTED);
+  }
+}
+
 void
 SoRayPickActionP::setFlag(const unsigned int flag)
 {
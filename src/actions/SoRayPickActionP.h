@@ -0,0 +1,135 @@
+#ifndef COIN_SORAYPICKACTIONP_H
+#define COIN_SORAYPICKACTIONP_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+// *************************************************************************
+
+#include <Inventor/SbLine.h>
+#include <Inventor/SbVec2f.h>
+#include <Inventor/SbVec2s.h>
+#include <Inventor/SbVec3d.h>
+#include <Inventor/SbViewVolume.h>
+#include <Inventor/SbDPLine.h>
+#include <Inventor/SbDPPlane.h>
+#include <Inventor/SbDPMatrix.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/lists/SoPickedPointList.h>
+
+class SoClipPlaneElement;
+class SoRayPickAction;
+class SoState;
+
+// *************************************************************************
+
+// The private data for the SoRayPickAction.
+
+class SoRayPickActionP {
+public:
+  SoRayPickActionP(void) : owner(NULL), shapepickstate(NULL) { }
+  // SoMultiRayPickAction copies the state of each ray. The picked
+  // points are not copied, only the pointers to them.
+  SoRayPickActionP(const SoRayPickActionP & other)
+    : owner(NULL), shapepickstate(NULL) { *this = other; }
+  SoRayPickActionP & operator=(const SoRayPickActionP & other);
+
+  static SoRayPickActionP * get(SoRayPickAction * action);
+
+  // Hidden private methods.
+
+  SbBool isBetweenPlanesWS(const SbVec3d & intersection,
+                           const SoClipPlaneElement * planes) const;
+  void cleanupPickedPoints(void);
+  void sortPickedPoints(void);
+  void setFlag(const unsigned int flag);
+  void clearFlag(const unsigned int flag);
+  SbBool isFlagSet(const unsigned int flag) const;
+  void calcObjectSpaceData(SoState * ownerstate);
+  void calcMatrices(SoState * ownerstate);
+  void setPickStyleFlags(SoState * ownerstate);
+
+  // Hidden private variables.
+
+  SbViewVolume osvolume;
+  SbViewVolume wsvolume;
+  SbLine osline_sp;
+
+  // use double precision types to increase picking precision
+  SbDPLine osline;
+  SbDPPlane nearplane;
+  SbVec2s vppoint;
+  SbVec2f normvppoint;
+  SbVec3d raystart;
+  SbVec3d raydirection;
+  double rayradiusstart;
+  double rayradiusdelta;
+  double raynear;
+  double rayfar;
+  float radiusinpixels;
+
+  SbDPLine wsline;
+  SbDPMatrix obj2world;
+  SbDPMatrix world2obj;
+  SbDPMatrix extramatrix;
+
+  SoPickedPointList pickedpointlist;
+  SbList <double> ppdistance;
+
+  unsigned int flags;
+  SbBool objectspacevalid; // FIXME: why not a flag?
+
+  enum {
+    WS_RAY_SET =         0x0001, // ray set by setRay()
+    WS_RAY_COMPUTED =    0x0002, // ray computed in computeWorldSpaceRay()
+    PICK_ALL =           0x0004, // return all picked objects, or just closest
+    NORM_POINT =         0x0008, // is normalized vppoint calculated
+    CLIP_NEAR =          0x0010, // clip ray at near plane?
+    CLIP_FAR =           0x0020, // clip ray at far plane?
+    EXTRA_MATRIX =       0x0040, // is extra matrix supplied in setObjectSpace()
+    PPLIST_IS_SORTED =   0x0080, // did we sort pickedpointslist ?
+    OSVOLUME_DIRTY =     0x0100, // did we calculate osvolume?
+    PUSH_PICK_TO_FRONT = 0x0200, // should pick go in front?
+    CULL_BACKFACES =     0x0400  // should backface picks be ignored?
+  };
+
+  SoRayPickAction * owner;
+  // set by SoShape::rayPick() while it generates primitives, so that
+  // several actions can pick the same shape at once
+  void * shapepickstate;
+};
+
+#endif // !COIN_SORAYPICKACTIONP_H
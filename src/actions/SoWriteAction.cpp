@@ -258,6 +258,9 @@ SoWriteAction::beginTraversal(SoNode * node)
     outobj->write('\n');
     outobj->resolveRoutes();
   }
+  if (this->outobj->isBinary() && !this->continuing) {
+    outobj->writeIndex();
+  }
   if (!this->continuing) {
     SoWriterefCounter::instance(this->getOutput())->debugCleanup();
 #if COIN_DEBUG
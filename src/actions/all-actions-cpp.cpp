@@ -47,6 +47,7 @@
 #include "SoGetPrimitiveCountAction.cpp"
 #include "SoHandleEventAction.cpp"
 #include "SoLineHighlightRenderAction.cpp"
+#include "SoMultiRayPickAction.cpp"
 #include "SoPickAction.cpp"
 #include "SoRayPickAction.cpp"
 #include "SoReorganizeAction.cpp"
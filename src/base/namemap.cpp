@@ -32,6 +32,7 @@
 
 #include "base/namemap.h"
 
+#include <atomic>
 #include <cstdlib>
 #include <cassert>
 #include <cstring>
@@ -67,6 +68,7 @@ using std::strcmp;
 
 #define CHUNK_SIZE (65536-32)
 static const unsigned int NAME_TABLE_SIZE = 1999;
+static const unsigned int NAME_TABLE_STRIPES = 32;
 
 struct NamemapMemChunk {
   char mem[CHUNK_SIZE];
@@ -81,9 +83,24 @@ struct NamemapBucketEntry {
   struct NamemapBucketEntry * next;
 };
 
-static void * access_mutex = NULL;
-static struct NamemapBucketEntry ** nametable = NULL;
+/*
+  Looking up a name which is already in the table does not take any
+  locks, since SbName instances are constructed all the time, from
+  any thread. This works because entries are never removed (until
+  exit), and an entry is completely set up before it is published as
+  the new head of its bucket list. The next pointers of entries in
+  the table are never changed.
+
+  Adding a name locks one of a set of mutexes, picked by the bucket,
+  so names going into different buckets can mostly be added in
+  parallel. The string storage has a mutex of its own.
+*/
+
+static std::atomic<struct NamemapBucketEntry *> nametable[NAME_TABLE_SIZE];
+static void * stripe_mutex[NAME_TABLE_STRIPES];
+static void * chunk_mutex = NULL;
 static struct NamemapMemChunk * headchunk = NULL;
+static SbBool namemap_initialized = FALSE;
 
 /* ************************************************************************* */
 
@@ -101,38 +118,30 @@ namemap_cleanup(void)
     free(chunkptr);
     chunkptr = next;
   }
-  
+  headchunk = NULL;
+
   for (i = 0; i < NAME_TABLE_SIZE; i++) {
-    struct NamemapBucketEntry * entry = nametable[i];
+    struct NamemapBucketEntry * entry = nametable[i].load(std::memory_order_relaxed);
     while (entry) {
       struct NamemapBucketEntry * next = entry->next;
       free(entry);
       entry = next;
     }
+    nametable[i].store(NULL, std::memory_order_relaxed);
   }
-  free(nametable);
-  nametable = static_cast<struct NamemapBucketEntry **>(NULL);
 
-  CC_MUTEX_DESTRUCT(access_mutex);
+  for (i = 0; i < NAME_TABLE_STRIPES; i++) {
+    if (stripe_mutex[i]) { CC_MUTEX_DESTRUCT(stripe_mutex[i]); }
+  }
+  CC_MUTEX_DESTRUCT(chunk_mutex);
+  namemap_initialized = FALSE;
 }
 
 } // extern "C"
 
-/* Initializes static data. */
-static void
-namemap_init(void)
-{
-  unsigned int i;
-
-  nametable = static_cast<struct NamemapBucketEntry **>(
-    malloc(sizeof(struct NamemapBucketEntry *) * NAME_TABLE_SIZE));
-  for (i = 0; i < NAME_TABLE_SIZE; i++) { nametable[i] = NULL; }
-
-  headchunk = NULL;
-
-  coin_atexit(static_cast<coin_atexit_f *>(namemap_cleanup), CC_ATEXIT_SBNAME);
-}
-
+/* Copies s into the string storage and returns the permanent
+   address. Also takes care of static initialization, since this is
+   run before the first entry is added. */
 static const char *
 find_string_address(const char * s)
 {
@@ -141,6 +150,14 @@ find_string_address(const char * s)
   /* FIXME: this is an unacceptable limitation. 20030608 mortene. */
   assert(len < CHUNK_SIZE);
 
+  if (chunk_mutex == NULL) { CC_MUTEX_CONSTRUCT(chunk_mutex); }
+  CC_MUTEX_LOCK(chunk_mutex);
+
+  if (!namemap_initialized) {
+    coin_atexit(static_cast<coin_atexit_f *>(namemap_cleanup), CC_ATEXIT_SBNAME);
+    namemap_initialized = TRUE;
+  }
+
   if (headchunk == NULL || headchunk->bytesleft < len) {
     struct NamemapMemChunk * newchunk = static_cast<struct NamemapMemChunk *>(
       malloc(sizeof(struct NamemapMemChunk))
@@ -159,41 +176,56 @@ find_string_address(const char * s)
   headchunk->curbyte += len;
   headchunk->bytesleft -= len;
 
+  CC_MUTEX_UNLOCK(chunk_mutex);
   return s;
 }
 
+static struct NamemapBucketEntry *
+namemap_find_entry(struct NamemapBucketEntry * entry, unsigned long h, const char * str)
+{
+  while (entry != NULL) {
+    if (entry->hashvalue == h && strcmp(entry->str, str) == 0) { break; }
+    entry = entry->next;
+  }
+  return entry;
+}
+
 static const char *
 namemap_find_or_add_string(const char * str, SbBool addifnotfound)
 {
   unsigned long h, i;
-  struct NamemapBucketEntry * entry;
-
-  if (access_mutex == NULL) { CC_MUTEX_CONSTRUCT(access_mutex); }
-  CC_MUTEX_LOCK(access_mutex);
-
-  if (nametable == NULL) { namemap_init(); }
-  assert(nametable != static_cast<struct NamemapBucketEntry **>(NULL) && "name hash dead");
+  unsigned int stripe;
+  struct NamemapBucketEntry * head, * entry;
 
   h = cc_string_hash_text(str);
   i = h % NAME_TABLE_SIZE;
-  entry = nametable[i];
 
-  while (entry != NULL) {
-    if (entry->hashvalue == h && strcmp(entry->str, str) == 0) { break; }
-    entry = entry->next;
-  }
+  /* the acquire pairs with the release when an entry is added, so
+     that we see the complete entry */
+  head = nametable[i].load(std::memory_order_acquire);
+  entry = namemap_find_entry(head, h, str);
+  if ((entry != NULL) || !addifnotfound) { return entry ? entry->str : NULL; }
+
+  stripe = static_cast<unsigned int>(i % NAME_TABLE_STRIPES);
+  if (stripe_mutex[stripe] == NULL) { CC_MUTEX_CONSTRUCT(stripe_mutex[stripe]); }
+  CC_MUTEX_LOCK(stripe_mutex[stripe]);
+
+  /* somebody may have added the string after we looked */
+  entry = nametable[i].load(std::memory_order_acquire);
+  if (entry != head) { entry = namemap_find_entry(entry, h, str); }
+  else { entry = NULL; }
 
-  if ((entry == NULL) && addifnotfound) {
+  if (entry == NULL) {
     entry = static_cast<struct NamemapBucketEntry *>(malloc(sizeof(struct NamemapBucketEntry)));
     entry->str = find_string_address(str);
     entry->hashvalue = h;
-    entry->next = nametable[i];
+    entry->next = nametable[i].load(std::memory_order_relaxed);
 
-    nametable[i] = entry;
+    nametable[i].store(entry, std::memory_order_release);
   }
 
-  CC_MUTEX_UNLOCK(access_mutex);
-  return entry ? entry->str : NULL;
+  CC_MUTEX_UNLOCK(stripe_mutex[stripe]);
+  return entry->str;
 }
 
 /* ************************************************************************* */
@@ -0,0 +1,259 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// SoCacheBuildJob runs the building of a cache on a worker thread.
+// It is used by shapes when SoGLRenderAction::setNumCacheThreads()
+// is set, to replace an invalid cache without stalling the render
+// thread: the shape keeps drawing the old cache until the job is
+// done, and the node is then touched so that the next redraw picks
+// up the new cache.
+
+#include "caches/SoCacheBuildJob.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <atomic>
+
+#include <Inventor/C/threads/condvar.h>
+#include <Inventor/C/threads/sched.h>
+#include <Inventor/C/threads/thread.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/nodes/SoNode.h>
+#include <Inventor/sensors/SoOneShotSensor.h>
+
+#include "tidbitsp.h"
+#include "threads/threadsutilp.h"
+
+// A finished job schedules a sensor from its worker thread, and the
+// sensor queues can only be used from more than one thread when Coin
+// is built with COIN_THREADSAFE. Otherwise jobs are run at once.
+#if defined(HAVE_THREADS) && defined(COIN_THREADSAFE)
+#define SOCACHEBUILDJOB_THREADS 1
+#else // !(HAVE_THREADS && COIN_THREADSAFE)
+#define SOCACHEBUILDJOB_THREADS 0
+#endif // !(HAVE_THREADS && COIN_THREADSAFE)
+
+// *************************************************************************
+
+class SoCacheBuildJobP {
+public:
+  enum State { IDLE, SCHEDULED, DONE };
+
+  SoCacheBuildJob * master;
+  SoNode * node;
+  std::atomic<int> state;
+  uint32_t schedid;
+
+#if SOCACHEBUILDJOB_THREADS
+  // Finished jobs whose nodes have not been touched yet. The worker
+  // thread which finishes a job schedules touchsensor, which touches
+  // the nodes from the render thread. Guarded by mutex, as are
+  // touchpending and the state changes of running jobs.
+  static SbList<SoCacheBuildJob *> * finished;
+  static SoOneShotSensor * touchsensor;
+  static SbBool touchpending;
+  static void * mutex;
+  static cc_condvar * donecond; // signalled when a job is done
+  static cc_sched * sched;
+
+  static void run_cb(void * closure);
+  static void touchsensor_cb(void * data, SoSensor * sensor);
+  static void remove(SoCacheBuildJob * job);
+  static void cleanup(void);
+#endif // SOCACHEBUILDJOB_THREADS
+};
+
+#if SOCACHEBUILDJOB_THREADS
+SbList<SoCacheBuildJob *> * SoCacheBuildJobP::finished = NULL;
+SoOneShotSensor * SoCacheBuildJobP::touchsensor = NULL;
+SbBool SoCacheBuildJobP::touchpending = FALSE;
+void * SoCacheBuildJobP::mutex = NULL;
+cc_condvar * SoCacheBuildJobP::donecond = NULL;
+cc_sched * SoCacheBuildJobP::sched = NULL;
+#endif // SOCACHEBUILDJOB_THREADS
+
+#define PRIVATE(obj) ((obj)->pimpl)
+
+#if SOCACHEBUILDJOB_THREADS
+
+void
+SoCacheBuildJobP::run_cb(void * closure)
+{
+  SoCacheBuildJob * job = static_cast<SoCacheBuildJob *>(closure);
+  job->run();
+  // the job may be deleted as soon as the mutex is unlocked
+  CC_MUTEX_LOCK(SoCacheBuildJobP::mutex);
+  PRIVATE(job)->state.store(DONE, std::memory_order_release);
+  SoCacheBuildJobP::finished->append(job);
+  if (!SoCacheBuildJobP::touchpending) {
+    SoCacheBuildJobP::touchpending = TRUE;
+    SoCacheBuildJobP::touchsensor->schedule();
+  }
+  cc_condvar_wake_all(SoCacheBuildJobP::donecond);
+  CC_MUTEX_UNLOCK(SoCacheBuildJobP::mutex);
+}
+
+// Touches the nodes of finished jobs. The list is checked again after
+// each touch, since notification might delete other jobs.
+void
+SoCacheBuildJobP::touchsensor_cb(void *, SoSensor *)
+{
+  CC_MUTEX_LOCK(SoCacheBuildJobP::mutex);
+  SoCacheBuildJobP::touchpending = FALSE;
+  while (SoCacheBuildJobP::finished->getLength()) {
+    SoNode * node = PRIVATE(SoCacheBuildJobP::finished->pop())->node;
+    CC_MUTEX_UNLOCK(SoCacheBuildJobP::mutex);
+    if (node) node->touch(); // trigger redraw
+    CC_MUTEX_LOCK(SoCacheBuildJobP::mutex);
+  }
+  CC_MUTEX_UNLOCK(SoCacheBuildJobP::mutex);
+}
+
+void
+SoCacheBuildJobP::remove(SoCacheBuildJob * job)
+{
+  if (SoCacheBuildJobP::finished == NULL) return;
+  CC_MUTEX_LOCK(SoCacheBuildJobP::mutex);
+  const int idx = SoCacheBuildJobP::finished->find(job);
+  if (idx >= 0) SoCacheBuildJobP::finished->removeFast(idx);
+  CC_MUTEX_UNLOCK(SoCacheBuildJobP::mutex);
+}
+
+void
+SoCacheBuildJobP::cleanup(void)
+{
+  if (SoCacheBuildJobP::sched) {
+    cc_sched_destruct(SoCacheBuildJobP::sched);
+    SoCacheBuildJobP::sched = NULL;
+  }
+  delete SoCacheBuildJobP::touchsensor;
+  SoCacheBuildJobP::touchsensor = NULL;
+  SoCacheBuildJobP::touchpending = FALSE;
+  delete SoCacheBuildJobP::finished;
+  SoCacheBuildJobP::finished = NULL;
+  cc_condvar_destruct(SoCacheBuildJobP::donecond);
+  SoCacheBuildJobP::donecond = NULL;
+  CC_MUTEX_DESTRUCT(SoCacheBuildJobP::mutex);
+}
+
+#endif // SOCACHEBUILDJOB_THREADS
+
+// *************************************************************************
+
+SoCacheBuildJob::SoCacheBuildJob(void)
+{
+  PRIVATE(this) = new SoCacheBuildJobP;
+  PRIVATE(this)->master = this;
+  PRIVATE(this)->node = NULL;
+  PRIVATE(this)->state.store(SoCacheBuildJobP::IDLE);
+  PRIVATE(this)->schedid = 0;
+}
+
+// Cancels the job if it has not been started yet, or else waits for
+// it to finish. Subclasses which own data used by run() must call
+// wait() from their own destructor, before the data goes away.
+SoCacheBuildJob::~SoCacheBuildJob()
+{
+  this->wait();
+#if SOCACHEBUILDJOB_THREADS
+  SoCacheBuildJobP::remove(this);
+#endif // SOCACHEBUILDJOB_THREADS
+  delete PRIVATE(this);
+}
+
+void
+SoCacheBuildJob::schedule(SoNode * node, const int numthreads)
+{
+  assert(PRIVATE(this)->state.load() == SoCacheBuildJobP::IDLE);
+  PRIVATE(this)->node = node;
+
+#if SOCACHEBUILDJOB_THREADS
+  if (numthreads > 0 && cc_thread_implementation() != CC_NO_THREADS) {
+    CC_MUTEX_CONSTRUCT(SoCacheBuildJobP::mutex);
+    CC_MUTEX_LOCK(SoCacheBuildJobP::mutex);
+    if (SoCacheBuildJobP::finished == NULL) {
+      SoCacheBuildJobP::finished = new SbList<SoCacheBuildJob *>;
+      SoCacheBuildJobP::touchsensor =
+        new SoOneShotSensor(SoCacheBuildJobP::touchsensor_cb, NULL);
+      SoCacheBuildJobP::donecond = cc_condvar_construct();
+      SoCacheBuildJobP::sched = cc_sched_construct(numthreads);
+      coin_atexit((coin_atexit_f *)SoCacheBuildJobP::cleanup, CC_ATEXIT_NORMAL);
+    }
+    else if (cc_sched_get_num_threads(SoCacheBuildJobP::sched) < numthreads) {
+      cc_sched_set_num_threads(SoCacheBuildJobP::sched, numthreads);
+    }
+    PRIVATE(this)->state.store(SoCacheBuildJobP::SCHEDULED);
+    PRIVATE(this)->schedid =
+      cc_sched_schedule(SoCacheBuildJobP::sched, SoCacheBuildJobP::run_cb, this, 0);
+    CC_MUTEX_UNLOCK(SoCacheBuildJobP::mutex);
+    return;
+  }
+#else // !SOCACHEBUILDJOB_THREADS
+  (void) numthreads;
+#endif // !SOCACHEBUILDJOB_THREADS
+
+  this->run();
+  PRIVATE(this)->state.store(SoCacheBuildJobP::DONE, std::memory_order_release);
+}
+
+// Returns TRUE when run() has finished, and the data it built can be
+// used by the calling thread.
+SbBool
+SoCacheBuildJob::isDone(void) const
+{
+  return PRIVATE(this)->state.load(std::memory_order_acquire) ==
+    SoCacheBuildJobP::DONE;
+}
+
+// Makes sure run() is not and will not be running on a worker
+// thread. A job which has not been started yet is cancelled.
+void
+SoCacheBuildJob::wait(void)
+{
+  if (PRIVATE(this)->state.load() != SoCacheBuildJobP::SCHEDULED) return;
+#if SOCACHEBUILDJOB_THREADS
+  if (cc_sched_unschedule(SoCacheBuildJobP::sched, PRIVATE(this)->schedid)) {
+    PRIVATE(this)->state.store(SoCacheBuildJobP::IDLE);
+    return;
+  }
+  CC_MUTEX_LOCK(SoCacheBuildJobP::mutex);
+  while (PRIVATE(this)->state.load() != SoCacheBuildJobP::DONE) {
+    cc_condvar_wait(SoCacheBuildJobP::donecond,
+                    static_cast<cc_mutex *>(SoCacheBuildJobP::mutex));
+  }
+  CC_MUTEX_UNLOCK(SoCacheBuildJobP::mutex);
+#endif // SOCACHEBUILDJOB_THREADS
+}
+
+#undef PRIVATE
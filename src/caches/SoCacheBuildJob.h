@@ -0,0 +1,77 @@
+#ifndef COIN_SOCACHEBUILDJOB_H
+#define COIN_SOCACHEBUILDJOB_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+// *************************************************************************
+
+#include <Inventor/SbBasic.h>
+#include <Inventor/system/inttypes.h>
+
+class SoCacheBuildJobP;
+class SoNode;
+
+// *************************************************************************
+
+// Work for a cache which is built on a worker thread while the
+// render thread goes on drawing the cache it replaces. Subclasses
+// copy the data they need when they are created, and do the
+// building in run().
+class SoCacheBuildJob {
+public:
+  SoCacheBuildJob(void);
+  virtual ~SoCacheBuildJob();
+
+  // Runs the job on one of numthreads worker threads. node is
+  // touched from the render thread's sensor queue when the job is
+  // done, to trigger a redraw. Unless Coin is built with
+  // COIN_THREADSAFE, the job is run before returning.
+  void schedule(SoNode * node, const int numthreads);
+  SbBool isDone(void) const;
+  void wait(void);
+
+protected:
+  virtual void run(void) = 0;
+
+private:
+  friend class SoCacheBuildJobP;
+  SoCacheBuildJobP * pimpl;
+};
+
+// *************************************************************************
+
+#endif // !COIN_SOCACHEBUILDJOB_H
@@ -58,16 +58,8 @@
 
 #include "tidbitsp.h"
 #include "base/SbGLUTessellator.h"
-
-// *************************************************************************
-
-class SoConvexDataCacheP {
-public:
-  SbList <int32_t> coordIndices;
-  SbList <int32_t> normalIndices;
-  SbList <int32_t> materialIndices;
-  SbList <int32_t> texIndices;
-};
+#include "caches/SoCacheBuildJob.h"
+#include "caches/SoConvexDataCacheP.h"
 
 #define PRIVATE(obj) ((obj)->pimpl)
 
@@ -89,6 +81,9 @@ SoConvexDataCache::SoConvexDataCache(SoState * const state)
   : SoCache(state)
 {
   PRIVATE(this) = new SoConvexDataCacheP;
+  PRIVATE(this)->defernode = NULL;
+  PRIVATE(this)->deferthreads = 0;
+  PRIVATE(this)->job = NULL;
 #if COIN_DEBUG
   if (coin_debug_caching_level() > 0) {
     SoDebugError::postInfo("SoConvexDataCache::SoConvexDataCache",
@@ -110,6 +105,7 @@ SoConvexDataCache::~SoConvexDataCache()
     
   }
 #endif // debug
+  delete PRIVATE(this)->job;
   delete PRIVATE(this);
 }
 
@@ -229,36 +225,84 @@ typedef struct {
   int numtexind;
 } tTessData;
 
-/*!
-  Generates the convexified data. FIXME: doc
-*/
-void
-SoConvexDataCache::generate(const SoCoordinateElement * const coords,
-                            const SbMatrix & matrix,
-                            const int32_t *vind,
-                            const int numv,
-                            const int32_t *mind, const int32_t *nind,
-                            const int32_t *tind,
-                            const Binding matbind, const Binding normbind,
-                            const Binding texbind)
+//
+// Finds the material, normal and texture coordinate index of each
+// vertex, and the vertex position, for the tessellator.
+//
+static void
+convexdatacache_prepare(const SoCoordinateElement * const coords,
+                        const SbMatrix & matrix,
+                        const int32_t *vind,
+                        const int numv,
+                        const int32_t *mind, const int32_t *nind,
+                        const int32_t *tind,
+                        const SoConvexDataCache::Binding matbind,
+                        const SoConvexDataCache::Binding normbind,
+                        const SoConvexDataCache::Binding texbind,
+                        tVertexInfo * vertexinfo,
+                        SbVec3f * points)
 {
-#if COIN_DEBUG && 0
-  SoDebugError::postInfo("SoConvexDataCache::generate",
-                         "generating convex data");
-#endif
-
   SbBool identity = matrix == SbMatrix::identity();
 
-  // remove old data
-  PRIVATE(this)->coordIndices.truncate(0);
-  PRIVATE(this)->materialIndices.truncate(0);
-  PRIVATE(this)->normalIndices.truncate(0);
-  PRIVATE(this)->texIndices.truncate(0);
-
   int matnr = 0;
   int texnr = 0;
   int normnr = 0;
 
+  for (int i = 0; i < numv; i++) {
+    if (vind[i] < 0) {
+      if (matbind == SoConvexDataCache::PER_VERTEX_INDEXED || 
+          matbind == SoConvexDataCache::PER_FACE ||
+          matbind == SoConvexDataCache::PER_FACE_INDEXED) matnr++;
+      if (normbind == SoConvexDataCache::PER_VERTEX_INDEXED ||
+          normbind == SoConvexDataCache::PER_FACE ||
+          normbind == SoConvexDataCache::PER_FACE_INDEXED) normnr++;
+      if (texbind == SoConvexDataCache::PER_VERTEX_INDEXED) texnr++;
+    }
+    else {
+      vertexinfo[i].vertexnr = vind[i];
+      if (mind)
+        vertexinfo[i].matnr = mind[matnr];
+      else vertexinfo[i].matnr = matnr;
+      if (matbind >= SoConvexDataCache::PER_VERTEX) {
+        matnr++;
+      }
+      if (nind)
+        vertexinfo[i].normnr = nind[normnr];
+      else vertexinfo[i].normnr = normnr;
+      if (normbind >= SoConvexDataCache::PER_VERTEX)
+        normnr++;
+      if (tind)
+        vertexinfo[i].texnr = tind[texnr++];
+      else
+        vertexinfo[i].texnr = texnr++;
+
+      SbVec3f v = coords->get3(vind[i]);
+      if (!identity) matrix.multVecMatrix(v,v);
+      points[i] = v;
+    }
+  }
+}
+
+//
+// Tessellates the polygons, with vertices set up by
+// convexdatacache_prepare().
+//
+static void
+convexdatacache_tessellate(SoConvexDataCacheP * thisp,
+                           const int32_t *vind,
+                           const int numv,
+                           tVertexInfo * vertexinfo,
+                           const SbVec3f * points,
+                           const SoConvexDataCache::Binding matbind,
+                           const SoConvexDataCache::Binding normbind,
+                           const SoConvexDataCache::Binding texbind)
+{
+  // remove old data
+  thisp->coordIndices.truncate(0);
+  thisp->materialIndices.truncate(0);
+  thisp->normalIndices.truncate(0);
+  thisp->texIndices.truncate(0);
+
   // initialize the struct with data needed during tessellation
   tTessData tessdata;
   tessdata.matbind = matbind;
@@ -268,9 +312,7 @@ SoConvexDataCache::generate(const SoCoordinateElement * const coords,
   tessdata.nummatind = 0;
   tessdata.numnormind = 0;
   tessdata.numtexind = 0;
-  // FIXME: stupid to have a separate struct for each coordIndex
-  // should only allocate enough to hold the largest polygon
-  tessdata.vertexInfo = new tVertexInfo[numv];
+  tessdata.vertexInfo = vertexinfo;
   tessdata.vertexIndex = NULL;
   tessdata.matIndex = NULL;
   tessdata.normIndex = NULL;
@@ -284,13 +326,13 @@ SoConvexDataCache::generate(const SoCoordinateElement * const coords,
 
   // if PER_FACE binding, the binding must change to PER_FACE_INDEXED
   // if convexify data is used.
-  tessdata.vertexIndex = &PRIVATE(this)->coordIndices;
-  if (matbind != NONE)
-    tessdata.matIndex = &PRIVATE(this)->materialIndices;
-  if (normbind != NONE)
-    tessdata.normIndex = &PRIVATE(this)->normalIndices;
-  if (texbind != NONE)
-    tessdata.texIndex = &PRIVATE(this)->texIndices;
+  tessdata.vertexIndex = &thisp->coordIndices;
+  if (matbind != SoConvexDataCache::NONE)
+    tessdata.matIndex = &thisp->materialIndices;
+  if (normbind != SoConvexDataCache::NONE)
+    tessdata.normIndex = &thisp->normalIndices;
+  if (texbind != SoConvexDataCache::NONE)
+    tessdata.texIndex = &thisp->texIndices;
 
   if (gt) { glutess.beginPolygon(); }
   else { tess.beginPolygon(); }
@@ -298,40 +340,14 @@ SoConvexDataCache::generate(const SoCoordinateElement * const coords,
     if (vind[i] < 0) {
       if (gt) { glutess.endPolygon(); }
       else { tess.endPolygon(); }
-      if (matbind == PER_VERTEX_INDEXED || 
-          matbind == PER_FACE ||
-          matbind == PER_FACE_INDEXED) matnr++;
-      if (normbind == PER_VERTEX_INDEXED ||
-          normbind == PER_FACE ||
-          normbind == PER_FACE_INDEXED) normnr++;
-      if (texbind == PER_VERTEX_INDEXED) texnr++;
       if (i < numv - 1) { // if not last polygon
         if (gt) { glutess.beginPolygon(); }
         else { tess.beginPolygon(); }
       }
     }
     else {
-      tessdata.vertexInfo[i].vertexnr = vind[i];
-      if (mind)
-        tessdata.vertexInfo[i].matnr = mind[matnr];
-      else tessdata.vertexInfo[i].matnr = matnr;
-      if (matbind >= PER_VERTEX) {
-        matnr++;
-      }
-      if (nind)
-        tessdata.vertexInfo[i].normnr = nind[normnr];
-      else tessdata.vertexInfo[i].normnr = normnr;
-      if (normbind >= PER_VERTEX)
-        normnr++;
-      if (tind)
-        tessdata.vertexInfo[i].texnr = tind[texnr++];
-      else
-        tessdata.vertexInfo[i].texnr = texnr++;
-
-      SbVec3f v = coords->get3(vind[i]);
-      if (!identity) matrix.multVecMatrix(v,v);
-      if (gt) { glutess.addVertex(v, static_cast<void *>(&tessdata.vertexInfo[i])); }
-      else { tess.addVertex(v, static_cast<void *>(&tessdata.vertexInfo[i])); }
+      if (gt) { glutess.addVertex(points[i], static_cast<void *>(&vertexinfo[i])); }
+      else { tess.addVertex(points[i], static_cast<void *>(&vertexinfo[i])); }
     }
   }
   
@@ -341,12 +357,117 @@ SoConvexDataCache::generate(const SoCoordinateElement * const coords,
     else { tess.endPolygon(); }
   }
 
-  delete [] tessdata.vertexInfo;
+  thisp->coordIndices.fit();
+  if (tessdata.matIndex) thisp->materialIndices.fit();
+  if (tessdata.normIndex) thisp->normalIndices.fit();
+  if (tessdata.texIndex) thisp->texIndices.fit();
+}
+
+#ifndef DOXYGEN_SKIP_THIS
+// Tessellates on a worker thread, with the vertices set up by the
+// render thread.
+class SoConvexDataCacheJob : public SoCacheBuildJob {
+public:
+  SoConvexDataCacheJob(SoConvexDataCacheP * thisp, const int numv)
+    : thisp(thisp), numv(numv) {
+    this->vind = new int32_t[numv];
+    this->vertexinfo = new tVertexInfo[numv];
+    this->points = new SbVec3f[numv];
+  }
+  virtual ~SoConvexDataCacheJob() {
+    this->wait();
+    delete [] this->vind;
+    delete [] this->vertexinfo;
+    delete [] this->points;
+  }
+
+  SoConvexDataCacheP * thisp;
+  int numv;
+  int32_t * vind;
+  tVertexInfo * vertexinfo;
+  SbVec3f * points;
+  SoConvexDataCache::Binding matbind;
+  SoConvexDataCache::Binding normbind;
+  SoConvexDataCache::Binding texbind;
+
+protected:
+  virtual void run(void) {
+    convexdatacache_tessellate(this->thisp, this->vind, this->numv,
+                               this->vertexinfo, this->points,
+                               this->matbind, this->normbind, this->texbind);
+  }
+};
+
+// Makes the next generate() call on cache tessellate on a worker
+// thread, touching node when done. Pass NULL for node to turn it off
+// again.
+void
+SoConvexDataCacheP::deferGenerate(SoConvexDataCache * cache, SoNode * node,
+                                  const int numthreads)
+{
+  PRIVATE(cache)->defernode = node;
+  PRIVATE(cache)->deferthreads = numthreads;
+}
+
+// Returns FALSE while tessellating on a worker thread. The cache
+// must not be used before this returns TRUE.
+SbBool
+SoConvexDataCacheP::isGenerated(SoConvexDataCache * cache)
+{
+  SoConvexDataCacheP * thisp = PRIVATE(cache);
+  if (thisp->job && thisp->job->isDone()) {
+    delete thisp->job;
+    thisp->job = NULL;
+  }
+  return thisp->job == NULL;
+}
+#endif // DOXYGEN_SKIP_THIS
+
+/*!
+  Generates the convexified data. FIXME: doc
+*/
+void
+SoConvexDataCache::generate(const SoCoordinateElement * const coords,
+                            const SbMatrix & matrix,
+                            const int32_t *vind,
+                            const int numv,
+                            const int32_t *mind, const int32_t *nind,
+                            const int32_t *tind,
+                            const Binding matbind, const Binding normbind,
+                            const Binding texbind)
+{
+#if COIN_DEBUG && 0
+  SoDebugError::postInfo("SoConvexDataCache::generate",
+                         "generating convex data");
+#endif
+
+  if (PRIVATE(this)->defernode) {
+    SoConvexDataCacheJob * job = new SoConvexDataCacheJob(PRIVATE(this), numv);
+    for (int i = 0; i < numv; i++) job->vind[i] = vind[i];
+    convexdatacache_prepare(coords, matrix, vind, numv, mind, nind, tind,
+                            matbind, normbind, texbind,
+                            job->vertexinfo, job->points);
+    job->matbind = matbind;
+    job->normbind = normbind;
+    job->texbind = texbind;
+
+    SoNode * node = PRIVATE(this)->defernode;
+    PRIVATE(this)->defernode = NULL;
+    PRIVATE(this)->job = job;
+    job->schedule(node, PRIVATE(this)->deferthreads);
+    return;
+  }
 
-  PRIVATE(this)->coordIndices.fit();
-  if (tessdata.matIndex) PRIVATE(this)->materialIndices.fit();
-  if (tessdata.normIndex) PRIVATE(this)->normalIndices.fit();
-  if (tessdata.texIndex) PRIVATE(this)->texIndices.fit();
+  // FIXME: stupid to have a separate struct for each coordIndex
+  // should only allocate enough to hold the largest polygon
+  tVertexInfo * vertexinfo = new tVertexInfo[numv];
+  SbVec3f * points = new SbVec3f[numv];
+  convexdatacache_prepare(coords, matrix, vind, numv, mind, nind, tind,
+                          matbind, normbind, texbind, vertexinfo, points);
+  convexdatacache_tessellate(PRIVATE(this), vind, numv, vertexinfo, points,
+                             matbind, normbind, texbind);
+  delete [] vertexinfo;
+  delete [] points;
 }
 
 //
@@ -57,19 +57,49 @@
 #include <Inventor/errors/SoDebugError.h>
 
 #include "tidbitsp.h"
+#include "caches/SoCacheBuildJob.h"
+#include "caches/SoNormalCacheP.h"
 
 // *************************************************************************
 
 #ifndef DOXYGEN_SKIP_THIS
-class SoNormalCacheP {
+// Holds a copy of the arguments to one of the generatePer*() methods,
+// and calls the method on a worker thread.
+class SoNormalCacheJob : public SoCacheBuildJob {
 public:
-  int numNormals;
-  union {
-    const SbVec3f *normals;
-    SoNormalGenerator *generator;
-  } normalData;
+  enum Method {
+    PER_VERTEX,
+    PER_FACE,
+    PER_FACE_STRIP,
+    PER_STRIP,
+    PER_VERTEX_QUAD,
+    PER_FACE_QUAD,
+    PER_ROW_QUAD
+  };
+
+  SoNormalCacheJob(SoNormalCache * cache, const Method method)
+    : cache(cache), method(method), hasfacenormals(FALSE) { }
+  virtual ~SoNormalCacheJob() { this->wait(); }
+
+  void copyCoords(const SbVec3f * coords, const unsigned int numcoords,
+                  const int32_t * vindex, const int numvi);
+  void copyCoords(const SbVec3f * coords, const unsigned int numcoords,
+                  const int vPerRow, const int vPerColumn);
+
+  SoNormalCache * cache;
+  Method method;
+  SbList <SbVec3f> coords;
   SbList <int32_t> indices;
-  SbList <SbVec3f> normalArray;
+  SbList <SbVec3f> facenormals;
+  SbBool hasfacenormals;
+  float creaseangle;
+  SbBool ccw;
+  SbBool tristrip;
+  int vPerRow;
+  int vPerColumn;
+
+protected:
+  virtual void run(void);
 };
 #endif // DOXYGEN_SKIP_THIS
 
@@ -85,6 +115,124 @@ public:
 
 // *************************************************************************
 
+#ifndef DOXYGEN_SKIP_THIS
+
+// Copies the coordinates and indices used by an indexed
+// generatePer*() call. Only coordinates up to the largest index are
+// needed.
+void
+SoNormalCacheJob::copyCoords(const SbVec3f * coords,
+                             const unsigned int numcoords,
+                             const int32_t * vindex,
+                             const int numvi)
+{
+  int i, maxi = -1;
+  this->indices.ensureCapacity(numvi);
+  for (i = 0; i < numvi; i++) {
+    if (vindex[i] > maxi) maxi = vindex[i];
+    this->indices.append(vindex[i]);
+  }
+  const int num = static_cast<int>(SbMin(numcoords, static_cast<unsigned int>(maxi + 1)));
+  this->coords.ensureCapacity(num);
+  for (i = 0; i < num; i++) this->coords.append(coords[i]);
+}
+
+// Copies the coordinates used by a quad generatePer*() call.
+void
+SoNormalCacheJob::copyCoords(const SbVec3f * coords,
+                             const unsigned int numcoords,
+                             const int vPerRow,
+                             const int vPerColumn)
+{
+  unsigned int num = numcoords;
+  if (vPerRow > 0 && vPerColumn > 0) {
+    num = SbMin(num, static_cast<unsigned int>(vPerRow * vPerColumn));
+  }
+  this->coords.ensureCapacity(num);
+  for (unsigned int i = 0; i < num; i++) this->coords.append(coords[i]);
+  this->vPerRow = vPerRow;
+  this->vPerColumn = vPerColumn;
+}
+
+void
+SoNormalCacheJob::run(void)
+{
+  const SbVec3f * coords = this->coords.getArrayPtr();
+  const unsigned int numcoords = this->coords.getLength();
+  const int32_t * vindex = this->indices.getArrayPtr();
+  const int numvi = this->indices.getLength();
+
+  switch (this->method) {
+  case PER_VERTEX:
+    this->cache->generatePerVertex(coords, numcoords, vindex, numvi,
+                                   this->creaseangle,
+                                   this->hasfacenormals ?
+                                   this->facenormals.getArrayPtr() : NULL,
+                                   this->hasfacenormals ?
+                                   this->facenormals.getLength() : -1,
+                                   this->ccw, this->tristrip);
+    break;
+  case PER_FACE:
+    this->cache->generatePerFace(coords, numcoords, vindex, numvi, this->ccw);
+    break;
+  case PER_FACE_STRIP:
+    this->cache->generatePerFaceStrip(coords, numcoords, vindex, numvi, this->ccw);
+    break;
+  case PER_STRIP:
+    this->cache->generatePerStrip(coords, numcoords, vindex, numvi, this->ccw);
+    break;
+  case PER_VERTEX_QUAD:
+    this->cache->generatePerVertexQuad(coords, numcoords, this->vPerRow,
+                                       this->vPerColumn, this->ccw);
+    break;
+  case PER_FACE_QUAD:
+    this->cache->generatePerFaceQuad(coords, numcoords, this->vPerRow,
+                                     this->vPerColumn, this->ccw);
+    break;
+  case PER_ROW_QUAD:
+    this->cache->generatePerRowQuad(coords, numcoords, this->vPerRow,
+                                    this->vPerColumn, this->ccw);
+    break;
+  }
+}
+
+// Makes the next generatePer*() call on cache copy its arguments and
+// generate the normals on a worker thread, touching node when
+// done. Pass NULL for node to turn it off again.
+void
+SoNormalCacheP::deferGenerate(SoNormalCache * cache, SoNode * node,
+                              const int numthreads)
+{
+  PRIVATE(cache)->defernode = node;
+  PRIVATE(cache)->deferthreads = numthreads;
+}
+
+// Returns FALSE while normals are being generated on a worker
+// thread. The cache must not be used before this returns TRUE.
+SbBool
+SoNormalCacheP::isGenerated(SoNormalCache * cache)
+{
+  SoNormalCacheP * thisp = PRIVATE(cache);
+  if (thisp->job && thisp->job->isDone()) {
+    delete thisp->job;
+    thisp->job = NULL;
+  }
+  return thisp->job == NULL;
+}
+
+void
+SoNormalCacheP::schedule(SoCacheBuildJob * job)
+{
+  SoNode * node = this->defernode;
+  this->defernode = NULL;
+  this->job = job;
+  job->schedule(node, this->deferthreads);
+}
+
+#endif // DOXYGEN_SKIP_THIS
+
+// *************************************************************************
+
 /*!
   Constructor with \a state being the current state.
 */
@@ -94,6 +242,9 @@ SoNormalCache::SoNormalCache(SoState * const state)
   PRIVATE(this) = new SoNormalCacheP;
   PRIVATE(this)->normalData.normals = NULL;
   PRIVATE(this)->numNormals = 0;
+  PRIVATE(this)->defernode = NULL;
+  PRIVATE(this)->deferthreads = 0;
+  PRIVATE(this)->job = NULL;
 
 #if COIN_DEBUG
   if (coin_debug_caching_level() > 0) {
@@ -117,6 +268,7 @@ SoNormalCache::~SoNormalCache()
   }
 #endif // debug
 
+  delete PRIVATE(this)->job;
   this->clearGenerator();
   delete PRIVATE(this);
 }
@@ -256,6 +408,22 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
   SoDebugError::postInfo("SoNormalCache::generatePerVertex", "generating normals");
 #endif
 
+  // face normals with an unknown count can't be copied
+  if (PRIVATE(this)->defernode && (facenormals == NULL || numfacenormals >= 0)) {
+    SoNormalCacheJob * job =
+      new SoNormalCacheJob(this, SoNormalCacheJob::PER_VERTEX);
+    job->copyCoords(coords, numcoords, vindex, numvi);
+    for (int i = 0; facenormals && i < numfacenormals; i++) {
+      job->facenormals.append(facenormals[i]);
+    }
+    job->hasfacenormals = facenormals != NULL;
+    job->creaseangle = crease_angle;
+    job->ccw = ccw;
+    job->tristrip = tristrip;
+    PRIVATE(this)->schedule(job);
+    return;
+  }
+
   this->clearGenerator();
   PRIVATE(this)->indices.truncate(0);
   PRIVATE(this)->normalArray.truncate(0);
@@ -460,6 +628,15 @@ SoNormalCache::generatePerFace(const SbVec3f * const coords,
     SoDebugError::postInfo("SoNormalCache::generatePerFace", "generating normals");
 #endif
 
+  if (PRIVATE(this)->defernode) {
+    SoNormalCacheJob * job =
+      new SoNormalCacheJob(this, SoNormalCacheJob::PER_FACE);
+    job->copyCoords(coords, numcoords, cind, nv);
+    job->ccw = ccw;
+    PRIVATE(this)->schedule(job);
+    return;
+  }
+
   this->clearGenerator();
   PRIVATE(this)->indices.truncate(0);
   PRIVATE(this)->normalArray.truncate(0, TRUE);
@@ -615,6 +792,15 @@ SoNormalCache::generatePerFaceStrip(const SbVec3f * const coords,
   SoDebugError::postInfo("SoNormalCache::generatePerFaceStrip", "generating normals");
 #endif
 
+  if (PRIVATE(this)->defernode) {
+    SoNormalCacheJob * job =
+      new SoNormalCacheJob(this, SoNormalCacheJob::PER_FACE_STRIP);
+    job->copyCoords(coords, numcoords, cind, nv);
+    job->ccw = ccw;
+    PRIVATE(this)->schedule(job);
+    return;
+  }
+
   this->clearGenerator();
   PRIVATE(this)->indices.truncate(0);
   PRIVATE(this)->normalArray.truncate(0, TRUE);
@@ -774,6 +960,15 @@ SoNormalCache::generatePerStrip(const SbVec3f * const coords,
   SoDebugError::postInfo("SoNormalCache::generatePerStrip", "generating normals");
 #endif
 
+  if (PRIVATE(this)->defernode) {
+    SoNormalCacheJob * job =
+      new SoNormalCacheJob(this, SoNormalCacheJob::PER_STRIP);
+    job->copyCoords(coords, numcoords, cind, nv);
+    job->ccw = ccw;
+    PRIVATE(this)->schedule(job);
+    return;
+  }
+
   this->clearGenerator();
   PRIVATE(this)->indices.truncate(0);
   PRIVATE(this)->normalArray.truncate(0, TRUE);
@@ -911,6 +1106,15 @@ SoNormalCache::generatePerVertexQuad(const SbVec3f * const coords,
   SoDebugError::postInfo("SoNormalCache::generatePerVertexQuad", "generating normals");
 #endif
 
+  if (PRIVATE(this)->defernode) {
+    SoNormalCacheJob * job =
+      new SoNormalCacheJob(this, SoNormalCacheJob::PER_VERTEX_QUAD);
+    job->copyCoords(coords, numcoords, vPerRow, vPerColumn);
+    job->ccw = ccw;
+    PRIVATE(this)->schedule(job);
+    return;
+  }
+
   this->clearGenerator();
   PRIVATE(this)->normalArray.truncate(0, TRUE);
   // avoid reallocations in growable array by setting the buffer size first
@@ -978,6 +1182,15 @@ SoNormalCache::generatePerFaceQuad(const SbVec3f * const coords,
   SoDebugError::postInfo("SoNormalCache::generatePerFaceQuad", "generating normals");
 #endif
 
+  if (PRIVATE(this)->defernode) {
+    SoNormalCacheJob * job =
+      new SoNormalCacheJob(this, SoNormalCacheJob::PER_FACE_QUAD);
+    job->copyCoords(coords, numcoords, vPerRow, vPerColumn);
+    job->ccw = ccw;
+    PRIVATE(this)->schedule(job);
+    return;
+  }
+
   this->clearGenerator();
   PRIVATE(this)->normalArray.truncate(0, TRUE);
   // avoid reallocations in growable array by setting the buffer size first
@@ -1064,6 +1277,15 @@ SoNormalCache::generatePerRowQuad(const SbVec3f * const coords,
   SoDebugError::postInfo("SoNormalCache::generatePerRowQuad", "generating normals");
 #endif
 
+  if (PRIVATE(this)->defernode) {
+    SoNormalCacheJob * job =
+      new SoNormalCacheJob(this, SoNormalCacheJob::PER_ROW_QUAD);
+    job->copyCoords(coords, numcoords, vPerRow, vPerColumn);
+    job->ccw = ccw;
+    PRIVATE(this)->schedule(job);
+    return;
+  }
+
   this->clearGenerator();
   PRIVATE(this)->normalArray.truncate(0, TRUE);
   SbVec3f n;
@@ -188,6 +188,7 @@ public:
   SoGLLazyElement::GLState poststate;
 
   void addVertex(const Vertex & v);
+  SbBool optimizeVertexCache(void);
 
   void renderImmediate(const cc_glglue * glue,
                        const GLint * indices,
@@ -239,6 +240,140 @@ namespace {
     }
     return FALSE;
   }
+
+#if COIN_DEBUG
+  // Returns the average number of cache misses per triangle when
+  // rendering the triangles through a FIFO vertex cache.
+  float sopvcache_acmr(const GLint * indices, const int numtri,
+                       const int numv, const int cachesize)
+  {
+    // a vertex is in the cache if fewer than cachesize misses have
+    // happened since it was loaded
+    int * loaded = new int[numv];
+    for (int i = 0; i < numv; i++) loaded[i] = -cachesize-1;
+    int misses = 0;
+    for (int i = 0; i < numtri * 3; i++) {
+      const int v = indices[i];
+      if (misses - loaded[v] > cachesize) {
+        loaded[v] = misses++;
+      }
+    }
+    delete[] loaded;
+    return float(misses) / float(numtri);
+  }
+#endif // debug
+
+  // Reorders triangles for the post-transform vertex cache, using the
+  // Tipsify algorithm from "Fast Triangle Reordering for Vertex
+  // Locality and Reduced Overdraw" by Sander, Nehab and Barczak. It
+  // runs in linear time, which matters since it's done every time a
+  // cache is built.
+  void sopvcache_tipsify(const GLint * indices, const int numtri,
+                         const int numv, const int cachesize,
+                         GLint * out)
+  {
+    int i, j;
+    const int numidx = numtri * 3;
+
+    // the triangles using each vertex, and how many of them that are
+    // still not emitted
+    int * live = new int[numv];
+    int * offset = new int[numv+1];
+    int * adjacency = new int[numidx];
+    for (i = 0; i < numv; i++) live[i] = 0;
+    for (i = 0; i < numidx; i++) live[indices[i]]++;
+    offset[0] = 0;
+    for (i = 0; i < numv; i++) offset[i+1] = offset[i] + live[i];
+    int * fill = new int[numv];
+    for (i = 0; i < numv; i++) fill[i] = offset[i];
+    for (i = 0; i < numidx; i++) adjacency[fill[indices[i]]++] = i / 3;
+    delete[] fill;
+
+    int * timestamp = new int[numv];
+    for (i = 0; i < numv; i++) timestamp[i] = 0;
+    unsigned char * emitted = new unsigned char[numtri];
+    for (i = 0; i < numtri; i++) emitted[i] = 0;
+
+    SbList <int> deadend;
+    SbList <int> candidates;
+    int time = cachesize + 1;
+    int cursor = 1;
+    int numout = 0;
+    int fan = 0;
+
+    while (fan >= 0) {
+      // emit all remaining triangles around the fanning vertex
+      candidates.truncate(0);
+      for (i = offset[fan]; i < offset[fan+1]; i++) {
+        const int t = adjacency[i];
+        if (emitted[t]) continue;
+        for (j = 0; j < 3; j++) {
+          const int v = indices[t*3+j];
+          out[numout++] = v;
+          deadend.push(v);
+          candidates.append(v);
+          live[v]--;
+          if (time - timestamp[v] > cachesize) {
+            timestamp[v] = time++;
+          }
+        }
+        emitted[t] = 1;
+      }
+
+      // continue with the candidate that will stay in the cache the
+      // longest, without being evicted before its triangles are done
+      int next = -1;
+      int best = -1;
+      for (i = 0; i < candidates.getLength(); i++) {
+        const int v = candidates[i];
+        if (live[v] > 0) {
+          int priority = 0;
+          if (time - timestamp[v] + 2 * live[v] <= cachesize) {
+            priority = time - timestamp[v];
+          }
+          if (priority > best) {
+            best = priority;
+            next = v;
+          }
+        }
+      }
+      if (next < 0) {
+        // dead end, try recently used vertices first
+        while (deadend.getLength() > 0) {
+          const int v = deadend.pop();
+          if (live[v] > 0) { next = v; break; }
+        }
+      }
+      if (next < 0) {
+        while (cursor < numv && live[cursor] == 0) cursor++;
+        if (cursor < numv) next = cursor;
+      }
+      fan = next;
+    }
+    assert(numout == numidx);
+
+    delete[] live;
+    delete[] offset;
+    delete[] adjacency;
+    delete[] timestamp;
+    delete[] emitted;
+  }
+
+  template <class Type>
+  void sopvcache_remap(SbList <Type> & list, const int * remap,
+                       const int numv, const int stride)
+  {
+    if (list.getLength() < numv * stride) return;
+    Type * ptr = const_cast<Type *>(list.getArrayPtr());
+    Type * tmp = new Type[numv * stride];
+    for (int i = 0; i < numv * stride; i++) tmp[i] = ptr[i];
+    for (int i = 0; i < numv; i++) {
+      for (int j = 0; j < stride; j++) {
+        ptr[remap[i]*stride+j] = tmp[i*stride+j];
+      }
+    }
+    delete[] tmp;
+  }
 };
 
 // *************************************************************************
@@ -834,7 +969,11 @@ SoPrimitiveVertexCache::fit(void)
   PRIVATE(this)->rgbalist.fit();
   PRIVATE(this)->vhash.clear();
 
-  if (PRIVATE(this)->triangleindexer) PRIVATE(this)->triangleindexer->close();
+  // reorder before the indexers are closed, since that compacts the
+  // indices. Reordered triangles shouldn't be sorted again.
+  const SbBool reordered = PRIVATE(this)->optimizeVertexCache();
+
+  if (PRIVATE(this)->triangleindexer) PRIVATE(this)->triangleindexer->close(!reordered);
   if (PRIVATE(this)->lineindexer) PRIVATE(this)->lineindexer->close();
   if (PRIVATE(this)->pointindexer) PRIVATE(this)->pointindexer->close();
 }
@@ -940,6 +1079,76 @@ SoPrimitiveVertexCacheP::addVertex(const Vertex & v)
   }
 }
 
+//
+// Reorders the triangles to get more hits in the GPU vertex cache,
+// and then the vertices in the order they are first used by the
+// triangles, so that vertex fetches are mostly sequential. Returns
+// TRUE if the triangles were reordered.
+//
+SbBool
+SoPrimitiveVertexCacheP::optimizeVertexCache(void)
+{
+  static int COIN_VERTEX_CACHE_SIZE = -1;
+  if (COIN_VERTEX_CACHE_SIZE < 0) {
+    const char * env = coin_getenv("COIN_VERTEX_CACHE_SIZE");
+    if (env) COIN_VERTEX_CACHE_SIZE = SbMax(atoi(env), 0);
+    else COIN_VERTEX_CACHE_SIZE = 16;
+  }
+  const int cachesize = COIN_VERTEX_CACHE_SIZE;
+  const int numv = this->vertexlist.getLength();
+  if (cachesize == 0 || this->triangleindexer == NULL || numv <= cachesize) return FALSE;
+
+  const int numtri = this->triangleindexer->getNumIndices() / 3;
+  if (numtri == 0) return FALSE;
+
+  GLint * indices = this->triangleindexer->getWriteableIndices();
+  GLint * ordered = new GLint[numtri*3];
+  sopvcache_tipsify(indices, numtri, numv, cachesize, ordered);
+
+#if COIN_DEBUG
+  if (coin_debug_caching_level() > 0) {
+    SoDebugError::postInfo("SoPrimitiveVertexCacheP::optimizeVertexCache",
+                           "%d triangles reordered for a vertex cache of "
+                           "size %d, misses per triangle: %.3f -> %.3f",
+                           numtri, cachesize,
+                           sopvcache_acmr(indices, numtri, numv, cachesize),
+                           sopvcache_acmr(ordered, numtri, numv, cachesize));
+  }
+#endif // debug
+
+  // vertices only used by lines or points are placed last
+  int * remap = new int[numv];
+  int i, numremapped = 0;
+  for (i = 0; i < numv; i++) remap[i] = -1;
+  for (i = 0; i < numtri*3; i++) {
+    if (remap[ordered[i]] < 0) remap[ordered[i]] = numremapped++;
+  }
+  for (i = 0; i < numv; i++) {
+    if (remap[i] < 0) remap[i] = numremapped++;
+  }
+  for (i = 0; i < numtri*3; i++) indices[i] = remap[ordered[i]];
+  delete[] ordered;
+
+  SoVertexArrayIndexer * other[2] = { this->lineindexer, this->pointindexer };
+  for (int j = 0; j < 2; j++) {
+    if (other[j] == NULL) continue;
+    const int num = other[j]->getNumIndices();
+    GLint * ptr = other[j]->getWriteableIndices();
+    for (i = 0; i < num; i++) ptr[i] = remap[ptr[i]];
+  }
+
+  sopvcache_remap(this->vertexlist, remap, numv, 1);
+  sopvcache_remap(this->normallist, remap, numv, 1);
+  sopvcache_remap(this->texcoordlist, remap, numv, 1);
+  sopvcache_remap(this->bumpcoordlist, remap, numv, 1);
+  sopvcache_remap(this->rgbalist, remap, numv, 4);
+  for (i = 1; i <= this->lastenabled; i++) {
+    sopvcache_remap(this->multitexcoords[i], remap, numv, 1);
+  }
+  delete[] remap;
+  return TRUE;
+}
+
 void
 SoPrimitiveVertexCacheP::enableArrays(const cc_glglue * glue,
                                       const SbBool color, const SbBool normal,
@@ -1134,3 +1343,296 @@ SoPrimitiveVertexCacheP::renderImmediate(const cc_glglue * glue,
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <cstring>
+
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/nodes/SoCallback.h>
+
+// only traverses, without the OpenGL setup of SoGLRenderAction, so
+// that the cache can be made from a GL render state
+class SoPVCacheRenderAction : public SoGLRenderAction {
+public:
+  SoPVCacheRenderAction(void) : SoGLRenderAction(SbViewportRegion(100, 100)) { }
+protected:
+  virtual void beginTraversal(SoNode * node) { this->traverse(node); }
+};
+
+// a grid of triangles, added in a scrambled order, plus a line and a
+// point between vertices not used by any triangle
+#define PVCACHE_GRID_SIZE 12
+
+static SbList <int> pvcache_input;
+static float pvcache_acmr_input;
+
+// Returns the average number of cache misses per triangle when
+// rendering the triangles through a FIFO vertex cache of 16 entries.
+static float
+pvcache_acmr(const int * indices, const int numtri, const int numv)
+{
+  const int cachesize = 16;
+  SbList <int> loaded;
+  for (int i = 0; i < numv; i++) loaded.append(-cachesize - 1);
+  int misses = 0;
+  for (int i = 0; i < numtri * 3; i++) {
+    if (misses - loaded[indices[i]] > cachesize) loaded[indices[i]] = misses++;
+  }
+  return float(misses) / float(numtri);
+}
+
+static SbVec3f
+pvcache_normal(const SbVec3f & p)
+{
+  SbVec3f n(p[0], p[1], 10.0f);
+  (void) n.normalize();
+  return n;
+}
+
+static SbVec4f
+pvcache_texcoord(const SbVec3f & p)
+{
+  return SbVec4f(p[0] / PVCACHE_GRID_SIZE, p[1] / PVCACHE_GRID_SIZE, 0.0f, 1.0f);
+}
+
+static void
+pvcache_add_vertex(SoPrimitiveVertex & v, const SbVec3f & p)
+{
+  v.setPoint(p);
+  v.setNormal(pvcache_normal(p));
+  v.setTextureCoords(pvcache_texcoord(p));
+  v.setMaterialIndex(0);
+}
+
+static void
+pvcache_build_cb(void * closure, SoAction * action)
+{
+  if (!action->isOfType(SoGLRenderAction::getClassTypeId())) return;
+  SoPrimitiveVertexCache ** cacheptr = static_cast<SoPrimitiveVertexCache **>(closure);
+  SoPrimitiveVertexCache * cache = new SoPrimitiveVertexCache(action->getState());
+  cache->ref();
+
+  const int n = PVCACHE_GRID_SIZE;
+  SbList <int> input;
+  for (int y = 0; y < n - 1; y++) {
+    for (int x = 0; x < n - 1; x++) {
+      const int i = y * n + x;
+      input.append(i); input.append(i + 1); input.append(i + n);
+      input.append(i + 1); input.append(i + n + 1); input.append(i + n);
+    }
+  }
+  // scramble the triangles, keeping the vertex order of each
+  const int numtri = input.getLength() / 3;
+  uint32_t seed = 1;
+  for (int t = numtri - 1; t > 0; t--) {
+    seed = seed * 1664525 + 1013904223;
+    const int other = int((seed >> 8) % uint32_t(t + 1));
+    for (int j = 0; j < 3; j++) {
+      const int tmp = input[t * 3 + j];
+      input[t * 3 + j] = input[other * 3 + j];
+      input[other * 3 + j] = tmp;
+    }
+  }
+  pvcache_input = input;
+  pvcache_acmr_input = pvcache_acmr(input.getArrayPtr(), numtri, n * n);
+
+  SoPrimitiveVertex v[3];
+  for (int t = 0; t < numtri; t++) {
+    for (int j = 0; j < 3; j++) {
+      const int i = input[t * 3 + j];
+      pvcache_add_vertex(v[j], SbVec3f(float(i % n), float(i / n), 0.0f));
+    }
+    cache->addTriangle(&v[0], &v[1], &v[2]);
+  }
+  pvcache_add_vertex(v[0], SbVec3f(-1.0f, 0.0f, 0.0f));
+  pvcache_add_vertex(v[1], SbVec3f(-2.0f, 0.0f, 0.0f));
+  cache->addLine(&v[0], &v[1]);
+  pvcache_add_vertex(v[2], SbVec3f(-3.0f, 0.0f, 0.0f));
+  cache->addPoint(&v[2]);
+  cache->fit();
+  *cacheptr = cache;
+}
+
+BOOST_AUTO_TEST_CASE(vertexCacheOrder)
+{
+  SoPrimitiveVertexCache * cache = NULL;
+  SoCallback * node = new SoCallback;
+  node->ref();
+  node->setCallback(pvcache_build_cb, &cache);
+  SoPVCacheRenderAction action;
+  action.apply(node);
+  node->unref();
+  BOOST_REQUIRE(cache != NULL);
+
+  const int n = PVCACHE_GRID_SIZE;
+  const int numv = cache->getNumVertices();
+  BOOST_REQUIRE_EQUAL(numv, n * n + 3);
+  const SbVec3f * vertices = cache->getVertexArray();
+  const SbVec3f * normals = cache->getNormalArray();
+  const SbVec4f * texcoords = cache->getTexCoordArray();
+
+  // the normals and texture coordinates must follow their vertices
+  int i;
+  SbBool followed = TRUE;
+  for (i = 0; i < numv; i++) {
+    followed = followed &&
+      normals[i].equals(pvcache_normal(vertices[i]), 1.0e-6f) &&
+      texcoords[i].equals(pvcache_texcoord(vertices[i]), 1.0e-6f);
+  }
+  BOOST_CHECK_MESSAGE(followed, "vertex attributes were not moved with their vertices");
+
+  // each input triangle must be there once, with its vertices in the
+  // same order
+  const int numtri = cache->getNumTriangleIndices() / 3;
+  BOOST_REQUIRE_EQUAL(numtri, pvcache_input.getLength() / 3);
+  const GLint * indices = cache->getTriangleIndices();
+  SbList <int> count;
+  for (i = 0; i < numtri; i++) count.append(0);
+  SbList <int> gridindices;
+  SbBool valid = TRUE;
+  for (i = 0; i < numtri * 3 && valid; i++) {
+    valid = indices[i] >= 0 && indices[i] < n * n;
+    if (valid) {
+      const SbVec3f & p = vertices[indices[i]];
+      gridindices.append(int(p[1]) * n + int(p[0]));
+    }
+  }
+  BOOST_REQUIRE_MESSAGE(valid, "triangle index out of range");
+  for (i = 0; i < numtri && valid; i++) {
+    const int * t = &gridindices[i * 3];
+    int found = -1;
+    for (int k = 0; k < numtri && found < 0; k++) {
+      const int * in = &pvcache_input[k * 3];
+      if (t[0] == in[0] && t[1] == in[1] && t[2] == in[2]) found = k;
+    }
+    valid = (found >= 0) && (count[found]++ == 0);
+  }
+  BOOST_CHECK_MESSAGE(valid, "the triangles are not a permutation of the input");
+
+  // the line and point vertices come after the triangle vertices
+  BOOST_REQUIRE_EQUAL(cache->getNumLineIndices(), 2);
+  BOOST_REQUIRE_EQUAL(cache->getNumPointIndices(), 1);
+  const GLint * line = cache->getLineIndices();
+  const GLint * point = cache->getPointIndices();
+  BOOST_CHECK(line[0] >= n * n && line[1] >= n * n && point[0] >= n * n);
+  BOOST_CHECK(vertices[line[0]] == SbVec3f(-1.0f, 0.0f, 0.0f));
+  BOOST_CHECK(vertices[line[1]] == SbVec3f(-2.0f, 0.0f, 0.0f));
+  BOOST_CHECK(vertices[point[0]] == SbVec3f(-3.0f, 0.0f, 0.0f));
+
+  // and the reordering must not make the cache behave worse
+  const float acmr = pvcache_acmr(indices, numtri, numv);
+  BOOST_CHECK_MESSAGE(acmr <= pvcache_acmr_input,
+                      "more vertex cache misses after reordering");
+
+  cache->unref();
+}
+
+// triangles that don't share vertices, so that the vertex indices go
+// past 65535 when there are enough of them, plus lines and points
+// that get the last vertex indices
+static void
+pvcache_build_separate_cb(void * closure, SoAction * action)
+{
+  if (!action->isOfType(SoGLRenderAction::getClassTypeId())) return;
+  void ** data = static_cast<void **>(closure);
+  const int numtri = *static_cast<int *>(data[0]);
+  SoPrimitiveVertexCache * cache = new SoPrimitiveVertexCache(action->getState());
+  cache->ref();
+
+  SoPrimitiveVertex v[3];
+  for (int t = 0; t < numtri; t++) {
+    for (int j = 0; j < 3; j++) {
+      pvcache_add_vertex(v[j], SbVec3f(float(t), float(j), 0.0f));
+    }
+    cache->addTriangle(&v[0], &v[1], &v[2]);
+  }
+  for (int l = 0; l < 4; l++) {
+    pvcache_add_vertex(v[0], SbVec3f(float(l), -1.0f, 0.0f));
+    pvcache_add_vertex(v[1], SbVec3f(float(l), -2.0f, 0.0f));
+    cache->addLine(&v[0], &v[1]);
+    pvcache_add_vertex(v[2], SbVec3f(float(l), -3.0f, 0.0f));
+    cache->addPoint(&v[2]);
+  }
+  cache->fit();
+  *static_cast<SoPrimitiveVertexCache **>(data[1]) = cache;
+}
+
+BOOST_AUTO_TEST_CASE(indexRoundTrip)
+{
+  // all indices fit in 16 bits, and some of them do
+  const int sizes[2] = { 100, 70000 / 3 };
+  for (int s = 0; s < 2; s++) {
+    int numtri = sizes[s];
+    SoPrimitiveVertexCache * cache = NULL;
+    void * data[2] = { &numtri, &cache };
+    SoCallback * node = new SoCallback;
+    node->ref();
+    node->setCallback(pvcache_build_separate_cb, data);
+    SoPVCacheRenderAction action;
+    action.apply(node);
+    node->unref();
+    BOOST_REQUIRE(cache != NULL);
+
+    const int numv = cache->getNumVertices();
+    BOOST_REQUIRE_EQUAL(numv, numtri * 3 + 12);
+    BOOST_REQUIRE_EQUAL(cache->getNumTriangleIndices(), numtri * 3);
+    const SbVec3f * vertices = cache->getVertexArray();
+
+    // every triangle must come back with its own vertices, in order
+    const GLint * indices = cache->getTriangleIndices();
+    SbList <int> count;
+    int i;
+    for (i = 0; i < numtri; i++) count.append(0);
+    SbBool valid = TRUE;
+    for (i = 0; i < numtri && valid; i++) {
+      const GLint * idx = &indices[i * 3];
+      valid = idx[0] >= 0 && idx[0] < numv && idx[1] >= 0 && idx[1] < numv &&
+        idx[2] >= 0 && idx[2] < numv;
+      if (valid) {
+        const int t = int(vertices[idx[0]][0]);
+        valid = t >= 0 && t < numtri && count[t]++ == 0 &&
+          vertices[idx[0]] == SbVec3f(float(t), 0.0f, 0.0f) &&
+          vertices[idx[1]] == SbVec3f(float(t), 1.0f, 0.0f) &&
+          vertices[idx[2]] == SbVec3f(float(t), 2.0f, 0.0f);
+      }
+    }
+    BOOST_CHECK_MESSAGE(valid, "triangle indices changed by the 16-bit round trip");
+
+    BOOST_REQUIRE_EQUAL(cache->getNumLineIndices(), 8);
+    BOOST_REQUIRE_EQUAL(cache->getNumPointIndices(), 4);
+    const GLint * lines = cache->getLineIndices();
+    const GLint * points = cache->getPointIndices();
+    SbBool found[4] = { FALSE, FALSE, FALSE, FALSE };
+    for (i = 0; i < 4; i++) {
+      const SbVec3f & p = vertices[lines[i * 2]];
+      const int l = int(p[0]);
+      BOOST_REQUIRE(l >= 0 && l < 4);
+      found[l] = TRUE;
+      BOOST_CHECK(p == SbVec3f(float(l), -1.0f, 0.0f));
+      BOOST_CHECK(vertices[lines[i * 2 + 1]] == SbVec3f(float(l), -2.0f, 0.0f));
+      BOOST_CHECK(vertices[points[i]][1] == -3.0f);
+    }
+    BOOST_CHECK(found[0] && found[1] && found[2] && found[3]);
+    if (s == 1) {
+      BOOST_CHECK_MESSAGE(lines[0] >= 65536, "expected 32-bit line indices");
+    }
+
+    // reading the indices again must give the same result
+    SbList <int> first;
+    for (i = 0; i < numtri * 3; i++) first.append(indices[i]);
+    const GLint * again = cache->getTriangleIndices();
+    BOOST_CHECK(again == indices);
+    BOOST_CHECK(memcmp(again, first.getArrayPtr(), numtri * 3 * sizeof(GLint)) == 0);
+    BOOST_CHECK_EQUAL(cache->getTriangleIndex(numtri * 3 - 1), first[numtri * 3 - 1]);
+    BOOST_CHECK_EQUAL(cache->getNumTriangleIndices(), numtri * 3);
+
+    cache->unref();
+  }
+}
+
+#undef PVCACHE_GRID_SIZE
+
+#endif // COIN_TEST_SUITE
@@ -0,0 +1,348 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+/*!
+  \class SoRayPickCache SoRayPickCache.h
+  \brief The SoRayPickCache class caches the triangles of a shape for picking.
+
+  \ingroup coin_caches
+
+  The cache keeps the triangles generated by a shape in a bounding
+  volume hierarchy, which is used to find the triangles a pick ray
+  might intersect without generating all the primitives of the shape.
+
+  Triangles are identified by the order in which they were generated.
+*/
+
+#include "caches/SoRayPickCache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include <Inventor/SbLine.h>
+#include <Inventor/SbVec3d.h>
+#include <Inventor/SbVec3f.h>
+
+// leaf nodes hold at most this many triangles
+#define SORAYPICKCACHE_LEAFSIZE 4
+
+// caches with fewer triangles are not worth it
+#define SORAYPICKCACHE_MINTRIANGLES 64
+
+class SoRayPickCacheP {
+public:
+  SoRayPickCacheP(void)
+    : haslinesorpoints(FALSE) { }
+
+  struct Node {
+    float bmin[3];
+    float bmax[3];
+    // for leaves, the range of triangles in 'order'. For other
+    // nodes, count is 0 and first is the index of the first of the
+    // two children.
+    int32_t first;
+    int32_t count;
+  };
+
+  std::vector<SbVec3f> vertices;
+  std::vector<int32_t> order;
+  std::vector<Node> nodes;
+  SbBool haslinesorpoints;
+
+  void build(const int nodeidx, const int first, const int count,
+             const std::vector<SbVec3f> & centers);
+  static SbBool intersect(const Node & node,
+                          const SbVec3d & orig, const SbVec3d & invdir);
+  SbBool intersect(const int triangle,
+                   const SbVec3d & orig, const SbVec3d & dir) const;
+};
+
+namespace {
+
+class soraypickcache_center_less {
+public:
+  soraypickcache_center_less(const std::vector<SbVec3f> & centers, const int axis)
+    : centers(centers), axis(axis) { }
+  bool operator()(const int32_t a, const int32_t b) const {
+    return this->centers[a][this->axis] < this->centers[b][this->axis];
+  }
+private:
+  const std::vector<SbVec3f> & centers;
+  const int axis;
+};
+
+} // namespace
+
+void
+SoRayPickCacheP::build(const int nodeidx, const int first, const int count,
+                       const std::vector<SbVec3f> & centers)
+{
+  SbVec3f bmin(FLT_MAX, FLT_MAX, FLT_MAX);
+  SbVec3f bmax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  SbVec3f cmin(bmin), cmax(bmax);
+  for (int i = first; i < first + count; i++) {
+    const int32_t t = this->order[i];
+    for (int j = 0; j < 3; j++) {
+      const SbVec3f & v = this->vertices[t * 3 + j];
+      for (int k = 0; k < 3; k++) {
+        if (v[k] < bmin[k]) bmin[k] = v[k];
+        if (v[k] > bmax[k]) bmax[k] = v[k];
+      }
+    }
+    for (int k = 0; k < 3; k++) {
+      if (centers[t][k] < cmin[k]) cmin[k] = centers[t][k];
+      if (centers[t][k] > cmax[k]) cmax[k] = centers[t][k];
+    }
+  }
+
+  Node & node = this->nodes[nodeidx];
+  for (int k = 0; k < 3; k++) {
+    // grow the box slightly so that rays grazing a triangle edge are
+    // never rejected because of rounding errors
+    const float eps = (bmax[k] - bmin[k] + SbAbs(bmax[k]) + SbAbs(bmin[k])) * 1.0e-5f + FLT_MIN;
+    node.bmin[k] = bmin[k] - eps;
+    node.bmax[k] = bmax[k] + eps;
+  }
+
+  if (count <= SORAYPICKCACHE_LEAFSIZE) {
+    node.first = first;
+    node.count = count;
+    return;
+  }
+
+  // split at the median of the triangle centers along the longest
+  // axis of their bounding box
+  const SbVec3f extent = cmax - cmin;
+  int axis = 0;
+  if (extent[1] > extent[axis]) axis = 1;
+  if (extent[2] > extent[axis]) axis = 2;
+
+  const int half = count / 2;
+  std::nth_element(this->order.begin() + first,
+                   this->order.begin() + first + half,
+                   this->order.begin() + first + count,
+                   soraypickcache_center_less(centers, axis));
+
+  const int child = static_cast<int>(this->nodes.size());
+  node.first = child;
+  node.count = 0;
+  // 'node' is invalid after this, as the vector is reallocated
+  this->nodes.resize(child + 2);
+  this->build(child, first, half, centers);
+  this->build(child + 1, first + half, count - half, centers);
+}
+
+// slab test against an infinite line, like SoRayPickAction does for
+// triangles
+SbBool
+SoRayPickCacheP::intersect(const Node & node,
+                           const SbVec3d & orig, const SbVec3d & invdir)
+{
+  double tmin = -DBL_MAX;
+  double tmax = DBL_MAX;
+  for (int k = 0; k < 3; k++) {
+    if (invdir[k] == 0.0) {
+      // parallel to the slab
+      if (orig[k] < node.bmin[k] || orig[k] > node.bmax[k]) return FALSE;
+      continue;
+    }
+    double t0 = (node.bmin[k] - orig[k]) * invdir[k];
+    double t1 = (node.bmax[k] - orig[k]) * invdir[k];
+    if (t0 > t1) std::swap(t0, t1);
+    if (t0 > tmin) tmin = t0;
+    if (t1 < tmax) tmax = t1;
+    if (tmin > tmax) return FALSE;
+  }
+  return TRUE;
+}
+
+// same test as SoRayPickAction::intersect() for triangles, with some
+// slack, so that all triangles which could be hit are found
+SbBool
+SoRayPickCacheP::intersect(const int triangle,
+                           const SbVec3d & orig, const SbVec3d & dir) const
+{
+  SbVec3d v0, v1, v2;
+  v0.setValue(this->vertices[triangle * 3]);
+  v1.setValue(this->vertices[triangle * 3 + 1]);
+  v2.setValue(this->vertices[triangle * 3 + 2]);
+
+  const SbVec3d edge1 = v1 - v0;
+  const SbVec3d edge2 = v2 - v0;
+  const SbVec3d pvec = dir.cross(edge2);
+  const double det = edge1.dot(pvec);
+  if (fabs(det) < DBL_EPSILON) return FALSE;
+
+  const double eps = 1.0e-4;
+  const double invdet = 1.0 / det;
+  const SbVec3d tvec = orig - v0;
+  const double u = tvec.dot(pvec) * invdet;
+  if (u < -eps || u > 1.0 + eps) return FALSE;
+  const SbVec3d qvec = tvec.cross(edge1);
+  const double v = dir.dot(qvec) * invdet;
+  if (v < -eps || u + v > 1.0 + eps) return FALSE;
+  return TRUE;
+}
+
+#define PRIVATE(obj) ((obj)->pimpl)
+
+/*!
+  Constructor.
+*/
+SoRayPickCache::SoRayPickCache(SoState * state)
+  : SoCache(state)
+{
+  PRIVATE(this) = new SoRayPickCacheP;
+}
+
+/*!
+  Destructor.
+*/
+SoRayPickCache::~SoRayPickCache()
+{
+  delete PRIVATE(this);
+}
+
+/*!
+  Adds a triangle to the cache. Used while the shape is generating
+  its primitives.
+*/
+void
+SoRayPickCache::addTriangle(const SbVec3f & v0, const SbVec3f & v1, const SbVec3f & v2)
+{
+  PRIVATE(this)->vertices.push_back(v0);
+  PRIVATE(this)->vertices.push_back(v1);
+  PRIVATE(this)->vertices.push_back(v2);
+}
+
+/*!
+  Should be called if the shape generates lines or points. Such
+  shapes can not be picked using the cache.
+*/
+void
+SoRayPickCache::addLineOrPoint(void)
+{
+  PRIVATE(this)->haslinesorpoints = TRUE;
+}
+
+/*!
+  Builds the bounding volume hierarchy after all the triangles have
+  been added.
+*/
+void
+SoRayPickCache::close(void)
+{
+  if (!this->isUsable()) {
+    std::vector<SbVec3f>().swap(PRIVATE(this)->vertices);
+    return;
+  }
+
+  const int numtriangles = this->getNumTriangles();
+  std::vector<SbVec3f> centers(numtriangles);
+  PRIVATE(this)->order.resize(numtriangles);
+  for (int i = 0; i < numtriangles; i++) {
+    const SbVec3f * v = &PRIVATE(this)->vertices[i * 3];
+    centers[i] = (v[0] + v[1] + v[2]) / 3.0f;
+    PRIVATE(this)->order[i] = i;
+  }
+
+  PRIVATE(this)->nodes.reserve(2 * (numtriangles / (SORAYPICKCACHE_LEAFSIZE / 2) + 1));
+  PRIVATE(this)->nodes.resize(1);
+  PRIVATE(this)->build(0, 0, numtriangles, centers);
+}
+
+/*!
+  Returns \c TRUE if the cache can be used to pick the shape. That is
+  not the case for shapes with lines or points, or with too few
+  triangles for the cache to be of any use.
+*/
+SbBool
+SoRayPickCache::isUsable(void) const
+{
+  return !PRIVATE(this)->haslinesorpoints &&
+    this->getNumTriangles() >= SORAYPICKCACHE_MINTRIANGLES;
+}
+
+/*!
+  Returns the number of triangles in the cache.
+*/
+int
+SoRayPickCache::getNumTriangles(void) const
+{
+  return static_cast<int>(PRIVATE(this)->vertices.size() / 3);
+}
+
+/*!
+  Finds the triangles which might intersect \a line, which is given
+  in the coordinate system of the shape, and appends their numbers
+  to \a triangles in increasing order.
+*/
+void
+SoRayPickCache::findTriangles(const SbLine & line, SbList<int> & triangles) const
+{
+  if (PRIVATE(this)->nodes.empty()) return;
+
+  SbVec3d orig, dir;
+  orig.setValue(line.getPosition());
+  dir.setValue(line.getDirection());
+  const SbVec3d invdir(dir[0] != 0.0 ? 1.0 / dir[0] : 0.0,
+                       dir[1] != 0.0 ? 1.0 / dir[1] : 0.0,
+                       dir[2] != 0.0 ? 1.0 / dir[2] : 0.0);
+
+  const int first = triangles.getLength();
+  SbList<int32_t> stack(64);
+  stack.append(0);
+  while (stack.getLength()) {
+    const SoRayPickCacheP::Node & node = PRIVATE(this)->nodes[stack.pop()];
+    if (!SoRayPickCacheP::intersect(node, orig, invdir)) continue;
+    if (node.count == 0) {
+      stack.append(node.first);
+      stack.append(node.first + 1);
+      continue;
+    }
+    for (int i = node.first; i < node.first + node.count; i++) {
+      const int32_t t = PRIVATE(this)->order[i];
+      if (PRIVATE(this)->intersect(t, orig, dir)) triangles.append(t);
+    }
+  }
+
+  if (triangles.getLength() - first > 1) {
+    int * ptr = const_cast<int *>(triangles.getArrayPtr(first));
+    std::sort(ptr, ptr + triangles.getLength() - first);
+  }
+}
+
+#undef PRIVATE
+#undef SORAYPICKCACHE_LEAFSIZE
+#undef SORAYPICKCACHE_MINTRIANGLES
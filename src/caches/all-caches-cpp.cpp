@@ -32,12 +32,14 @@
 
 #include "SoBoundingBoxCache.cpp"
 #include "SoCache.cpp"
+#include "SoCacheBuildJob.cpp"
 #include "SoConvexDataCache.cpp"
 #include "SoGLCacheList.cpp"
 #include "SoGLRenderCache.cpp"
 #include "SoNormalCache.cpp"
 #include "SoTextureCoordinateCache.cpp"
 #include "SoPrimitiveVertexCache.cpp"
+#include "SoRayPickCache.cpp"
 #include "SoGlyphCache.cpp"
 #include "SoShaderProgramCache.cpp"
 #include "SoVBOCache.cpp"
@@ -52,10 +52,11 @@
 #include "config.h"
 #endif // HAVE_CONFIG_H
 
-#ifdef COIN_THREADSAFE
+#ifdef HAVE_THREADS
 #include <Inventor/threads/SbTypedStorage.h>
-#endif // COIN_THREADSAFE
+#endif // HAVE_THREADS
 
+#include "elements/SoCacheElementP.h"
 #include "tidbitsp.h"
 #include "SbBasicP.h"
 #include "coindefs.h"
@@ -66,17 +67,33 @@ SbBool SoCacheElement::invalidated = FALSE;
 
 // *************************************************************************
 
-#ifdef COIN_THREADSAFE
+#ifdef HAVE_THREADS
 
 static SbTypedStorage <SbBool*> * invalidated_storage = NULL;
 
+#ifndef COIN_THREADSAFE
+// the storage is only used while this is larger than zero
+static int invalidated_threadlocal = 0;
+#endif // !COIN_THREADSAFE
+
+static void
+cacheelement_invalidated_construct(void * ptr)
+{
+  *static_cast<SbBool *>(ptr) = FALSE;
+}
+
+static void
+cacheelement_invalidated_destruct(void *)
+{
+}
+
 static void
 cacheelement_cleanup(void)
 {
   delete invalidated_storage;
 }
 
-#endif // COIN_THREADSAFE
+#endif // HAVE_THREADS
 
 // *************************************************************************
 
@@ -94,11 +111,13 @@ SoCacheElement::initClass(void)
   SO_ELEMENT_INIT_CLASS(SoCacheElement, inherited);
   SoCacheElement::invalidated = FALSE;
 
-#ifdef COIN_THREADSAFE
-  invalidated_storage = new SbTypedStorage <SbBool*> (sizeof(SbBool));
-  *(invalidated_storage->get()) = FALSE;
+#ifdef HAVE_THREADS
+  invalidated_storage =
+    new SbTypedStorage <SbBool*> (sizeof(SbBool),
+                                  cacheelement_invalidated_construct,
+                                  cacheelement_invalidated_destruct);
   coin_atexit((coin_atexit_f*) cacheelement_cleanup, CC_ATEXIT_NORMAL);
-#endif // COIN_THREADSAFE
+#endif // HAVE_THREADS
 }
 
 /*!
@@ -316,12 +335,42 @@ SoCacheElement::setInvalid(const SbBool newvalue)
   SbBool oldval = *ptr;
   *ptr = newvalue;
 #else // COIN_THREADSAFE
+#ifdef HAVE_THREADS
+  if (invalidated_threadlocal > 0) {
+    SbBool * ptr = invalidated_storage->get();
+    SbBool oldval = *ptr;
+    *ptr = newvalue;
+    return oldval;
+  }
+#endif // HAVE_THREADS
   SbBool oldval = SoCacheElement::invalidated;
   SoCacheElement::invalidated = newvalue;
 #endif // ! COIN_THREADSAFE
   return oldval;
 }
 
+// *************************************************************************
+
+// Note that the counter is not protected by a mutex. It is only
+// changed by the calling thread before it starts, and after it has
+// waited for, the worker threads.
+void
+SoCacheElementP::beginThreadLocalInvalid(void)
+{
+#if defined(HAVE_THREADS) && !defined(COIN_THREADSAFE)
+  invalidated_threadlocal++;
+#endif // HAVE_THREADS && !COIN_THREADSAFE
+}
+
+void
+SoCacheElementP::endThreadLocalInvalid(void)
+{
+#if defined(HAVE_THREADS) && !defined(COIN_THREADSAFE)
+  assert(invalidated_threadlocal > 0);
+  invalidated_threadlocal--;
+#endif // HAVE_THREADS && !COIN_THREADSAFE
+}
+
 /*!
   This method returns the current cache.  No cache dependencies are honored.
 */
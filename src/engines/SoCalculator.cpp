@@ -209,6 +209,9 @@
 #include "SbBasicP.h"
 
 #include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
 
 #include <Inventor/lists/SoEngineOutputList.h>
 
@@ -216,8 +219,12 @@
 #include <Inventor/errors/SoDebugError.h>
 #endif // COIN_DEBUG
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
 #include "engines/evaluator.h"
 #include "engines/SoSubEngineP.h"
+#include "threads/threadsutilp.h"
 
 /*!
   \var SoMFFloat SoCalculator::a
@@ -320,20 +327,392 @@
   (SoMFVec3f) Output value with result from the calculations.
 */
 
+// *************************************************************************
+
+// The expressions are compiled into a flat program working on
+// "slots", where each slot holds one float for each of up to
+// SOCALCULATOR_BLOCKSIZE field indices. Vectors take three slots. The
+// program is run once for each block of field indices, so every
+// instruction is a tight loop over the block which the compiler can
+// vectorize.
+
+#define SOCALCULATOR_BLOCKSIZE 64
+
+namespace {
+
+// the named registers come first among the slots
+enum {
+  SLOT_IN_FLT = 0,      // a-h
+  SLOT_IN_VEC = 8,      // A-H
+  SLOT_TMP_FLT = 32,    // ta-th
+  SLOT_TMP_VEC = 40,    // tA-tH
+  SLOT_OUT_FLT = 64,    // oa-od
+  SLOT_OUT_VEC = 68,    // oA-oD
+  SLOT_NUMNAMED = 80
+};
+
+enum socalculator_op {
+  OP_CONST, OP_MOV, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_FMOD, OP_NEG,
+  OP_AND, OP_OR, OP_NOT, OP_TEST, OP_SELECT,
+  OP_EQ, OP_NEQ, OP_LT, OP_GT, OP_LEQ, OP_GEQ,
+  OP_COS, OP_SIN, OP_TAN, OP_ACOS, OP_ASIN, OP_ATAN, OP_ATAN2,
+  OP_COSH, OP_SINH, OP_TANH, OP_SQRT, OP_EXP, OP_LOG, OP_LOG10,
+  OP_CEIL, OP_FLOOR, OP_FABS, OP_RAND, OP_POW,
+  OP_LENGTH, // sqrt() without the check for negative values
+  OP_NORMDIV // a / b, or 0 if b isn't positive
+};
+
+struct socalculator_instr {
+  int op;
+  int dst, a, b, c;
+  float value;
+};
+
+inline float
+socalculator_clamp(const float val, const float minval, const float maxval)
+{
+  if (val <= minval) return minval;
+  else if (val >= maxval) return maxval;
+  return val;
+}
+
+// Compiles the parse trees. The results of each operation are
+// computed just like so_eval_evaluate() does, but conditional
+// expressions evaluate both branches and select between them.
+class socalculator_compiler {
+public:
+  socalculator_compiler(SbList<socalculator_instr> & prog)
+    : program(prog), numslots(SLOT_NUMNAMED), carried(FALSE)
+  {
+    for (int i = 0; i < 32; i++) this->tmpwritten[i] = FALSE;
+    for (int i = 0; i < 16; i++) this->inused[i] = 0;
+    for (int i = 0; i < 8; i++) this->outused[i] = 0;
+  }
+
+  void compile(const so_eval_node * node);
+
+  SbList<socalculator_instr> & program;
+  int numslots;
+  // set if a temporary register is read before it is set, so its
+  // value is carried over from the previous field index
+  SbBool carried;
+  char inused[16]; // a-h and A-H
+  char outused[8]; // oa-od and oA-oD
+
+private:
+  static SbBool isVector(const so_eval_node * node);
+  int findRegister(const so_eval_node * node, const SbBool write);
+  int expression(const so_eval_node * node);
+  int emit(const int op, const int a = -1, const int b = -1, const int c = -1,
+           const float value = 0.0f);
+  void emitMove(const int dst, const int src);
+
+  SbBool tmpwritten[32];
+};
+
+SbBool
+socalculator_compiler::isVector(const so_eval_node * node)
+{
+  switch (node->id) {
+  case ID_ADD_VEC:
+  case ID_SUB_VEC:
+  case ID_NEG_VEC:
+  case ID_CROSS:
+  case ID_NORMALIZE:
+  case ID_VEC3F:
+  case ID_VEC_REG:
+  case ID_VEC_COND:
+  case ID_MUL_VEC_FLT:
+  case ID_DIV_VEC_FLT:
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+int
+socalculator_compiler::emit(const int op, const int a, const int b, const int c,
+                            const float value)
+{
+  socalculator_instr instr;
+  instr.op = op;
+  instr.dst = this->numslots++;
+  instr.a = a;
+  instr.b = b;
+  instr.c = c;
+  instr.value = value;
+  this->program.append(instr);
+  return instr.dst;
+}
+
+void
+socalculator_compiler::emitMove(const int dst, const int src)
+{
+  socalculator_instr instr;
+  instr.op = OP_MOV;
+  instr.dst = dst;
+  instr.a = src;
+  instr.b = instr.c = -1;
+  instr.value = 0.0f;
+  this->program.append(instr);
+}
+
+// Returns the slot of a register node, or of the vector component
+// for ID_VEC_REG_COMP nodes.
+int
+socalculator_compiler::findRegister(const so_eval_node * node, const SbBool write)
+{
+  const char * name = node->regname;
+  const char prefix = (name[0] == 't' || name[0] == 'o') ? name[0] : 0;
+  const char reg = prefix ? name[1] : name[0];
+  const SbBool vec = (reg >= 'A') && (reg <= 'H');
+  const int idx = vec ? (reg - 'A') : (reg - 'a');
+
+  int slot, num = 1;
+  if (prefix == 't') slot = vec ? SLOT_TMP_VEC + idx * 3 : SLOT_TMP_FLT + idx;
+  else if (prefix == 'o') slot = vec ? SLOT_OUT_VEC + idx * 3 : SLOT_OUT_FLT + idx;
+  else slot = vec ? SLOT_IN_VEC + idx * 3 : SLOT_IN_FLT + idx;
+  if (vec) {
+    if (node->id == ID_VEC_REG_COMP) {
+      slot += SbClamp(node->regidx, 0, 2);
+    }
+    else num = 3;
+  }
+
+  if (prefix == 't') {
+    for (int i = 0; i < num; i++) {
+      if (write) this->tmpwritten[slot + i - SLOT_TMP_FLT] = TRUE;
+      else if (!this->tmpwritten[slot + i - SLOT_TMP_FLT]) this->carried = TRUE;
+    }
+  }
+  else if (prefix == 'o') {
+    if (write) this->outused[vec ? 4 + idx : idx] = 1;
+  }
+  else {
+    this->inused[vec ? 8 + idx : idx] = 1;
+  }
+  return slot;
+}
+
+// Returns the first slot of the result.
+int
+socalculator_compiler::expression(const so_eval_node * node)
+{
+  int p1 = -1, p2 = -1, p3 = -1;
+  if (node->child1) p1 = this->expression(node->child1);
+  if (node->child2) p2 = this->expression(node->child2);
+  if (node->child3) p3 = this->expression(node->child3);
+
+  int r, i;
+  switch (node->id) {
+  case ID_ADD: return this->emit(OP_ADD, p1, p2);
+  case ID_SUB: return this->emit(OP_SUB, p1, p2);
+  case ID_MUL: return this->emit(OP_MUL, p1, p2);
+  case ID_DIV: return this->emit(OP_DIV, p1, p2);
+  case ID_FMOD: return this->emit(OP_FMOD, p1, p2);
+  case ID_NEG: return this->emit(OP_NEG, p1);
+  case ID_AND: return this->emit(OP_AND, p1, p2);
+  case ID_OR: return this->emit(OP_OR, p1, p2);
+  case ID_NOT: return this->emit(OP_NOT, p1);
+  // vectors are compared by their first component, like in
+  // so_eval_evaluate()
+  case ID_EQ: return this->emit(OP_EQ, p1, p2);
+  case ID_NEQ: return this->emit(OP_NEQ, p1, p2);
+  case ID_LT: return this->emit(OP_LT, p1, p2);
+  case ID_GT: return this->emit(OP_GT, p1, p2);
+  case ID_LEQ: return this->emit(OP_LEQ, p1, p2);
+  case ID_GEQ: return this->emit(OP_GEQ, p1, p2);
+  case ID_COS: return this->emit(OP_COS, p1);
+  case ID_SIN: return this->emit(OP_SIN, p1);
+  case ID_TAN: return this->emit(OP_TAN, p1);
+  case ID_ACOS: return this->emit(OP_ACOS, p1);
+  case ID_ASIN: return this->emit(OP_ASIN, p1);
+  case ID_ATAN: return this->emit(OP_ATAN, p1);
+  case ID_ATAN2: return this->emit(OP_ATAN2, p1, p2);
+  case ID_COSH: return this->emit(OP_COSH, p1);
+  case ID_SINH: return this->emit(OP_SINH, p1);
+  case ID_TANH: return this->emit(OP_TANH, p1);
+  case ID_SQRT: return this->emit(OP_SQRT, p1);
+  case ID_EXP: return this->emit(OP_EXP, p1);
+  case ID_LOG: return this->emit(OP_LOG, p1);
+  case ID_LOG10: return this->emit(OP_LOG10, p1);
+  case ID_CEIL: return this->emit(OP_CEIL, p1);
+  case ID_FLOOR: return this->emit(OP_FLOOR, p1);
+  case ID_FABS: return this->emit(OP_FABS, p1);
+  case ID_RAND: return this->emit(OP_RAND, p1);
+  case ID_POW: return this->emit(OP_POW, p1, p2);
+  case ID_TEST_FLT: return this->emit(OP_TEST, p1);
+  case ID_TEST_VEC:
+    r = this->emit(OP_OR, this->emit(OP_TEST, p1), this->emit(OP_TEST, p1 + 1));
+    return this->emit(OP_OR, r, this->emit(OP_TEST, p1 + 2));
+  case ID_VALUE: return this->emit(OP_CONST, -1, -1, -1, node->value);
+  case ID_FLT_REG:
+  case ID_VEC_REG:
+  case ID_VEC_REG_COMP:
+    return this->findRegister(node, FALSE);
+  case ID_FLT_COND: return this->emit(OP_SELECT, p1, p2, p3);
+  case ID_DOT:
+  case ID_LEN:
+    if (node->id == ID_LEN) p2 = p1;
+    r = this->emit(OP_ADD, this->emit(OP_MUL, p1, p2),
+                   this->emit(OP_MUL, p1 + 1, p2 + 1));
+    r = this->emit(OP_ADD, r, this->emit(OP_MUL, p1 + 2, p2 + 2));
+    return (node->id == ID_LEN) ? this->emit(OP_LENGTH, r) : r;
+  default:
+    break;
+  }
+
+  // vector results, one instruction per component in three
+  // consecutive slots
+  int length = -1;
+  if (node->id == ID_NORMALIZE) {
+    r = this->emit(OP_ADD, this->emit(OP_MUL, p1, p1),
+                   this->emit(OP_MUL, p1 + 1, p1 + 1));
+    r = this->emit(OP_ADD, r, this->emit(OP_MUL, p1 + 2, p1 + 2));
+    length = this->emit(OP_LENGTH, r);
+  }
+  else if (node->id == ID_CROSS) {
+    const int m[6] = {
+      this->emit(OP_MUL, p1 + 1, p2 + 2), this->emit(OP_MUL, p1 + 2, p2 + 1),
+      this->emit(OP_MUL, p1 + 2, p2), this->emit(OP_MUL, p1, p2 + 2),
+      this->emit(OP_MUL, p1, p2 + 1), this->emit(OP_MUL, p1 + 1, p2)
+    };
+    r = this->emit(OP_SUB, m[0], m[1]);
+    (void) this->emit(OP_SUB, m[2], m[3]);
+    (void) this->emit(OP_SUB, m[4], m[5]);
+    return r;
+  }
+
+  r = this->numslots;
+  for (i = 0; i < 3; i++) {
+    switch (node->id) {
+    case ID_ADD_VEC: (void) this->emit(OP_ADD, p1 + i, p2 + i); break;
+    case ID_SUB_VEC: (void) this->emit(OP_SUB, p1 + i, p2 + i); break;
+    case ID_NEG_VEC: (void) this->emit(OP_NEG, p1 + i); break;
+    case ID_MUL_VEC_FLT: (void) this->emit(OP_MUL, p1 + i, p2); break;
+    case ID_DIV_VEC_FLT: (void) this->emit(OP_DIV, p1 + i, p2); break;
+    case ID_NORMALIZE: (void) this->emit(OP_NORMDIV, p1 + i, length); break;
+    case ID_VEC_COND: (void) this->emit(OP_SELECT, p1, p2 + i, p3 + i); break;
+    case ID_VEC3F: (void) this->emit(OP_MOV, i == 0 ? p1 : (i == 1 ? p2 : p3)); break;
+    default:
+      assert(0 && "unknown node id");
+      break;
+    }
+  }
+  return r;
+}
+
+void
+socalculator_compiler::compile(const so_eval_node * node)
+{
+  if (node == NULL) return;
+
+  if (node->id == ID_SEPARATOR) {
+    this->compile(node->child1);
+    this->compile(node->child2);
+  }
+  else {
+    assert(node->id == ID_ASSIGN_FLT || node->id == ID_ASSIGN_VEC);
+    const int src = this->expression(node->child2);
+    const int dst = this->findRegister(node->child1, TRUE);
+    const int num = isVector(node->child1) ? 3 : 1;
+    for (int i = 0; i < num; i++) this->emitMove(dst + i, src + i);
+  }
+}
+
+// Runs the program on the first n entries of each slot. The math
+// functions are called in double precision, like evaluator.c does, so
+// the results are the same as with the tree walking evaluator.
+void
+socalculator_run(const socalculator_instr * program, const int numinstr,
+                 float * slots, const int n)
+{
+#define SLOT(_idx_) (slots + (_idx_) * SOCALCULATOR_BLOCKSIZE)
+#define LANES(_expr_) for (k = 0; k < n; k++) { d[k] = _expr_; } break
+  int k;
+  for (int i = 0; i < numinstr; i++) {
+    const socalculator_instr & instr = program[i];
+    float * d = SLOT(instr.dst);
+    const float * a = (instr.a >= 0) ? SLOT(instr.a) : NULL;
+    const float * b = (instr.b >= 0) ? SLOT(instr.b) : NULL;
+    const float * c = (instr.c >= 0) ? SLOT(instr.c) : NULL;
+    switch (instr.op) {
+    case OP_CONST: LANES(instr.value);
+    case OP_MOV: LANES(a[k]);
+    case OP_ADD: LANES(a[k] + b[k]);
+    case OP_SUB: LANES(a[k] - b[k]);
+    case OP_MUL: LANES(a[k] * b[k]);
+    case OP_DIV: LANES(b[k] == 0.0f ? a[k] / FLT_EPSILON : a[k] / b[k]);
+    case OP_FMOD: LANES(b[k] != 0.0f ? float(fmod(a[k], b[k])) : 0.0f);
+    case OP_NEG: LANES(-a[k]);
+    case OP_AND: LANES((a[k] != 0.0f && b[k] != 0.0f) ? 1.0f : 0.0f);
+    case OP_OR: LANES((a[k] != 0.0f || b[k] != 0.0f) ? 1.0f : 0.0f);
+    case OP_NOT: LANES(a[k] == 0.0f ? 1.0f : 0.0f);
+    case OP_TEST: LANES(a[k] != 0.0f ? 1.0f : 0.0f);
+    case OP_SELECT: LANES(a[k] != 0.0f ? b[k] : c[k]);
+    case OP_EQ: LANES(a[k] == b[k] ? 1.0f : 0.0f);
+    case OP_NEQ: LANES(a[k] != b[k] ? 1.0f : 0.0f);
+    case OP_LT: LANES(a[k] < b[k] ? 1.0f : 0.0f);
+    case OP_GT: LANES(a[k] > b[k] ? 1.0f : 0.0f);
+    case OP_LEQ: LANES(a[k] <= b[k] ? 1.0f : 0.0f);
+    case OP_GEQ: LANES(a[k] >= b[k] ? 1.0f : 0.0f);
+    case OP_COS: LANES(float(cos(double(a[k]))));
+    case OP_SIN: LANES(float(sin(double(a[k]))));
+    case OP_TAN: LANES(float(tan(double(a[k]))));
+    case OP_ACOS: LANES(float(acos(double(socalculator_clamp(a[k], -1.0f, 1.0f)))));
+    case OP_ASIN: LANES(float(asin(double(socalculator_clamp(a[k], -1.0f, 1.0f)))));
+    case OP_ATAN: LANES(float(atan(double(a[k]))));
+    case OP_ATAN2:
+      LANES(b[k] == 0.0f ? float(a[k] >= 0.0f ? M_PI * 0.5 : - M_PI * 0.5) :
+            float(atan2(double(a[k]), double(b[k]))));
+    case OP_COSH: LANES(float(cosh(double(a[k]))));
+    case OP_SINH: LANES(float(sinh(double(a[k]))));
+    case OP_TANH: LANES(float(tanh(double(a[k]))));
+    case OP_SQRT: LANES(a[k] > 0.0f ? float(sqrt(double(a[k]))) : 0.0f);
+    case OP_EXP: LANES(float(exp(double(a[k]))));
+    case OP_LOG: LANES(a[k] <= 0.0f ? -128.0f : float(log(double(a[k]))));
+    case OP_LOG10: LANES(a[k] <= 0.0f ? -38.0f : float(log10(double(a[k]))));
+    case OP_CEIL: LANES(float(ceil(a[k])));
+    case OP_FLOOR: LANES(float(floor(a[k])));
+    case OP_FABS: LANES(float(fabs(a[k])));
+    case OP_RAND: LANES(float(rand()) / float(RAND_MAX) * a[k]);
+    case OP_POW:
+      LANES(a[k] == 0.0f ? 0.0f :
+            (a[k] > 0.0f ? float(pow(double(a[k]), double(b[k]))) :
+             float(pow(double(a[k]), floor(b[k] + 0.5)))));
+    case OP_LENGTH: LANES(float(sqrt(double(a[k]))));
+    case OP_NORMDIV: LANES(b[k] > 0.0f ? a[k] / b[k] : 0.0f);
+    default:
+      assert(0 && "unknown op");
+      break;
+    }
+  }
+#undef LANES
+#undef SLOT
+}
+
+} // namespace
+
+// *************************************************************************
+
 class SoCalculatorP {
 public:
+  SoCalculatorP(void) : slots(NULL), compiled(FALSE) { }
+  ~SoCalculatorP() { delete[] slots; }
+
+  // the temporary registers keep their values between evaluations
   float ta_th[8];
   SbVec3f tA_tH[8];
 
-  float a_h[8];
-  SbVec3f A_H[8];
-  float oa_od[4];
-  SbVec3f oA_oD[4];
-  SbList <struct so_eval_node*> evaluatorList;
+  SbList<socalculator_instr> program;
+  float * slots;
+  SbBool compiled;
+  SbBool carried;
+  char inused[16]; // a-h and A-H
+  char outused[8]; // oa-od and oA-oD
 };
 
 #define PRIVATE(thisp) (thisp->pimpl)
-#define THISP(POINTER) static_cast<SoCalculator *>(POINTER)
 
 SO_ENGINE_SOURCE(SoCalculator);
 
@@ -386,9 +765,6 @@ SoCalculator::SoCalculator(void)
 */
 SoCalculator::~SoCalculator(void)
 {
-  for (int i = 0; i < PRIVATE(this)->evaluatorList.getLength(); i++) {
-    so_eval_delete(PRIVATE(this)->evaluatorList[i]);
-  }
   delete PRIVATE(this);
 }
 
@@ -401,202 +777,154 @@ SoCalculator::initClass(void)
   SO_ENGINE_INTERNAL_INIT_CLASS(SoCalculator);
 }
 
+// Parses and compiles the expressions.
+void
+SoCalculator::compile(void)
+{
+  SoCalculatorP * p = PRIVATE(this);
+  p->program.truncate(0);
+  socalculator_compiler compiler(p->program);
+
+  // the parser isn't reentrant, and engines may be evaluated on
+  // several threads by SoEngine::evaluateDirtyEngines()
+  CC_SYNC_BEGIN(so_eval_parse);
+  for (int i = 0; i < this->expression.getNum(); i++) {
+    const SbString & s = this->expression[i];
+    if (s.getLength() == 0) continue;
+    so_eval_node * node = so_eval_parse(s.getString());
+#if COIN_DEBUG
+    if (so_eval_error()) {
+      SoDebugError::postWarning("SoCalculator::evaluateExpression",
+                                "%s", so_eval_error());
+    }
+#endif // COIN_DEBUG
+    compiler.compile(node);
+    so_eval_delete(node);
+  }
+  CC_SYNC_END(so_eval_parse);
+
+  delete[] p->slots;
+  p->slots = new float[compiler.numslots * SOCALCULATOR_BLOCKSIZE];
+  p->carried = compiler.carried;
+  for (int i = 0; i < 16; i++) p->inused[i] = compiler.inused[i];
+  for (int i = 0; i < 8; i++) p->outused[i] = compiler.outused[i];
+  p->compiled = TRUE;
+}
+
 // Documented in superclass.
 void
 SoCalculator::evaluate(void)
 {
-  int i, j;
+  int i, j, k;
 
   if (this->expression.getNum() == 0 ||
       this->expression[0].getLength() == 0) return;
 
-  if (PRIVATE(this)->evaluatorList.getLength() == 0) {
-    for (i = 0; i < this->expression.getNum(); i++) {
-      const SbString &s = this->expression[i];
-      if (s.getLength()) {
-        PRIVATE(this)->evaluatorList.append(so_eval_parse(s.getString()));
-#if COIN_DEBUG
-        if (so_eval_error()) {
-          SoDebugError::postWarning("SoCalculator::evaluateExpression",
-                                    "%s", so_eval_error());
-        }
-#endif // COIN_DEBUG
-      }
-      else PRIVATE(this)->evaluatorList.append(NULL);
-    }
-  }
+  SoCalculatorP * p = PRIVATE(this);
+  if (!p->compiled) this->compile();
 
+  SoMFFloat * fltin[8] = { &this->a, &this->b, &this->c, &this->d,
+                           &this->e, &this->f, &this->g, &this->h };
+  SoMFVec3f * vecin[8] = { &this->A, &this->B, &this->C, &this->D,
+                           &this->E, &this->F, &this->G, &this->H };
 
-  // find all fields used in all expressions
+  // find max number of values in used input fields
   int maxnum = 0;
-  char inused[16]; /* a-h and A-H */
-  char outused[8]; /* a-d and A-D */
-  for (i = 0; i < 16; i++) inused[i] = 0;
-  for (i = 0; i < 8; i++) outused[i] = 0;
+  for (i = 0; i < 8; i++) {
+    if (p->inused[i]) maxnum = SbMax(maxnum, fltin[i]->getNum());
+    if (p->inused[i + 8]) maxnum = SbMax(maxnum, vecin[i]->getNum());
+  }
+  if (maxnum == 0) maxnum = 1; // in case only temporary registers were used
 
-  for (i = 0; i < PRIVATE(this)->evaluatorList.getLength(); i++) {
-    this->findUsed(PRIVATE(this)->evaluatorList[i], inused, outused);
+  float * fltout[4];
+  SbVec3f * vecout[4];
+  for (i = 0; i < 4; i++) {
+    fltout[i] = p->outused[i] ? new float[maxnum] : NULL;
+    vecout[i] = p->outused[i + 4] ? new SbVec3f[maxnum] : NULL;
   }
 
-  // find max number of values in used input fields
-  char fieldname[2];
-  fieldname[1] = 0;
-  for (i = 0; i < 16; i++) {
-    if (inused[i]) {
-      if (i < 8) {
-        fieldname[0] = 'a' + i;
+  // A temporary register which is read before it is set gets its
+  // value from the previous field index, so the field indices must
+  // then be evaluated one at a time.
+  const int blocksize = p->carried ? 1 : SOCALCULATOR_BLOCKSIZE;
+  const int numinstr = p->program.getLength();
+  float * slots = p->slots;
+#define SLOT(_idx_) (slots + (_idx_) * SOCALCULATOR_BLOCKSIZE)
+
+  for (int start = 0; start < maxnum; start += blocksize) {
+    const int n = SbMin(blocksize, maxnum - start);
+
+    // copy values from fields to the input registers, using the last
+    // value when the index is out of bounds for a field
+    for (i = 0; i < 8; i++) {
+      if (p->inused[i]) {
+        const int num = fltin[i]->getNum();
+        const float * values = fltin[i]->getValues(0);
+        float * s = SLOT(SLOT_IN_FLT + i);
+        for (k = 0; k < n; k++) {
+          s[k] = num ? values[SbMin(start + k, num - 1)] : 0.0f;
+        }
       }
-      else {
-        fieldname[0] = 'A' + (i-8);
+      if (p->inused[i + 8]) {
+        const int num = vecin[i]->getNum();
+        const SbVec3f * values = vecin[i]->getValues(0);
+        for (j = 0; j < 3; j++) {
+          float * s = SLOT(SLOT_IN_VEC + i * 3 + j);
+          for (k = 0; k < n; k++) {
+            s[k] = num ? values[SbMin(start + k, num - 1)][j] : 0.0f;
+          }
+        }
       }
-      SoMField * field = coin_assert_cast<SoMField*>(this->getField(fieldname));
-      maxnum = SbMax(maxnum, field->getNum());
     }
-  }
-  if (maxnum == 0) maxnum = 1; // in case only temporary registers were used
-
-  if (outused[0]) { SO_ENGINE_OUTPUT(oa, SoMFFloat, setNum(maxnum)); }
-  if (outused[1]) { SO_ENGINE_OUTPUT(ob, SoMFFloat, setNum(maxnum)); }
-  if (outused[2]) { SO_ENGINE_OUTPUT(oc, SoMFFloat, setNum(maxnum)); }
-  if (outused[3]) { SO_ENGINE_OUTPUT(od, SoMFFloat, setNum(maxnum)); }
-
-  if (outused[4]) { SO_ENGINE_OUTPUT(oA, SoMFVec3f, setNum(maxnum)); }
-  if (outused[5]) { SO_ENGINE_OUTPUT(oB, SoMFVec3f, setNum(maxnum)); }
-  if (outused[6]) { SO_ENGINE_OUTPUT(oC, SoMFVec3f, setNum(maxnum)); }
-  if (outused[7]) { SO_ENGINE_OUTPUT(oD, SoMFVec3f, setNum(maxnum)); }
-
-  // loop through all fieldindices and evaluate
-  for (i = 0; i < maxnum; i++) {
-    // just initialize output registers to default values
-    // (in case an expression reads from an output before setting its value)
-    PRIVATE(this)->oA_oD[0] = SbVec3f(0.0f, 0.0f, 0.0f);
-    PRIVATE(this)->oA_oD[1] = SbVec3f(0.0f, 0.0f, 0.0f);
-    PRIVATE(this)->oA_oD[2] = SbVec3f(0.0f, 0.0f, 0.0f);
-    PRIVATE(this)->oA_oD[3] = SbVec3f(0.0f, 0.0f, 0.0f);
-    PRIVATE(this)->oa_od[0] = 0.0f;
-    PRIVATE(this)->oa_od[1] = 0.0f;
-    PRIVATE(this)->oa_od[2] = 0.0f;
-    PRIVATE(this)->oa_od[3] = 0.0f;
-
-    // evaluate all expressions for this fieldidx
-    for (j = 0; j < PRIVATE(this)->evaluatorList.getLength(); j++) {
-      if (PRIVATE(this)->evaluatorList[j]) {
-        this->evaluateExpression(PRIVATE(this)->evaluatorList[j], i);
+    // the output registers start out as zero for each field index (in
+    // case an expression reads from an output before setting its value)
+    for (i = SLOT_OUT_FLT; i < SLOT_NUMNAMED; i++) {
+      float * s = SLOT(i);
+      for (k = 0; k < n; k++) s[k] = 0.0f;
+    }
+    for (i = 0; i < 8; i++) {
+      float * s = SLOT(SLOT_TMP_FLT + i);
+      for (k = 0; k < n; k++) s[k] = p->ta_th[i];
+      for (j = 0; j < 3; j++) {
+        s = SLOT(SLOT_TMP_VEC + i * 3 + j);
+        for (k = 0; k < n; k++) s[k] = p->tA_tH[i][j];
       }
     }
-  }
-}
-
-// "extern C" wrapper and C-function typedefs are needed with the
-// OSF1/cxx compiler (probably a bug in the compiler, but it doesn't
-// seem to hurt to do this anyway).
-extern "C" {
-  typedef void(*C_func_read)(const char *, float *, void *);
-  typedef void(*C_func_write)(const char *, float *, int, void *);
-}
-
-// evaluates a single expression from/into fieldidx
-void
-SoCalculator::evaluateExpression(struct so_eval_node *node, const int fieldidx)
-{
-  int i;
-
-  char fieldname[2];
-  fieldname[1] = 0;
-  char inused[16]; /* a-h and A-H */
-  char outused[8]; /* oa-od and oA-oD */
-
-  so_eval_cbdata cbdata;
-  cbdata.readfieldcb = reinterpret_cast<C_func_read>(SoCalculator::readfieldcb);
-  cbdata.writefieldcb = reinterpret_cast<C_func_write>(SoCalculator::writefieldcb);
-  cbdata.userdata = this;
-
-  for (i = 0; i < 16; i++) inused[i] = 0;
-  for (i = 0; i < 8; i++) outused[i] = 0;
 
-  this->findUsed(node, inused, outused);
+    socalculator_run(p->program.getArrayPtr(), numinstr, slots, n);
 
-  // copy values from fields to temporary "registers" while evaluating
-  for (i = 0; i < 8; i++) {
-    if (inused[i]) {
-      fieldname[0] = 'a' + i;
-      SoMFFloat * field = coin_assert_cast<SoMFFloat *>(this->getField(fieldname));
-      int num = field->getNum();
-      if (num) PRIVATE(this)->a_h[i] = field->getValues(0)[SbMin(fieldidx, num-1)];
-      else PRIVATE(this)->a_h[i] = 0.0f;
+    for (i = 0; i < 8; i++) {
+      p->ta_th[i] = SLOT(SLOT_TMP_FLT + i)[n - 1];
+      for (j = 0; j < 3; j++) p->tA_tH[i][j] = SLOT(SLOT_TMP_VEC + i * 3 + j)[n - 1];
     }
-  }
-  for (i = 0; i < 8; i++) {
-    if (inused[i+8]) {
-      fieldname[0] = 'A' + i;
-      SoMFVec3f * field = coin_assert_cast<SoMFVec3f *>(this->getField(fieldname));
-      int num = field->getNum();
-      if (num) PRIVATE(this)->A_H[i] = field->getValues(0)[SbMin(fieldidx, num-1)];
-      else PRIVATE(this)->A_H[i] = SbVec3f(0.0f, 0.0f, 0.0f);
-    }
-  }
-  so_eval_evaluate(node, &cbdata);
-
-  // copy the output values from "registers" to engine output
-  if (outused[0]) { SO_ENGINE_OUTPUT(oa, SoMFFloat, set1Value(fieldidx, PRIVATE(this)->oa_od[0])); }
-  if (outused[1]) { SO_ENGINE_OUTPUT(ob, SoMFFloat, set1Value(fieldidx, PRIVATE(this)->oa_od[1])); }
-  if (outused[2]) { SO_ENGINE_OUTPUT(oc, SoMFFloat, set1Value(fieldidx, PRIVATE(this)->oa_od[2])); }
-  if (outused[3]) { SO_ENGINE_OUTPUT(od, SoMFFloat, set1Value(fieldidx, PRIVATE(this)->oa_od[3])); }
-
-  if (outused[4]) { SO_ENGINE_OUTPUT(oA, SoMFVec3f, set1Value(fieldidx, PRIVATE(this)->oA_oD[0])); }
-  if (outused[5]) { SO_ENGINE_OUTPUT(oB, SoMFVec3f, set1Value(fieldidx, PRIVATE(this)->oA_oD[1])); }
-  if (outused[6]) { SO_ENGINE_OUTPUT(oC, SoMFVec3f, set1Value(fieldidx, PRIVATE(this)->oA_oD[2])); }
-  if (outused[7]) { SO_ENGINE_OUTPUT(oD, SoMFVec3f, set1Value(fieldidx, PRIVATE(this)->oA_oD[3])); }
-}
-
-
-
-//
-// find all input and output fields that are used in the expression(s)
-// inused 0-7   => a-h
-// inused 8-15  => A-H
-// outused 0-3  => oa-od
-// outused 4-7  => oA-oD
-//
-// inused and outused must be cleared before calling this method
-//
-// FIXME: this becomes a bottleneck if there are many SoCalculator
-// engines in the scene graph which are updated all the time. See the
-// SoGuiExamples/coin-competitions/SIM-20010914/kaos.cpp.in for some
-// great test-code to use while profiling.  Could be solved by caching
-// the set of expressions found.  20010917 mortene.
-void
-SoCalculator::findUsed(struct so_eval_node *node, char *inused, char *outused)
-{
-  if (node == NULL) return;
-
-  if (node->id == ID_ASSIGN_FLT || node->id == ID_ASSIGN_VEC) {
-    this->findUsed(node->child2, inused, outused); // traverse rhs
-    // inspect lhs
-    node = node->child1;
-    if (node->regname[0] == 'o') { // only consider engine outputs
-      if ((node->regname[1] >= 'A') && (node->regname[1] <= 'D')) {
-        outused[node->regname[1]-'A'+4] = 1;
+    for (i = 0; i < 4; i++) {
+      if (fltout[i]) {
+        const float * s = SLOT(SLOT_OUT_FLT + i);
+        for (k = 0; k < n; k++) fltout[i][start + k] = s[k];
       }
-      else {
-        assert((node->regname[1] >= 'a') && (node->regname[1] <= 'd'));
-        outused[node->regname[1]-'a'] = 1;
+      if (vecout[i]) {
+        for (j = 0; j < 3; j++) {
+          const float * s = SLOT(SLOT_OUT_VEC + i * 3 + j);
+          for (k = 0; k < n; k++) vecout[i][start + k][j] = s[k];
+        }
       }
     }
   }
-  else {
-    if (node->child1) this->findUsed(node->child1, inused, outused);
-    if (node->child2) this->findUsed(node->child2, inused, outused);
-    if (node->child3) this->findUsed(node->child3, inused, outused);
-  }
-  if (node->id == ID_FLT_REG) {
-    if ((node->regname[0] >= 'a') && (node->regname[0] <= 'h')) {
-      inused[node->regname[0]-'a'] = 1;
+#undef SLOT
+
+  // copy the results to the engine outputs
+  SoEngineOutput * fltoutputs[4] = { &this->oa, &this->ob, &this->oc, &this->od };
+  SoEngineOutput * vecoutputs[4] = { &this->oA, &this->oB, &this->oC, &this->oD };
+  for (i = 0; i < 4; i++) {
+    if (fltout[i]) {
+      SO_ENGINE_OUTPUT((*fltoutputs[i]), SoMFFloat, setNum(maxnum));
+      SO_ENGINE_OUTPUT((*fltoutputs[i]), SoMFFloat, setValues(0, maxnum, fltout[i]));
+      delete[] fltout[i];
     }
-  }
-  else if (node->id == ID_VEC_REG || node->id == ID_VEC_REG_COMP) {
-    if ((node->regname[0] >= 'A') && (node->regname[0] <= 'H')) {
-      inused[node->regname[0]-'A'+8] = 1;
+    if (vecout[i]) {
+      SO_ENGINE_OUTPUT((*vecoutputs[i]), SoMFVec3f, setNum(maxnum));
+      SO_ENGINE_OUTPUT((*vecoutputs[i]), SoMFVec3f, setValues(0, maxnum, vecout[i]));
+      delete[] vecout[i];
     }
   }
 }
@@ -605,111 +933,75 @@ SoCalculator::findUsed(struct so_eval_node *node, char *inused, char *outused)
 void
 SoCalculator::inputChanged(SoField *which)
 {
-  // if expression changes we have to rebuild the eval tree structure
+  // if expression changes we have to compile the expressions again
   if (which == &this->expression) {
-    for (int i = 0; i < PRIVATE(this)->evaluatorList.getLength(); i++) {
-      so_eval_delete(PRIVATE(this)->evaluatorList[i]);
-    }
-    PRIVATE(this)->evaluatorList.truncate(0);
+    PRIVATE(this)->compiled = FALSE;
   }
 }
 
-// callback from evaluator. Reads values from temporary registers
-void
-SoCalculator::readfieldcb(const char *fieldname, float *data, void *userdata)
-{
-  SoCalculator * thisp = THISP(userdata);
-  if (fieldname[0] == 'o') {
-    //
-    // FIXME: I'm not quite sure if it should be legal to read from an
-    // output field. Investigate. pederb, 20000307
-    //
-
-    // this will work if output was set in an earlier expression
-    if ((fieldname[1] >= 'A') && (fieldname[1] <= 'D')) {
-      int idx = fieldname[1] - 'A';
-      data[0] = PRIVATE(thisp)->oA_oD[idx][0];
-      data[1] = PRIVATE(thisp)->oA_oD[idx][1];
-      data[2] = PRIVATE(thisp)->oA_oD[idx][2];
-    }
-    else {
-      assert((fieldname[1] >= 'a') && (fieldname[1] <= 'd'));
-      int idx = fieldname[1] - 'a';
-      data[0] = PRIVATE(thisp)->oa_od[idx];
-    }
-  }
-  else if (fieldname[0] == 't') {
-    if ((fieldname[1] >= 'A') && (fieldname[1] <= 'H')) {
-      int idx = fieldname[1] - 'A';
-      data[0] = PRIVATE(thisp)->tA_tH[idx][0];
-      data[1] = PRIVATE(thisp)->tA_tH[idx][1];
-      data[2] = PRIVATE(thisp)->tA_tH[idx][2];
-    }
-    else {
-      assert((fieldname[1] >= 'a') && (fieldname[1] <= 'h'));
-      int idx = fieldname[1] - 'a';
-      data[0] = PRIVATE(thisp)->ta_th[idx];
-    }
-  }
-  else if ((fieldname[0] >= 'A') && (fieldname[0] <= 'H')) {
-    int idx = fieldname[0] - 'A';
-    data[0] = PRIVATE(thisp)->A_H[idx][0];
-    data[1] = PRIVATE(thisp)->A_H[idx][1];
-    data[2] = PRIVATE(thisp)->A_H[idx][2];
-  }
-  else {
-    assert((fieldname[0] >= 'a') && (fieldname[0] <= 'h'));
-    int idx = fieldname[0] - 'a';
-    data[0] = PRIVATE(thisp)->a_h[idx];
-  }
-}
+#undef PRIVATE
 
-// callback from evaluator. Writes values into temporary registers
-void
-SoCalculator::writefieldcb(const char *fieldname, float *data,
-                           int comp, void *userdata)
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/engines/SoCalculator.h>
+#include <Inventor/fields/SoMFFloat.h>
+#include <Inventor/fields/SoMFVec3f.h>
+
+BOOST_AUTO_TEST_CASE(evaluateBlocks)
 {
-  SoCalculator * thisp = THISP(userdata);
-  if (fieldname[0] == 'o') {
-    if ((fieldname[1] >= 'A') && (fieldname[1] <= 'D')) {
-      int idx = fieldname[1] - 'A';
-      if (comp >= 0) {
-        PRIVATE(thisp)->oA_oD[idx][comp] = data[0];
-      }
-      else {
-        PRIVATE(thisp)->oA_oD[idx][0] = data[0];
-        PRIVATE(thisp)->oA_oD[idx][1] = data[1];
-        PRIVATE(thisp)->oA_oD[idx][2] = data[2];
-      }
-    }
-    else {
-      assert((fieldname[1] >= 'a') && (fieldname[1] <= 'd'));
-      int idx = fieldname[1] - 'a';
-      PRIVATE(thisp)->oa_od[idx] = data[0];
-    }
+  // more values than fit in one block, with inputs of different
+  // lengths, where the last value of the shorter inputs is repeated
+  const int NUM = 150;
+  SoCalculator * calc = new SoCalculator;
+  calc->ref();
+  calc->a.setNum(NUM);
+  for (int i = 0; i < NUM; i++) calc->a.set1Value(i, float(i));
+  const float b[] = { 2.0f, 3.0f };
+  calc->b.setValues(0, 2, b);
+  calc->A.setValue(SbVec3f(1.0f, 2.0f, 3.0f));
+  calc->expression.set1Value(0, "ta = a > 100 ? a * b : -a; oA = A * ta");
+  calc->expression.set1Value(1, "oB = cross(A, vec3f(0, 0, 1)); oB[2] = a; ob = oB[2] + length(oB)");
+
+  SoMFVec3f oA, oB;
+  SoMFFloat ob;
+  oA.connectFrom(&calc->oA);
+  oB.connectFrom(&calc->oB);
+  ob.connectFrom(&calc->ob);
+
+  BOOST_CHECK_EQUAL(oA.getNum(), NUM);
+  BOOST_CHECK_EQUAL(oB.getNum(), NUM);
+  BOOST_CHECK_EQUAL(ob.getNum(), NUM);
+  SbBool correct = TRUE;
+  for (int i = 0; i < NUM; i++) {
+    const float a = float(i);
+    const float ta = (a > 100) ? a * ((i == 0) ? 2.0f : 3.0f) : -a;
+    if (oA[i] != SbVec3f(1.0f, 2.0f, 3.0f) * ta) correct = FALSE;
+    if (oB[i] != SbVec3f(2.0f, -1.0f, a)) correct = FALSE;
+    if (ob[i] != a + SbVec3f(2.0f, -1.0f, a).length()) correct = FALSE;
   }
-  else if (fieldname[0] == 't') {
-    if ((fieldname[1] >= 'A') && (fieldname[1] <= 'H')) {
-      int idx = fieldname[1] - 'A';
-      if (comp >= 0) {
-        PRIVATE(thisp)->tA_tH[idx][comp] = data[0];
-      }
-      else {
-        PRIVATE(thisp)->tA_tH[idx][0] = data[0];
-        PRIVATE(thisp)->tA_tH[idx][1] = data[1];
-        PRIVATE(thisp)->tA_tH[idx][2] = data[2];
-      }
-    }
-    else {
-      assert((fieldname[1] >= 'a') && (fieldname[1] <= 'h'));
-      int idx = fieldname[1] - 'a';
-      PRIVATE(thisp)->ta_th[idx] = data[0];
-    }
-  }
-  else {
-    assert(0 && "should not happen");
+  BOOST_CHECK_MESSAGE(correct, "wrong result from block evaluation");
+
+  // a temporary register which is read before it is written carries
+  // its value from one index to the next, and between evaluations
+  calc->expression.setValue("tb = tb + a; oa = tb");
+  SoMFFloat oa;
+  oa.connectFrom(&calc->oa);
+  float sum = 0.0f;
+  correct = TRUE;
+  for (int i = 0; i < NUM; i++) {
+    sum += float(i);
+    if (oa[i] != sum) correct = FALSE;
   }
+  BOOST_CHECK_MESSAGE(correct, "temporary register not carried between indices");
+  calc->a.setValue(1.0f);
+  BOOST_CHECK_EQUAL(oa.getNum(), 1);
+  BOOST_CHECK_EQUAL(oa[0], sum + 1.0f);
+
+  oA.disconnect();
+  oB.disconnect();
+  ob.disconnect();
+  oa.disconnect();
+  calc->unref();
 }
 
-#undef THISP
-#undef PRIVATE
+#endif // COIN_TEST_SUITE
@@ -60,8 +60,13 @@
 
 #include <Inventor/engines/SoEngine.h>
 
+#include <atomic>
+#include <cstdlib>
+
 #include "SbBasicP.h"
 
+#include <Inventor/C/tidbits.h> // coin_getenv()
+#include <Inventor/C/threads/sched.h>
 #include <Inventor/engines/SoEngines.h>
 #include <Inventor/engines/SoNodeEngine.h>
 #include <Inventor/engines/SoOutputData.h>
@@ -73,6 +78,9 @@
 #include "config.h"
 #endif // HAVE_CONFIG_H
 #include "coindefs.h" // COIN_STUB()
+#include "misc/SbHash.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
 #ifdef COIN_THREADSAFE
 #include "threads/recmutexp.h"
 #endif // COIN_THREADSAFE
@@ -95,6 +103,219 @@ SoType SoEngine::classTypeId STATIC_SOTYPE_INIT;
 
 // *************************************************************************
 
+static int soengine_numthreads = -1;
+
+static int
+soengine_get_numthreads(void)
+{
+  if (soengine_numthreads == -1) {
+    const char * env = coin_getenv("COIN_SOENGINE_THREADS");
+    const int threads = env ? atoi(env) : 0;
+    soengine_numthreads = SbMax(threads, 0);
+  }
+  return soengine_numthreads;
+}
+
+namespace {
+
+// Engines which have become dirty since the last call to
+// SoEngine::evaluateDirtyEngines(). Only kept when threads are used.
+SbList<SoEngine *> * soengine_queue = NULL;
+
+void
+soengine_queue_cleanup(void)
+{
+  delete soengine_queue;
+  soengine_queue = NULL;
+}
+
+inline void
+soengine_lock_queue(void)
+{
+#ifdef COIN_THREADSAFE
+  (void) cc_recmutex_internal_notify_lock();
+#endif // COIN_THREADSAFE
+}
+
+inline void
+soengine_unlock_queue(void)
+{
+#ifdef COIN_THREADSAFE
+  (void) cc_recmutex_internal_notify_unlock();
+#endif // COIN_THREADSAFE
+}
+
+void soengine_find_dependents(SoField * field,
+                              const SbHash<const SoBase *, int> & index,
+                              SbList<int> & dependents,
+                              SbList<SoField *> & visited,
+                              SbBool & fanin);
+
+// Finds the engines in index reading from the outputs of container.
+void
+soengine_find_output_dependents(SoFieldContainer * container,
+                                const SbHash<const SoBase *, int> & index,
+                                SbList<int> & dependents,
+                                SbList<SoField *> & visited,
+                                SbBool & fanin)
+{
+  SoEngineOutputList outputs;
+  if (container->isOfType(SoEngine::getClassTypeId())) {
+    static_cast<SoEngine *>(container)->getOutputs(outputs);
+  }
+  else if (container->isOfType(SoNodeEngine::getClassTypeId())) {
+    static_cast<SoNodeEngine *>(container)->getOutputs(outputs);
+  }
+  for (int i = 0; i < outputs.getLength(); i++) {
+    SoEngineOutput * output = outputs[i];
+    for (int j = 0; j < output->getNumConnections(); j++) {
+      soengine_find_dependents((*output)[j], index, dependents, visited, fanin);
+    }
+  }
+}
+
+// Finds the engines in index which will read the value of field,
+// directly or through field connections and other engines. fanin is
+// set if any of the fields on the way has more than one master.
+void
+soengine_find_dependents(SoField * field,
+                         const SbHash<const SoBase *, int> & index,
+                         SbList<int> & dependents,
+                         SbList<SoField *> & visited,
+                         SbBool & fanin)
+{
+  if (visited.find(field) >= 0) return;
+  visited.append(field);
+
+  if (field->getNumConnections() > 1) fanin = TRUE;
+
+  SoFieldContainer * container = field->getContainer();
+  if (container &&
+      (container->isOfType(SoEngine::getClassTypeId()) ||
+       container->isOfType(SoNodeEngine::getClassTypeId()))) {
+    int idx;
+    if (index.get(container, idx)) {
+      dependents.append(idx);
+      return;
+    }
+    // an engine which isn't scheduled is evaluated when its outputs
+    // are read, so look through it
+    soengine_find_output_dependents(container, index, dependents, visited, fanin);
+  }
+
+  SoFieldList slaves;
+  field->getForwardConnections(slaves);
+  for (int i = 0; i < slaves.getLength(); i++) {
+    soengine_find_dependents(slaves[i], index, dependents, visited, fanin);
+  }
+}
+
+// Writing engine outputs notifies through SoDB::startNotify() and
+// SoDB::endNotify(), which may also process the immediate sensor
+// queue. That is only safe from more than one thread when Coin is
+// built with COIN_THREADSAFE.
+#if defined(HAVE_THREADS) && defined(COIN_THREADSAFE)
+#define SOENGINE_PARALLEL 1
+#else // !(HAVE_THREADS && COIN_THREADSAFE)
+#define SOENGINE_PARALLEL 0
+#endif // !(HAVE_THREADS && COIN_THREADSAFE)
+
+#if SOENGINE_PARALLEL
+
+#define SOENGINE_CHUNKSIZE 16
+
+struct soengine_job {
+  SoEngine * const * engines;
+  int numengines;
+  std::atomic<int> next;
+};
+
+void
+soengine_evaluate_chunks(soengine_job * job)
+{
+  int start;
+  while ((start = job->next.fetch_add(SOENGINE_CHUNKSIZE)) < job->numengines) {
+    const int end = SbMin(start + SOENGINE_CHUNKSIZE, job->numengines);
+    for (int i = start; i < end; i++) job->engines[i]->evaluateWrapper();
+  }
+}
+
+#endif // SOENGINE_PARALLEL
+
+void
+soengine_evaluate_sequential(SoEngine * const * engines, const int numengines)
+{
+#ifdef COIN_THREADSAFE
+  cc_recmutex_internal_field_lock();
+#endif // COIN_THREADSAFE
+  for (int i = 0; i < numengines; i++) engines[i]->evaluateWrapper();
+#ifdef COIN_THREADSAFE
+  cc_recmutex_internal_field_unlock();
+#endif // COIN_THREADSAFE
+}
+
+#if SOENGINE_PARALLEL
+
+cc_sched * soengine_sched = NULL;
+void * soengine_mutex = NULL;
+
+void
+soengine_cleanup(void)
+{
+  if (soengine_sched) {
+    cc_sched_destruct(soengine_sched);
+    soengine_sched = NULL;
+  }
+  CC_MUTEX_DESTRUCT(soengine_mutex);
+}
+
+void
+soengine_evaluate_cb(void * closure)
+{
+  soengine_evaluate_chunks(static_cast<soengine_job *>(closure));
+}
+
+#endif // SOENGINE_PARALLEL
+
+// Evaluates engines which don't depend on each other.
+void
+soengine_evaluate_parallel(SoEngine * const * engines, const int numengines)
+{
+#if SOENGINE_PARALLEL
+  const int numthreads =
+    SbMin(soengine_get_numthreads(), numengines / SOENGINE_CHUNKSIZE);
+  if (numthreads > 0) {
+    soengine_job job;
+    job.engines = engines;
+    job.numengines = numengines;
+    job.next = 0;
+
+    CC_MUTEX_CONSTRUCT(soengine_mutex);
+    CC_MUTEX_LOCK(soengine_mutex);
+    if (soengine_sched == NULL) {
+      soengine_sched = cc_sched_construct(soengine_get_numthreads());
+      coin_atexit((coin_atexit_f *) soengine_cleanup, CC_ATEXIT_NORMAL);
+    }
+    else if (cc_sched_get_num_threads(soengine_sched) < numthreads) {
+      cc_sched_set_num_threads(soengine_sched, numthreads);
+    }
+    for (int i = 0; i < numthreads; i++) {
+      (void) cc_sched_schedule(soengine_sched, soengine_evaluate_cb, &job, 0);
+    }
+    // the calling thread takes its share of the engines too
+    soengine_evaluate_chunks(&job);
+    cc_sched_wait_all(soengine_sched);
+    CC_MUTEX_UNLOCK(soengine_mutex);
+    return;
+  }
+#endif // SOENGINE_PARALLEL
+  soengine_evaluate_sequential(engines, numengines);
+}
+
+} // namespace
+
+// *************************************************************************
+
 /*!
   Default constructor.
 */
@@ -145,6 +366,13 @@ SoEngine::destroy(void)
   cc_recmutex_internal_field_unlock();
 #endif // COIN_THREADSAFE
 
+  if (this->flags & FLAG_ISQUEUED) {
+    soengine_lock_queue();
+    const int idx = soengine_queue->find(this);
+    if (idx >= 0) (*soengine_queue)[idx] = NULL;
+    soengine_unlock_queue();
+  }
+
   // SoBase destroy().
   inherited::destroy();
 
@@ -322,7 +550,7 @@ SoEngine::notify(SoNotList * nl)
   // The notification invocation could stem from a value change in
   // whatever this engine is connected to, so we need to be evaluated
   // on the next attempted read on our output(s).
-  this->flags |= FLAG_ISDIRTY;
+  this->setDirty();
 
   // Call inputChanged() only if we're being notified through one of
   // the engine's fields (lastrec == CONTAINER, set in
@@ -551,4 +779,207 @@ void
 SoEngine::setDirty(void)
 {
   this->flags |= FLAG_ISDIRTY;
+  if (!(this->flags & FLAG_ISQUEUED) && soengine_get_numthreads() > 0) {
+    soengine_lock_queue();
+    if (soengine_queue == NULL) {
+      soengine_queue = new SbList<SoEngine *>;
+      coin_atexit((coin_atexit_f *) soengine_queue_cleanup, CC_ATEXIT_NORMAL);
+    }
+    soengine_queue->append(this);
+    this->flags |= FLAG_ISQUEUED;
+    soengine_unlock_queue();
+  }
+}
+
+/*!
+  Evaluates all engines which have been marked dirty since the last
+  call, instead of waiting for each engine to be evaluated when one of
+  its outputs is read. Engines which don't read from each other are
+  evaluated in parallel on getNumThreads() worker threads, and an
+  engine is never evaluated before the engines it reads from. Worker
+  threads are only used when Coin is built with COIN_THREADSAFE, since
+  writing the outputs notifies the scene graph. Otherwise, the engines
+  are evaluated in the same order on the calling thread.
+
+  This is meant to be called right before a scene graph is traversed,
+  and SoRenderManager::render() does so. When there are many
+  independent engines, for instance interpolators animating a large
+  scene, the evaluation is then spread over several cores instead of
+  being done one engine at a time during traversal.
+
+  Nothing is done unless setNumThreads() has been set to a value
+  larger than 0. The application must not access the engines or their
+  connected fields from other threads while this method runs, and
+  evaluate() of all engine types in use must be safe to call on
+  different engines at the same time.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setNumThreads()
+  \since Coin 4.1
+*/
+void
+SoEngine::evaluateDirtyEngines(void)
+{
+  if (soengine_queue == NULL) return;
+
+  SbList<SoEngine *> engines;
+  soengine_lock_queue();
+  for (int i = 0; i < soengine_queue->getLength(); i++) {
+    SoEngine * engine = (*soengine_queue)[i];
+    if (engine == NULL) continue;
+    engine->flags &= ~FLAG_ISQUEUED;
+    // engines may already have been evaluated when read
+    if (engine->flags & FLAG_ISDIRTY) engines.append(engine);
+  }
+  soengine_queue->truncate(0);
+  soengine_unlock_queue();
+
+  const int numengines = engines.getLength();
+  if (numengines == 0) return;
+
+  SbHash<const SoBase *, int> index(numengines);
+  int i, j;
+  for (i = 0; i < numengines; i++) (void) index.put(engines[i], i);
+
+  // Find the engines reading from each engine, and count the number
+  // of engines each engine reads from.
+  SbList<int> edgestart(numengines + 1);
+  SbList<int> edges;
+  SbList<int> indegree(numengines);
+  for (i = 0; i < numengines; i++) indegree.append(0);
+  SbList<SoField *> visited;
+  SbBool fanin = FALSE;
+  for (i = 0; i < numengines; i++) {
+    edgestart.append(edges.getLength());
+    visited.truncate(0);
+    soengine_find_output_dependents(engines[i], index, edges, visited, fanin);
+    for (j = edgestart[i]; j < edges.getLength(); j++) indegree[edges[j]]++;
+  }
+  edgestart.append(edges.getLength());
+
+  // Fields written by more than one engine would be set from several
+  // threads at once, so evaluate such networks in sequence.
+  if (fanin) {
+    soengine_evaluate_sequential(engines.getArrayPtr(), numengines);
+    return;
+  }
+
+  // Evaluate the network level by level, where each level holds the
+  // engines which only read from engines in earlier levels.
+  SbList<SoEngine *> level;
+  SbList<int> current, next;
+  for (i = 0; i < numengines; i++) {
+    if (indegree[i] == 0) current.append(i);
+  }
+  int numdone = 0;
+  while (current.getLength()) {
+    level.truncate(0);
+    for (i = 0; i < current.getLength(); i++) level.append(engines[current[i]]);
+    soengine_evaluate_parallel(level.getArrayPtr(), level.getLength());
+    numdone += current.getLength();
+
+    next.truncate(0);
+    for (i = 0; i < current.getLength(); i++) {
+      const int e = current[i];
+      for (j = edgestart[e]; j < edgestart[e + 1]; j++) {
+        if (--indegree[edges[j]] == 0) next.append(edges[j]);
+      }
+    }
+    current = next;
+  }
+
+  // Engines in cycles are left, and are evaluated like they would be
+  // when read.
+  if (numdone < numengines) {
+    level.truncate(0);
+    for (i = 0; i < numengines; i++) {
+      if (indegree[i] > 0) level.append(engines[i]);
+    }
+    soengine_evaluate_sequential(level.getArrayPtr(), level.getLength());
+  }
 }
+
+/*!
+  Sets the number of threads used by evaluateDirtyEngines(). Set to 0
+  to evaluate engines only when their outputs are read, which is the
+  default unless the COIN_SOENGINE_THREADS environment variable is
+  set. Engines are evaluated on the calling thread if Coin was built
+  without support for threads, or without COIN_THREADSAFE.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa evaluateDirtyEngines()
+  \since Coin 4.1
+*/
+void
+SoEngine::setNumThreads(const int num)
+{
+  soengine_numthreads = SbMax(num, 0);
+}
+
+/*!
+  Returns the number of threads used by evaluateDirtyEngines().
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setNumThreads()
+  \since Coin 4.1
+*/
+int
+SoEngine::getNumThreads(void)
+{
+  return soengine_get_numthreads();
+}
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/engines/SoCalculator.h>
+#include <Inventor/engines/SoCompose.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+BOOST_AUTO_TEST_CASE(evaluateDirtyEngines)
+{
+  const int oldnumthreads = SoEngine::getNumThreads();
+  SoEngine::setNumThreads(2);
+
+  // three levels of engines: calculator -> decompose -> compose
+  const int NUM = 100;
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCalculator * calc[NUM];
+  for (int i = 0; i < NUM; i++) {
+    calc[i] = new SoCalculator;
+    calc[i]->a = float(i);
+    calc[i]->expression = "oA = vec3f(a, a * 2, 0)";
+    SoDecomposeVec3f * decompose = new SoDecomposeVec3f;
+    decompose->vector.connectFrom(&calc[i]->oA);
+    SoComposeVec3f * compose = new SoComposeVec3f;
+    compose->x.connectFrom(&decompose->y);
+    compose->y.connectFrom(&decompose->x);
+    SoTranslation * t = new SoTranslation;
+    t->translation.connectFrom(&compose->vector);
+    root->addChild(t);
+  }
+
+  for (int pass = 0; pass < 2; pass++) {
+    SoEngine::evaluateDirtyEngines();
+    SbBool evaluated = TRUE, correct = TRUE;
+    for (int i = 0; i < NUM; i++) {
+      SoTranslation * t = static_cast<SoTranslation *>(root->getChild(i));
+      if (t->translation.getDirty()) evaluated = FALSE;
+      const float a = float(i + pass);
+      if (t->translation.getValue() != SbVec3f(a * 2, a, 0.0f)) correct = FALSE;
+    }
+    BOOST_CHECK_MESSAGE(evaluated, "connected fields should be set before they are read");
+    BOOST_CHECK_MESSAGE(correct, "engines evaluated to the wrong values");
+
+    for (int i = 0; i < NUM; i++) calc[i]->a = float(i + pass + 1);
+  }
+
+  root->unref();
+  SoEngine::setNumThreads(oldnumthreads);
+}
+
+#endif // COIN_TEST_SUITE
@@ -143,17 +143,27 @@ inline unsigned int SbHashFunc(const void * key)
 {
   return SbHashFunc(reinterpret_cast<size_t>(key));
 }
+#include "misc/SoDBP.h"
 #include "coindefs.h" // COIN_STUB(), COIN_CHECK_THREAD()
 
+unsigned int SbHashFunc(const SoField * key)
+{
+  return SbHashFunc(reinterpret_cast<size_t>(key));
+}
+
 #ifdef COIN_THREADSAFE
 #include "threads/recmutexp.h"
 #define SOFIELD_RECLOCK (void) cc_recmutex_internal_field_lock()
 #define SOFIELD_RECUNLOCK (void) cc_recmutex_internal_field_unlock()
+#define SOFIELD_NOTIFYLOCK (void) cc_recmutex_internal_notify_lock()
+#define SOFIELD_NOTIFYUNLOCK (void) cc_recmutex_internal_notify_unlock()
 
 #else // COIN_THREADSAFE
 
 #define SOFIELD_RECLOCK
 #define SOFIELD_RECUNLOCK
+#define SOFIELD_NOTIFYLOCK
+#define SOFIELD_NOTIFYUNLOCK
 
 #endif // !COIN_THREADSAFE
 
@@ -567,6 +577,19 @@ SoField::~SoField()
   // slave.
   this->disconnect();
 
+  // Remove ourself from a pending notification batch. The batch
+  // lists are global, so they are only touched with the notification
+  // lock held.
+  SOFIELD_NOTIFYLOCK;
+  if (SoDBP::batchedfieldslots && SoDBP::batchedfieldslots->getNumElements()) {
+    int idx;
+    if (SoDBP::batchedfieldslots->get(this, idx)) {
+      (*SoDBP::batchedfields)[idx] = NULL;
+      (void) SoDBP::batchedfieldslots->erase(this);
+    }
+  }
+  SOFIELD_NOTIFYUNLOCK;
+
   if (this->hasExtendedStorage()) {
 
     // Disconnect slave fields using us as a master.
@@ -1434,6 +1457,12 @@ SoField::touch(void)
 
   At the end of a notification sequence, all "immediate" sensors
   (i.e. sensors set up with a zero priority) are triggered.
+
+  Inside a notification batch, connected fields, engines and field
+  sensors are notified at once, but the notification of the field's
+  container node is held back until the batch ends.
+
+  \sa SoDB::beginNotificationBatch()
 */
 void
 SoField::startNotify(void)
@@ -1540,6 +1569,24 @@ SoField::notify(SoNotList * nlist)
                            "field %p, list %p", this, nlist);
 #endif //COIN_DEBUG_EXTRA
 
+    // Inside a notification batch, nodes are notified when the batch
+    // ends. Engines are notified at once, so that their outputs are
+    // up to date. The batch state is global and guarded by the
+    // notification lock.
+    if (cont && cont->isOfType(SoNode::getClassTypeId()) &&
+        !cont->isOfType(SoNodeEngine::getClassTypeId())) {
+      SOFIELD_NOTIFYLOCK;
+      if (SoDBP::notificationbatch > 0) {
+        int idx;
+        if (!SoDBP::batchedfieldslots->get(this, idx)) {
+          (void) SoDBP::batchedfieldslots->put(this, SoDBP::batchedfields->getLength());
+          SoDBP::batchedfields->append(this);
+        }
+        cont = NULL;
+      }
+      SOFIELD_NOTIFYUNLOCK;
+    }
+
     if (this->hasExtendedStorage() && this->storage->auditors.getLength()) {
       // need to copy list first if we're going to notify the auditors
       SoNotList listcopy(*nlist);
@@ -98,6 +98,16 @@ SoMFColor::write1Value(SoOutput * out, int idx) const
   sosfvec3f_write_value(out, (*this)[idx]);
 }
 
+SbBool
+SoMFColor::readBinaryValues(SoInput * in, int numarg)
+{
+  assert(in->isBinary());
+  assert(numarg >= 0 && numarg <= this->maxNum);
+  return somffloat_read_binary_values(in,
+                                      reinterpret_cast<float *>(this->values),
+                                      numarg * 3);
+}
+
 #endif // DOXYGEN_SKIP_THIS
 
 
@@ -107,6 +117,7 @@ SoMFColor::write1Value(SoOutput * out, int idx) const
 void
 SoMFColor::setValues(int start, int numarg, const float rgb[][3])
 {
+  this->detachValues();
   if(start+numarg > this->maxNum) this->makeRoom(start+numarg);
   else if(start+numarg > this->num) this->num = start+numarg;
 
@@ -120,6 +131,7 @@ SoMFColor::setValues(int start, int numarg, const float rgb[][3])
 void
 SoMFColor::setHSVValues(int start, int numarg, const float hsv[][3])
 {
+  this->detachValues();
   if(start+numarg > this->maxNum) this->makeRoom(start+numarg);
   else if(start+numarg > this->num) this->num = start+numarg;
 
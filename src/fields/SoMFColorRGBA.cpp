@@ -107,6 +107,7 @@ SoMFColorRGBA::write1Value(SoOutput * out, int idx) const
 void
 SoMFColorRGBA::setValues(int start, int numarg, const float rgba[][4])
 {
+  this->detachValues();
   if(start+numarg > this->maxNum) this->makeRoom(start+numarg);
   else if(start+numarg > this->num) this->num = start+numarg;
 
@@ -120,6 +121,7 @@ SoMFColorRGBA::setValues(int start, int numarg, const float rgba[][4])
 void
 SoMFColorRGBA::setHSVValues(int start, int numarg, const float hsva[][4])
 {
+  this->detachValues();
   if(start+numarg > this->maxNum) this->makeRoom(start+numarg);
   else if(start+numarg > this->num) this->num = start+numarg;
 
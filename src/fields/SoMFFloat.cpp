@@ -93,6 +93,14 @@ SoMFFloat::write1Value(SoOutput * out, int idx) const
   sosffloat_write_value(out, (*this)[idx]);
 }
 
+SbBool
+SoMFFloat::readBinaryValues(SoInput * in, int numarg)
+{
+  assert(in->isBinary());
+  assert(numarg >= 0 && numarg <= this->maxNum);
+  return somffloat_read_binary_values(in, this->values, numarg);
+}
+
 #endif // DOXYGEN_SKIP_THIS
 
 
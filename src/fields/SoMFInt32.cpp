@@ -56,6 +56,7 @@
 #endif // COIN_DEBUG
 
 #include "fields/SoSubFieldP.h"
+#include "fields/shared.h"
 
 
 SO_MFIELD_SOURCE_MALLOC(SoMFInt32, int32_t, int32_t);
@@ -96,6 +97,14 @@ SoMFInt32::write1Value(SoOutput * out, int idx) const
   sosfint32_write_value(out, (*this)[idx]);
 }
 
+SbBool
+SoMFInt32::readBinaryValues(SoInput * in, int numarg)
+{
+  assert(in->isBinary());
+  assert(numarg >= 0 && numarg <= this->maxNum);
+  return somfint32_read_binary_values(in, this->values, numarg);
+}
+
 #endif // DOXYGEN_SKIP_THIS
 
 
@@ -68,7 +68,7 @@
 #include <Inventor/actions/SoWriteAction.h>
 #include <Inventor/SoPath.h>
 #include <Inventor/engines/SoEngine.h>
-#include <Inventor/nodes/SoNode.h>
+#include <Inventor/nodes/SoGroup.h>
 
 #if COIN_DEBUG
 #include <Inventor/errors/SoDebugError.h>
@@ -76,6 +76,7 @@
 
 #include "fields/SoSubFieldP.h"
 #include "misc/SoBaseP.h"
+#include "io/SoInputP.h"
 
 // These are the macros from SO_MFIELD_SOURCE_MALLOC we're
 // using. What's missing is the SO_MFIELD_VALUE_SOURCE macro, which we
@@ -347,6 +348,11 @@ SoMFNode::read1Value(SoInput * in, int index)
     SoNode * node = sfnode.getValue();
     if (!node) return FALSE;
     this->set1Value(index, node);
+    // the VRML97 group nodes keep their children in SoMFNode fields
+    SoFieldContainer * container = this->getContainer();
+    if (container && container->isOfType(SoGroup::getClassTypeId())) {
+      SoInputP::nodeRead(in, node, coin_assert_cast<SoGroup *>(container));
+    }
   };
   return result;
 #endif // old version
@@ -97,6 +97,7 @@ SoMFString::write1Value(SoOutput * out, int idx) const
 void
 SoMFString::setValues(const int start, const int numarg, const char * strings[])
 {
+  this->detachValues();
   if (start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if (start+numarg > this->num) this->num = start+numarg;
 
@@ -134,6 +135,7 @@ SoMFString::deleteText(const int fromline, const int fromchar,
   }
 #endif // debug
 
+  this->detachValues();
   if (fromline == toline) {
     this->values[fromline].deleteSubString(fromchar, tochar);
   }
@@ -98,6 +98,16 @@ SoMFUInt32::write1Value(SoOutput * out, int idx) const
   sosfuint32_write_value(out, (*this)[idx]);
 }
 
+SbBool
+SoMFUInt32::readBinaryValues(SoInput * in, int numarg)
+{
+  assert(in->isBinary());
+  assert(numarg >= 0 && numarg <= this->maxNum);
+  return somfint32_read_binary_values(in,
+                                      reinterpret_cast<int32_t *>(this->values),
+                                      numarg);
+}
+
 #endif // DOXYGEN_SKIP_THIS
 
 // *************************************************************************
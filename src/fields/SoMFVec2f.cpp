@@ -98,6 +98,16 @@ SoMFVec2f::write1Value(SoOutput * out, int idx) const
   sosfvec2f_write_value(out, (*this)[idx]);
 }
 
+SbBool
+SoMFVec2f::readBinaryValues(SoInput * in, int numarg)
+{
+  assert(in->isBinary());
+  assert(numarg >= 0 && numarg <= this->maxNum);
+  return somffloat_read_binary_values(in,
+                                      reinterpret_cast<float *>(this->values),
+                                      numarg * 2);
+}
+
 #endif // DOXYGEN_SKIP_THIS
 
 // *************************************************************************
@@ -109,6 +119,7 @@ SoMFVec2f::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec2f::setValues(int start, int numarg, const float xy[][2])
 {
+  this->detachValues();
   if (start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if (start+numarg > this->num) this->num = start+numarg;
 
@@ -111,6 +111,7 @@ SoMFVec2s::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec2s::setValues(int start, int numarg, const short xy[][2])
 {
+  this->detachValues();
   if (start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if (start+numarg > this->num) this->num = start+numarg;
 
@@ -107,6 +107,7 @@ SoMFVec3d::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec3d::setValues(int start, int numarg, const double xyz[][3])
 {
+  this->detachValues();
   if (start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if (start+numarg > this->num) this->num = start+numarg;
 
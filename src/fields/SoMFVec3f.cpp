@@ -104,6 +104,16 @@ SoMFVec3f::write1Value(SoOutput * out, int idx) const
   sosfvec3f_write_value(out, (*this)[idx]);
 }
 
+SbBool
+SoMFVec3f::readBinaryValues(SoInput * in, int numarg)
+{
+  assert(in->isBinary());
+  assert(numarg >= 0 && numarg <= this->maxNum);
+  return somffloat_read_binary_values(in,
+                                      reinterpret_cast<float *>(this->values),
+                                      numarg * 3);
+}
+
 #endif // DOXYGEN_SKIP_THIS
 
 // *************************************************************************
@@ -120,6 +130,7 @@ SoMFVec3f::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec3f::setValues(int start, int numarg, const float xyz[][3])
 {
+  this->detachValues();
   if (start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if (start+numarg > this->num) this->num = start+numarg;
 
@@ -170,6 +181,12 @@ SoMFVec3f::setValue(const float xyz[3])
 
 #ifdef COIN_TEST_SUITE
 
+#include <Inventor/SoDB.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoSeparator.h>
+
 BOOST_AUTO_TEST_CASE(initialized)
 {
   SoMFVec3f field;
@@ -178,4 +195,104 @@ BOOST_AUTO_TEST_CASE(initialized)
   BOOST_CHECK_EQUAL(field.getNum(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(binaryReadBack)
+{
+  const int numpoints = 1000;
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  root->addChild(coords);
+  coords->point.setNum(numpoints);
+  SbVec3f * points = coords->point.startEditing();
+  for (int i = 0; i < numpoints; i++) {
+    points[i].setValue(float(i), -float(i) / 3.0f, 1.0e10f * float(i));
+  }
+  coords->point.finishEditing();
+
+  SoOutput out;
+  out.setBinary(TRUE);
+  out.setBuffer(malloc(1024), 1024, realloc);
+  SoWriteAction wa(&out);
+  wa.apply(root);
+
+  void * buffer;
+  size_t size;
+  out.getBuffer(buffer, size);
+
+  SoInput in;
+  in.setBuffer(buffer, size);
+  SoSeparator * readroot = SoDB::readAll(&in);
+  BOOST_REQUIRE(readroot != NULL);
+  readroot->ref();
+  BOOST_REQUIRE(readroot->getNumChildren() == 1);
+  SoCoordinate3 * readcoords = (SoCoordinate3 *) readroot->getChild(0);
+  BOOST_REQUIRE(readcoords->isOfType(SoCoordinate3::getClassTypeId()));
+  BOOST_CHECK(readcoords->point == coords->point);
+
+  readroot->unref();
+  root->unref();
+  free(buffer);
+}
+
+BOOST_AUTO_TEST_CASE(copyOnWrite)
+{
+  const int numpoints = 1000;
+  const SbBool oldsharing = SoMField::isValueSharingEnabled();
+  SoMField::enableValueSharing(TRUE);
+
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->ref();
+  coords->point.setNum(numpoints);
+  SbVec3f * points = coords->point.startEditing();
+  for (int i = 0; i < numpoints; i++) points[i].setValue(float(i), 0.0f, 0.0f);
+  coords->point.finishEditing();
+
+  SoCoordinate3 * copy = static_cast<SoCoordinate3 *>(coords->copy());
+  copy->ref();
+  BOOST_CHECK_MESSAGE(copy->point.getValues(0) == coords->point.getValues(0),
+                      "copied values should be shared");
+
+  SoMFVec3f field;
+  field = copy->point;
+  field.set1Value(1, SbVec3f(-1.0f, -1.0f, -1.0f));
+  BOOST_CHECK(field.getValues(0) != copy->point.getValues(0));
+  BOOST_CHECK(field[1] == SbVec3f(-1.0f, -1.0f, -1.0f));
+
+  points = coords->point.startEditing();
+  points[0].setValue(1.0f, 2.0f, 3.0f);
+  coords->point.finishEditing();
+  coords->point.deleteValues(numpoints - 10);
+  BOOST_CHECK_EQUAL(coords->point.getNum(), numpoints - 10);
+  BOOST_CHECK(coords->point[0] == SbVec3f(1.0f, 2.0f, 3.0f));
+
+  coords->unref();
+  BOOST_CHECK_EQUAL(copy->point.getNum(), numpoints);
+  BOOST_CHECK(copy->point[0] == SbVec3f(0.0f, 0.0f, 0.0f));
+  BOOST_CHECK(copy->point[1] == SbVec3f(1.0f, 0.0f, 0.0f));
+  BOOST_CHECK(field[0] == SbVec3f(0.0f, 0.0f, 0.0f));
+  copy->unref();
+  SoMField::enableValueSharing(oldsharing);
+}
+
+BOOST_AUTO_TEST_CASE(noSharingByDefault)
+{
+  const SbBool oldsharing = SoMField::isValueSharingEnabled();
+  SoMField::enableValueSharing(FALSE);
+
+  SoMFVec3f field;
+  field.setNum(1000);
+  SoMFVec3f copy;
+  copy = field;
+  BOOST_CHECK(copy.getValues(0) != field.getValues(0));
+
+  // writing through the const pointer, as code built against older
+  // headers may do, must not change the copy
+  SbVec3f * values = const_cast<SbVec3f *>(field.getValues(0));
+  values[0].setValue(1.0f, 2.0f, 3.0f);
+  BOOST_CHECK(copy[0] != SbVec3f(1.0f, 2.0f, 3.0f));
+
+  SoMField::enableValueSharing(oldsharing);
+}
+
 #endif // COIN_TEST_SUITE
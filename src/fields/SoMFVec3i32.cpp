@@ -122,6 +122,7 @@ SoMFVec3i32::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec3i32::setValues(int start, int numarg, const int32_t xyz[][3])
 {
+  this->detachValues();
   if (start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if (start+numarg > this->num) this->num = start+numarg;
 
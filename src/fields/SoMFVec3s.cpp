@@ -122,6 +122,7 @@ SoMFVec3s::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec3s::setValues(int start, int numarg, const short xyz[][3])
 {
+  this->detachValues();
   if (start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if (start+numarg > this->num) this->num = start+numarg;
 
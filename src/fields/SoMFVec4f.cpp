@@ -100,6 +100,16 @@ SoMFVec4f::write1Value(SoOutput * out, int idx) const
   sosfvec4f_write_value(out, (*this)[idx]);
 }
 
+SbBool
+SoMFVec4f::readBinaryValues(SoInput * in, int numarg)
+{
+  assert(in->isBinary());
+  assert(numarg >= 0 && numarg <= this->maxNum);
+  return somffloat_read_binary_values(in,
+                                      reinterpret_cast<float *>(this->values),
+                                      numarg * 4);
+}
+
 #endif // DOXYGEN_SKIP_THIS
 
 // *************************************************************************
@@ -111,6 +121,7 @@ SoMFVec4f::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec4f::setValues(int start, int numarg, const float xyzw[][4])
 {
+  this->detachValues();
   if(start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if(start+numarg > this->num) this->num = start+numarg;
 
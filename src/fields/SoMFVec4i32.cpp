@@ -113,6 +113,7 @@ SoMFVec4i32::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec4i32::setValues(int start, int numarg, const int32_t xyzw[][4])
 {
+  this->detachValues();
   if(start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if(start+numarg > this->num) this->num = start+numarg;
 
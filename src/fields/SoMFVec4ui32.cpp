@@ -113,6 +113,7 @@ SoMFVec4ui32::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec4ui32::setValues(int start, int numarg, const uint32_t xyzw[][4])
 {
+  this->detachValues();
   if(start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if(start+numarg > this->num) this->num = start+numarg;
 
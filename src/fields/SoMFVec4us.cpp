@@ -113,6 +113,7 @@ SoMFVec4us::write1Value(SoOutput * out, int idx) const
 void
 SoMFVec4us::setValues(int start, int numarg, const unsigned short xyzw[][4])
 {
+  this->detachValues();
   if(start+numarg > this->maxNum) this->allocValues(start+numarg);
   else if(start+numarg > this->num) this->num = start+numarg;
 
@@ -236,6 +236,29 @@
   very careful about how your application and DLLs are linked to the
   underlying C library.
 
+  If value sharing is enabled with enableValueSharing() or the
+  COIN_MFIELD_SHARE_VALUES environment variable, copying a
+  multiple-value field, either with the assignment operator or with
+  SoField::copyFrom() (which is what SoNode::copy() does for all
+  fields of the copied nodes), does not copy the value array. Instead
+  the two fields share it until one of them is changed, so copying a
+  scene graph with large coordinate or index arrays costs little
+  memory. The array is copied before it is written to by setValues(),
+  set1Value(), setNum(), startEditing() and the other methods which
+  change the values, and only the field which is changed gets the new
+  copy. Fields of node, path and engine pointers, and fields using
+  setValuesPointer(), never share their arrays.
+
+  Sharing is off by default, since it changes what happens to code
+  which writes to the values without going through the field. Code
+  which casts away the constness of getValues() and changes the values
+  in place will then also change the values of every copy of the
+  field. The same goes for code built against headers from before
+  value sharing, where the inlined startEditing() doesn't give the
+  field its own copy of the array first. Only enable sharing when all
+  code which writes to fields uses the field methods, and is built
+  against the current headers.
+
   \sa SoSField
 */
 
@@ -252,10 +275,24 @@
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/errors/SoReadError.h>
 #include <Inventor/fields/SoSubField.h>
+#include <Inventor/fields/SoMFEngine.h>
+#include <Inventor/fields/SoMFFloat.h>
+#include <Inventor/fields/SoMFInt32.h>
+#include <Inventor/fields/SoMFNode.h>
+#include <Inventor/fields/SoMFPath.h>
+#include <Inventor/fields/SoMFVec3f.h>
+
+inline unsigned int SbHashFunc(const void * key);
+#include "misc/SbHash.h"
+inline unsigned int SbHashFunc(const void * key)
+{
+  return SbHashFunc(reinterpret_cast<size_t>(key));
+}
 
 #include "threads/threadsutilp.h"
 #include "tidbitsp.h"
 #include "coindefs.h" // COIN_WORKAROUND_*
+#include "io/SoInputP.h"
 
 #ifndef COIN_WORKAROUND_NO_USING_STD_FUNCS
 using std::memcpy;
@@ -292,10 +329,36 @@ SoType SoMField::classTypeId STATIC_SOTYPE_INIT;
 // need one static mutex for field_buffer in SoMField::get1(SbString &)
 static void * somfield_mutex = NULL;
 
+// Value arrays shared between fields after a copy, with the number
+// of fields sharing each array. An array is removed when it is used
+// by only one field again.
+typedef SbHash<const void *, int> SoMFieldSharedValues;
+static SoMFieldSharedValues * somfield_sharedvalues = NULL;
+static void * somfield_sharedmutex = NULL;
+
+// Arrays smaller than this many bytes are cheaper to just copy.
+#define SOMFIELD_MINSHAREDSIZE 256
+
+// -1 until COIN_MFIELD_SHARE_VALUES has been checked
+static int somfield_sharevalues = -1;
+
+static SbBool
+somfield_is_sharing_enabled(void)
+{
+  if (somfield_sharevalues < 0) {
+    const char * env = coin_getenv("COIN_MFIELD_SHARE_VALUES");
+    somfield_sharevalues = (env && atoi(env) > 0) ? 1 : 0;
+  }
+  return somfield_sharevalues ? TRUE : FALSE;
+}
+
 static void
 somfield_mutex_cleanup(void)
 {
   CC_MUTEX_DESTRUCT(somfield_mutex);
+  CC_MUTEX_DESTRUCT(somfield_sharedmutex);
+  delete somfield_sharedvalues;
+  somfield_sharedvalues = NULL;
 }
 
 // *************************************************************************
@@ -319,6 +382,8 @@ SoMField::initClass(void)
   PRIVATE_FIELD_INIT_CLASS(SoMField, "MField", inherited, NULL);
 
   CC_MUTEX_CONSTRUCT(somfield_mutex);
+  CC_MUTEX_CONSTRUCT(somfield_sharedmutex);
+  somfield_sharedvalues = new SoMFieldSharedValues;
   coin_atexit(somfield_mutex_cleanup, CC_ATEXIT_NORMAL);
 }
 
@@ -369,6 +434,7 @@ SbBool
 SoMField::set1(const int index, const char * const valuestring)
 {
   int oldnum = this->num;
+  this->detachValues();
   // make sure the array has room for the new item
   if (index >= this->maxNum) this->allocValues(index+1);
   else if (index >= this->num) this->num = index+1;
@@ -475,6 +541,9 @@ SoMField::readValue(SoInput * in)
     return FALSE; \
   }
 
+  // The values are written straight into the array below.
+  this->detachValues();
+
   // ** Binary format ******************************************************
   if (in->isBinary()) {
     int numtoread;
@@ -516,7 +585,33 @@ SoMField::readValue(SoInput * in)
       else {
         in->putBack(c);
 
+        // Lists of the most common field types are read in batches
+        // straight from the input buffer, falling back to reading
+        // value by value where that is not possible.
+        const SoType type = this->getTypeId();
+        const SbBool batchint32 = (type == SoMFInt32::getClassTypeId());
+        const int batchitemsize =
+          (type == SoMFVec3f::getClassTypeId()) ? 3 :
+          (type == SoMFFloat::getClassTypeId() || batchint32) ? 1 : 0;
+        const int BATCHSIZE = 1024;
+
         while (TRUE) {
+          if (batchitemsize > 0) {
+            if (currentidx + BATCHSIZE > this->num) {
+              this->makeRoom(currentidx + BATCHSIZE);
+            }
+            SbBool endoflist;
+            const int numread = batchint32 ?
+              SoInputP::readIntegerArray(in, static_cast<int32_t *>(this->valuesPtr()) +
+                                         currentidx, BATCHSIZE, endoflist) :
+              SoInputP::readRealArray(in, static_cast<float *>(this->valuesPtr()) +
+                                      currentidx * batchitemsize,
+                                      BATCHSIZE, batchitemsize, endoflist);
+            currentidx += numread;
+            if (endoflist) { break; }
+            if (numread == BATCHSIZE) { continue; }
+          }
+
           // makeRoom() makes sure the allocation strategy is decent.
           if (currentidx >= this->num) this->makeRoom(currentidx + 1);
 
@@ -699,7 +794,9 @@ SoMField::deleteValues(int start, int numarg)
   }
 #endif // COIN_DEBUG
 
-  // Move elements downward to fill the gap.
+  // Move elements downward to fill the gap. When deleting from the
+  // end, allocValues() below takes care of a shared array.
+  if (end < oldnum) this->detachValues();
   for (int i = 0; i < oldnum-(start+numarg); i++)
     this->copyValue(start+i, start+numarg+i);
 
@@ -746,6 +843,41 @@ SoMField::isDeleteValuesEnabled(void) const
   return !this->userDataIsUsed;
 }
 
+/*!
+  Enables or disables sharing of value arrays between copies of
+  multiple-value fields. Sharing is off by default, unless the
+  COIN_MFIELD_SHARE_VALUES environment variable is set to 1. Fields
+  which already share an array keep doing so until they are changed.
+
+  See the SoMField class documentation for what enabling this means
+  for code which writes to field values.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa isValueSharingEnabled()
+  \since Coin 4.1
+*/
+void
+SoMField::enableValueSharing(const SbBool onoff)
+{
+  somfield_sharevalues = onoff ? 1 : 0;
+}
+
+/*!
+  Returns whether value arrays are shared between copies of
+  multiple-value fields.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa enableValueSharing()
+  \since Coin 4.1
+*/
+SbBool
+SoMField::isValueSharingEnabled(void)
+{
+  return somfield_is_sharing_enabled();
+}
+
 /*!
   Insert \a num "slots" for new value elements from \a start.
   The elements already present from \a start will be moved
@@ -793,15 +925,18 @@ SoMField::allocValues(int newnum)
 
   assert(newnum >= 0);
 
+  // A shared array is never changed, so it is always reallocated.
+  const SbBool shared = this->hasSharedValues();
+
   if (newnum == 0) {
-    if (!this->userDataIsUsed) {
+    if (!this->userDataIsUsed && !this->releaseSharedValues()) {
       delete[] static_cast<unsigned char *>(this->valuesPtr());
     }
     this->setValuesPtr(NULL);
     this->userDataIsUsed = FALSE;
     this->maxNum = 0;
   }
-  else if (newnum > this->maxNum || newnum < this->num) {
+  else if (shared || newnum > this->maxNum || newnum < this->num) {
     int fsize = this->fieldSizeof();
     if (this->valuesPtr()) {
 
@@ -824,7 +959,7 @@ SoMField::allocValues(int newnum)
 
 #endif // debug
 
-      if (oldmaxnum != this->maxNum) {
+      if (shared || oldmaxnum != this->maxNum) {
         // FIXME: Umm.. aren't we supposed to use realloc() here?
         // 20000915 mortene.
         size_t buffersize = size_t(this->maxNum) * size_t(fsize);
@@ -837,7 +972,7 @@ SoMField::allocValues(int newnum)
         if (buffersize > copysize) {
           (void)memset(newblock + copysize, 0, buffersize - copysize);
         }
-        if (!this->userDataIsUsed) {
+        if (!this->userDataIsUsed && !this->releaseSharedValues()) {
           delete[] static_cast<unsigned char *>(this->valuesPtr());
         }
         this->setValuesPtr(newblock);
@@ -858,6 +993,92 @@ SoMField::allocValues(int newnum)
 
   this->num = newnum;
 }
+
+// Makes this field share the value array of \a field, instead of
+// copying it. Returns FALSE if the array can't be shared, and the
+// values must be copied the usual way.
+SbBool
+SoMField::shareValues(const SoMField & field)
+{
+  if (!somfield_is_sharing_enabled()) return FALSE;
+  // values are copied into application data set with setValuesPointer()
+  if (&field == this || this->userDataIsUsed) return FALSE;
+  // the values of these fields are reference counted one by one
+  const SoType type = this->getTypeId();
+  if (type.isDerivedFrom(SoMFNode::getClassTypeId()) ||
+      type.isDerivedFrom(SoMFPath::getClassTypeId()) ||
+      type.isDerivedFrom(SoMFEngine::getClassTypeId())) return FALSE;
+
+  SoMField & src = const_cast<SoMField &>(field);
+  src.evaluate();
+  if (src.userDataIsUsed || src.valuesPtr() == NULL ||
+      size_t(src.num) * size_t(src.fieldSizeof()) < SOMFIELD_MINSHAREDSIZE) {
+    return FALSE;
+  }
+
+  this->allocValues(0);
+
+  const void * values = src.valuesPtr();
+  CC_MUTEX_LOCK(somfield_sharedmutex);
+  int count;
+  if (!somfield_sharedvalues->get(values, count)) count = 1;
+  (void) somfield_sharedvalues->put(values, count + 1);
+  src.statusbits |= FLAG_SHAREDVALUES;
+  this->statusbits |= FLAG_SHAREDVALUES;
+  CC_MUTEX_UNLOCK(somfield_sharedmutex);
+
+  this->setValuesPtr(src.valuesPtr());
+  this->num = src.num;
+  this->maxNum = src.maxNum;
+  return TRUE;
+}
+
+// Gives this field its own copy of the value array if it is shared
+// with other fields. Must be called before the array is written to.
+void
+SoMField::detachValues(void)
+{
+  if (this->statusbits & FLAG_SHAREDVALUES) this->allocValues(this->num);
+}
+
+// Returns TRUE if the value array is shared with other fields.
+SbBool
+SoMField::hasSharedValues(void)
+{
+  if (!(this->statusbits & FLAG_SHAREDVALUES)) return FALSE;
+  // don't risk deleting an array in use after SoMField cleanup
+  if (somfield_sharedvalues == NULL) return TRUE;
+
+  CC_MUTEX_LOCK(somfield_sharedmutex);
+  int count;
+  const SbBool shared = somfield_sharedvalues->get(this->valuesPtr(), count);
+  CC_MUTEX_UNLOCK(somfield_sharedmutex);
+
+  // the other fields have let go of the array
+  if (!shared) this->statusbits &= ~FLAG_SHAREDVALUES;
+  return shared;
+}
+
+// Lets go of a shared value array. Returns TRUE if the array is still
+// used by other fields, so it must not be deleted.
+SbBool
+SoMField::releaseSharedValues(void)
+{
+  if (!(this->statusbits & FLAG_SHAREDVALUES)) return FALSE;
+  this->statusbits &= ~FLAG_SHAREDVALUES;
+  if (somfield_sharedvalues == NULL) return TRUE;
+
+  const void * values = this->valuesPtr();
+  CC_MUTEX_LOCK(somfield_sharedmutex);
+  int count;
+  const SbBool shared = somfield_sharedvalues->get(values, count);
+  if (shared) {
+    if (count > 2) (void) somfield_sharedvalues->put(values, count - 1);
+    else (void) somfield_sharedvalues->erase(values);
+  }
+  CC_MUTEX_UNLOCK(somfield_sharedmutex);
+  return shared;
+}
 #endif // DOXYGEN_SKIP_THIS
 
 SoNotRec
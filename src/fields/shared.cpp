@@ -154,6 +154,28 @@ sosffloat_write_value(SoOutput * out, float val)
   out->write(val);
 }
 
+// Read num binary format floating point values straight into the
+// values array of a multiple-value field, in one block. Non-finite
+// values are replaced with 0.0f, like SoInput::read(float &) does.
+// Used from the readBinaryValues() overrides of SoMFFloat, SoMFVec2f,
+// SoMFVec3f, SoMFVec4f and SoMFColor.
+SbBool
+somffloat_read_binary_values(SoInput * in, float * values, int num)
+{
+  if (num == 0) return TRUE;
+  if (!in->readBinaryArray(values, num)) return FALSE;
+
+  for (int i = 0; i < num; i++) {
+    if (!coin_finite(static_cast<double>(values[i]))) {
+      SoReadError::post(in,
+                        "Detected non-valid floating point number, replacing "
+                        "with 0.0f");
+      values[i] = 0.0f;
+    }
+  }
+  return TRUE;
+}
+
 // Write double precision floating point value to output stream. Used from
 // SoSFDouble and SoMFDouble.
 void
@@ -358,6 +380,16 @@ sosfuint32_write_value(SoOutput * out, uint32_t val)
   out->write(tmp);
 }
 
+// Read num binary format 32-bit integer values straight into the
+// values array of a multiple-value field, in one block. Used from
+// SoMFInt32 and SoMFUInt32.
+SbBool
+somfint32_read_binary_values(SoInput * in, int32_t * values, int num)
+{
+  if (num == 0) return TRUE;
+  return in->readBinaryArray(values, num);
+}
+
 // *************************************************************************
 
 // Write integer value to output stream. Used from SoSFUShort and
@@ -68,6 +68,7 @@ SbBool sosfbool_read_value(SoInput * in, SbBool & val);
 void sosfbool_write_value(SoOutput * out, SbBool val);
 
 void sosffloat_write_value(SoOutput * out, float val);
+SbBool somffloat_read_binary_values(SoInput * in, float * values, int num);
 void sosfdouble_write_value(SoOutput * out, double val);
 
 void sosfstring_write_value(const SoField * f, SoOutput * out,
@@ -87,6 +88,7 @@ SbBool sosftime_read_value(SoInput * in, SbTime & t);
 void sosftime_write_value(SoOutput * out, const SbTime & p);
 
 void sosfuint32_write_value(SoOutput * out, uint32_t val);
+SbBool somfint32_read_binary_values(SoInput * in, int32_t * values, int num);
 void sosfushort_write_value(SoOutput * out, unsigned short val);
 
 void sosfvec2b_write_value(SoOutput * out, SbVec2b v);
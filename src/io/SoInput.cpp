@@ -86,6 +86,19 @@
   this is no longer possible, since the reading now starts at the
   SoFile node, with an empty dictionary.
 
+  The environment variable COIN_SOINPUT_MMAP_THRESHOLD sets the file
+  size, in bytes, from which uncompressed files are memory mapped even
+  if setMemoryMapping() has not been called. The default is 64
+  MB. Set it to "0" to only use memory mapping when explicitly
+  requested.
+
+  COIN_SOINPUT_PREFETCH_THREADS sets the default number of threads
+  used for loading files referenced from a scene in advance, see
+  setPrefetchThreads(). The default is "0", which disables it.
+  COIN_SOINPUT_PREFETCH_MAXBYTES limits how many bytes of loaded
+  files are kept in memory before they are read. Files which do not
+  fit are opened normally when needed. The default is 256 MB.
+
   \sa SoOutput, SoDB
 */
 
@@ -129,6 +142,7 @@
 #include "coindefs.h" // COIN_STUB(), COIN_OBSOLETED()
 #include "io/SoInputP.h"
 #include "io/SoInput_FileInfo.h"
+#include "io/SoInput_Prefetcher.h"
 
 // This (POSIX-compliant) macro is missing from the Win32 API header
 // files for MSVC++ 6.0.
@@ -175,6 +189,65 @@ soinput_destruct_tls_data(void * closure)
 
 // *************************************************************************
 
+// Byte swapping of whole arrays from network byte order (big-endian)
+// to host byte order, used by the convert*Array() methods. from and
+// to may point to the same memory. The loops are kept simple, with
+// no calls and no branches, so the compiler can turn them into
+// vectorized byte shuffles.
+
+static void
+soinput_ntoh_16bit_array(const char * from, char * to, int len)
+{
+  if (coin_host_get_endianness() == COIN_HOST_IS_BIGENDIAN) {
+    if (from != to) memmove(to, from, len * sizeof(uint16_t));
+    return;
+  }
+  for (int i = 0; i < len; i++) {
+    uint16_t v;
+    memcpy(&v, from + i * sizeof(uint16_t), sizeof(uint16_t));
+    v = static_cast<uint16_t>((v >> 8) | (v << 8));
+    memcpy(to + i * sizeof(uint16_t), &v, sizeof(uint16_t));
+  }
+}
+
+static void
+soinput_ntoh_32bit_array(const char * from, char * to, int len)
+{
+  if (coin_host_get_endianness() == COIN_HOST_IS_BIGENDIAN) {
+    if (from != to) memmove(to, from, len * sizeof(uint32_t));
+    return;
+  }
+  for (int i = 0; i < len; i++) {
+    uint32_t v;
+    memcpy(&v, from + i * sizeof(uint32_t), sizeof(uint32_t));
+    v = (v >> 24) | ((v >> 8) & 0x0000ff00) |
+      ((v << 8) & 0x00ff0000) | (v << 24);
+    memcpy(to + i * sizeof(uint32_t), &v, sizeof(uint32_t));
+  }
+}
+
+static void
+soinput_ntoh_64bit_array(const char * from, char * to, int len)
+{
+  if (coin_host_get_endianness() == COIN_HOST_IS_BIGENDIAN) {
+    if (from != to) memmove(to, from, len * sizeof(uint64_t));
+    return;
+  }
+  for (int i = 0; i < len; i++) {
+    uint32_t hi, lo;
+    memcpy(&hi, from + i * sizeof(uint64_t), sizeof(uint32_t));
+    memcpy(&lo, from + i * sizeof(uint64_t) + sizeof(uint32_t), sizeof(uint32_t));
+    hi = (hi >> 24) | ((hi >> 8) & 0x0000ff00) |
+      ((hi << 8) & 0x00ff0000) | (hi << 24);
+    lo = (lo >> 24) | ((lo >> 8) & 0x0000ff00) |
+      ((lo << 8) & 0x00ff0000) | (lo << 24);
+    memcpy(to + i * sizeof(uint64_t), &lo, sizeof(uint32_t));
+    memcpy(to + i * sizeof(uint64_t) + sizeof(uint32_t), &hi, sizeof(uint32_t));
+  }
+}
+
+// *************************************************************************
+
 #define PRIVATE(obj) (obj->pimpl)
 
 // *************************************************************************
@@ -470,7 +543,8 @@ SoInput::setFilePointer(FILE * newFP)
   // stdin. SoInput_FileInfo will create it when we know that we're
   // actually going to read from stdin
   if (newFP != coin_get_stdin()) {
-    reader = SoInput_Reader::createReader(newFP, SbString(name));
+    reader = SoInput_Reader::createReader(newFP, SbString(name),
+                                          PRIVATE(this)->memorymapping);
   }
   SoInput_FileInfo * newfile =
     new SoInput_FileInfo(reader, PRIVATE(this)->copied_references);
@@ -499,13 +573,23 @@ SoInput::openFile(const char * fileName, SbBool okIfNotFound)
   SbString fullname;
   FILE * fp = this->findFile(fileName, fullname);
   if (fp) {
-    SoInput_Reader * reader = SoInput_Reader::createReader(fp, fullname);
+    SoInput_Reader * reader =
+      SoInput_Reader::createReader(fp, fullname, PRIVATE(this)->memorymapping);
     assert(reader);
     SoInput_FileInfo * newfile =
       new SoInput_FileInfo(reader, PRIVATE(this)->copied_references);
     this->filestack.insert(newfile, 0);
 
     SoInput::addDirectoryFirst(SoInput::getPathname(fullname).getString());
+
+#ifdef HAVE_THREADS
+    if (PRIVATE(this)->prefetchthreads > 0) {
+      PRIVATE(this)->prefetcher =
+        new SoInput_Prefetcher(PRIVATE(this)->prefetchthreads,
+                               SoInputP::prefetchMaxBytes());
+      PRIVATE(this)->prefetcher->scanFile(fullname, SoInput::getDirectories());
+    }
+#endif // HAVE_THREADS
     return TRUE;
   }
 
@@ -550,7 +634,15 @@ SoInput::pushFile(const char * filename)
   SbString fullname;
   FILE * fp = this->findFile(filename, fullname);
   if (fp) {
-    SoInput_Reader * reader = SoInput_Reader::createReader(fp, fullname);
+    SoInput_Reader * reader = NULL;
+    if (PRIVATE(this)->prefetcher) {
+      reader = PRIVATE(this)->prefetcher->takeReader(fullname);
+      if (reader) { fclose(fp); }
+    }
+    if (reader == NULL) {
+      reader = SoInput_Reader::createReader(fp, fullname,
+                                            PRIVATE(this)->memorymapping);
+    }
     SoInput_FileInfo * newfile =
       new SoInput_FileInfo(reader, PRIVATE(this)->copied_references);
     this->filestack.insert(newfile, 0);
@@ -588,6 +680,9 @@ SoInput::closeFile(void)
     delete this->getTopOfStack();
     this->filestack.remove(0);
   }
+
+  delete PRIVATE(this)->prefetcher;
+  PRIVATE(this)->prefetcher = NULL;
 }
 
 /*!
@@ -722,6 +817,125 @@ SoInput::setStringArray(const char * strings[])
   info->setDeleteBuffer(buf);
 }
 
+/*!
+  Set whether or not files opened through openFile(), pushFile() or
+  setFilePointer() after this call should be memory mapped instead of
+  being read through the C library stream functions. This lets the
+  parser work directly on the file's pages, which is considerably
+  faster for big files. Compressed files are never memory mapped.
+
+  Big files are memory mapped even if this flag is not set, see the
+  COIN_SOINPUT_MMAP_THRESHOLD environment variable described in the
+  class documentation. If the platform does not support memory
+  mapping, files are read the regular way.
+
+  Default value is \c FALSE.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.1
+*/
+void
+SoInput::setMemoryMapping(const SbBool onoff)
+{
+  PRIVATE(this)->memorymapping = onoff;
+}
+
+/*!
+  Returns whether or not files will be memory mapped when opened.
+
+  \sa setMemoryMapping()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.1
+*/
+SbBool
+SoInput::isMemoryMapping(void) const
+{
+  return PRIVATE(this)->memorymapping;
+}
+
+/*!
+  Set the number of worker threads used to load files referenced
+  from the scene in advance. When \a numthreads is larger than 0, the
+  next file opened with openFile() is scanned for SoFile::name and
+  SoVRMLInline::url references, and the files found are read and
+  decompressed by a pool of \a numthreads threads while the scene is
+  being parsed. This is done recursively for the referenced files. The
+  loaded data is then used when the SoFile and SoVRMLInline nodes push
+  their files on the stack through pushFile().
+
+  This speeds up reading of scenes which are split over many files,
+  like big CAD assemblies. The files are still parsed, and the scene
+  graph built, on the thread which reads from this SoInput, since
+  that can not be done in parallel.
+
+  Set to 0 to disable, which is the default unless the
+  COIN_SOINPUT_PREFETCH_THREADS environment variable is set. Has no
+  effect if Coin was built without support for threads.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.1
+*/
+void
+SoInput::setPrefetchThreads(const int numthreads)
+{
+  PRIVATE(this)->prefetchthreads = SbMax(numthreads, 0);
+}
+
+/*!
+  Returns the number of threads used to load referenced files in
+  advance.
+
+  \sa setPrefetchThreads()
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.1
+*/
+int
+SoInput::getPrefetchThreads(void) const
+{
+  return PRIVATE(this)->prefetchthreads;
+}
+
+/*!
+  Set a callback which is invoked while a scene is read with
+  SoDB::readAll() or SoDB::readAllVRML(), each time a node at the top
+  level of the file, or a child of a group node at the top level, has
+  been read in full. \a parent is the group the node will be added to,
+  or \c NULL for nodes at the top level. For VRML97 group nodes the
+  callback is invoked for each node read into their children field.
+  Nodes read into single-node fields, like the proxy of a VRML97
+  Collision node, are not reported.
+
+  This makes it possible to show a big scene progressively while it
+  is being read, as most files have a single root node with the
+  actual contents as its children. The nodes passed to the callback
+  are complete, and may be referenced and inserted in another scene
+  graph right away, but the parent group is still being read and must
+  not be touched. Use getNumBytesRead() from the callback to find how
+  far into the current file the reading has come.
+
+  Note that the callback is invoked from the middle of the read
+  process, so it must not read from or otherwise change the state of
+  this SoInput.
+
+  Set \a func to \c NULL to disable the callback.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.1
+*/
+void
+SoInput::setReadCallback(SoInputReadCB * func, void * userdata)
+{
+  PRIVATE(this)->readcb = func;
+  PRIVATE(this)->readcbdata = userdata;
+}
+
 /*!
   Sets up the input stream for reading from a memory buffer. Closes all
   open files in the file stack first.
@@ -2347,11 +2561,7 @@ SoInput::convertDouble(char * from, double * d)
 void
 SoInput::convertShortArray(char * from, short * to, int len)
 {
-  for (int i=0; i < len; i++) {
-    this->convertShort(from, to);
-    from += sizeof(short);
-    to++;
-  }
+  soinput_ntoh_16bit_array(from, reinterpret_cast<char *>(to), len);
 }
 
 /*!
@@ -2362,11 +2572,7 @@ SoInput::convertShortArray(char * from, short * to, int len)
 void
 SoInput::convertInt32Array(char * from, int32_t * to, int len)
 {
-  for (int i=0; i < len; i++) {
-    this->convertInt32(from, to);
-    from += sizeof(int32_t);
-    to++;
-  }
+  soinput_ntoh_32bit_array(from, reinterpret_cast<char *>(to), len);
 }
 
 /*!
@@ -2378,11 +2584,7 @@ SoInput::convertInt32Array(char * from, int32_t * to, int len)
 void
 SoInput::convertFloatArray(char * from, float * to, int len)
 {
-  for (int i=0; i < len; i++) {
-    this->convertFloat(from, to);
-    from += sizeof(float);
-    to++;
-  }
+  soinput_ntoh_32bit_array(from, reinterpret_cast<char *>(to), len);
 }
 
 /*!
@@ -2394,11 +2596,7 @@ SoInput::convertFloatArray(char * from, float * to, int len)
 void
 SoInput::convertDoubleArray(char * from, double * to, int len)
 {
-  for (int i=0; i < len; i++) {
-    this->convertDouble(from, to);
-    from += sizeof(double);
-    to++;
-  }
+  soinput_ntoh_64bit_array(from, reinterpret_cast<char *>(to), len);
 }
 
 /*!
@@ -2616,3 +2814,422 @@ SoInput::findFile(const char * basename, SbString & fullname)
 #undef READ_UNSIGNED_INTEGER
 #undef READ_REAL
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SoInput.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/actions/SoWriteAction.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoFile.h>
+#include <Inventor/fields/SoMFFloat.h>
+#include <Inventor/fields/SoMFInt32.h>
+#include <Inventor/fields/SoMFVec3f.h>
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/lists/SoPathList.h>
+#include <Inventor/SoFullPath.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/C/tidbits.h>
+#include <Inventor/fields/SoMFNode.h>
+#include <Inventor/VRMLnodes/SoVRMLGroup.h>
+
+BOOST_AUTO_TEST_CASE(readMemoryMappedFile)
+{
+  // big enough to span several of the memory mapped reader's windows
+  const int numpoints = 600000;
+
+  FILE * fp = tmpfile();
+  BOOST_REQUIRE(fp != NULL);
+  fprintf(fp, "#Inventor V2.1 ascii\n\nSeparator { Coordinate3 { point [\n");
+  for (int i = 0; i < numpoints; i++) {
+    fprintf(fp, "%d 1 2,\n", i);
+  }
+  fprintf(fp, "] } }\n");
+  rewind(fp);
+
+  SoInput in;
+  in.setMemoryMapping(TRUE);
+  BOOST_CHECK(in.isMemoryMapping());
+  in.setFilePointer(fp);
+  SoSeparator * root = SoDB::readAll(&in);
+  BOOST_REQUIRE(root != NULL);
+  root->ref();
+
+  BOOST_REQUIRE(root->getNumChildren() == 1);
+  SoCoordinate3 * coords = (SoCoordinate3 *) root->getChild(0);
+  BOOST_REQUIRE(coords->isOfType(SoCoordinate3::getClassTypeId()));
+  BOOST_REQUIRE(coords->point.getNum() == numpoints);
+  BOOST_CHECK(coords->point[0] == SbVec3f(0.0f, 1.0f, 2.0f));
+  BOOST_CHECK(coords->point[numpoints-1] == SbVec3f(float(numpoints-1), 1.0f, 2.0f));
+
+  root->unref();
+  in.closeFile();
+  fclose(fp);
+}
+
+// Returns the temporary directory, without a trailing separator.
+static SbString
+soinput_temp_dirname(void)
+{
+  const char * dir = coin_getenv("TMPDIR");
+  if (dir == NULL) dir = coin_getenv("TEMP");
+  if (dir == NULL) dir = coin_getenv("TMP");
+  SbString dirname = dir ? dir : ".";
+  const int len = dirname.getLength();
+  if ((len > 1) && (dirname[len - 1] == '/' || dirname[len - 1] == '\\')) {
+    dirname = dirname.getSubString(0, len - 2);
+  }
+  return dirname;
+}
+
+// Writes the scene files used by the prefetch tests to the temporary
+// directory, under names which are unique for the test run, and
+// removes them again when going out of scope.
+class PrefetchTestFiles {
+public:
+  PrefetchTestFiles(void) {
+    this->basename.sprintf("soinput_prefetch_%lu_",
+                           (unsigned long) SbTime::getTimeOfDay().getMsecValue());
+    this->dirname = soinput_temp_dirname();
+
+    SbString contents[3];
+    contents[0].sprintf("#Inventor V2.1 ascii\n\n"
+                        "Separator {\n"
+                        "  # File { name \"%smissing.iv\" }\n"
+                        "  File { name \"%sa.iv\" }\n"
+                        "  DEF second File { name %sb.iv }\n"
+                        "}\n",
+                        this->basename.getString(), this->basename.getString(),
+                        this->basename.getString());
+    contents[1].sprintf("#Inventor V2.1 ascii\n\n"
+                        "Separator { Coordinate3 { point 1 2 3 } "
+                        "File { name \"%sb.iv\" } }\n",
+                        this->basename.getString());
+    contents[2] = "#Inventor V2.1 ascii\n\nCoordinate3 { point 4 5 6 }\n";
+
+    static const char * suffixes[] = { "main.iv", "a.iv", "b.iv" };
+    for (int i = 0; i < 3; i++) {
+      this->names[i] = this->dirname + "/" + this->basename + suffixes[i];
+      FILE * fp = fopen(this->names[i].getString(), "wb");
+      if (fp) {
+        fputs(contents[i].getString(), fp);
+        fclose(fp);
+      }
+    }
+  }
+  ~PrefetchTestFiles() {
+    for (int i = 0; i < 3; i++) (void) remove(this->names[i].getString());
+  }
+
+  SbString dirname, basename;
+  SbString names[3];
+};
+
+BOOST_AUTO_TEST_CASE(readPrefetchedFiles)
+{
+  PrefetchTestFiles files;
+
+  // with a limit of 16 bytes, none of the referenced files are kept
+  // by the prefetcher, and they are read the regular way instead
+  for (int limited = 0; limited < 2; limited++) {
+    if (limited) coin_setenv("COIN_SOINPUT_PREFETCH_MAXBYTES", "16", 1);
+
+    SoInput in;
+    in.setPrefetchThreads(2);
+    BOOST_CHECK_EQUAL(in.getPrefetchThreads(), 2);
+    BOOST_REQUIRE(in.openFile(files.names[0].getString()));
+    SoSeparator * root = SoDB::readAll(&in);
+    in.closeFile();
+    SoInput::removeDirectory(files.dirname.getString());
+    coin_unsetenv("COIN_SOINPUT_PREFETCH_MAXBYTES");
+    BOOST_REQUIRE(root != NULL);
+    root->ref();
+
+    const SbBool searchok = SoFile::getSearchOK();
+    SoFile::setSearchOK(TRUE);
+    SoSearchAction sa;
+    sa.setType(SoCoordinate3::getClassTypeId());
+    sa.setInterest(SoSearchAction::ALL);
+    sa.apply(root);
+    SoFile::setSearchOK(searchok);
+    const SoPathList & paths = sa.getPaths();
+    BOOST_CHECK_EQUAL(paths.getLength(), 3);
+    if (paths.getLength() == 3) {
+      // the coordinates are hidden children of the SoFile nodes
+      SoCoordinate3 * coords = (SoCoordinate3 *) ((SoFullPath *) paths[0])->getTail();
+      BOOST_CHECK(coords->point[0] == SbVec3f(1.0f, 2.0f, 3.0f));
+      coords = (SoCoordinate3 *) ((SoFullPath *) paths[2])->getTail();
+      BOOST_CHECK(coords->point[0] == SbVec3f(4.0f, 5.0f, 6.0f));
+    }
+    root->unref();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(readNumbersInBuffer)
+{
+  // Numbers which end at the end of the input are read character by
+  // character, while the ones inside a value list are parsed straight
+  // from the buffer. The results must be identical.
+  static const char * reals[] = {
+    "0", "-0.1", "+2.5E+3", "7.", ".5", "1e-5", "3.14159265358979",
+    "-3.4028234e38", "1.17549435e-38", "0.30000000000000004",
+    "123456789012345678901234567890", "6.02214076e23"
+  };
+  static const char * integers[] = {
+    "0", "-1", "+3", "010", "0x1F", "123456789", "-987654321",
+    "2147483647", "4294967295"
+  };
+  const int numreals = sizeof(reals) / sizeof(reals[0]);
+  const int numintegers = sizeof(integers) / sizeof(integers[0]);
+
+  SbString list("[");
+  for (int i = 0; i < numreals; i++) {
+    list += reals[i];
+    list += (i % 2) ? ",\n" : " , ";
+  }
+  list += "]";
+  SoMFFloat mffloat;
+  BOOST_REQUIRE(mffloat.set(list.getString()));
+  BOOST_REQUIRE_EQUAL(mffloat.getNum(), numreals);
+  for (int i = 0; i < numreals; i++) {
+    SoInput in;
+    in.setBuffer(reals[i], strlen(reals[i]));
+    float f;
+    BOOST_REQUIRE(in.read(f));
+    const float inlist = mffloat[i];
+    BOOST_CHECK_MESSAGE(memcmp(&f, &inlist, sizeof(float)) == 0,
+                        reals[i]);
+  }
+
+  list = "[";
+  for (int i = 0; i < numintegers; i++) {
+    list += integers[i];
+    list += " ";
+  }
+  list += "]";
+  SoMFInt32 mfint32;
+  BOOST_REQUIRE(mfint32.set(list.getString()));
+  BOOST_REQUIRE_EQUAL(mfint32.getNum(), numintegers);
+  for (int i = 0; i < numintegers; i++) {
+    SoInput in;
+    in.setBuffer(integers[i], strlen(integers[i]));
+    int value;
+    BOOST_REQUIRE(in.read(value));
+    BOOST_CHECK_MESSAGE(value == mfint32[i], integers[i]);
+  }
+
+  SoMFVec3f mfvec3f;
+  BOOST_REQUIRE(mfvec3f.set("[ 1 2 3, 4 5 6 # comment\n 7 8 9\n10 11 12 ]"));
+  BOOST_REQUIRE_EQUAL(mfvec3f.getNum(), 4);
+  BOOST_CHECK(mfvec3f[2] == SbVec3f(7.0f, 8.0f, 9.0f));
+  BOOST_CHECK(mfvec3f[3] == SbVec3f(10.0f, 11.0f, 12.0f));
+  BOOST_CHECK(!mfvec3f.set("[ 1 2 3, 4 5 }"));
+}
+
+struct SoInputReadCBData {
+  SbList<SoNode *> nodes;
+  SbList<SoGroup *> parents;
+  SbList<size_t> bytesread;
+};
+
+static void
+readcallback(void * userdata, SoInput * in, SoNode * node, SoGroup * parent)
+{
+  SoInputReadCBData * data = static_cast<SoInputReadCBData *>(userdata);
+  data->nodes.append(node);
+  data->parents.append(parent);
+  data->bytesread.append(in->getNumBytesRead());
+}
+
+BOOST_AUTO_TEST_CASE(readCallback)
+{
+  const char scene[] =
+    "#Inventor V2.1 ascii\n\n"
+    "Separator {\n"
+    "  Cube { }\n"
+    "  Separator { Sphere { } }\n"
+    "}\n"
+    "Cone { }\n";
+
+  SoInputReadCBData data;
+  SoInput in;
+  in.setBuffer(scene, strlen(scene));
+  in.setReadCallback(readcallback, &data);
+  SoSeparator * root = SoDB::readAll(&in);
+  BOOST_REQUIRE(root);
+  root->ref();
+
+  BOOST_REQUIRE_EQUAL(root->getNumChildren(), 2);
+  SoGroup * top = static_cast<SoGroup *>(root->getChild(0));
+  BOOST_REQUIRE_EQUAL(data.nodes.getLength(), 4);
+  BOOST_CHECK(data.nodes[0] == top->getChild(0));
+  BOOST_CHECK(data.parents[0] == top);
+  BOOST_CHECK(data.nodes[1] == top->getChild(1));
+  BOOST_CHECK(data.parents[1] == top);
+  BOOST_CHECK(data.nodes[2] == top);
+  BOOST_CHECK(data.parents[2] == NULL);
+  BOOST_CHECK(data.nodes[3] == root->getChild(1));
+  BOOST_CHECK(data.parents[3] == NULL);
+  for (int i = 1; i < data.bytesread.getLength(); i++) {
+    BOOST_CHECK(data.bytesread[i] > data.bytesread[i-1]);
+  }
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(readCallbackVRML)
+{
+  const char scene[] =
+    "#VRML V2.0 utf8\n\n"
+    "Collision {\n"
+    "  proxy Group { children [ Box { } ] }\n"
+    "  children [\n"
+    "    Shape { geometry Sphere { } }\n"
+    "    Group { children [ Shape { } ] }\n"
+    "  ]\n"
+    "}\n"
+    "Transform { }\n";
+
+  SoInputReadCBData data;
+  SoInput in;
+  in.setBuffer(scene, strlen(scene));
+  in.setReadCallback(readcallback, &data);
+  SoVRMLGroup * root = SoDB::readAllVRML(&in);
+  BOOST_REQUIRE(root);
+  root->ref();
+
+  BOOST_REQUIRE_EQUAL(root->getNumChildren(), 2);
+  SoGroup * top = static_cast<SoGroup *>(root->getChild(0));
+  SoMFNode * children = static_cast<SoMFNode *>(top->getField("children"));
+  BOOST_REQUIRE(children);
+  BOOST_REQUIRE_EQUAL(children->getNum(), 2);
+  BOOST_REQUIRE_EQUAL(data.nodes.getLength(), 4);
+  BOOST_CHECK(data.nodes[0] == (*children)[0]);
+  BOOST_CHECK(data.parents[0] == top);
+  BOOST_CHECK(data.nodes[1] == (*children)[1]);
+  BOOST_CHECK(data.parents[1] == top);
+  BOOST_CHECK(data.nodes[2] == top);
+  BOOST_CHECK(data.parents[2] == NULL);
+  BOOST_CHECK(data.nodes[3] == root->getChild(1));
+  BOOST_CHECK(data.parents[3] == NULL);
+
+  root->unref();
+}
+
+// A file in the temporary directory, with a name which is unique for
+// the test run. The file is removed when going out of scope.
+class TempTestFile {
+public:
+  TempTestFile(const char * suffix) {
+    this->name.sprintf("%s/soinput_%lu_%s", soinput_temp_dirname().getString(),
+                       (unsigned long) SbTime::getTimeOfDay().getMsecValue(),
+                       suffix);
+  }
+  ~TempTestFile() { (void) remove(this->name.getString()); }
+
+  SbString name;
+};
+
+BOOST_AUTO_TEST_CASE(readParallelCompressedFile)
+{
+  unsigned int nummethods = 0;
+  const SbName * methods = SoOutput::getAvailableCompressionMethods(nummethods);
+  SbBool havegzip = FALSE;
+  for (unsigned int i = 0; i < nummethods; i++) {
+    if (methods[i] == "GZIP") havegzip = TRUE;
+  }
+  if (!havegzip) return;
+
+  // big enough to be split in several blocks by the writer
+  const int numpoints = 200000;
+  TempTestFile file("compressed.iv.gz");
+  const char * filename = file.name.getString();
+
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->ref();
+  coords->point.setNum(numpoints);
+  SbVec3f * points = coords->point.startEditing();
+  for (int i = 0; i < numpoints; i++) {
+    points[i].setValue(float(i), 1.0f, 2.0f);
+  }
+  coords->point.finishEditing();
+
+  SoOutput out;
+  BOOST_REQUIRE(out.setCompression("GZIP", 0.5f));
+  out.setCompressionThreads(2);
+  BOOST_CHECK_EQUAL(out.getCompressionThreads(), 2);
+  BOOST_REQUIRE(out.openFile(filename));
+  SoWriteAction wa(&out);
+  wa.apply(coords);
+  out.closeFile();
+  coords->unref();
+
+  SoInput in;
+  BOOST_REQUIRE(in.openFile(filename));
+  SoSeparator * root = SoDB::readAll(&in);
+  BOOST_REQUIRE(root != NULL);
+  root->ref();
+  in.closeFile();
+
+  BOOST_REQUIRE(root->getNumChildren() == 1);
+  coords = (SoCoordinate3 *) root->getChild(0);
+  BOOST_REQUIRE(coords->isOfType(SoCoordinate3::getClassTypeId()));
+  BOOST_REQUIRE(coords->point.getNum() == numpoints);
+  BOOST_CHECK(coords->point[0] == SbVec3f(0.0f, 1.0f, 2.0f));
+  BOOST_CHECK(coords->point[numpoints-1] == SbVec3f(float(numpoints-1), 1.0f, 2.0f));
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(readBzip2File)
+{
+  unsigned int nummethods = 0;
+  const SbName * methods = SoOutput::getAvailableCompressionMethods(nummethods);
+  SbBool havebzip2 = FALSE;
+  for (unsigned int i = 0; i < nummethods; i++) {
+    if (methods[i] == "BZIP2") havebzip2 = TRUE;
+  }
+  if (!havebzip2) return;
+
+  // big enough to span several of the read-ahead blocks
+  const int numvalues = 400000;
+  TempTestFile file("compressed.iv.bz2");
+  const char * filename = file.name.getString();
+
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->ref();
+  coords->point.setNum(numvalues);
+  SbVec3f * points = coords->point.startEditing();
+  for (int i = 0; i < numvalues; i++) {
+    points[i].setValue(1.0f, float(i), 3.0f);
+  }
+  coords->point.finishEditing();
+
+  SoOutput out;
+  BOOST_REQUIRE(out.setCompression("BZIP2", 0.5f));
+  BOOST_REQUIRE(out.openFile(filename));
+  SoWriteAction wa(&out);
+  wa.apply(coords);
+  out.closeFile();
+  coords->unref();
+
+  SoInput in;
+  BOOST_REQUIRE(in.openFile(filename));
+  SoSeparator * root = SoDB::readAll(&in);
+  BOOST_REQUIRE(root != NULL);
+  root->ref();
+  in.closeFile();
+
+  BOOST_REQUIRE(root->getNumChildren() == 1);
+  coords = (SoCoordinate3 *) root->getChild(0);
+  BOOST_REQUIRE(coords->point.getNum() == numvalues);
+  BOOST_CHECK(coords->point[numvalues/2] == SbVec3f(1.0f, float(numvalues/2), 3.0f));
+  BOOST_CHECK(coords->point[numvalues-1] == SbVec3f(1.0f, float(numvalues-1), 3.0f));
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
@@ -35,10 +35,21 @@
 #include "config.h"
 #endif // HAVE_CONFIG_H
 
+#include <cassert>
+#include <cstdlib>
+
 #include <Inventor/SoInput.h>
+#include <Inventor/errors/SoReadError.h>
+#include <Inventor/misc/SoBase.h>
 
 #include "io/SoInputP.h"
 #include "io/SoInput_FileInfo.h"
+#include "io/SoInput_Prefetcher.h"
+
+// *************************************************************************
+
+const char SoInputP::INDEX_KEYWORD[] = "INDEX";
+const uint32_t SoInputP::INDEX_MAGIC = 0x49445831; // "IDX1"
 
 // *************************************************************************
 
@@ -64,6 +75,197 @@ SoInputP::debugBinary(void)
   return debug ? TRUE : FALSE;
 }
 
+int
+SoInputP::defaultPrefetchThreads(void)
+{
+  static int threads = -1;
+  if (threads == -1) {
+    const char * env = coin_getenv("COIN_SOINPUT_PREFETCH_THREADS");
+    threads = env ? atoi(env) : 0;
+    if (threads < 0) { threads = 0; }
+  }
+  return threads;
+}
+
+// The most data, in bytes, the prefetcher keeps loaded before it is
+// needed. Read each time a file is opened.
+size_t
+SoInputP::prefetchMaxBytes(void)
+{
+  const char * env = coin_getenv("COIN_SOINPUT_PREFETCH_MAXBYTES");
+  const long maxbytes = env ? atol(env) : -1;
+  return (maxbytes >= 0) ? size_t(maxbytes) :
+    size_t(SoInput_Prefetcher::DEFAULT_MAXBYTES);
+}
+
+// SoBase::read() counts how many nodes are being read at the moment,
+// so that the callback set with SoInput::setReadCallback() is only
+// invoked for nodes at the top level, and for the children of group
+// nodes at the top level. The children are reported by
+// SoGroup::readChildren(), and by SoMFNode for VRML97 groups, which
+// keep their children in a field. Nodes in SoSFNode fields are never
+// reported.
+void
+SoInputP::beginReadAll(SoInput * in)
+{
+  in->pimpl->readallnesting++;
+}
+
+void
+SoInputP::endReadAll(SoInput * in)
+{
+  assert(in->pimpl->readallnesting > 0);
+  in->pimpl->readallnesting--;
+}
+
+void
+SoInputP::pushReadDepth(SoInput * in)
+{
+  in->pimpl->readdepth++;
+}
+
+void
+SoInputP::popReadDepth(SoInput * in)
+{
+  assert(in->pimpl->readdepth > 0);
+  in->pimpl->readdepth--;
+}
+
+void
+SoInputP::nodeRead(SoInput * in, SoNode * node, SoGroup * parent)
+{
+  SoInputP * thisp = in->pimpl;
+  if (thisp->readcb && (thisp->readallnesting > 0) &&
+      (thisp->readdepth <= 1)) {
+    thisp->readcb(thisp->readcbdata, in, node,
+                  (thisp->readdepth == 0) ? NULL : parent);
+  }
+}
+
+// Reads the table of contents at the end of an indexed binary file,
+// after the INDEX keyword. See SoOutput::writeIndex() for the format.
+SbBool
+SoInputP::readIndex(SoInput * in)
+{
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  fi->clearIndex();
+
+  int num;
+  unsigned int hi, lo, magic;
+  SbBool ok = in->read(num) && (num >= 0);
+  for (int i = 0; ok && (i < num); i++) {
+    SbString name;
+    ok = in->read(name) && in->read(hi) && in->read(lo);
+    if (ok) { fi->addIndexEntry(SbName(name), (size_t) ((((uint64_t) hi) << 32) | lo)); }
+  }
+  ok = ok && in->read(hi) && in->read(lo) && in->read(magic) &&
+    (magic == SoInputP::INDEX_MAGIC);
+
+  if (!ok) {
+    SoReadError::post(in, "Invalid %s record", SoInputP::INDEX_KEYWORD);
+    fi->clearIndex();
+    return FALSE;
+  }
+  fi->setIndexRead();
+  return TRUE;
+}
+
+// Reads the table of contents of an indexed binary file, found
+// through the last 12 bytes of the file, unless it has been read
+// already. Returns FALSE if the file isn't indexed or doesn't support
+// random access. The read position is left unchanged.
+SbBool
+SoInputP::loadIndex(SoInput * in)
+{
+  if (!in->checkHeader()) return FALSE;
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  if (fi->hasIndex()) return TRUE;
+  if (!fi->isBinary()) return FALSE;
+
+  const size_t pos = fi->getNumBytesParsedSoFar();
+  const size_t size = fi->getSize();
+  unsigned int hi, lo, magic;
+  SbBool ok = (size >= 12) && fi->seek(size - 12) &&
+    in->read(hi) && in->read(lo) && in->read(magic) &&
+    (magic == SoInputP::INDEX_MAGIC);
+
+  SbName keyword;
+  ok = ok && fi->seek((size_t) ((((uint64_t) hi) << 32) | lo)) &&
+    in->read(keyword, TRUE) && (keyword == SoInputP::INDEX_KEYWORD) &&
+    SoInputP::readIndex(in);
+
+  return fi->seek(pos) && ok;
+}
+
+// Reads the instance DEF'd as name from an indexed binary file, by
+// seeking to it. If before is non-zero, the last instance with that
+// name before that offset is read, as needed to resolve a USE.
+// Otherwise the first instance with that name is read. The read
+// position is left unchanged.
+SbBool
+SoInputP::readIndexedBase(SoInput * in, const SbName & name,
+                          const size_t before, SoBase *& base)
+{
+  base = NULL;
+  if (!SoInputP::loadIndex(in)) return FALSE;
+
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  size_t offset;
+  if (!fi->findIndexEntry(name, before, offset)) return FALSE;
+
+  const size_t pos = fi->getNumBytesParsedSoFar();
+  SbBool ok = fi->seek(offset) &&
+    SoBase::read(in, base, SoBase::getClassTypeId()) && (base != NULL);
+  return fi->seek(pos) && ok;
+}
+
+SbBool
+SoInputP::hasIndex(SoInput * in)
+{
+  return in->getTopOfStack()->hasIndex();
+}
+
+// Used by SoBase::read() to avoid reading an instance from an indexed
+// binary file twice, when it has been read out of order. On success,
+// the read position is moved past the instance.
+SbBool
+SoInputP::findIndexedInstance(SoInput * in, const size_t pos, SoBase *& base)
+{
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  size_t end;
+  if (!fi->findInstance(pos, base, end)) return FALSE;
+  return fi->seek(end);
+}
+
+void
+SoInputP::addIndexedInstance(SoInput * in, const size_t pos, SoBase * base)
+{
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  fi->addInstance(pos, base, fi->getNumBytesParsedSoFar());
+}
+
+// Batched reading of ASCII value lists for SoMField::readValue(), see
+// SoInput_FileInfo::readRealArray().
+int
+SoInputP::readRealArray(SoInput * in, float * values, const int numitems,
+                        const int itemsize, SbBool & endoflist)
+{
+  endoflist = FALSE;
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  if ((fi == NULL) || fi->isBinary()) return 0;
+  return fi->readRealArray(values, numitems, itemsize, endoflist);
+}
+
+int
+SoInputP::readIntegerArray(SoInput * in, int32_t * values,
+                           const int numitems, SbBool & endoflist)
+{
+  endoflist = FALSE;
+  SoInput_FileInfo * fi = in->getTopOfStack();
+  if ((fi == NULL) || fi->isBinary()) return 0;
+  return fi->readIntegerArray(values, numitems, endoflist);
+}
+
 // *************************************************************************
 /*
   Important note: Up until Coin 3.1.1 we used to have a bug in SoInput
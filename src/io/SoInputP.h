@@ -39,10 +39,14 @@
 
 // *************************************************************************
 
+#include <Inventor/SoInput.h>
 #include "misc/SbHash.h"
 
-class SoInput;
+class SoBase;
+class SoGroup;
 class SoInput_FileInfo;
+class SoInput_Prefetcher;
+class SoNode;
 
 // *************************************************************************
 
@@ -51,10 +55,45 @@ public:
   SoInputP(SoInput * owner) {
     this->owner = owner;
     this->usingstdin = FALSE;
+    this->memorymapping = FALSE;
+    this->prefetchthreads = SoInputP::defaultPrefetchThreads();
+    this->prefetcher = NULL;
+    this->readcb = NULL;
+    this->readcbdata = NULL;
+    this->readdepth = 0;
+    this->readallnesting = 0;
   }
 
   static SbBool debug(void);
   static SbBool debugBinary(void);
+  static int defaultPrefetchThreads(void);
+  static size_t prefetchMaxBytes(void);
+
+  static int readRealArray(SoInput * in, float * values, const int numitems,
+                           const int itemsize, SbBool & endoflist);
+  static int readIntegerArray(SoInput * in, int32_t * values,
+                              const int numitems, SbBool & endoflist);
+
+  static void beginReadAll(SoInput * in);
+  static void endReadAll(SoInput * in);
+  static void pushReadDepth(SoInput * in);
+  static void popReadDepth(SoInput * in);
+  static void nodeRead(SoInput * in, SoNode * node, SoGroup * parent);
+
+  // table of contents at the end of indexed binary files, see
+  // SoOutput::setIndexed()
+  static const char INDEX_KEYWORD[];
+  static const uint32_t INDEX_MAGIC;
+
+  static SbBool readIndex(SoInput * in);
+  static SbBool loadIndex(SoInput * in);
+  static SbBool readIndexedBase(SoInput * in, const SbName & name,
+                                const size_t before, SoBase *& base);
+  static SbBool hasIndex(SoInput * in);
+  static SbBool findIndexedInstance(SoInput * in, const size_t pos,
+                                    SoBase *& base);
+  static void addIndexedInstance(SoInput * in, const size_t pos,
+                                 SoBase * base);
 
   SoInput_FileInfo * getTopOfStackPopOnEOF(void);
 
@@ -66,6 +105,15 @@ public:
   static SbBool isNameCharVRML2(unsigned char c, SbBool validIdent);
 
   SbBool usingstdin;
+  SbBool memorymapping;
+  int prefetchthreads;
+  SoInput_Prefetcher * prefetcher;
+
+  // see SoInput::setReadCallback()
+  SoInputReadCB * readcb;
+  void * readcbdata;
+  int readdepth;
+  int readallnesting;
 
   SbHash<const char *, SoBase *> copied_references;
 
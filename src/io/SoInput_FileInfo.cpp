@@ -70,10 +70,11 @@ SoInput_FileInfo::SoInput_FileInfo(SoInput_Reader * readerptr,
   this->threadreadidx = 0;
   this->threadbufidx = 0;
   this->threadeof = FALSE;
-  this->readbuf = NULL;
+  this->readbufstorage = NULL;
 #else // HAVE_THREADS && SOINPUT_ASYNC_IO
-  this->readbuf = new char[READBUFSIZE];
+  this->readbufstorage = new char[READBUFSIZE];
 #endif // !(HAVE_THREADS && SOINPUT_ASYNC_IO)
+  this->readbuf = this->readbufstorage;
   this->readbuflen = 0;
   this->readbufidx = 0;
 
@@ -92,9 +93,10 @@ SoInput_FileInfo::SoInput_FileInfo(SoInput_Reader * readerptr,
   this->postfunc = NULL;
   this->stdinname = "<stdin>";
   this->deletebuffer = NULL;
+  this->indexread = FALSE;
 
 #if defined(HAVE_THREADS) && defined(SOINPUT_ASYNC_IO)
-  if (this->reader) {
+  if (this->reader && !this->reader->canReadInPlace()) {
     // schedule two buffer reads
     cc_sched_schedule(this->sched, sched_cb, this, 0);
   }
@@ -110,7 +112,7 @@ SoInput_FileInfo::~SoInput_FileInfo()
   delete[] this->threadbuf[0];
   delete[] this->threadbuf[1];
 #else // HAVE_THREADS && SOINPUT_ASYNC_IO
-  delete[] this->readbuf;
+  delete[] this->readbufstorage;
 #endif // !(HAVE_THREADS && SOINPUT_ASYNC_IO)
   delete this->reader;
   // to be safe, delete this after deleting the reader
@@ -150,6 +152,28 @@ SoInput_FileInfo::doBufferRead(void)
   assert(this->backbuffer.getLength() == 0);
   assert(this->readbufidx == this->readbuflen);
 
+  // Readers keeping their data in memory (memory buffers and memory
+  // mapped files) hand out their data directly, so we don't need to
+  // copy it into our own buffer.
+  SoInput_Reader * r = this->getReader();
+  if (r->canReadInPlace()) {
+    const char * ptr = NULL;
+    const size_t len = r->readInPlace(ptr);
+    if (len == 0) {
+      this->readbufidx = 0;
+      this->readbuflen = 0;
+      this->eof = TRUE;
+    }
+    else {
+      this->totalread += this->readbufidx;
+      this->readbufidx = 0;
+      this->readbuflen = len;
+      // never written to, see putBack()
+      this->readbuf = const_cast<char *>(ptr);
+    }
+    return;
+  }
+
 #if defined(HAVE_THREADS) && defined(SOINPUT_ASYNC_IO)
   cc_mutex_lock(this->mutex);
   int idx = this->threadbufidx;
@@ -181,7 +205,8 @@ SoInput_FileInfo::doBufferRead(void)
 
 #else // HAVE_THREADS && SOINPUT_ASYNC_IO
 
-  size_t len = this->getReader()->readBuffer(this->readbuf, READBUFSIZE);
+  size_t len = r->readBuffer(this->readbufstorage, READBUFSIZE);
+  this->readbuf = this->readbufstorage;
   if (len == 0) {
     this->readbufidx = 0;
     this->readbuflen = 0;
@@ -215,10 +240,12 @@ SoInput_FileInfo::getChunkOfBytes(unsigned char * ptr, size_t length)
 
   do {
     // Grab bytes from the buffer.
-    while ((this->readbufidx < this->readbuflen) && (length > 0)) {
-      *ptr++ = this->readbuf[this->readbufidx++];
-      --length;
-    }
+    size_t n = this->readbuflen - this->readbufidx;
+    if (n > length) n = length;
+    memcpy(ptr, this->readbuf + this->readbufidx, n);
+    this->readbufidx += n;
+    ptr += n;
+    length -= n;
 
     // Fetch more bytes if necessary. doBufferRead() sets the eof-flag
     // as a side-effect.
@@ -250,6 +277,86 @@ SoInput_FileInfo::findReference(const SbName & name) const
   return NULL;
 }
 
+// Moves the read position to pos bytes from the start of the file,
+// or returns FALSE if the reader doesn't support random access.
+SbBool
+SoInput_FileInfo::seek(const size_t pos)
+{
+  // stdin can't be seeked in
+  if (this->reader == NULL) return FALSE;
+
+  // no need to go through the reader if pos is within the buffer
+  if ((this->backbuffer.getLength() == 0) && (pos >= this->totalread) &&
+      (pos < this->totalread + this->readbuflen)) {
+    this->readbufidx = pos - this->totalread;
+  }
+  else {
+#if defined(HAVE_THREADS) && defined(SOINPUT_ASYNC_IO)
+    // the reader is busy filling the next buffer
+    if (!this->reader->canReadInPlace()) return FALSE;
+#endif // HAVE_THREADS && SOINPUT_ASYNC_IO
+    if (!this->reader->seek(pos)) return FALSE;
+    this->backbuffer.truncate(0);
+    this->readbuf = this->readbufstorage;
+    this->readbufidx = 0;
+    this->readbuflen = 0;
+    this->totalread = pos;
+  }
+  this->lastputback = -1;
+  this->lastchar = -1;
+  this->eof = FALSE;
+  return TRUE;
+}
+
+// Returns the size of the file, or 0 if the reader doesn't support
+// random access.
+size_t
+SoInput_FileInfo::getSize(void)
+{
+  if (this->reader == NULL) return 0;
+  return this->reader->getSize();
+}
+
+void
+SoInput_FileInfo::clearIndex(void)
+{
+  this->indexread = FALSE;
+  this->indexoffsets.truncate(0);
+  this->indexprev.truncate(0);
+  this->indexnames.clear();
+}
+
+void
+SoInput_FileInfo::addIndexEntry(const SbName & name, const size_t offset)
+{
+  int prev;
+  if (!this->indexnames.get(name.getString(), prev)) prev = -1;
+  this->indexnames.put(name.getString(), this->indexoffsets.getLength());
+  this->indexoffsets.append(offset);
+  this->indexprev.append(prev);
+}
+
+// Finds the offset of the last instance DEF'd with name before
+// offset before, or the first one if before is 0.
+SbBool
+SoInput_FileInfo::findIndexEntry(const SbName & name, const size_t before,
+                                 size_t & offset) const
+{
+  int idx;
+  if (!this->indexnames.get(name.getString(), idx)) return FALSE;
+  if (before == 0) {
+    while (this->indexprev[idx] >= 0) idx = this->indexprev[idx];
+  }
+  else {
+    while ((idx >= 0) && (this->indexoffsets[idx] >= before)) {
+      idx = this->indexprev[idx];
+    }
+    if (idx < 0) return FALSE;
+  }
+  offset = this->indexoffsets[idx];
+  return TRUE;
+}
+
 SbBool
 SoInput_FileInfo::get(char & c)
 {
@@ -490,6 +597,155 @@ SoInput_FileInfo::getReader(void)
   return this->reader;
 }
 
+// *************************************************************************
+
+// The functions below parse numbers straight from the read buffer, for
+// the common case where the whole number is available there. They give
+// exactly the same results as the character by character code in
+// readReal(), readInteger() and readUnsignedInteger(), and return NULL
+// if the number may continue past the end of the buffer, or is in a
+// form they do not handle, in which case the caller falls back to that
+// code. Note that isdigit() is not used, to stay independent of the
+// current locale.
+
+static inline SbBool
+soinput_fileinfo_isdigit(const char c)
+{
+  return (c >= '0') && (c <= '9');
+}
+
+// Returns a pointer past the digits starting at p, or NULL if they
+// run up to end.
+static inline const char *
+soinput_fileinfo_skip_digits(const char * p, const char * const end)
+{
+  while ((p < end) && soinput_fileinfo_isdigit(*p)) p++;
+  return (p < end) ? p : NULL;
+}
+
+// Accumulates the digits the same way as readReal(), which starts
+// with the least significant digit, so results are bit-identical.
+static inline double
+soinput_fileinfo_digits_value(const char * const digits, const int n)
+{
+  double number = 0.0;
+  double mul = 1.0;
+  for (int i = n - 1; i >= 0; i--) {
+    number += (digits[i] - '0') * mul;
+    mul *= 10.0;
+  }
+  return number;
+}
+
+static const char *
+soinput_fileinfo_parse_real(const char * p, const char * const end,
+                            double & d)
+{
+  if (p >= end) return NULL;
+
+  SbBool minus = FALSE;
+  if (*p == '-') { minus = TRUE; p++; }
+  else if (*p == '+') { p++; }
+
+  SbBool gotnum = FALSE;
+  double number = 0.0;
+
+  const char * digits = p;
+  if ((p = soinput_fileinfo_skip_digits(p, end)) == NULL) return NULL;
+  if (p > digits) {
+    gotnum = TRUE;
+    number = soinput_fileinfo_digits_value(digits, (int)(p - digits));
+  }
+
+  if (*p == '.') {
+    digits = ++p;
+    if ((p = soinput_fileinfo_skip_digits(p, end)) == NULL) return NULL;
+    if (p > digits) {
+      gotnum = TRUE;
+      double mul = 0.1;
+      for (const char * q = digits; q < p; q++) {
+        number += (*q - '0') * mul;
+        mul *= 0.1;
+      }
+    }
+  }
+
+  if (!gotnum) return NULL;
+
+  if (minus) number = -number;
+
+  if ((*p == 'e') || (*p == 'E')) {
+    if (++p >= end) return NULL;
+
+    SbBool expminus = FALSE;
+    if (*p == '-') { expminus = TRUE; p++; }
+    else if (*p == '+') { p++; }
+
+    digits = p;
+    if ((p = soinput_fileinfo_skip_digits(p, end)) == NULL) return NULL;
+    if (p == digits) return NULL;
+
+    double exponent = soinput_fileinfo_digits_value(digits, (int)(p - digits));
+    if (expminus) exponent = -exponent;
+
+    number *= pow(10.0, exponent);
+  }
+
+  d = number;
+  return p;
+}
+
+// Only handles plain decimal numbers of up to 9 digits, which can not
+// overflow, so the result is the same as from strtol() and strtoul().
+// Hexadecimal and octal numbers are left to the regular code.
+static const char *
+soinput_fileinfo_parse_integer(const char * p, const char * const end,
+                               const SbBool allowsign, int32_t & l)
+{
+  if (p >= end) return NULL;
+
+  SbBool minus = FALSE;
+  if (allowsign) {
+    if (*p == '-') { minus = TRUE; p++; }
+    else if (*p == '+') { p++; }
+  }
+
+  const char * digits = p;
+  if ((p = soinput_fileinfo_skip_digits(p, end)) == NULL) return NULL;
+  const int n = (int)(p - digits);
+  if ((n == 0) || (n > 9)) return NULL;
+  if ((digits[0] == '0') && ((n > 1) || (*p == 'x'))) return NULL;
+
+  int32_t value = 0;
+  for (int i = 0; i < n; i++) {
+    value = value * 10 + (digits[i] - '0');
+  }
+  l = minus ? -value : value;
+  return p;
+}
+
+// Parses a single value for readNumberArray(), with the same checks
+// as SoInput::read(float &) and SoInput::read(int &).
+static inline const char *
+soinput_fileinfo_parse_value(const char * p, const char * const end,
+                             float & f)
+{
+  double d;
+  if ((p = soinput_fileinfo_parse_real(p, end, d)) == NULL) return NULL;
+  f = (float) d;
+  // leave it to SoInput::read() to report non-valid numbers
+  return coin_finite((double) f) ? p : NULL;
+}
+
+static inline const char *
+soinput_fileinfo_parse_value(const char * p, const char * const end,
+                             int32_t & l)
+{
+  return soinput_fileinfo_parse_integer(p, end, TRUE, l);
+}
+
+// *************************************************************************
+
 SbBool
 SoInput_FileInfo::readUnsignedIntegerString(char * str)
 {
@@ -519,6 +775,19 @@ SbBool
 SoInput_FileInfo::readUnsignedInteger(uint32_t & l)
 {
   assert(!this->isBinary());
+  if (this->canReadInBuffer()) {
+    int32_t value;
+    const char * p =
+      soinput_fileinfo_parse_integer(this->readbuf + this->readbufidx,
+                                     this->readbuf + this->readbuflen,
+                                     FALSE, value);
+    if (p) {
+      this->setBufferPosition(p);
+      l = (uint32_t) value;
+      return TRUE;
+    }
+  }
+
   // FIXME: fixed size buffer for input of unknown
   // length. Ouch. 19990530 mortene.
   char str[512];
@@ -537,6 +806,17 @@ SbBool
 SoInput_FileInfo::readInteger(int32_t & l)
 {
   assert(!this->isBinary());
+  if (this->canReadInBuffer()) {
+    const char * p =
+      soinput_fileinfo_parse_integer(this->readbuf + this->readbufidx,
+                                     this->readbuf + this->readbuflen,
+                                     TRUE, l);
+    if (p) {
+      this->setBufferPosition(p);
+      return TRUE;
+    }
+  }
+
   // FIXME: fixed size buffer for input of unknown
   // length. Ouch. 19990530 mortene.
   char str[512];
@@ -594,6 +874,16 @@ SbBool
 SoInput_FileInfo::readReal(double & d)
 {
   assert(!this->isBinary());
+  if (this->canReadInBuffer()) {
+    const char * p =
+      soinput_fileinfo_parse_real(this->readbuf + this->readbufidx,
+                                  this->readbuf + this->readbuflen, d);
+    if (p) {
+      this->setBufferPosition(p);
+      return TRUE;
+    }
+  }
+
   const int BUFSIZE = 2048;
   SbBool minus = FALSE;
   SbBool gotNum = FALSE;
@@ -728,3 +1018,108 @@ SoInput_FileInfo::readHexDigits(char * str)
   const ptrdiff_t offset = s - str;
   return (int)offset;
 }
+
+// Skips whitespace in the read buffer, counting lines the same way as
+// get(). Returns NULL at the end of the buffer.
+const char *
+SoInput_FileInfo::skipBufferWhiteSpace(const char * p, const char * end,
+                                       unsigned int & linenr, int & lastchar)
+{
+  while ((p < end) && this->isSpace(*p)) {
+    const char c = *p++;
+    if ((c == '\r') || ((c == '\n') && (lastchar != '\r'))) linenr++;
+    lastchar = c;
+  }
+  return (p < end) ? p : NULL;
+}
+
+// Reads up to numitems items of itemsize numbers each from an ASCII
+// value list, straight from the read buffer. The input is consumed in
+// exactly the same way as by repeated calls to
+// SoMField::read1Value(), including the separators between items
+// handled by SoMField::readValue(). Stops in front of anything out of
+// the ordinary, like comments, the end of the buffer, or numbers which
+// do not parse, and returns the number of complete items read. The
+// caller should then continue with read1Value(). endoflist is set if
+// the closing bracket of the list was read.
+template <class Type>
+int
+SoInput_FileInfo::readNumberArray(Type * values, const int numitems,
+                                  const int itemsize, SbBool & endoflist)
+{
+  endoflist = FALSE;
+  if (!this->canReadInBuffer()) return 0;
+
+  // state after the last complete item
+  const char * const end = this->readbuf + this->readbuflen;
+  const char * p = this->readbuf + this->readbufidx;
+  unsigned int linenr = this->linenr;
+  int lastchar = this->lastchar;
+  int lastputback = this->lastputback;
+
+  int count = 0;
+  while (count < numitems) {
+    const char * q = p;
+    unsigned int ln = linenr;
+    int lc = lastchar;
+
+    Type * item = values + count * itemsize;
+    int i;
+    for (i = 0; i < itemsize; i++) {
+      q = this->skipBufferWhiteSpace(q, end, ln, lc);
+      if ((q == NULL) || (*q == '#')) break;
+      q = soinput_fileinfo_parse_value(q, end, item[i]);
+      if (q == NULL) break;
+      lc = -1;
+    }
+    if (i < itemsize) break;
+
+    q = this->skipBufferWhiteSpace(q, end, ln, lc);
+    if ((q == NULL) || (*q == '#')) break;
+    char c = *q++;
+    if (c == ',') {
+      lc = c;
+      q = this->skipBufferWhiteSpace(q, end, ln, lc);
+      if ((q == NULL) || (*q == '#')) break;
+      c = *q++;
+    }
+    // premature end of the list is reported by SoMField::readValue()
+    if (c == '}') break;
+
+    count++;
+    p = q;
+    linenr = ln;
+    if (c == ']') {
+      lastchar = c;
+      lastputback = -1;
+      endoflist = TRUE;
+      break;
+    }
+    // put back the first character of the next item
+    p--;
+    lastchar = -1;
+    lastputback = (int)c;
+  }
+
+  this->readbufidx = p - this->readbuf;
+  this->linenr = linenr;
+  this->lastchar = lastchar;
+  this->lastputback = lastputback;
+  return count;
+}
+
+int
+SoInput_FileInfo::readRealArray(float * values, const int numitems,
+                                const int itemsize, SbBool & endoflist)
+{
+  assert(!this->isBinary());
+  return this->readNumberArray(values, numitems, itemsize, endoflist);
+}
+
+int
+SoInput_FileInfo::readIntegerArray(int32_t * values, const int numitems,
+                                   SbBool & endoflist)
+{
+  assert(!this->isBinary());
+  return this->readNumberArray(values, numitems, 1, endoflist);
+}
@@ -210,15 +210,66 @@ public:
   SbBool readInteger(int32_t & l);
   SbBool readReal(double & d);
 
+  int readRealArray(float * values, const int numitems, const int itemsize,
+                    SbBool & endoflist);
+  int readIntegerArray(int32_t * values, const int numitems,
+                       SbBool & endoflist);
+
   const SbHash<const char *, SoBase *> & getReferences() const {
     return this->references;
   }
+
+  // random access, only possible for some of the readers
+  SbBool seek(const size_t pos);
+  size_t getSize(void);
+
+  // table of contents for indexed binary files, see SoInputP::readIndex()
+  SbBool hasIndex(void) const {
+    return this->indexread;
+  }
+  void setIndexRead(void) {
+    this->indexread = TRUE;
+  }
+  void clearIndex(void);
+  void addIndexEntry(const SbName & name, const size_t offset);
+  SbBool findIndexEntry(const SbName & name, const size_t before,
+                        size_t & offset) const;
+  void addInstance(const size_t pos, SoBase * base, const size_t end) {
+    const IndexedInstance instance = { base, end };
+    this->instances.put(pos, instance);
+  }
+  SbBool findInstance(const size_t pos, SoBase *& base, size_t & end) const {
+    IndexedInstance instance;
+    if (!this->instances.get(pos, instance)) return FALSE;
+    base = instance.base;
+    end = instance.end;
+    return TRUE;
+  }
+
 private:
 
   SoInput_Reader * getReader(void);
   SoInput_Reader * reader;
   SbBool readHeaderInternal(SoInput * input);
 
+  // numbers are parsed straight from the read buffer when they can
+  // be, see readReal() and readNumberArray()
+  SbBool canReadInBuffer(void) const {
+    return (this->readbufidx < this->readbuflen) &&
+      ((this->readbufidx > 0) || (this->backbuffer.getLength() == 0));
+  }
+  void setBufferPosition(const char * p) {
+    // same state as when the character at p has been read and put back
+    this->readbufidx = p - this->readbuf;
+    this->lastchar = -1;
+    this->lastputback = (int)*p;
+  }
+  const char * skipBufferWhiteSpace(const char * p, const char * end,
+                                    unsigned int & linenr, int & lastchar);
+  template <class Type>
+  int readNumberArray(Type * values, const int numitems, const int itemsize,
+                      SbBool & endoflist);
+
   unsigned int linenr;
 
   // Data about the file's header.
@@ -228,7 +279,10 @@ private:
   void * userdata;
   SbBool isbinary;
 
+  // readbuf points either into readbufstorage, or straight at the
+  // reader's own data for readers which can read in place.
   char * readbuf;
+  char * readbufstorage;
   size_t readbufidx;
   size_t readbuflen;
   size_t totalread;
@@ -247,6 +301,20 @@ private:
   char * deletebuffer;
   SbHash<const char *, SoBase *> references;
 
+  // offsets of all DEF'd instances, in file order. The hash maps a
+  // name to its last entry, and indexprev chains entries with the
+  // same name.
+  SbBool indexread;
+  SbList<size_t> indexoffsets;
+  SbList<int> indexprev;
+  SbHash<const char *, int> indexnames;
+  // instances read from an indexed file, by offset
+  struct IndexedInstance {
+    SoBase * base;
+    size_t end;
+  };
+  SbHash<size_t, IndexedInstance> instances;
+
 #if defined(HAVE_THREADS) && defined(SOINPUT_ASYNC_IO)
   static void sched_cb(void * closure);
   cc_mutex * mutex;
@@ -0,0 +1,380 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+
+#include "io/SoInput_Prefetcher.h"
+
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <sys/stat.h>
+
+// This (POSIX-compliant) macro is missing from the Win32 API header
+// files for MSVC++ 6.0.
+#ifndef S_ISDIR
+ // The _S_IFDIR bitpattern is not in the POSIX standard, but MSVC++
+ // header files have it.
+ #ifdef _S_IFDIR
+ #define S_ISDIR(s) ((s) & _S_IFDIR)
+ #else // Ai.
+ #error Can neither find nor make an S_ISDIR macro to test stat structures.
+ #endif // !_S_IFDIR
+#endif // !S_ISDIR
+
+#include <Inventor/SoInput.h>
+#include <Inventor/lists/SbStringList.h>
+#include <Inventor/C/threads/condvar.h>
+#include <Inventor/C/threads/mutex.h>
+#include <Inventor/C/threads/sched.h>
+
+#include "io/SoInput_Reader.h"
+
+// *************************************************************************
+
+// Size of the first chunk allocated when loading a file. The buffer
+// is doubled until the whole file fits.
+static const size_t PREFETCH_INITIAL_BUFFERSIZE = 64 * 1024;
+
+// *************************************************************************
+
+SoInput_Prefetcher::SoInput_Prefetcher(const int numthreads,
+                                       const size_t maxbytes)
+{
+  assert(numthreads > 0);
+  this->maxbytes = maxbytes;
+  this->bytesheld = 0;
+  this->sched = cc_sched_construct(numthreads);
+  this->mutex = cc_mutex_construct();
+  this->condvar = cc_condvar_construct();
+  this->cancelled = FALSE;
+}
+
+SoInput_Prefetcher::~SoInput_Prefetcher()
+{
+  cc_mutex_lock(this->mutex);
+  this->cancelled = TRUE;
+  cc_mutex_unlock(this->mutex);
+
+  // jobs which have not been started are dropped, while the ones
+  // being run will notice the cancelled flag and not schedule
+  // anything new.
+  cc_sched_destruct(this->sched);
+
+  for (int i = 0; i < this->entries.getLength(); i++) {
+    free(this->entries[i]->buffer);
+    delete this->entries[i];
+  }
+  cc_condvar_destruct(this->condvar);
+  cc_mutex_destruct(this->mutex);
+}
+
+// Starts scanning the file fullname for references to other files,
+// which will be loaded in the background. The file itself is not
+// kept, since it has already been opened by the SoInput.
+void
+SoInput_Prefetcher::scanFile(const SbString & fullname,
+                             const SbStringList & searchdirs)
+{
+  SbList<SbString> dirs;
+  for (int i = 0; i < searchdirs.getLength(); i++) {
+    dirs.append(*searchdirs[i]);
+  }
+  cc_mutex_lock(this->mutex);
+  this->schedule(fullname, dirs, FALSE);
+  cc_mutex_unlock(this->mutex);
+}
+
+// Returns a reader for the prefetched contents of fullname, or NULL
+// if the file was not prefetched or could not be loaded, in which
+// case the caller should read the file the regular way. If the file
+// is being loaded, waits for it to finish. If it has not been
+// started yet, it is loaded on the calling thread instead.
+//
+// The data for a file can only be taken once.
+SoInput_Reader *
+SoInput_Prefetcher::takeReader(const SbString & fullname)
+{
+  Entry * entry = NULL;
+  cc_mutex_lock(this->mutex);
+  if (!this->files.get(fullname, entry) || (entry->state == TAKEN)) {
+    cc_mutex_unlock(this->mutex);
+    return NULL;
+  }
+  if ((entry->state == QUEUED) &&
+      cc_sched_unschedule(this->sched, entry->schedid)) {
+    cc_mutex_unlock(this->mutex);
+    this->load(entry, TRUE);
+    cc_mutex_lock(this->mutex);
+  }
+  while (entry->state != DONE) {
+    cc_condvar_wait(this->condvar, this->mutex);
+  }
+  entry->state = TAKEN;
+  char * buffer = entry->buffer;
+  const size_t buffersize = entry->buffersize;
+  entry->buffer = NULL;
+  this->bytesheld -= buffersize;
+  cc_mutex_unlock(this->mutex);
+
+  if (buffer == NULL) return NULL;
+  return new SoInput_PrefetchedFileReader(fullname.getString(),
+                                          buffer, buffersize);
+}
+
+// Schedules fullname for loading unless it has been seen before.
+// Assumes the mutex is locked.
+void
+SoInput_Prefetcher::schedule(const SbString & fullname,
+                             const SbList<SbString> & searchdirs,
+                             const SbBool keepdata)
+{
+  Entry * entry = NULL;
+  if (this->cancelled || this->files.get(fullname, entry)) return;
+
+  entry = new Entry;
+  entry->owner = this;
+  entry->fullname = fullname;
+  entry->searchdirs = searchdirs;
+  entry->state = QUEUED;
+  entry->keepdata = keepdata;
+  entry->buffer = NULL;
+  entry->buffersize = 0;
+  this->files.put(fullname, entry);
+  this->entries.append(entry);
+
+  // the job can not start before we release the mutex, so schedid is
+  // set before anybody looks at it
+  entry->schedid = cc_sched_schedule(this->sched,
+                                     SoInput_Prefetcher::load_cb, entry, 0.0f);
+}
+
+void
+SoInput_Prefetcher::load_cb(void * closure)
+{
+  Entry * entry = (Entry *) closure;
+  entry->owner->load(entry, FALSE);
+}
+
+// Loads the file for entry, and schedules the files it references.
+// The data is kept within the byte limit, or regardless of the limit
+// if the file is loaded because it is being taken.
+void
+SoInput_Prefetcher::load(Entry * entry, const SbBool taking)
+{
+  cc_mutex_lock(this->mutex);
+  if (this->cancelled || (entry->state != QUEUED)) {
+    cc_mutex_unlock(this->mutex);
+    return;
+  }
+  entry->state = LOADING;
+  cc_mutex_unlock(this->mutex);
+
+  char * buffer = NULL;
+  size_t buffersize = 0;
+  SbList<SbString> references;
+  if (SoInput_Prefetcher::readFile(entry->fullname, buffer, buffersize)) {
+    SbList<SbString> names;
+    SoInput_Prefetcher::findReferences(buffer, buffersize, names);
+    for (int i = 0; i < names.getLength(); i++) {
+      SbString found = SoInput_Prefetcher::resolve(names[i], entry->searchdirs);
+      if (found.getLength()) references.append(found);
+    }
+  }
+
+  // files referenced from this file are searched for in its own
+  // directory first, just like SoInput::pushFile() does
+  SbList<SbString> dirs;
+  dirs.append(SoInput::getPathname(entry->fullname));
+  for (int i = 0; i < entry->searchdirs.getLength(); i++) {
+    dirs.append(entry->searchdirs[i]);
+  }
+
+  cc_mutex_lock(this->mutex);
+  for (int i = 0; i < references.getLength(); i++) {
+    this->schedule(references[i], dirs, TRUE);
+  }
+  if (!entry->keepdata ||
+      (!taking && (this->bytesheld + buffersize > this->maxbytes))) {
+    free(buffer);
+    buffer = NULL;
+    buffersize = 0;
+  }
+  entry->buffer = buffer;
+  entry->buffersize = buffersize;
+  this->bytesheld += buffersize;
+  entry->state = DONE;
+  cc_condvar_wake_all(this->condvar);
+  cc_mutex_unlock(this->mutex);
+}
+
+// Reads the complete (decompressed) contents of the file fullname
+// into a malloc'ed buffer.
+SbBool
+SoInput_Prefetcher::readFile(const SbString & fullname,
+                             char *& buffer, size_t & size)
+{
+  buffer = NULL;
+  size = 0;
+
+  FILE * fp = fopen(fullname.getString(), "rb");
+  if (fp == NULL) return FALSE;
+
+  // takes over fp
+  SoInput_Reader * reader = SoInput_Reader::createReader(fp, fullname);
+  size_t allocated = PREFETCH_INITIAL_BUFFERSIZE;
+  buffer = (char *) malloc(allocated);
+  SbBool ok = buffer != NULL;
+  while (ok) {
+    if (size == allocated) {
+      char * newbuffer = (char *) realloc(buffer, allocated * 2);
+      if (newbuffer == NULL) { ok = FALSE; break; }
+      buffer = newbuffer;
+      allocated *= 2;
+    }
+    const size_t len = reader->readBuffer(buffer + size, allocated - size);
+    if (len == 0) break;
+    size += len;
+  }
+  delete reader;
+
+  if (!ok) {
+    free(buffer);
+    buffer = NULL;
+    size = 0;
+  }
+  return ok;
+}
+
+// Finds the names of the files referenced through the SoFile::name
+// and SoVRMLInline::url fields of an ASCII format file. This is a
+// plain scan of the tokens, not a parse of the file, so it can be
+// fooled by e.g. PROTOs with fields of the same name. That does no
+// harm though, since files are only loaded in advance and then used
+// by SoInput::pushFile() if they are asked for.
+void
+SoInput_Prefetcher::findReferences(const char * buffer, const size_t size,
+                                   SbList<SbString> & names)
+{
+  // binary files are not scanned
+  const char * end = buffer + size;
+  if ((size == 0) || (buffer[0] != '#')) return;
+  const char * eol = (const char *) memchr(buffer, '\n', size);
+  const SbString header(buffer, 0, (int) ((eol ? eol : end) - buffer) - 1);
+  if (strstr(header.getString(), "binary")) return;
+
+  enum { NONE, FILENODE, INLINENODE } pending = NONE, node = NONE;
+  SbBool expectvalue = FALSE;
+
+  const char * p = buffer;
+  while (p < end) {
+    const char c = *p;
+    if (isspace((unsigned char) c) || (c == ',') || (c == '[')) {
+      p++;
+    }
+    else if (c == '#') {
+      while ((p < end) && (*p != '\n') && (*p != '\r')) p++;
+    }
+    else if (c == '"') {
+      SbString value;
+      p++;
+      while ((p < end) && (*p != '"')) {
+        if ((*p == '\\') && (p + 1 < end) && (p[1] == '"')) p++;
+        if (expectvalue) value += *p;
+        p++;
+      }
+      if (p < end) p++;
+      if (expectvalue && value.getLength()) names.append(value);
+      expectvalue = FALSE;
+    }
+    else if (c == '{') {
+      node = pending;
+      pending = NONE;
+      expectvalue = FALSE;
+      p++;
+    }
+    else if ((c == '}') || (c == ']')) {
+      if (c == '}') node = NONE;
+      expectvalue = FALSE;
+      p++;
+    }
+    else {
+      const char * start = p;
+      while ((p < end) && !isspace((unsigned char) *p) &&
+             !strchr("{}[]\",#", *p)) p++;
+      const SbString token(start, 0, (int) (p - start) - 1);
+      if ((node == FILENODE) && expectvalue) {
+        // SoSFString values need not be quoted
+        names.append(token);
+        expectvalue = FALSE;
+      }
+      else if (node != NONE) {
+        expectvalue =
+          ((node == FILENODE) && (token == "name")) ||
+          ((node == INLINENODE) && (token == "url"));
+      }
+      else {
+        pending =
+          (token == "File") ? FILENODE :
+          (token == "Inline") ? INLINENODE : NONE;
+      }
+    }
+  }
+}
+
+// Mirrors the search done by SoInput::findFile(), which first looks
+// relative to the current working directory.
+SbString
+SoInput_Prefetcher::resolve(const SbString & name,
+                            const SbList<SbString> & searchdirs)
+{
+  for (int i = -1; i < searchdirs.getLength(); i++) {
+    SbString n = (i < 0) ? SbString("") : searchdirs[i];
+    const int namelen = n.getLength();
+    if ((namelen && n[namelen - 1] != '/' && n[namelen - 1] != '\\') &&
+        (name[0] != '/' && name[0] != '\\')) {
+      n += "/";
+    }
+    n += name;
+
+    struct stat buf;
+    if ((stat(n.getString(), &buf) == 0) && !S_ISDIR(buf.st_mode)) {
+      return n;
+    }
+  }
+  return SbString("");
+}
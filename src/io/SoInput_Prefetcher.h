@@ -0,0 +1,120 @@
+#ifndef COIN_SOINPUT_PREFETCHER_H
+#define COIN_SOINPUT_PREFETCHER_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+// *************************************************************************
+
+#include <Inventor/SbString.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/C/threads/common.h>
+
+#include "misc/SbHash.h"
+
+class SbStringList;
+class SoInput_Reader;
+
+// *************************************************************************
+
+// Loads the files referenced from a scene through SoFile and
+// SoVRMLInline nodes on a pool of worker threads, while the scene is
+// parsed on the main thread. Each loaded file is scanned for further
+// references, which are then scheduled as well. SoInput::pushFile()
+// picks up the loaded (and decompressed) data with takeReader().
+//
+// Parsing itself still happens on the thread that owns the SoInput,
+// since neither the SoInput dictionaries nor scene graph construction
+// are thread safe.
+//
+// At most maxbytes of loaded data is kept waiting to be taken. Files
+// loaded when the limit is reached are still scanned for references,
+// but their data is dropped, and they are read the regular way when
+// SoInput::pushFile() gets to them.
+
+class SoInput_Prefetcher {
+public:
+  SoInput_Prefetcher(const int numthreads,
+                     const size_t maxbytes = DEFAULT_MAXBYTES);
+  ~SoInput_Prefetcher();
+
+  void scanFile(const SbString & fullname, const SbStringList & searchdirs);
+  SoInput_Reader * takeReader(const SbString & fullname);
+
+  enum { DEFAULT_MAXBYTES = 256 * 1024 * 1024 };
+
+private:
+  enum EntryState {
+    QUEUED,
+    LOADING,
+    DONE,
+    TAKEN
+  };
+
+  struct Entry {
+    SoInput_Prefetcher * owner;
+    SbString fullname;
+    SbList<SbString> searchdirs;
+    EntryState state;
+    SbBool keepdata;
+    uint32_t schedid;
+    char * buffer;
+    size_t buffersize;
+  };
+
+  void schedule(const SbString & fullname,
+                const SbList<SbString> & searchdirs,
+                const SbBool keepdata);
+  void load(Entry * entry, const SbBool taking);
+
+  static void load_cb(void * closure);
+  static SbBool readFile(const SbString & fullname, char *& buffer, size_t & size);
+  static void findReferences(const char * buffer, const size_t size,
+                             SbList<SbString> & names);
+  static SbString resolve(const SbString & name,
+                          const SbList<SbString> & searchdirs);
+
+  cc_sched * sched;
+  cc_mutex * mutex;
+  cc_condvar * condvar;
+  SbBool cancelled;
+  size_t maxbytes;
+  size_t bytesheld;
+  SbHash<SbString, Entry *> files;
+  SbList<Entry *> entries;
+};
+
+#endif // COIN_SOINPUT_PREFETCHER_H
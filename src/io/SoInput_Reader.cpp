@@ -32,6 +32,7 @@
 
 #include "io/SoInput_Reader.h"
 
+#include <cstdlib>
 #include <cstring>
 #include <cassert>
 #ifdef HAVE_CONFIG_H
@@ -50,11 +51,20 @@
 #include <sys/stat.h>
 #endif
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif // HAVE_MMAP
+
+#include <Inventor/C/tidbits.h>
+#include <Inventor/C/threads/condvar.h>
+#include <Inventor/C/threads/mutex.h>
+#include <Inventor/C/threads/sched.h>
 #include <Inventor/errors/SoDebugError.h>
 
 #include "io/gzmemio.h"
 #include "glue/zlib.h"
 #include "glue/bzip2.h"
+#include "coindefs.h" // COIN_UNUSED_ARG
 
 // We don't want to include bzlib.h, so we just define the constants
 // we use here
@@ -66,6 +76,16 @@
 #define BZ_STREAM_END 4
 #endif // BZ_STREAM_END
 
+// Files at least this big are memory mapped even if it was not
+// explicitly requested through SoInput::setMemoryMapping(). Can be
+// overridden with the COIN_SOINPUT_MMAP_THRESHOLD environment
+// variable.
+static const size_t MMAP_DEFAULT_THRESHOLD = 64 * 1024 * 1024;
+
+// Number of bytes handed out per SoInput_MemMapReader::readInPlace()
+// call. The next window is prefetched while the current one is parsed.
+static const size_t MMAP_WINDOWSIZE = 4 * 1024 * 1024;
+
 //
 // abstract class
 //
@@ -91,15 +111,74 @@ SoInput_Reader::getFilePointer(void)
   return NULL;
 }
 
+SbBool
+SoInput_Reader::canReadInPlace(void) const
+{
+  return FALSE;
+}
+
+size_t
+SoInput_Reader::readInPlace(const char *& buf)
+{
+  assert(0 && "must be overloaded by readers which can read in place");
+  buf = NULL;
+  return 0;
+}
+
+SbBool
+SoInput_Reader::seek(const size_t COIN_UNUSED_ARG(pos))
+{
+  return FALSE;
+}
+
+size_t
+SoInput_Reader::getSize(void)
+{
+  return 0;
+}
+
+// returns the file size from which files are memory mapped
+// automatically, or 0 if this is disabled.
+static size_t
+soinput_reader_mmap_threshold(void)
+{
+  static long threshold = -1;
+  if (threshold < 0) {
+    threshold = (long) MMAP_DEFAULT_THRESHOLD;
+    const char * env = coin_getenv("COIN_SOINPUT_MMAP_THRESHOLD");
+    if (env) { threshold = atol(env); }
+    if (threshold < 0) { threshold = 0; }
+  }
+  return (size_t) threshold;
+}
+
+// returns TRUE if compressed files should be decompressed on a
+// separate thread. Enabled by default, set COIN_SOINPUT_READAHEAD to
+// "0" to disable it.
+static SbBool
+soinput_reader_readahead(void)
+{
+  static int readahead = -1;
+  if (readahead < 0) {
+    const char * env = coin_getenv("COIN_SOINPUT_READAHEAD");
+    readahead = (env && (atoi(env) <= 0)) ? 0 : 1;
+  }
+  return readahead ? TRUE : FALSE;
+}
+
 // creates the correct reader based on the file type in fp (will
 // examine the file header). If fullname is empty, it's assumed that
 // file FILE pointer is passed from the user, and that we cannot
-// necessarily find the file handle.
+// necessarily find the file handle. Uncompressed regular files are
+// memory mapped if memorymapping is TRUE, or if they are bigger than
+// the threshold returned by soinput_reader_mmap_threshold().
 SoInput_Reader *
-SoInput_Reader::createReader(FILE * fp, const SbString & fullname)
+SoInput_Reader::createReader(FILE * fp, const SbString & fullname,
+                             const SbBool memorymapping)
 {
   SoInput_Reader * reader = NULL;
   SbBool trycompression = FALSE;
+  SbBool trymmap = FALSE;
 
 #ifdef HAVE_FSTAT
   // need to make sure stream is seekable to enable compression
@@ -109,6 +188,9 @@ SoInput_Reader::createReader(FILE * fp, const SbString & fullname)
   if ( fstat(fn, &sb) == 0 ) {
     if ( sb.st_mode & S_IFREG ) { // regular file
       trycompression = TRUE;
+      const size_t threshold = soinput_reader_mmap_threshold();
+      trymmap = memorymapping ||
+        ((threshold > 0) && ((size_t) sb.st_size >= threshold));
     }
   }
 #endif // HAVE_FSTAT
@@ -179,6 +261,16 @@ SoInput_Reader::createReader(FILE * fp, const SbString & fullname)
         }
       }
     }
+
+#ifdef HAVE_THREADS
+    if (reader && soinput_reader_readahead()) {
+      reader = new SoInput_ReadAheadReader(reader);
+    }
+#endif // HAVE_THREADS
+  }
+
+  if ((reader == NULL) && trymmap) {
+    reader = SoInput_MemMapReader::create(fullname.getString(), fp);
   }
 
   if (reader == NULL) {
@@ -197,6 +289,7 @@ SoInput_FileReader::SoInput_FileReader(const char * const filenamearg, FILE * fi
 {
   this->fp = filepointer;
   this->filename = filenamearg;
+  this->startpos = filepointer ? ftell(filepointer) : -1;
 }
 
 SoInput_FileReader::~SoInput_FileReader()
@@ -224,6 +317,25 @@ SoInput_FileReader::readBuffer(char * buf, const size_t readlen)
   return fread(buf, 1, readlen, this->fp);
 }
 
+SbBool
+SoInput_FileReader::seek(const size_t pos)
+{
+  // ftell() fails for pipes and other streams we can't seek in
+  if (this->startpos < 0) return FALSE;
+  return fseek(this->fp, this->startpos + (long) pos, SEEK_SET) == 0;
+}
+
+size_t
+SoInput_FileReader::getSize(void)
+{
+  if (this->startpos < 0) return 0;
+  const long pos = ftell(this->fp);
+  if ((pos < 0) || (fseek(this->fp, 0, SEEK_END) != 0)) return 0;
+  const long end = ftell(this->fp);
+  (void) fseek(this->fp, pos, SEEK_SET);
+  return (end > this->startpos) ? (size_t) (end - this->startpos) : 0;
+}
+
 const SbString &
 SoInput_FileReader::getFilename(void)
 {
@@ -269,6 +381,244 @@ SoInput_MemBufferReader::readBuffer(char * buffer, const size_t readlen)
   return len;
 }
 
+SbBool
+SoInput_MemBufferReader::canReadInPlace(void) const
+{
+  return TRUE;
+}
+
+size_t
+SoInput_MemBufferReader::readInPlace(const char *& buffer)
+{
+  const size_t len = this->buflen - this->bufpos;
+  buffer = this->buf + this->bufpos;
+  this->bufpos += len;
+  return len;
+}
+
+SbBool
+SoInput_MemBufferReader::seek(const size_t pos)
+{
+  if (pos > this->buflen) return FALSE;
+  this->bufpos = pos;
+  return TRUE;
+}
+
+size_t
+SoInput_MemBufferReader::getSize(void)
+{
+  return this->buflen;
+}
+
+//
+// memory mapped file class
+//
+
+SoInput_MemMapReader::SoInput_MemMapReader(const char * const filenamearg,
+                                           FILE * filepointer,
+                                           void * mappingarg,
+                                           size_t mapsizearg,
+                                           size_t mapposarg)
+{
+  this->filename = filenamearg;
+  this->fp = filepointer;
+  this->mapping = mappingarg;
+  this->mapsize = mapsizearg;
+  this->mappos = mapposarg;
+  this->mapstart = mapposarg;
+}
+
+SoInput_MemMapReader::~SoInput_MemMapReader()
+{
+#ifdef HAVE_MMAP
+  (void) munmap(this->mapping, this->mapsize);
+#endif // HAVE_MMAP
+  // same rules as for SoInput_FileReader
+  if (this->fp &&
+      (this->filename != "<stdin>") &&
+      (this->filename.getLength())) {
+    fclose(this->fp);
+  }
+}
+
+// Maps the file behind fp from its current read position. Returns
+// NULL if the file can not be mapped, in which case the caller should
+// fall back to a regular SoInput_FileReader.
+SoInput_MemMapReader *
+SoInput_MemMapReader::create(const char * const filenamearg, FILE * fp)
+{
+#if defined(HAVE_MMAP) && defined(HAVE_FSTAT)
+  const int fd = fileno(fp);
+  struct stat sb;
+  if ((fd < 0) || (fstat(fd, &sb) != 0) || (sb.st_size <= 0)) return NULL;
+
+  const long offset = ftell(fp);
+  if ((offset < 0) || (offset >= sb.st_size)) return NULL;
+
+  const size_t size = (size_t) sb.st_size;
+  void * mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    SoDebugError::postWarning("SoInput_MemMapReader::create",
+                              "Unable to memory map '%s', "
+                              "falling back to regular file reads.",
+                              filenamearg);
+    return NULL;
+  }
+#ifdef HAVE_MADVISE
+  (void) madvise(mapping, size, MADV_SEQUENTIAL);
+#endif // HAVE_MADVISE
+  return new SoInput_MemMapReader(filenamearg, fp, mapping, size, (size_t) offset);
+#else // ! (HAVE_MMAP && HAVE_FSTAT)
+  return NULL;
+#endif // ! (HAVE_MMAP && HAVE_FSTAT)
+}
+
+SoInput_Reader::ReaderType
+SoInput_MemMapReader::getType(void) const
+{
+  return MEMMAPFILE;
+}
+
+size_t
+SoInput_MemMapReader::readBuffer(char * buf, const size_t readlen)
+{
+  size_t len = this->mapsize - this->mappos;
+  if (len > readlen) len = readlen;
+
+  memcpy(buf, (const char *) this->mapping + this->mappos, len);
+  this->mappos += len;
+
+  return len;
+}
+
+SbBool
+SoInput_MemMapReader::canReadInPlace(void) const
+{
+  return TRUE;
+}
+
+size_t
+SoInput_MemMapReader::readInPlace(const char *& buf)
+{
+  size_t len = this->mapsize - this->mappos;
+  if (len > MMAP_WINDOWSIZE) len = MMAP_WINDOWSIZE;
+
+  buf = (const char *) this->mapping + this->mappos;
+  this->mappos += len;
+
+#ifdef HAVE_MADVISE
+  // start paging in the next window while the parser works on this
+  // one. madvise() needs a page aligned start address.
+  if (this->mappos < this->mapsize) {
+    static const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t start = this->mappos - (this->mappos % pagesize);
+    size_t prefetch = this->mapsize - start;
+    if (prefetch > MMAP_WINDOWSIZE) prefetch = MMAP_WINDOWSIZE;
+    (void) madvise((char *) this->mapping + start, prefetch, MADV_WILLNEED);
+  }
+#endif // HAVE_MADVISE
+
+  return len;
+}
+
+SbBool
+SoInput_MemMapReader::seek(const size_t pos)
+{
+  if (pos > this->mapsize - this->mapstart) return FALSE;
+  this->mappos = this->mapstart + pos;
+  return TRUE;
+}
+
+size_t
+SoInput_MemMapReader::getSize(void)
+{
+  return this->mapsize - this->mapstart;
+}
+
+const SbString &
+SoInput_MemMapReader::getFilename(void)
+{
+  return this->filename;
+}
+
+FILE *
+SoInput_MemMapReader::getFilePointer(void)
+{
+  return this->fp;
+}
+
+//
+// file already loaded into memory by SoInput_Prefetcher
+//
+
+SoInput_PrefetchedFileReader::SoInput_PrefetchedFileReader(const char * const filenamearg,
+                                                           char * bufferarg,
+                                                           size_t buffersizearg)
+{
+  this->filename = filenamearg;
+  this->buf = bufferarg;
+  this->buflen = buffersizearg;
+  this->bufpos = 0;
+}
+
+SoInput_PrefetchedFileReader::~SoInput_PrefetchedFileReader()
+{
+  free(this->buf);
+}
+
+SoInput_Reader::ReaderType
+SoInput_PrefetchedFileReader::getType(void) const
+{
+  return PREFETCHEDFILE;
+}
+
+size_t
+SoInput_PrefetchedFileReader::readBuffer(char * buffer, const size_t readlen)
+{
+  size_t len = this->buflen - this->bufpos;
+  if (len > readlen) len = readlen;
+
+  memcpy(buffer, this->buf + this->bufpos, len);
+  this->bufpos += len;
+
+  return len;
+}
+
+SbBool
+SoInput_PrefetchedFileReader::canReadInPlace(void) const
+{
+  return TRUE;
+}
+
+size_t
+SoInput_PrefetchedFileReader::readInPlace(const char *& buffer)
+{
+  const size_t len = this->buflen - this->bufpos;
+  buffer = this->buf + this->bufpos;
+  this->bufpos += len;
+  return len;
+}
+
+SbBool
+SoInput_PrefetchedFileReader::seek(const size_t pos)
+{
+  if (pos > this->buflen) return FALSE;
+  this->bufpos = pos;
+  return TRUE;
+}
+
+size_t
+SoInput_PrefetchedFileReader::getSize(void)
+{
+  return this->buflen;
+}
+
+const SbString &
+SoInput_PrefetchedFileReader::getFilename(void)
+{
+  return this->filename;
+}
+
 //
 // gzip readers
 //
@@ -401,5 +751,133 @@ SoInput_BZ2FileReader::getFilename(void)
   return this->filename;
 }
 
+//
+// read-ahead class for compressed files
+//
+
+// Size of each of the decompressed blocks in the ring. Should be
+// bigger than the read buffer in SoInput_FileInfo, so that each
+// readBuffer() call is served from one or two blocks.
+static const size_t READAHEAD_BLOCKSIZE = 256 * 1024;
+
+SoInput_ReadAheadReader::SoInput_ReadAheadReader(SoInput_Reader * sourcearg)
+{
+  this->source = sourcearg;
+  for (int i = 0; i < NUMBLOCKS; i++) {
+    this->blocks[i] = new char[READAHEAD_BLOCKSIZE];
+    this->blocklen[i] = 0;
+  }
+  this->numfilled = 0;
+  this->fillidx = 0;
+  this->readidx = 0;
+  this->readpos = 0;
+  this->sourceeof = FALSE;
+  this->cancelled = FALSE;
+
+  this->mutex = cc_mutex_construct();
+  this->condvar = cc_condvar_construct();
+  this->sched = cc_sched_construct(1);
+  // a single job fills the ring for as long as the file lasts
+  (void) cc_sched_schedule(this->sched,
+                           SoInput_ReadAheadReader::readahead_cb, this, 0.0f);
+}
+
+SoInput_ReadAheadReader::~SoInput_ReadAheadReader()
+{
+  cc_mutex_lock(this->mutex);
+  this->cancelled = TRUE;
+  cc_condvar_wake_all(this->condvar);
+  cc_mutex_unlock(this->mutex);
+  cc_sched_destruct(this->sched);
+
+  cc_condvar_destruct(this->condvar);
+  cc_mutex_destruct(this->mutex);
+  for (int i = 0; i < NUMBLOCKS; i++) {
+    delete[] this->blocks[i];
+  }
+  delete this->source;
+}
+
+SoInput_Reader::ReaderType
+SoInput_ReadAheadReader::getType(void) const
+{
+  return this->source->getType();
+}
+
+const SbString &
+SoInput_ReadAheadReader::getFilename(void)
+{
+  return this->source->getFilename();
+}
+
+size_t
+SoInput_ReadAheadReader::readBuffer(char * buf, const size_t readlen)
+{
+  size_t numread = 0;
+  while (numread < readlen) {
+    cc_mutex_lock(this->mutex);
+    while (this->numfilled == 0) {
+      if (this->sourceeof) {
+        cc_mutex_unlock(this->mutex);
+        return numread;
+      }
+      cc_condvar_wait(this->condvar, this->mutex);
+    }
+    cc_mutex_unlock(this->mutex);
+
+    // the block at readidx is ours until we hand it back
+    const size_t len = this->blocklen[this->readidx];
+    const size_t n = SbMin(readlen - numread, len - this->readpos);
+    memcpy(buf + numread, this->blocks[this->readidx] + this->readpos, n);
+    numread += n;
+    this->readpos += n;
+
+    if (this->readpos == len) {
+      this->readidx = (this->readidx + 1) % NUMBLOCKS;
+      this->readpos = 0;
+      cc_mutex_lock(this->mutex);
+      this->numfilled--;
+      cc_condvar_wake_all(this->condvar);
+      cc_mutex_unlock(this->mutex);
+    }
+  }
+  return numread;
+}
+
+void
+SoInput_ReadAheadReader::readahead_cb(void * closure)
+{
+  SoInput_ReadAheadReader * thisp = (SoInput_ReadAheadReader *) closure;
+
+  for (;;) {
+    cc_mutex_lock(thisp->mutex);
+    while ((thisp->numfilled == NUMBLOCKS) && !thisp->cancelled) {
+      cc_condvar_wait(thisp->condvar, thisp->mutex);
+    }
+    if (thisp->cancelled) {
+      cc_mutex_unlock(thisp->mutex);
+      return;
+    }
+    const int idx = thisp->fillidx;
+    cc_mutex_unlock(thisp->mutex);
+
+    const size_t len = thisp->source->readBuffer(thisp->blocks[idx],
+                                                 READAHEAD_BLOCKSIZE);
+
+    cc_mutex_lock(thisp->mutex);
+    if (len == 0) {
+      thisp->sourceeof = TRUE;
+    }
+    else {
+      thisp->blocklen[idx] = len;
+      thisp->fillidx = (idx + 1) % NUMBLOCKS;
+      thisp->numfilled++;
+    }
+    cc_condvar_wake_all(thisp->condvar);
+    cc_mutex_unlock(thisp->mutex);
+    if (len == 0) return;
+  }
+}
+
 #undef BZ_OK
 #undef BZ_STREAM_END
@@ -40,6 +40,7 @@
 // *************************************************************************
 
 #include <Inventor/SbString.h>
+#include <Inventor/C/threads/common.h>
 #include <stdio.h>
 
 // *************************************************************************
@@ -55,7 +56,9 @@ public:
     MEMBUFFER,
     GZFILE,
     BZ2FILE,
-    GZMEMBUFFER
+    GZMEMBUFFER,
+    MEMMAPFILE,
+    PREFETCHEDFILE
   };
 
   // must be overloaded to return type
@@ -73,7 +76,28 @@ public:
   // reader uses FILE * to read data.
   virtual FILE * getFilePointer(void);
 
-  static SoInput_Reader * createReader(FILE * fp, const SbString & fullname);
+  // should be overloaded to return TRUE by readers that keep all
+  // their data available in memory. Default method returns FALSE.
+  virtual SbBool canReadInPlace(void) const;
+
+  // must be overloaded if canReadInPlace() returns TRUE. Should set
+  // buf to point at the next chunk of data, without copying it, and
+  // return the number of bytes in the chunk or 0 if eof. The data
+  // must stay valid for the lifetime of the reader.
+  virtual size_t readInPlace(const char *& buf);
+
+  // should be overloaded by readers which support random access.
+  // Should move to pos bytes from where the reader started reading
+  // and return TRUE. Default method returns FALSE.
+  virtual SbBool seek(const size_t pos);
+
+  // should be overloaded by readers which support random access to
+  // return the number of bytes available from where the reader
+  // started reading. Default method returns 0.
+  virtual size_t getSize(void);
+
+  static SoInput_Reader * createReader(FILE * fp, const SbString & fullname,
+                                       const SbBool memorymapping = FALSE);
 
 public:
   SbString dummyname;
@@ -87,12 +111,16 @@ public:
   virtual ReaderType getType(void) const;
   virtual size_t readBuffer(char * buf, const size_t readlen);
 
+  virtual SbBool seek(const size_t pos);
+  virtual size_t getSize(void);
+
   virtual const SbString & getFilename(void);
   virtual FILE * getFilePointer(void);
 
 public:
   SbString filename;
   FILE * fp;
+  long startpos;
 
 };
 
@@ -104,12 +132,71 @@ public:
   virtual ReaderType getType(void) const;
   virtual size_t readBuffer(char * buf, const size_t readlen);
 
+  virtual SbBool canReadInPlace(void) const;
+  virtual size_t readInPlace(const char *& buf);
+
+  virtual SbBool seek(const size_t pos);
+  virtual size_t getSize(void);
+
 public:
   char * buf;
   size_t buflen;
   size_t bufpos;
 };
 
+class SoInput_MemMapReader : public SoInput_Reader {
+public:
+  SoInput_MemMapReader(const char * const filename, FILE * filepointer,
+                       void * mapping, size_t mapsize, size_t mappos);
+  virtual ~SoInput_MemMapReader();
+
+  static SoInput_MemMapReader * create(const char * const filename, FILE * fp);
+
+  virtual ReaderType getType(void) const;
+  virtual size_t readBuffer(char * buf, const size_t readlen);
+
+  virtual SbBool canReadInPlace(void) const;
+  virtual size_t readInPlace(const char *& buf);
+
+  virtual SbBool seek(const size_t pos);
+  virtual size_t getSize(void);
+
+  virtual const SbString & getFilename(void);
+  virtual FILE * getFilePointer(void);
+
+public:
+  SbString filename;
+  FILE * fp;
+  void * mapping;
+  size_t mapsize;
+  size_t mappos;
+  size_t mapstart;
+};
+
+class SoInput_PrefetchedFileReader : public SoInput_Reader {
+public:
+  SoInput_PrefetchedFileReader(const char * const filename,
+                               char * buffer, size_t buffersize);
+  virtual ~SoInput_PrefetchedFileReader();
+
+  virtual ReaderType getType(void) const;
+  virtual size_t readBuffer(char * buf, const size_t readlen);
+
+  virtual SbBool canReadInPlace(void) const;
+  virtual size_t readInPlace(const char *& buf);
+
+  virtual SbBool seek(const size_t pos);
+  virtual size_t getSize(void);
+
+  virtual const SbString & getFilename(void);
+
+public:
+  SbString filename;
+  char * buf;
+  size_t buflen;
+  size_t bufpos;
+};
+
 class SoInput_GZMemBufferReader : public SoInput_Reader {
 public:
   SoInput_GZMemBufferReader(const void * bufPointer, size_t bufSize);
@@ -154,4 +241,37 @@ public:
   SbString filename;
 };
 
+// Wraps a reader for a compressed file, and decompresses the file on
+// a separate thread into a ring of blocks, ahead of what is being
+// read. This lets decompression and parsing run in parallel.
+class SoInput_ReadAheadReader : public SoInput_Reader {
+public:
+  SoInput_ReadAheadReader(SoInput_Reader * source);
+  virtual ~SoInput_ReadAheadReader();
+
+  virtual ReaderType getType(void) const;
+  virtual size_t readBuffer(char * buf, const size_t readlen);
+
+  virtual const SbString & getFilename(void);
+
+private:
+  enum { NUMBLOCKS = 4 };
+
+  static void readahead_cb(void * closure);
+
+  SoInput_Reader * source;
+  char * blocks[NUMBLOCKS];
+  size_t blocklen[NUMBLOCKS];
+  int numfilled;
+  int fillidx;
+  int readidx;
+  size_t readpos;
+  SbBool sourceeof;
+  SbBool cancelled;
+
+  cc_sched * sched;
+  cc_mutex * mutex;
+  cc_condvar * condvar;
+};
+
 #endif // COIN_SOINPUT_READER_H
@@ -62,6 +62,11 @@
   You cannot use file compression together with I/O to memory buffers,
   except for reading from memory buffers containing gzip-compressed files.
 
+  Writing gzip-compressed files can be done on several threads, see
+  SoOutput::setCompressionThreads. The default number of threads is
+  taken from the COIN_SOOUTPUT_COMPRESSION_THREADS environment
+  variable.
+
   For backwards compatibility with Coin 2.0 and Coin 1.0, compressed files
   must not be used.  Compressed files works only from Coin 2.1 and
   upwards.
@@ -100,6 +105,7 @@
 #include "glue/bzip2.h"
 #include "io/SoOutput_Writer.h"
 #include "io/SoWriterefCounter.h"
+#include "io/SoInputP.h"
 
 // *************************************************************************
 
@@ -197,6 +203,33 @@ public:
 
   SbName compmethod;
   float complevel;
+  int compthreads;
+
+  static int defaultCompressionThreads(void) {
+    static int threads = -1;
+    if (threads == -1) {
+      const char * env = coin_getenv("COIN_SOOUTPUT_COMPRESSION_THREADS");
+      threads = env ? atoi(env) : 0;
+      if (threads < 0) { threads = 0; }
+    }
+    return threads;
+  }
+
+  // see SoOutput::setIndexed()
+  SbBool indexed;
+  size_t indexstart;
+  SbList <SbName> indexnames;
+  SbList <size_t> indexoffsets;
+
+  // the write position, counted from the start of our part of the
+  // memory buffer if we're writing to one
+  size_t getWritePosition(void) {
+    size_t pos = this->getWriter()->bytesInBuf();
+    if (this->getWriter()->getType() == SoOutput_Writer::MEMBUFFER) {
+      pos -= ((SoOutput_MemBufferWriter*)this->getWriter())->startoffset;
+    }
+    return pos;
+  }
 
   void pushRoutes(const SbBool copyprev) {
     const int oldidx = this->routestack.getLength() - 1;
@@ -255,7 +288,8 @@ public:
   SoOutput_Writer * getWriter(void) {
     if (this->writer == NULL) {
       this->writer = SoOutput_Writer::createWriter(coin_get_stdout(), FALSE,
-                                                   this->compmethod, this->complevel);
+                                                   this->compmethod, this->complevel,
+                                                   this->compthreads);
     }
     return this->writer;
   }
@@ -350,6 +384,10 @@ SoOutput::constructorCommon(void)
 
   PRIVATE(this)->compmethod = SbName("NONE");
   PRIVATE(this)->complevel = 0.0f;;
+  PRIVATE(this)->compthreads = SoOutputP::defaultCompressionThreads();
+
+  PRIVATE(this)->indexed = FALSE;
+  PRIVATE(this)->indexstart = 0;
 }
 
 /*!
@@ -379,7 +417,8 @@ SoOutput::setFilePointer(FILE * newFP)
   this->reset();
   PRIVATE(this)->setWriter(SoOutput_Writer::createWriter(newFP, FALSE,
                                                          PRIVATE(this)->compmethod,
-                                                         PRIVATE(this)->complevel));
+                                                         PRIVATE(this)->complevel,
+                                                         PRIVATE(this)->compthreads));
 }
 
 /*!
@@ -418,7 +457,8 @@ SoOutput::openFile(const char * const fileName)
   if (newfile) {
     PRIVATE(this)->setWriter(SoOutput_Writer::createWriter(newfile, TRUE,
                                                            PRIVATE(this)->compmethod,
-                                                           PRIVATE(this)->complevel));
+                                                           PRIVATE(this)->complevel,
+                                                           PRIVATE(this)->compthreads));
     PRIVATE(this)->usercalledopenfile = TRUE;
   }
   else {
@@ -496,6 +536,46 @@ SoOutput::setCompression(const SbName & compmethod, const float level)
   return FALSE;
 }
 
+/*!
+  Sets the number of threads used to compress the output when writing
+  gzip-compressed files. With one or more threads, the output is
+  split into blocks which are compressed in parallel while the scene
+  is being written, and then written to the file in order. This makes
+  writing big compressed files considerably faster, at the cost of a
+  slightly larger file. The file is still a regular gzip file.
+
+  Set to 0 to compress on the writing thread, which is the default
+  unless the COIN_SOOUTPUT_COMPRESSION_THREADS environment variable is
+  set. bzip2 compression is always done on the writing thread. Has no
+  effect if Coin was built without support for threads.
+
+  The setting is used for files opened after it has been changed.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setCompression()
+  \since Coin 4.1
+*/
+void
+SoOutput::setCompressionThreads(const int numthreads)
+{
+  PRIVATE(this)->compthreads = SbMax(numthreads, 0);
+}
+
+/*!
+  Returns the number of threads used to compress the output.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setCompressionThreads()
+  \since Coin 4.1
+*/
+int
+SoOutput::getCompressionThreads(void) const
+{
+  return PRIVATE(this)->compthreads;
+}
+
 /*!
   Returns the array of available compression methods. The number
   of elements in the array will be stored in \a num.
@@ -665,6 +745,44 @@ SoOutput::isBinary(void) const
   return PRIVATE(this)->binarystream;
 }
 
+/*!
+  Set whether or not binary output should end with an index of the
+  byte offsets of all named (DEF'd) instances.
+
+  An indexed file is a regular binary Inventor file which can be read
+  by any version of Coin from this version on. When it is read from a
+  file or memory buffer, SoDB::readNamedNode() can load a single named
+  subgraph without reading the rest of the file, by seeking straight
+  to it. Instances referenced by the subgraph, but defined elsewhere
+  in the file, are loaded on demand in the same way.
+
+  The flag has no effect on ASCII output. Default value is \c FALSE.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa isIndexed(), setBinary(), SoDB::readNamedNode()
+  \since Coin 4.1
+*/
+void
+SoOutput::setIndexed(const SbBool flag)
+{
+  PRIVATE(this)->indexed = flag;
+}
+
+/*!
+  Returns whether or not binary output is written with an index.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setIndexed()
+  \since Coin 4.1
+*/
+SbBool
+SoOutput::isIndexed(void) const
+{
+  return PRIVATE(this)->indexed;
+}
+
 /*!
   Set the output file header string.
 
@@ -1185,6 +1303,8 @@ SoOutput::reset(void)
   PRIVATE(this)->disabledwriting = FALSE;
   this->wroteHeader = FALSE;
   PRIVATE(this)->indentlevel = 0;
+  PRIVATE(this)->indexnames.truncate(0);
+  PRIVATE(this)->indexoffsets.truncate(0);
 }
 
 /*!
@@ -1286,10 +1406,7 @@ SoOutput::writeBytesWithPadding(const char * const p, const size_t nr)
     if (padbytes[0] == 'X')
       for (size_t i=0; i < HOSTWORDSIZE; i++) padbytes[i] = '\0';
 
-    size_t writeposition = this->bytesInBuf();
-    if (PRIVATE(this)->getWriter()->getType() == SoOutput_Writer::MEMBUFFER) {
-      writeposition -= ((SoOutput_MemBufferWriter*)PRIVATE(this)->getWriter())->startoffset;
-    }
+    const size_t writeposition = PRIVATE(this)->getWritePosition();
     size_t padsize = HOSTWORDSIZE - (writeposition % HOSTWORDSIZE);
     if (padsize == HOSTWORDSIZE) padsize = 0;
     this->writeBinaryArray(padbytes, (int)padsize);
@@ -1309,6 +1426,11 @@ SoOutput::checkHeader(void)
     // end up in an eternal double-recursive loop.
     this->wroteHeader = TRUE;
 
+    // index offsets are counted from the start of the header
+    PRIVATE(this)->indexstart = PRIVATE(this)->getWritePosition();
+    PRIVATE(this)->indexnames.truncate(0);
+    PRIVATE(this)->indexoffsets.truncate(0);
+
     SbString h;
     if (PRIVATE(this)->headerstring) h = *(PRIVATE(this)->headerstring);
     else if (this->isBinary()) h = SoOutput::getDefaultBinaryHeader();
@@ -1705,6 +1827,56 @@ SoOutput::removeSoBase2IdRef(const SoBase * base)
   PRIVATE(this)->counter->removeSoBase2IdRef(base);
 }
 
+//
+// Used by SoBase::writeHeader() to record the offset of an instance
+// which is about to be DEF'd.
+//
+void
+SoOutput::addIndexEntry(const SbName & name)
+{
+  if (!PRIVATE(this)->indexed || !this->isBinary() ||
+      (this->getStage() != SoOutput::WRITE)) return;
+
+  this->checkHeader();
+  PRIVATE(this)->indexnames.append(name);
+  PRIVATE(this)->indexoffsets.append(PRIVATE(this)->getWritePosition() -
+                                     PRIVATE(this)->indexstart);
+}
+
+//
+// Used by SoWriteAction to end indexed binary output. The index is
+// written as a top level record:
+//
+//   INDEX <count> { <name> <offset> }* <index offset> <magic>
+//
+// with all offsets as two unsigned ints (high and low 32 bits), so
+// that the index can be found from the last 12 bytes of the file. The
+// index lists all instances DEF'd so far, so only the last index in a
+// file written with several calls to SoWriteAction::apply() matters.
+//
+void
+SoOutput::writeIndex(void)
+{
+  if (!PRIVATE(this)->indexed || !this->isBinary()) return;
+
+  this->checkHeader();
+  const size_t indexpos =
+    PRIVATE(this)->getWritePosition() - PRIVATE(this)->indexstart;
+
+  this->write(SoInputP::INDEX_KEYWORD);
+  const int n = PRIVATE(this)->indexnames.getLength();
+  this->write(n);
+  for (int i = 0; i < n; i++) {
+    const uint64_t offset = PRIVATE(this)->indexoffsets[i];
+    this->write(PRIVATE(this)->indexnames[i].getString());
+    this->write((unsigned int) (offset >> 32));
+    this->write((unsigned int) (offset & 0xffffffff));
+  }
+  this->write((unsigned int) (((uint64_t) indexpos) >> 32));
+  this->write((unsigned int) (indexpos & 0xffffffff));
+  this->write((unsigned int) SoInputP::INDEX_MAGIC);
+}
+
 // FIXME: temporary workaround needed to test if we are currently
 // exporting a VRML97 or an Inventor file. Used from
 // SoBase::writeHeader(). pederb, 2003-02-18
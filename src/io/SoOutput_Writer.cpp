@@ -51,8 +51,13 @@
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/SbName.h>
 
+#include <Inventor/C/threads/condvar.h>
+#include <Inventor/C/threads/mutex.h>
+#include <Inventor/C/threads/sched.h>
+
 #include "glue/zlib.h"
 #include "glue/bzip2.h"
+#include "io/gzmemio.h"
 
 // We don't want to include bzlib.h, so we just define the constants
 // we use here
@@ -88,10 +93,16 @@ SoOutput_Writer *
 SoOutput_Writer::createWriter(FILE * fp, 
                               const SbBool shouldclose,
                               const SbName & compmethod,
-                              const float level)
+                              const float level,
+                              const int numthreads)
 {
   if (compmethod == "GZIP") {
     if (cc_zlibglue_available()) {
+#ifdef HAVE_THREADS
+      if (numthreads > 0) {
+        return new SoOutput_ParallelGZFileWriter(fp, shouldclose, level, numthreads);
+      }
+#endif // HAVE_THREADS
       return new SoOutput_GZFileWriter(fp, shouldclose, level);
     }
     SoDebugError::postWarning("SoOutput_Writer::createWriter",
@@ -284,6 +295,193 @@ SoOutput_GZFileWriter::bytesInBuf(void)
   return 0;
 }
 
+//
+// multithreaded zlib writer
+//
+
+// Amount of uncompressed data in each block handed to the compression
+// threads. Each block costs a few bytes of compressed output for the
+// sync flush, and loses the references into the previous block, so
+// this should not be too small.
+static const uint32_t SOOUTPUT_GZBLOCKSIZE = 256 * 1024;
+
+SoOutput_ParallelGZFileWriter::SoOutput_ParallelGZFileWriter(FILE * fparg,
+                                                             const SbBool shouldclosearg,
+                                                             const float levelarg,
+                                                             const int numthreads)
+{
+  assert(numthreads > 0);
+  this->fp = fparg;
+  this->shouldclose = shouldclosearg;
+  // convert level from [0.0, 1.0] to [1, 9]
+  this->level = (int) SbClamp((levelarg * 8.0f) + 1.0f, 1.0f, 9.0f);
+  this->failed = FALSE;
+  // keep a couple of blocks in the queue for each thread, so they
+  // don't run out of work while we wait for the oldest block
+  this->maxpending = 2 * numthreads;
+  this->current = NULL;
+  this->crc = (uint32_t) cc_zlibglue_crc32(0L, NULL, 0);
+  this->totalin = 0;
+
+  this->sched = cc_sched_construct(numthreads);
+  this->mutex = cc_mutex_construct();
+  this->condvar = cc_condvar_construct();
+
+  // a minimal gzip header: no file name, no modification time
+  static const unsigned char header[10] = {
+    0x1f, 0x8b, 8 /* deflate */, 0 /* flags */, 0, 0, 0, 0 /* time */,
+    0 /* xflags */, 3 /* unix */
+  };
+  if (fwrite(header, 1, 10, this->fp) != 10) this->failed = TRUE;
+}
+
+SoOutput_ParallelGZFileWriter::~SoOutput_ParallelGZFileWriter()
+{
+  this->submitBlock(TRUE);
+  this->writeBlocks(0);
+
+  unsigned char trailer[8];
+  const uint32_t isize = (uint32_t) this->totalin;
+  for (int i = 0; i < 4; i++) {
+    trailer[i] = (unsigned char) ((this->crc >> (i * 8)) & 0xff);
+    trailer[i + 4] = (unsigned char) ((isize >> (i * 8)) & 0xff);
+  }
+  if (fwrite(trailer, 1, 8, this->fp) != 8) this->failed = TRUE;
+
+  if (this->failed) {
+    SoDebugError::postWarning("SoOutput_ParallelGZFileWriter::~SoOutput_ParallelGZFileWriter",
+                              "Error when writing compressed file.");
+  }
+
+  cc_sched_destruct(this->sched);
+  cc_condvar_destruct(this->condvar);
+  cc_mutex_destruct(this->mutex);
+
+  if (this->shouldclose) fclose(this->fp);
+  else fflush(this->fp);
+}
+
+SoOutput_Writer::WriterType
+SoOutput_ParallelGZFileWriter::getType(void) const
+{
+  return GZFILE;
+}
+
+size_t
+SoOutput_ParallelGZFileWriter::write(const char * buf, size_t numbytes, const SbBool COIN_UNUSED_ARG(binary))
+{
+  size_t left = numbytes;
+  while (left > 0) {
+    if (this->current == NULL) {
+      this->current = this->createBlock(SOOUTPUT_GZBLOCKSIZE);
+    }
+    const size_t n = SbMin(left, (size_t) (SOOUTPUT_GZBLOCKSIZE - this->current->datalen));
+    memcpy(this->current->data + this->current->datalen, buf, n);
+    this->current->datalen += (uint32_t) n;
+    buf += n;
+    left -= n;
+    if (this->current->datalen == SOOUTPUT_GZBLOCKSIZE) {
+      this->submitBlock(FALSE);
+      this->writeBlocks(this->maxpending);
+    }
+  }
+  this->totalin += numbytes;
+  return numbytes;
+}
+
+size_t
+SoOutput_ParallelGZFileWriter::bytesInBuf(void)
+{
+  // like gztell(), return the uncompressed position
+  return this->totalin;
+}
+
+// Hands the current block over to the compression threads. The CRC
+// is updated here, since the blocks must be added in order.
+void
+SoOutput_ParallelGZFileWriter::submitBlock(const SbBool last)
+{
+  if (this->current == NULL) {
+    if (!last) return;
+    // the stream must be terminated even if it is empty
+    this->current = this->createBlock(0);
+  }
+  Block * block = this->current;
+  this->current = NULL;
+  block->last = last;
+  if (block->datalen > 0) {
+    this->crc = (uint32_t) cc_zlibglue_crc32(this->crc, block->data, block->datalen);
+  }
+
+  // the pending list is only used from this thread, the compression
+  // threads just fill in the blocks
+  this->pending.append(block);
+  (void) cc_sched_schedule(this->sched,
+                           SoOutput_ParallelGZFileWriter::compress_cb, block, 0.0f);
+}
+
+// Writes compressed blocks to the file, in order, until no more than
+// keep blocks are pending. Waits for blocks still being compressed.
+void
+SoOutput_ParallelGZFileWriter::writeBlocks(const int keep)
+{
+  while (this->pending.getLength() > keep) {
+    Block * block = this->pending[0];
+    cc_mutex_lock(this->mutex);
+    while (!block->done) {
+      cc_condvar_wait(this->condvar, this->mutex);
+    }
+    cc_mutex_unlock(this->mutex);
+    this->pending.remove(0);
+
+    if (block->compressed == NULL) {
+      this->failed = TRUE;
+    }
+    else if (!this->failed &&
+             (fwrite(block->compressed, 1, block->compressedlen, this->fp) !=
+              block->compressedlen)) {
+      this->failed = TRUE;
+    }
+    free(block->data);
+    free(block->compressed);
+    delete block;
+  }
+}
+
+SoOutput_ParallelGZFileWriter::Block *
+SoOutput_ParallelGZFileWriter::createBlock(const uint32_t size)
+{
+  Block * block = new Block;
+  block->owner = this;
+  block->data = size ? (char *) malloc(size) : NULL;
+  block->datalen = 0;
+  block->compressed = NULL;
+  block->compressedlen = 0;
+  block->last = FALSE;
+  block->done = FALSE;
+  return block;
+}
+
+void
+SoOutput_ParallelGZFileWriter::compress_cb(void * closure)
+{
+  Block * block = (Block *) closure;
+  SoOutput_ParallelGZFileWriter * thisp = block->owner;
+
+  unsigned char * compressed = NULL;
+  uint32_t compressedlen = 0;
+  (void) cc_gzm_deflate_block((const uint8_t *) block->data, block->datalen,
+                              &compressed, &compressedlen,
+                              thisp->level, block->last ? 1 : 0);
+
+  cc_mutex_lock(thisp->mutex);
+  block->compressed = compressed;
+  block->compressedlen = compressedlen;
+  block->done = TRUE;
+  cc_condvar_wake_all(thisp->condvar);
+  cc_mutex_unlock(thisp->mutex);
+}
+
 //
 // bzip2 writer
 //
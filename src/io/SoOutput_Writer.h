@@ -40,6 +40,8 @@
 // *************************************************************************
 
 #include <Inventor/SoOutput.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/C/threads/common.h>
 #include <stdio.h>
 
 // *************************************************************************
@@ -74,7 +76,8 @@ public:
   static SoOutput_Writer * createWriter(FILE * fp,
                                         const SbBool shouldclose,
                                         const SbName & compmethod,
-                                        const float level);
+                                        const float level,
+                                        const int numthreads = 0);
 
 };
 
@@ -132,6 +135,51 @@ public:
   void * gzfp;
 };
 
+// class for zlib writing where blocks of data are compressed on a
+// pool of threads, while the scene is still being written. The
+// compressed blocks are written to the file in order, as a single
+// gzip member, so the file can be read by any gzip reader.
+class SoOutput_ParallelGZFileWriter : public SoOutput_Writer {
+public:
+  SoOutput_ParallelGZFileWriter(FILE * fp, const SbBool shouldclose,
+                                const float level, const int numthreads);
+  virtual ~SoOutput_ParallelGZFileWriter();
+
+  virtual size_t bytesInBuf(void);
+  virtual WriterType getType(void) const;
+  virtual size_t write(const char * buf, size_t numbytes, const SbBool binary);
+
+private:
+  struct Block {
+    SoOutput_ParallelGZFileWriter * owner;
+    char * data;
+    uint32_t datalen;
+    unsigned char * compressed;
+    uint32_t compressedlen;
+    SbBool last;
+    SbBool done;
+  };
+
+  Block * createBlock(const uint32_t size);
+  void submitBlock(const SbBool last);
+  void writeBlocks(const int keep);
+  static void compress_cb(void * closure);
+
+  FILE * fp;
+  SbBool shouldclose;
+  int level;
+  SbBool failed;
+  int maxpending;
+  Block * current;
+  uint32_t crc;
+  size_t totalin;
+
+  cc_sched * sched;
+  cc_mutex * mutex;
+  cc_condvar * condvar;
+  SbList<Block *> pending;
+};
+
 class SoOutput_BZ2FileWriter : public SoOutput_Writer {
 public:
   SoOutput_BZ2FileWriter(FILE * fp, const SbBool shouldclose, const float level);
@@ -34,6 +34,7 @@
 #include "SoInput.cpp"
 #include "SoInputP.cpp"
 #include "SoInput_FileInfo.cpp"
+#include "SoInput_Prefetcher.cpp"
 #include "SoInput_Reader.cpp"
 #include "SoOutput.cpp"
 #include "SoOutput_Writer.cpp"
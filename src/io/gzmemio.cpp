@@ -54,6 +54,8 @@ typedef void   (*free_func)(void * opaque, void * address);
 #define Z_ERRNO        (-1)
 #define Z_STREAM_END    1
 #define Z_NO_FLUSH      0
+#define Z_SYNC_FLUSH    2
+#define Z_FINISH        4
 #define Z_DEFLATED   8
 #define MAX_WBITS   15 /* 32K LZ77 window */
 
@@ -89,6 +91,7 @@ cc_gzm_sizeof_z_stream(void)
 }
 
 #define Z_BUFSIZE 16384
+#define Z_DEF_MEM_LEVEL 8
 #define Z_NO_DEFLATE 1
 
 #define Z_ALLOC(size) malloc(size)
@@ -850,7 +853,83 @@ cc_gzm_ferror(cc_gzm_file * COIN_UNUSED_ARG(file))
   return 0;
 }
 
+/* ===========================================================================
+   Compresses len bytes from in as a piece of a raw deflate stream.
+   Pieces for consecutive blocks can be compressed independently and
+   then simply be concatenated, as every piece but the last ends with
+   a sync flush, while the last piece (last != 0) terminates the
+   stream. This is used to compress gzip files on several threads.
+
+   On success, *out is set to a buffer allocated with malloc() which
+   the caller must free(), *outlen is set to the size of the data in
+   it, and Z_OK is returned.
+*/
+int
+cc_gzm_deflate_block(const uint8_t * in, uint32_t len,
+                     uint8_t ** out, uint32_t * outlen,
+                     int level, int last)
+{
+  z_stream stream;
+  uint32_t size;
+  uint8_t * buf;
+  int err;
+
+  *out = NULL;
+  *outlen = 0;
+
+  stream.zalloc = (alloc_func)0;
+  stream.zfree = (free_func)0;
+  stream.opaque = (void *)0;
+
+  err = cc_zlibglue_deflateInit2(&stream, level, Z_DEFLATED,
+                                 -MAX_WBITS, Z_DEF_MEM_LEVEL,
+                                 Z_DEFAULT_STRATEGY);
+  /* windowBits is passed < 0 to suppress the zlib header */
+  if (err != Z_OK) return err;
+
+  /* enough for most data, grown below if needed */
+  size = len + (len >> 3) + 64;
+  buf = (uint8_t*) Z_ALLOC(size);
+  if (buf == NULL) {
+    (void) cc_zlibglue_deflateEnd(&stream);
+    return Z_ERRNO;
+  }
+
+  stream.next_in = (unsigned char *) in;
+  stream.avail_in = len;
+  stream.next_out = buf;
+  stream.avail_out = size;
+
+  for (;;) {
+    err = cc_zlibglue_deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (last && err == Z_STREAM_END) break;
+    if (err != Z_OK) break;
+    /* with room left in the output buffer, all the input has been
+       consumed and flushed */
+    if (!last && stream.avail_out != 0) break;
+
+    if (stream.avail_out == 0) {
+      uint8_t * newbuf = (uint8_t*) realloc(buf, size * 2);
+      if (newbuf == NULL) { err = Z_ERRNO; break; }
+      buf = newbuf;
+      stream.next_out = buf + size;
+      stream.avail_out = size;
+      size *= 2;
+    }
+  }
+  (void) cc_zlibglue_deflateEnd(&stream);
+
+  if (err != (last ? Z_STREAM_END : Z_OK)) {
+    Z_TRYFREE(buf);
+    return err;
+  }
+  *out = buf;
+  *outlen = (uint32_t) stream.total_out;
+  return Z_OK;
+}
+
 #undef Z_BUFSIZE
+#undef Z_DEF_MEM_LEVEL
 #undef Z_NO_DEFLATE
 #undef Z_ALLOC
 #undef Z_TRYFREE
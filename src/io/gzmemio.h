@@ -53,6 +53,9 @@ extern "C" {
   int cc_gzm_eof(void * file);
   int cc_gzm_close(void * file);
   int cc_gzm_sizeof_z_stream(void);
+  int cc_gzm_deflate_block(const uint8_t * in, uint32_t len,
+                           uint8_t ** out, uint32_t * outlen,
+                           int level, int last);
   
 
   /*
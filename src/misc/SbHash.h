@@ -118,9 +118,11 @@ unsigned int SbHashFunc(const SbString & key);
 */
 //FIXME: Don't hold these definitions here, but where they are used - BFG 20080729
 class SoBase;
+class SoField;
 class SoOutput;
 class SoSensor;
 unsigned int SbHashFunc(const SoBase * key);
+unsigned int SbHashFunc(const SoField * key);
 unsigned int SbHashFunc(const SoOutput * key);
 unsigned int SbHashFunc(const SoSensor * key);
 
@@ -1077,6 +1077,10 @@ SoBase::read(SoInput * in, SoBase *& base, SoType expectedtype)
   assert(expectedtype != SoType::badType());
   base = NULL;
 
+  // with the index of a binary file loaded, instances can be read out
+  // of order, so we keep track of where each of them is defined
+  size_t pos = in->getNumBytesRead();
+
   SbName name;
   SbBool result = in->read(name, TRUE);
 
@@ -1091,12 +1095,16 @@ SoBase::read(SoInput * in, SoBase *& base, SoType expectedtype)
 
   // read all (vrml97) routes. Do this also for non-vrml97 files,
   // since in Coin we can have a mix of Inventor and VRML97 nodes in
-  // the same file.
-  while (result && name == PImpl::ROUTE_KEYWORD) {
-    result = SoBase::readRoute(in);
+  // the same file. The index at the end of indexed binary files is
+  // skipped over the same way.
+  while (result && ((name == PImpl::ROUTE_KEYWORD) ||
+                    (in->isBinary() && (name == SoInputP::INDEX_KEYWORD)))) {
+    if (name == PImpl::ROUTE_KEYWORD) result = SoBase::readRoute(in);
+    else result = SoInputP::readIndex(in);
     // read next ROUTE keyword
-    if (result) result = in->read(name, TRUE);
-    else return FALSE; // error while reading ROUTE
+    if (!result) return FALSE; // error while reading ROUTE or INDEX
+    pos = in->getNumBytesRead();
+    result = in->read(name, TRUE);
   }
 
   // The SoInput stream does not start with a valid base name. Return
@@ -1107,9 +1115,18 @@ SoBase::read(SoInput * in, SoBase *& base, SoType expectedtype)
   // from SbInput::read(SbName&,TRUE) _should_ also be FALSE.
   assert(name != "");
 
+  const SbBool indexed = in->isBinary() && (name == PImpl::DEF_KEYWORD) &&
+    SoInputP::hasIndex(in);
+
   if (name == PImpl::USE_KEYWORD) result = SoBase::PImpl::readReference(in, base);
   else if (name == PImpl::NULL_KEYWORD) return TRUE;
-  else result = SoBase::PImpl::readBase(in, name, base);
+  else if (indexed && SoInputP::findIndexedInstance(in, pos, base)) result = TRUE;
+  else {
+    SoInputP::pushReadDepth(in);
+    result = SoBase::PImpl::readBase(in, name, base);
+    SoInputP::popReadDepth(in);
+    if (result && indexed) SoInputP::addIndexedInstance(in, pos, base);
+  }
 
   // Check type correctness.
   if (result) {
@@ -1247,6 +1264,7 @@ SoBase::writeHeader(SoOutput * out, SbBool isgroup, SbBool isengine) const
   }
   else {
     if (name != SbName::empty() || multiref) {
+      out->addIndexEntry(writename);
       out->write(PImpl::DEF_KEYWORD);
       if (!out->isBinary()) out->write(' ');
 
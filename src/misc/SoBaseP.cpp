@@ -244,8 +244,13 @@ SoBase::PImpl::readReference(SoInput * in, SoBase *& base)
   }
 
   if ((base = in->findReference(refname)) == NULL) {
-    SoReadError::post(in, "Unknown reference \"%s\"", refname.getString());
-    return FALSE;
+    // instances defined in a part of an indexed binary file we
+    // haven't read are loaded on demand
+    if (!in->isBinary() ||
+        !SoInputP::readIndexedBase(in, refname, in->getNumBytesRead(), base)) {
+      SoReadError::post(in, "Unknown reference \"%s\"", refname.getString());
+      return FALSE;
+    }
   }
 
   // when referencing an SoProtoInstance, we need to return the proto
@@ -40,12 +40,21 @@
   adding or removing children.
 
   Methods for action traversal of the children are also provided.
+
+  The list also keeps the action method index of each child's node
+  type (see SoNode::getActionMethodIndex()), updated by the methods
+  that change the list. During traversal, a child's action method
+  can then be looked up directly in the action's method list,
+  without asking the child for its type.
 */
 
 #include <Inventor/misc/SoChildList.h>
 #include <Inventor/actions/SoAction.h>
 #include <Inventor/nodes/SoNode.h>
 #include <Inventor/SbName.h>
+#include <Inventor/lists/SoActionMethodList.h>
+
+#include <Inventor/annex/Profiler/SoProfiler.h>
 
 #if COIN_DEBUG
 #include <Inventor/errors/SoDebugError.h>
@@ -111,6 +120,7 @@ SoChildList::append(SoNode * const node)
     node->addAuditor(this->parent, SoNotRec::PARENT);
   }
   SoNodeList::append(node);
+  this->methodindices.append(SoNode::getActionMethodIndex(node->getTypeId()));
 
   if (this->parent) {
     this->parent->startNotify();
@@ -138,6 +148,8 @@ SoChildList::insert(SoNode * const node, const int addbefore)
     node->addAuditor(this->parent, SoNotRec::PARENT);
   }
   SoNodeList::insert(node, addbefore);
+  this->methodindices.insert(SoNode::getActionMethodIndex(node->getTypeId()),
+                             addbefore);
 
   // FIXME: shouldn't we move this startNotify() call to the end of
   // the function?  pederb, 2002-10-02
@@ -180,6 +192,7 @@ SoChildList::remove(const int index)
     this->parent->startNotify();
   }
   SoNodeList::remove(index);
+  this->methodindices.remove(index);
 }
 
 /*!
@@ -213,6 +226,7 @@ SoChildList::truncate(const int length)
       }
     }
     SoNodeList::truncate(length);
+    this->methodindices.truncate(length);
   }
 }
 
@@ -231,6 +245,7 @@ SoChildList::copy(const SoChildList & cl)
   // Call truncate() explicitly here to get the path notification.
   this->truncate(0);
   SoBaseList::copy(cl);
+  this->methodindices = cl.methodindices;
 
   // it's important to add parent as auditor for all nodes (this is
   // usually done in SoChildList::append/insert)
@@ -272,6 +287,7 @@ SoChildList::set(const int index, SoNode * const node)
   prevchild->ref();
 
   SoBaseList::set(index, (SoBase *)node);
+  this->methodindices[index] = SoNode::getActionMethodIndex(node->getTypeId());
 
   // FIXME: shouldn't we move this startNotify() call to the end of
   // the function?  pederb, 2002-10-02
@@ -368,16 +384,43 @@ SoChildList::traverse(SoAction * const action, const int first, const int last)
   case SoAction::BELOW_PATH:
     // always traverse all nodes.
     action->pushCurPath();
-    for (i = first; (i <= last) && !action->hasTerminated(); i++) {
+    if (!SoProfiler::isEnabled()) {
+      // same as SoAction::traverse(), but with the method index
+      // stored in the list
+      SoActionMethodList & methods = *action->traversalMethods;
+      for (i = first; (i <= last) && !action->hasTerminated(); i++) {
 #if COIN_DEBUG
-      if (i >= this->getLength()) {
-        changedetected = TRUE;
-        break;
+        if (i >= this->getLength()) {
+          changedetected = TRUE;
+          break;
+        }
+#endif // COIN_DEBUG
+        node = static_cast<SoNode *>(this->get(i));
+        action->popPushCurPath(i, node);
+        // checked for every child, since the list can be changed by
+        // the children's action methods or by callbacks, and through
+        // the base classes, which don't update the indices
+        if (this->methodindices.getLength() == this->getLength()) {
+          methods[this->methodindices[i]](action, node);
+        }
+        else {
+          action->traverse(node);
+        }
       }
+    }
+    else {
+      // profiling
+      for (i = first; (i <= last) && !action->hasTerminated(); i++) {
+#if COIN_DEBUG
+        if (i >= this->getLength()) {
+          changedetected = TRUE;
+          break;
+        }
 #endif // COIN_DEBUG
-      node = (*this)[i];
-      action->popPushCurPath(i, node);
-      action->traverse(node);
+        node = (*this)[i];
+        action->popPushCurPath(i, node);
+        action->traverse(node);
+      }
     }
     action->popCurPath();
     break;
@@ -512,3 +555,77 @@ SoChildList::removePathAuditor(SoPath * const path)
 #endif // COIN_DEBUG
   this->auditors.remove(index);
 }
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoSphere.h>
+
+static SoCallbackAction::Response
+count_node_cb(void * closure, SoCallbackAction *, const SoNode * node)
+{
+  SbString * visited = static_cast<SbString *>(closure);
+  *visited += node->isOfType(SoCube::getClassTypeId()) ? "c" : "s";
+  return SoCallbackAction::CONTINUE;
+}
+
+BOOST_AUTO_TEST_CASE(traverseAfterChanges)
+{
+  SoGroup * root = new SoGroup;
+  root->ref();
+  root->addChild(new SoCube);
+  root->addChild(new SoSphere);
+  root->insertChild(new SoSphere, 0);
+  root->replaceChild(1, new SoSphere);
+  root->insertChild(new SoCube, 2);
+  root->removeChild(3);
+
+  SbString visited;
+  SoCallbackAction action;
+  action.addPreCallback(SoCube::getClassTypeId(), count_node_cb, &visited);
+  action.addPreCallback(SoSphere::getClassTypeId(), count_node_cb, &visited);
+  action.apply(root);
+  BOOST_CHECK(visited == "ssc");
+
+  SoGroup * copy = static_cast<SoGroup *>(root->copy());
+  copy->ref();
+  copy->addChild(new SoCube);
+  visited.makeEmpty();
+  action.apply(copy);
+  BOOST_CHECK(visited == "sscc");
+
+  copy->unref();
+  root->unref();
+}
+
+static SoCallbackAction::Response
+add_child_cb(void * closure, SoCallbackAction *, const SoNode *)
+{
+  SoGroup * root = static_cast<SoGroup *>(closure);
+  if (root->getNumChildren() < 40) root->addChild(new SoSphere);
+  return SoCallbackAction::CONTINUE;
+}
+
+BOOST_AUTO_TEST_CASE(traverseWhileChanging)
+{
+  SoGroup * root = new SoGroup;
+  root->ref();
+  for (int i = 0; i < 16; i++) root->addChild(new SoCube);
+
+  // the list grows, and its arrays are reallocated, while the
+  // children are traversed
+  SbString visited;
+  SoCallbackAction action;
+  action.addPreCallback(SoCube::getClassTypeId(), add_child_cb, root);
+  action.addPreCallback(SoCube::getClassTypeId(), count_node_cb, &visited);
+  action.addPreCallback(SoSphere::getClassTypeId(), count_node_cb, &visited);
+  action.apply(root);
+  BOOST_CHECK_EQUAL(root->getNumChildren(), 32);
+  BOOST_CHECK(visited == "cccccccccccccccc");
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
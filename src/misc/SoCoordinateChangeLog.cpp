@@ -0,0 +1,204 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+// SoCoordinateChangeLog is documented in SoCoordinateChangeLog.h.
+
+#include "misc/SoCoordinateChangeLog.h"
+
+#include <atomic>
+
+#include <Inventor/misc/SoNotification.h>
+#include <Inventor/misc/SoNotRec.h>
+
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+// The log is a small ring of the latest changes, shared by all
+// coordinate nodes. If a shape falls so far behind that its changes
+// have been overwritten, it will just recompute its bounding box.
+#define SOCOORDINATECHANGELOG_SIZE 64
+
+// isChanged() is called for every bounding box calculation of every
+// vertex shape, so it first looks the node id up in a table of the
+// latest logged ids, indexed by the low bits of the id, which needs no
+// locking. Ids which share a slot just overwrite each other, which at
+// worst makes a shape recompute its bounding box.
+#define SOCOORDINATECHANGELOG_FILTERSIZE 256
+
+namespace {
+
+struct changelog_entry {
+  uint32_t previd;
+  uint32_t newid;
+  int start;
+  int num; // 0 when no coordinates were changed
+};
+
+changelog_entry changelog_entries[SOCOORDINATECHANGELOG_SIZE];
+std::atomic<int> changelog_numentries(0);
+int changelog_next = 0;
+void * changelog_mutex = NULL;
+std::atomic<uint32_t> changelog_filter[SOCOORDINATECHANGELOG_FILTERSIZE];
+
+std::atomic<uint32_t> &
+changelog_filter_slot(const uint32_t nodeid)
+{
+  return changelog_filter[nodeid % SOCOORDINATECHANGELOG_FILTERSIZE];
+}
+
+void
+changelog_cleanup(void)
+{
+  CC_MUTEX_DESTRUCT(changelog_mutex);
+  changelog_numentries = 0;
+  changelog_next = 0;
+  for (int i = 0; i < SOCOORDINATECHANGELOG_FILTERSIZE; i++) {
+    changelog_filter[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+// must be called with the mutex locked
+const changelog_entry *
+changelog_find(const uint32_t previd)
+{
+  const int num = changelog_numentries.load(std::memory_order_relaxed);
+  for (int i = 0; i < num; i++) {
+    if (changelog_entries[i].previd == previd) return &changelog_entries[i];
+  }
+  return NULL;
+}
+
+} // namespace
+
+// *************************************************************************
+
+// Returns TRUE if the notification in list is known to change either
+// just the values from start to start+num-1 of the coords field, or
+// some other field of the node (num will then be 0).
+SbBool
+SoCoordinateChangeLog::getChangedIndices(SoNotList * list,
+                                         const SoField * coords,
+                                         int & start, int & num)
+{
+  const SoField * field = list->getLastField();
+  if (field == NULL) return FALSE;
+  if (field != coords) {
+    start = 0;
+    num = 0;
+    return TRUE;
+  }
+  // changes passed on from connected fields or engines are not
+  // ranged, even if the original change was
+  const SoNotRec * rec = list->getFirstRec();
+  if (rec != list->getLastRec()) return FALSE;
+  start = rec->getIndex();
+  num = rec->getFieldNumIndices();
+  return (start >= 0) && (num > 0);
+}
+
+// Records that a coordinate node changed its id from previd to newid,
+// and that only num coordinates from start were changed.
+void
+SoCoordinateChangeLog::changed(const uint32_t previd, const uint32_t newid,
+                               const int start, const int num)
+{
+  if (previd == newid) return;
+
+  if (changelog_mutex == NULL) {
+    CC_MUTEX_CONSTRUCT(changelog_mutex);
+    coin_atexit((coin_atexit_f *) changelog_cleanup, CC_ATEXIT_NORMAL);
+  }
+  CC_MUTEX_LOCK(changelog_mutex);
+  changelog_entry & entry = changelog_entries[changelog_next];
+  entry.previd = previd;
+  entry.newid = newid;
+  entry.start = start;
+  entry.num = num;
+  changelog_next = (changelog_next + 1) % SOCOORDINATECHANGELOG_SIZE;
+  if (changelog_numentries.load(std::memory_order_relaxed) < SOCOORDINATECHANGELOG_SIZE) {
+    changelog_numentries.fetch_add(1, std::memory_order_release);
+  }
+  changelog_filter_slot(newid).store(newid, std::memory_order_release);
+  CC_MUTEX_UNLOCK(changelog_mutex);
+}
+
+// Returns TRUE if a node got nodeid from a logged change.
+SbBool
+SoCoordinateChangeLog::isChanged(const uint32_t nodeid)
+{
+  if (changelog_filter_slot(nodeid).load(std::memory_order_acquire) != nodeid) {
+    return FALSE;
+  }
+  if (changelog_numentries.load(std::memory_order_acquire) == 0) return FALSE;
+
+  // the id may since have been overwritten in the ring
+  SbBool found = FALSE;
+  CC_MUTEX_LOCK(changelog_mutex);
+  const int num = changelog_numentries.load(std::memory_order_relaxed);
+  for (int i = 0; i < num && !found; i++) {
+    found = (changelog_entries[i].newid == nodeid);
+  }
+  CC_MUTEX_UNLOCK(changelog_mutex);
+  return found;
+}
+
+// Appends the start and number of the coordinates changed between
+// fromid and toid to ranges. Returns FALSE if the changes are not
+// all in the log.
+SbBool
+SoCoordinateChangeLog::getChanges(const uint32_t fromid, const uint32_t toid,
+                                  SbList<int> & ranges)
+{
+  if (fromid == toid) return TRUE;
+  if (changelog_numentries.load(std::memory_order_acquire) == 0) return FALSE;
+
+  SbBool found = FALSE;
+  CC_MUTEX_LOCK(changelog_mutex);
+  uint32_t id = fromid;
+  for (int i = 0; i < SOCOORDINATECHANGELOG_SIZE && !found; i++) {
+    const changelog_entry * entry = changelog_find(id);
+    if (entry == NULL) break;
+    if (entry->num > 0) {
+      ranges.append(entry->start);
+      ranges.append(entry->num);
+    }
+    id = entry->newid;
+    found = (id == toid);
+  }
+  CC_MUTEX_UNLOCK(changelog_mutex);
+  return found;
+}
+
+#undef SOCOORDINATECHANGELOG_SIZE
+#undef SOCOORDINATECHANGELOG_FILTERSIZE
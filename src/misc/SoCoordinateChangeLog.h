@@ -0,0 +1,69 @@
+#ifndef COIN_SOCOORDINATECHANGELOG_H
+#define COIN_SOCOORDINATECHANGELOG_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif // !COIN_INTERNAL
+
+#include <Inventor/SbBasic.h>
+#include <Inventor/lists/SbList.h>
+
+class SoNotList;
+class SoField;
+
+// SoCoordinateChangeLog keeps a short history of which coordinates
+// were changed by notifications from coordinate nodes. Each change
+// is recorded with the node id before and after the change, so that
+// a shape which remembers the node id it last saw can find the index
+// ranges changed since then, and update its bounding box for just
+// those coordinates.
+//
+// Only changes which are known to touch a range of the coordinates,
+// or none of them, are recorded. A node id with no entry means that
+// anything may have changed.
+
+class SoCoordinateChangeLog {
+public:
+  static SbBool getChangedIndices(SoNotList * list, const SoField * coords,
+                                  int & start, int & num);
+  static void changed(const uint32_t previd, const uint32_t newid,
+                      const int start, const int num);
+
+  static SbBool isChanged(const uint32_t nodeid);
+  static SbBool getChanges(const uint32_t fromid, const uint32_t toid,
+                           SbList<int> & ranges);
+};
+
+#endif // !COIN_SOCOORDINATECHANGELOG_H
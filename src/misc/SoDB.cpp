@@ -91,6 +91,7 @@
 #include <Inventor/fields/SoSFTime.h>
 #include <Inventor/misc/SoGLBigImage.h>
 #include <Inventor/misc/SoGLImage.h>
+#include <Inventor/misc/SoNotification.h>
 #include <Inventor/misc/SoProto.h>
 #include <Inventor/misc/SoProtoInstance.h>
 #include <Inventor/nodes/SoSeparator.h>
@@ -115,6 +116,7 @@
 #include "misc/CoinStaticObjectInDLL.h"
 #include "misc/systemsanity.icc"
 #include "misc/SoDBP.h"
+#include "io/SoInputP.h"
 #include "misc/SbHash.h"
 #include "misc/SoConfigSettings.h"
 #include "rendering/SoVBO.h"
@@ -703,6 +705,51 @@ SoDB::readAllVRML(SoInput * in)
 #endif // ! HAVE_VRML97
 }
 
+/*!
+  Reads the node which was written with the DEF name \a name, and its
+  subgraph, from an indexed binary file written with
+  SoOutput::setIndexed(). Only the parts of the file needed for that
+  subgraph are read, so this is a lot faster than readAll() for
+  picking a single part out of a large file. The file must be read
+  from disk or a memory buffer, not through a pipe or decompression.
+
+  Nodes which have already been read through \a input are returned
+  as they are. Note that, like for any other node you read, the
+  returned node has a reference count of zero.
+
+  Returns \c NULL if \a input isn't an indexed file, if no node was
+  written with the name \a name, or on any read error. The read
+  position of \a input is left unchanged, so this can be combined
+  with other reads from the same file.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa SoOutput::setIndexed()
+  \since Coin 4.1
+*/
+SoNode *
+SoDB::readNamedNode(SoInput * in, const SbName & name)
+{
+  SoBase * base = in->findReference(name);
+  if (base == NULL) {
+    if (!SoInputP::loadIndex(in)) {
+      SoReadError::post(in, "Not an indexed binary file, or the file "
+                        "can't be read with random access.");
+      return NULL;
+    }
+    if (!SoInputP::readIndexedBase(in, name, 0, base)) {
+      SoReadError::post(in, "Unable to read '%s' from the index",
+                        name.getString());
+      return NULL;
+    }
+  }
+  if (!base->isOfType(SoNode::getClassTypeId())) {
+    SoReadError::post(in, "'%s' not derived from SoNode", name.getString());
+    return NULL;
+  }
+  return (SoNode *)base;
+}
+
 /*!
   Check if \a testString is a valid file format header identifier string.
 
@@ -1172,6 +1219,90 @@ SoDB::endNotify(void)
 
 }
 
+/*!
+  Starts a batch of field updates. Until the matching
+  endNotificationBatch() call, fields of nodes which are changed will
+  not notify their nodes. Instead, each changed field is recorded once,
+  no matter how many times it is set, and the nodes are notified when
+  the outermost batch ends.
+
+  This is useful when a lot of fields are set in one go, for instance
+  when updating the transforms of many objects from a simulation. When
+  the batch ends, the notification travels up through the scene graph
+  once for each node and parent, instead of once for every value that
+  was set, and "immediate" (zero priority) sensors are triggered once,
+  after all the nodes have been notified.
+
+  Fields connected to a changed field, engines reading from it, and
+  field sensors are still notified at once, so they see the new value
+  during the batch. Notification from other changes, like adding or
+  removing children of a group node, is not held back either.
+
+  Batches can be nested, and are global, not per thread. The list of
+  batched fields is guarded by the notification lock, which is only
+  present when Coin is built with \c COIN_THREADSAFE. Without it,
+  notification batches must not be used while fields are changed or
+  destructed from several threads.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa endNotificationBatch()
+  \since Coin 4.1
+*/
+void
+SoDB::beginNotificationBatch(void)
+{
+  SoDB::startNotify();
+  if (SoDBP::batchedfields == NULL) {
+    SoDBP::batchedfields = new SbList<SoField *>;
+    SoDBP::batchedfieldslots = new SbHash<SoField *, int>;
+  }
+  SoDBP::notificationbatch++;
+  SoDB::endNotify();
+}
+
+/*!
+  Ends a batch of field updates started with beginNotificationBatch().
+  When the outermost batch ends, the nodes of every field which was
+  changed during the batch are notified.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa beginNotificationBatch()
+  \since Coin 4.1
+*/
+void
+SoDB::endNotificationBatch(void)
+{
+  // Notification is "started" around the whole batch, so immediate
+  // sensors are triggered only once, after the last field.
+  SoDB::startNotify();
+  assert(SoDBP::notificationbatch > 0 && "unmatched endNotificationBatch()");
+  if (--SoDBP::notificationbatch == 0) {
+    SbList<SoField *> & fields = *SoDBP::batchedfields;
+    // All the notifications get the time stamp of one list, so that
+    // SoNode::notify() stops at nodes which have already been
+    // notified. Each node still sees all its changed fields, but a
+    // node and its parents propagate the notification only once.
+    const SoNotList stamp;
+    // Fields destructed while in the list are set to NULL.
+    for (int i = 0; i < fields.getLength(); i++) {
+      SoField * field = fields[i];
+      if (field == NULL) continue;
+      SoFieldContainer * cont = field->getContainer();
+      SoNotList l(&stamp);
+      SoNotRec rec(cont);
+      rec.setOperationType(SoNotRec::FIELD_UPDATE);
+      l.append(&rec, field);
+      l.setLastType(SoNotRec::CONTAINER);
+      cont->notify(&l);
+    }
+    fields.truncate(0);
+    SoDBP::batchedfieldslots->clear();
+  }
+  SoDB::endNotify();
+}
+
 /*!
   Turn on or off the real time sensor.
 
@@ -1246,14 +1377,20 @@ SoDB::readAllWrapper(SoInput * in, const SoType & grouptype)
 
   SoGroup * root = (SoGroup *)grouptype.createInstance();
   SoNode * topnode;
+  SoInputP::beginReadAll(in);
   do {
     if (!SoDB::read(in, topnode)) {
+      SoInputP::endReadAll(in);
       root->ref();
       root->unref();
       return NULL;
     }
-    if (topnode) { root->addChild(topnode); }
+    if (topnode) {
+      root->addChild(topnode);
+      SoInputP::nodeRead(in, topnode, root);
+    }
   } while (topnode && in->skipWhiteSpace());
+  SoInputP::endReadAll(in);
 
   if (!in->eof()) {
     // All  characters  may not  have  been  read  from the  current
@@ -1691,14 +1828,25 @@ SoDB::removeRoute(SoNode * fromnode, const char * eventout,
 
 #include <Inventor/SoInput.h>
 #include <Inventor/SoInteraction.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/actions/SoWriteAction.h>
 #include <Inventor/errors/SoReadError.h>
 #include <Inventor/fields/SoMFNode.h>
 #include <Inventor/fields/SoSFTime.h>
 #include <Inventor/nodekits/SoNodeKit.h>
+#include <Inventor/nodes/SoCube.h>
 #include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoMaterial.h>
 #include <Inventor/nodes/SoNode.h>
 #include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
 #include <Inventor/nodes/SoRotationXYZ.h>
+#include <Inventor/nodes/SoTranslation.h>
+#include <Inventor/nodes/SoTransform.h>
+#include <Inventor/sensors/SoNodeSensor.h>
+#include <Inventor/engines/SoDecomposeVec3f.h>
+#include <Inventor/fields/SoSFFloat.h>
+#include <Inventor/misc/SoNotification.h>
 #include <boost/detail/workaround.hpp>
 
 BOOST_AUTO_TEST_CASE(globalRealTimeField)
@@ -1896,6 +2044,214 @@ BOOST_AUTO_TEST_CASE(globalfield_import)
   g->unref();
 }
 
+BOOST_AUTO_TEST_CASE(readNamedNode)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoMaterial * material = new SoMaterial;
+  material->setName("shared");
+  SoSeparator * first = new SoSeparator;
+  first->setName("first");
+  first->addChild(material);
+  first->addChild(new SoCube);
+  SoSeparator * second = new SoSeparator;
+  second->setName("second");
+  second->addChild(material);
+  second->addChild(new SoSphere);
+  root->addChild(first);
+  root->addChild(second);
+
+  void * buf[2];
+  size_t size[2];
+  for (int i = 0; i < 2; i++) {
+    SoOutput out;
+    out.setBuffer(malloc(1024), 1024, realloc);
+    out.setBinary(TRUE);
+    out.setIndexed(i == 0);
+    SoWriteAction wa(&out);
+    wa.apply(root);
+    BOOST_REQUIRE(out.getBuffer(buf[i], size[i]));
+  }
+  root->unref();
+
+  // indexed files read as any other binary file
+  {
+    SoInput in;
+    in.setBuffer(buf[0], size[0]);
+    SoSeparator * all = SoDB::readAll(&in);
+    BOOST_REQUIRE(all);
+    all->ref();
+    BOOST_REQUIRE_EQUAL(all->getNumChildren(), 2);
+    BOOST_CHECK_EQUAL(((SoGroup *)all->getChild(1))->getNumChildren(), 2);
+    all->unref();
+  }
+
+  {
+    SoInput in;
+    in.setBuffer(buf[0], size[0]);
+    SoNode * node = SoDB::readNamedNode(&in, "second");
+    BOOST_REQUIRE(node && node->isOfType(SoSeparator::getClassTypeId()));
+    node->ref();
+    SoGroup * group = (SoGroup *)node;
+    BOOST_REQUIRE_EQUAL(group->getNumChildren(), 2);
+    BOOST_CHECK(group->getChild(0)->isOfType(SoMaterial::getClassTypeId()));
+    BOOST_CHECK(group->getChild(0)->getName() == "shared");
+    BOOST_CHECK(group->getChild(1)->isOfType(SoSphere::getClassTypeId()));
+
+    SoNode * other = SoDB::readNamedNode(&in, "first");
+    BOOST_REQUIRE(other);
+    other->ref();
+    BOOST_REQUIRE_EQUAL(((SoGroup *)other)->getNumChildren(), 2);
+    BOOST_CHECK(((SoGroup *)other)->getChild(0) == group->getChild(0));
+    BOOST_CHECK(SoDB::readNamedNode(&in, "second") == node);
+    other->unref();
+    node->unref();
+  }
+
+  // files without an index can't be read this way
+  {
+    SoErrorCB * prevErrorCB = SoReadError::getHandlerCallback();
+    SoReadError::setHandlerCallback(readErrorHandler, NULL);
+    SoInput in;
+    in.setBuffer(buf[1], size[1]);
+    BOOST_CHECK(SoDB::readNamedNode(&in, "second") == NULL);
+    SoReadError::setHandlerCallback(prevErrorCB, NULL);
+  }
+
+  free(buf[0]);
+  free(buf[1]);
+}
+
 // *************************************************************************
 
+static void
+notificationBatch_cb(void * data, SoSensor *)
+{
+  (*static_cast<int *>(data))++;
+}
+
+BOOST_AUTO_TEST_CASE(notificationBatch)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoTranslation * t0 = new SoTranslation;
+  SoTranslation * t1 = new SoTranslation;
+  SoTranslation * dying = new SoTranslation;
+  root->addChild(t0);
+  root->addChild(t1);
+  root->addChild(dying);
+
+  int triggered = 0;
+  SoNodeSensor sensor(notificationBatch_cb, &triggered);
+  sensor.setPriority(0);
+  sensor.attach(root);
+
+  t0->translation.setValue(1.0f, 0.0f, 0.0f);
+  t1->translation.setValue(1.0f, 0.0f, 0.0f);
+  BOOST_CHECK_EQUAL(triggered, 2);
+
+  triggered = 0;
+  SoDB::beginNotificationBatch();
+  for (int i = 0; i < 100; i++) {
+    t0->translation.setValue(float(i), 0.0f, 0.0f);
+    t1->translation.setValue(0.0f, float(i), 0.0f);
+    SoDB::beginNotificationBatch();
+    dying->translation.setValue(0.0f, 0.0f, float(i));
+    SoDB::endNotificationBatch();
+  }
+  root->removeChild(dying);
+  const int beforeend = triggered;
+  SoDB::endNotificationBatch();
+
+  BOOST_CHECK_MESSAGE(beforeend == 1, "only the removeChild() should notify in the batch");
+  BOOST_CHECK_MESSAGE(triggered == 2, "the batched fields should notify once");
+  BOOST_CHECK(t0->translation.getValue() == SbVec3f(99.0f, 0.0f, 0.0f));
+  BOOST_CHECK(t1->translation.getValue() == SbVec3f(0.0f, 99.0f, 0.0f));
+
+  t0->translation.setValue(0.0f, 0.0f, 0.0f);
+  BOOST_CHECK_EQUAL(triggered, 3);
+
+  sensor.detach();
+  root->unref();
+}
+
+// counts the notifications of a node, and the fields they came from
+template <class Base>
+class NotificationBatchCounter : public Base {
+public:
+  NotificationBatchCounter(void) : count(0) { }
+  virtual void notify(SoNotList * l) {
+    this->count++;
+    this->fields.append(l->getLastField());
+    Base::notify(l);
+  }
+  int count;
+  SbList <SoField *> fields;
+};
+
+BOOST_AUTO_TEST_CASE(notificationBatchOncePerNode)
+{
+  NotificationBatchCounter<SoSeparator> * root = new NotificationBatchCounter<SoSeparator>;
+  root->ref();
+  SoSeparator * group = new SoSeparator;
+  NotificationBatchCounter<SoTransform> * t0 = new NotificationBatchCounter<SoTransform>;
+  SoTransform * t1 = new SoTransform;
+  group->addChild(t0);
+  group->addChild(t1);
+  root->addChild(group);
+  root->count = 0;
+
+  SoDB::beginNotificationBatch();
+  for (int i = 0; i < 10; i++) {
+    t0->translation.setValue(float(i), 0.0f, 0.0f);
+    t0->scaleFactor.setValue(1.0f, float(i), 1.0f);
+    t1->translation.setValue(0.0f, float(i), 0.0f);
+  }
+  BOOST_CHECK_EQUAL(root->count, 0);
+  BOOST_CHECK_EQUAL(t0->count, 0);
+  SoDB::endNotificationBatch();
+
+  // the node sees both of its changed fields, but the notification
+  // goes up through the scene graph once
+  BOOST_CHECK_EQUAL(t0->count, 2);
+  BOOST_CHECK(t0->fields.find(&t0->translation) >= 0);
+  BOOST_CHECK(t0->fields.find(&t0->scaleFactor) >= 0);
+  BOOST_CHECK_EQUAL(root->count, 1);
+
+  // and a later change notifies as usual
+  t1->translation.setValue(0.0f, 0.0f, 1.0f);
+  BOOST_CHECK_EQUAL(root->count, 2);
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(notificationBatchConnections)
+{
+  SoTranslation * master = new SoTranslation;
+  master->ref();
+  SoTranslation * slave = new SoTranslation;
+  slave->ref();
+  slave->translation.connectFrom(&master->translation);
+  SoDecomposeVec3f * engine = new SoDecomposeVec3f;
+  engine->ref();
+  engine->vector.connectFrom(&master->translation);
+  SoSFFloat x;
+  x.connectFrom(&engine->x);
+
+  SoDB::beginNotificationBatch();
+  master->translation.setValue(1.0f, 2.0f, 3.0f);
+  // connected fields and engines are updated during the batch
+  BOOST_CHECK(slave->translation.getValue() == SbVec3f(1.0f, 2.0f, 3.0f));
+  BOOST_CHECK_EQUAL(x.getValue(), 1.0f);
+  master->translation.setValue(4.0f, 5.0f, 6.0f);
+  BOOST_CHECK(slave->translation.getValue() == SbVec3f(4.0f, 5.0f, 6.0f));
+  BOOST_CHECK_EQUAL(x.getValue(), 4.0f);
+  SoDB::endNotificationBatch();
+
+  x.disconnect();
+  engine->unref();
+  slave->unref();
+  master->unref();
+}
+
 #endif // COIN_TEST_SUITE
@@ -30,6 +30,9 @@ SoTimerSensor * SoDBP::globaltimersensor = NULL;
 UInt32ToInt16Map * SoDBP::converters = NULL;
 SbBool SoDBP::isinitialized = FALSE;
 int SoDBP::notificationcounter = 0;
+int SoDBP::notificationbatch = 0;
+SbList<SoField *> * SoDBP::batchedfields = NULL;
+SbHash<SoField *, int> * SoDBP::batchedfieldslots = NULL;
 SbList<SoDBP::ProgressCallbackInfo> * SoDBP::progresscblist = NULL;
 
 // *************************************************************************
@@ -109,6 +112,10 @@ SoDBP::clean(void)
 {
   delete SoDBP::progresscblist;
   SoDBP::progresscblist = NULL;
+  delete SoDBP::batchedfields;
+  SoDBP::batchedfields = NULL;
+  delete SoDBP::batchedfieldslots;
+  SoDBP::batchedfieldslots = NULL;
 
   // Avoid having the SoSensorManager instance trigging the callback
   // into the So@Gui@ class -- not only have it possible "died", but
@@ -92,6 +92,11 @@ public:
   static SoTimerSensor * globaltimersensor;
   static UInt32ToInt16Map * converters;
   static int notificationcounter;
+  static int notificationbatch;
+  // fields whose containers are notified when the batch ends, in the
+  // order they changed, and the position of each field in that list
+  static SbList<SoField *> * batchedfields;
+  static SbHash<SoField *, int> * batchedfieldslots;
   static SbBool isinitialized;
 
   static SbBool is3dsFile(SoInput * in);
@@ -41,12 +41,107 @@
 
 #include <Inventor/misc/SoNormalGenerator.h>
 
+#include <atomic>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
+#include <Inventor/C/tidbits.h> // coin_getenv()
+#include <Inventor/C/threads/condvar.h>
+#include <Inventor/C/threads/mutex.h>
+#include <Inventor/C/threads/sched.h>
 #include <Inventor/errors/SoDebugError.h>
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+inline unsigned int SbHashFunc(const void * key);
+#include "misc/SbHash.h"
+inline unsigned int SbHashFunc(const void * key)
+{
+  return SbHashFunc(reinterpret_cast<size_t>(key));
+}
+
 #include "tidbitsp.h"
 #include "coindefs.h" // COIN_OBSOLETED()
+#include "threads/threadsutilp.h"
+
+// *************************************************************************
+
+// The welded points, which used to be kept in the bsp member.
+class SoNormalGeneratorP {
+public:
+  SoNormalGeneratorP(const int approxVertices)
+    : pointList(approxVertices) { }
+
+  SbList <SbVec3f> pointList;
+  // open addressing hash table of indices into pointList, with -1
+  // for unused entries
+  SbList <int> pointHash;
+};
+
+// SoNormalGenerator has no pimpl pointer, and its layout can't change
+// without breaking the ABI, so the private data is kept in a table
+// keyed by the generator.
+typedef SbHash<const void *, SoNormalGeneratorP *> SoNormalGeneratorPrivates;
+static SoNormalGeneratorPrivates * sonormalgenerator_privates = NULL;
+static void * sonormalgenerator_privatesmutex = NULL;
+
+static void
+sonormalgenerator_privates_cleanup(void)
+{
+  delete sonormalgenerator_privates;
+  sonormalgenerator_privates = NULL;
+  CC_MUTEX_DESTRUCT(sonormalgenerator_privatesmutex);
+}
+
+static SoNormalGeneratorP *
+sonormalgenerator_get_private(const SoNormalGenerator * generator)
+{
+  SoNormalGeneratorP * pimpl = NULL;
+  CC_MUTEX_LOCK(sonormalgenerator_privatesmutex);
+  (void) sonormalgenerator_privates->get(generator, pimpl);
+  CC_MUTEX_UNLOCK(sonormalgenerator_privatesmutex);
+  assert(pimpl && "no private data for SoNormalGenerator");
+  return pimpl;
+}
+
+#define PRIVATE(obj) (sonormalgenerator_get_private(obj))
+
+// *************************************************************************
+
+// Vertex normals are calculated in chunks of this many vertices, and
+// only on several threads when there are at least two chunks.
+#define SONORMALGENERATOR_CHUNKSIZE 8192
+
+static int sonormalgenerator_numthreads = -1;
+
+static int
+sonormalgenerator_get_numthreads(void)
+{
+  if (sonormalgenerator_numthreads == -1) {
+    const char * env = coin_getenv("COIN_SONORMALGENERATOR_THREADS");
+    const int threads = env ? atoi(env) : 0;
+    sonormalgenerator_numthreads = SbMax(threads, 0);
+  }
+  return sonormalgenerator_numthreads;
+}
+
+// The points are welded with the same test as SbBSPTree::addPoint()
+// used, plain float comparison, so -0.0 and 0.0 must hash the same.
+static uint32_t
+sonormalgenerator_hash(const SbVec3f & pt)
+{
+  uint32_t h = 0;
+  for (int i = 0; i < 3; i++) {
+    const float f = (pt[i] == 0.0f) ? 0.0f : pt[i];
+    uint32_t bits;
+    (void) memcpy(&bits, &f, sizeof(bits));
+    h = (h ^ bits) * 0x9e3779b1;
+  }
+  return h ^ (h >> 16);
+}
 
 /*!
   Constructor with \a isccw indicating if polygons are specified
@@ -55,7 +150,7 @@
 */
 SoNormalGenerator::SoNormalGenerator(const SbBool isccw,
                                      const int approxVertices)
-  : bsp(128, approxVertices),
+  : bsp(128, 1), // not used any more
     vertexList(approxVertices),
     vertexFace(approxVertices),
     faceNormals(approxVertices / 4),
@@ -63,6 +158,16 @@ SoNormalGenerator::SoNormalGenerator(const SbBool isccw,
     ccw(isccw),
     perVertex(TRUE)
 {
+  CC_MUTEX_CONSTRUCT(sonormalgenerator_privatesmutex);
+  CC_MUTEX_LOCK(sonormalgenerator_privatesmutex);
+  if (sonormalgenerator_privates == NULL) {
+    sonormalgenerator_privates = new SoNormalGeneratorPrivates;
+    coin_atexit((coin_atexit_f *) sonormalgenerator_privates_cleanup,
+                CC_ATEXIT_NORMAL);
+  }
+  (void) sonormalgenerator_privates->put(this,
+                                         new SoNormalGeneratorP(approxVertices));
+  CC_MUTEX_UNLOCK(sonormalgenerator_privatesmutex);
 }
 
 /*!
@@ -70,6 +175,12 @@ SoNormalGenerator::SoNormalGenerator(const SbBool isccw,
 */
 SoNormalGenerator::~SoNormalGenerator()
 {
+  SoNormalGeneratorP * pimpl = NULL;
+  CC_MUTEX_LOCK(sonormalgenerator_privatesmutex);
+  (void) sonormalgenerator_privates->get(this, pimpl);
+  (void) sonormalgenerator_privates->erase(this);
+  CC_MUTEX_UNLOCK(sonormalgenerator_privatesmutex);
+  delete pimpl;
 }
 
 /*!
@@ -84,7 +195,9 @@ void
 SoNormalGenerator::reset(const SbBool ccwarg)
 {
   this->ccw = ccwarg;
-  this->bsp.clear();
+  SoNormalGeneratorP * pimpl = PRIVATE(this);
+  pimpl->pointList.truncate(0);
+  pimpl->pointHash.truncate(0);
   this->vertexList.truncate(0);
   this->vertexFace.truncate(0);
   this->faceNormals.truncate(0);
@@ -111,7 +224,7 @@ SoNormalGenerator::beginPolygon(void)
 void
 SoNormalGenerator::polygonVertex(const SbVec3f &v)
 {
-  this->vertexList.append(this->bsp.addPoint(v));
+  this->vertexList.append(this->addPoint(v));
   this->vertexFace.append(this->faceNormals.getLength());
 }
 
@@ -165,14 +278,13 @@ SoNormalGenerator::quad(const SbVec3f &v0,
 //
 static void
 calc_normal_vec(const SbVec3f *facenormals, const int facenum,
-                SbList <int32_t> &faceArray, const float threshold,
+                const int32_t * faceArray, const int n, const float threshold,
                 SbVec3f &vertnormal)
 {
   // start with face normal vector
   const SbVec3f * facenormal = &facenormals[facenum];
   vertnormal = *facenormal;
 
-  int n = faceArray.getLength();
   int currface;
 
   for (int i = 0; i < n; i++) {
@@ -187,6 +299,98 @@ calc_normal_vec(const SbVec3f *facenormals, const int facenum,
   }
 }
 
+namespace {
+
+struct sonormalgenerator_job {
+  const SbVec3f * facenormals;
+  const int * vertexface;
+  const int * vertexlist;
+  const int * facestart; // for each point, where its faces start in faces
+  const int32_t * faces;
+  const int32_t * vertices;
+  int numvertices;
+  float threshold;
+  SbVec3f * normals;
+  std::atomic<int> next; // next chunk to calculate
+#ifdef HAVE_THREADS
+  // workers still running, guarded by mutex
+  int pending;
+  cc_mutex * mutex;
+  cc_condvar * done;
+#endif // HAVE_THREADS
+};
+
+void
+sonormalgenerator_calc_chunks(sonormalgenerator_job * job)
+{
+  const int numchunks =
+    (job->numvertices + SONORMALGENERATOR_CHUNKSIZE - 1) / SONORMALGENERATOR_CHUNKSIZE;
+  int chunk;
+  while ((chunk = job->next.fetch_add(1)) < numchunks) {
+    const int start = chunk * SONORMALGENERATOR_CHUNKSIZE;
+    const int end = SbMin(start + SONORMALGENERATOR_CHUNKSIZE, job->numvertices);
+    for (int k = start; k < end; k++) {
+      const int i = job->vertices ? job->vertices[k] : k;
+      const int pt = job->vertexlist[i];
+      SbVec3f tmpvec;
+      calc_normal_vec(job->facenormals, job->vertexface[i],
+                      job->faces + job->facestart[pt],
+                      job->facestart[pt + 1] - job->facestart[pt],
+                      job->threshold, tmpvec);
+      (void) tmpvec.normalize();
+      job->normals[k] = tmpvec;
+    }
+  }
+}
+
+#ifdef HAVE_THREADS
+
+// shared by all normal generators. The mutex only guards creating
+// and resizing it, so several threads can generate normals at once.
+cc_sched * sonormalgenerator_sched = NULL;
+void * sonormalgenerator_mutex = NULL;
+
+void
+sonormalgenerator_cleanup(void)
+{
+  if (sonormalgenerator_sched) {
+    cc_sched_destruct(sonormalgenerator_sched);
+    sonormalgenerator_sched = NULL;
+  }
+  CC_MUTEX_DESTRUCT(sonormalgenerator_mutex);
+}
+
+void
+sonormalgenerator_calc_cb(void * closure)
+{
+  sonormalgenerator_job * job = static_cast<sonormalgenerator_job *>(closure);
+  sonormalgenerator_calc_chunks(job);
+  cc_mutex_lock(job->mutex);
+  if (--job->pending == 0) cc_condvar_wake_all(job->done);
+  cc_mutex_unlock(job->mutex);
+}
+
+cc_sched *
+sonormalgenerator_get_sched(const int numthreads)
+{
+  CC_MUTEX_CONSTRUCT(sonormalgenerator_mutex);
+  CC_MUTEX_LOCK(sonormalgenerator_mutex);
+  if (sonormalgenerator_sched == NULL) {
+    sonormalgenerator_sched = cc_sched_construct(numthreads);
+    coin_atexit((coin_atexit_f *) sonormalgenerator_cleanup, CC_ATEXIT_NORMAL);
+  }
+  else if (cc_sched_get_num_threads(sonormalgenerator_sched) < numthreads) {
+    cc_sched_set_num_threads(sonormalgenerator_sched, numthreads);
+  }
+  cc_sched * sched = sonormalgenerator_sched;
+  CC_MUTEX_UNLOCK(sonormalgenerator_mutex);
+  return sched;
+}
+
+#endif // HAVE_THREADS
+
+} // namespace
+
 /*!
   Triggers the normal generation. Normals are generated using
   \a creaseAngle to find which edges should be flat-shaded
@@ -199,6 +403,7 @@ calc_normal_vec(const SbVec3f *facenormals, const int facenum,
   have to know how OpenGL/Coin generate triangles from triangle
   strips.
 
+  \sa setNumThreads()
 */
 void
 SoNormalGenerator::generate(const float creaseAngle,
@@ -212,73 +417,116 @@ SoNormalGenerator::generate(const float creaseAngle,
   // longer triangle strips).
 
   int i;
-
-  // for each vertex, store all faceindices the vertex is a part of
-  SbList <int32_t> * vertexFaceArray = new SbList<int32_t>[bsp.numPoints()];
-
   int numvi = this->vertexList.getLength();
 
-  for (i = 0; i < numvi; i++) {
-    vertexFaceArray[vertexList[i]].append(this->vertexFace[i]);
-  }
-
   float threshold = (float)cos(SbClamp(creaseAngle, 0.0f, (float) M_PI));
 
   if (striplens) {
+    // find the vertices to calculate normals for
+    SbList <int32_t> vertices(numvi);
     i = 0;
     for (int j = 0; j < numstrips; j++) {
       assert(i+2 < numvi);
-      SbVec3f tmpvec;
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i],
-                      vertexFaceArray[vertexList[i]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
-      this->vertexNormals.append(tmpvec);
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i+1],
-                      vertexFaceArray[vertexList[i+1]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
-      this->vertexNormals.append(tmpvec);
+      vertices.append(i);
+      vertices.append(i+1);
 
       int num = striplens[j] - 2;
 
       while (num--) {
         i += 2;
         assert(i < numvi);
-        calc_normal_vec(this->faceNormals.getArrayPtr(),
-                        this->vertexFace[i],
-                        vertexFaceArray[vertexList[i]],
-                        threshold, tmpvec);
-        (void) tmpvec.normalize();
-        this->vertexNormals.append(tmpvec);
+        vertices.append(i);
         i++;
       }
     }
+    this->generateVertexNormals(threshold, vertices.getArrayPtr(),
+                                vertices.getLength());
   }
   else {
-    for (i = 0; i < numvi; i++) {
-      SbVec3f tmpvec;
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i],
-                      vertexFaceArray[vertexList[i]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
-      this->vertexNormals.append(tmpvec);
-    }
+    this->generateVertexNormals(threshold, NULL, numvi);
   }
-  delete [] vertexFaceArray;
   this->vertexFace.truncate(0, TRUE);
   this->vertexList.truncate(0, TRUE);
   this->faceNormals.truncate(0, TRUE);
-  this->bsp.clear();
+  SoNormalGeneratorP * pimpl = PRIVATE(this);
+  pimpl->pointList.truncate(0, TRUE);
+  pimpl->pointHash.truncate(0, TRUE);
   this->vertexNormals.fit();
 
   // return vertex normals
   this->perVertex = TRUE;
 }
 
+//
+// Calculates the normals for the vertices in the vertexList, or for
+// just the listed vertices if vertices is not NULL, and stores them
+// in vertexNormals.
+//
+void
+SoNormalGenerator::generateVertexNormals(const float threshold,
+                                         const int32_t * vertices,
+                                         const int numvertices)
+{
+  int i;
+  const int numpoints = PRIVATE(this)->pointList.getLength();
+  const int numvi = this->vertexList.getLength();
+
+  // for each point, store all faceindices the point is a part of, in
+  // the same order as the vertices
+  SbList <int> facestart(numpoints + 1);
+  for (i = 0; i <= numpoints; i++) facestart.append(0);
+  for (i = 0; i < numvi; i++) facestart[this->vertexList[i] + 1]++;
+  for (i = 0; i < numpoints; i++) facestart[i + 1] += facestart[i];
+  SbList <int32_t> faces(numvi);
+  for (i = 0; i < numvi; i++) faces.append(0);
+  SbList <int> pos(numpoints);
+  for (i = 0; i < numpoints; i++) pos.append(facestart[i]);
+  for (i = 0; i < numvi; i++) {
+    faces[pos[this->vertexList[i]]++] = this->vertexFace[i];
+  }
+
+  this->vertexNormals.truncate(0);
+  this->vertexNormals.ensureCapacity(numvertices);
+  for (i = 0; i < numvertices; i++) this->vertexNormals.append(SbVec3f());
+
+  sonormalgenerator_job job;
+  job.facenormals = this->faceNormals.getArrayPtr();
+  job.vertexface = this->vertexFace.getArrayPtr();
+  job.vertexlist = this->vertexList.getArrayPtr();
+  job.facestart = facestart.getArrayPtr();
+  job.faces = faces.getArrayPtr();
+  job.vertices = vertices;
+  job.numvertices = numvertices;
+  job.threshold = threshold;
+  job.normals = numvertices ? &this->vertexNormals[0] : NULL;
+  job.next = 0;
+
+#ifdef HAVE_THREADS
+  const int numthreads = SoNormalGenerator::getNumThreads();
+  if (numthreads > 0 && numvertices >= 2 * SONORMALGENERATOR_CHUNKSIZE) {
+    cc_sched * sched = sonormalgenerator_get_sched(numthreads);
+    // wait for just our own workers, not for those of other
+    // generators sharing the scheduler
+    job.pending = numthreads;
+    job.mutex = cc_mutex_construct();
+    job.done = cc_condvar_construct();
+    for (i = 0; i < numthreads; i++) {
+      (void) cc_sched_schedule(sched, sonormalgenerator_calc_cb, &job, 0);
+    }
+    // the calling thread takes its share of the chunks too
+    sonormalgenerator_calc_chunks(&job);
+    cc_mutex_lock(job.mutex);
+    while (job.pending > 0) (void) cc_condvar_wait(job.done, job.mutex);
+    cc_mutex_unlock(job.mutex);
+    cc_condvar_destruct(job.done);
+    cc_mutex_destruct(job.mutex);
+    return;
+  }
+#endif // HAVE_THREADS
+
+  sonormalgenerator_calc_chunks(&job);
+}
+
 /*!
   Generates one normal per strip by averaging face normals.
 */
@@ -383,6 +631,42 @@ SoNormalGenerator::getNormal(const int32_t i) const
   return this->getNormals()[i];
 }
 
+/*!
+  Sets the number of threads used to calculate vertex normals in
+  generate(). Each vertex normal is calculated just like on a single
+  thread, so the normals are the same for any number of threads.
+  The threads are shared by all normal generators, and several
+  threads can call generate() on their own generators at once.
+
+  Set to 0 to do all the work on the calling thread, which is the
+  default unless the COIN_SONORMALGENERATOR_THREADS environment
+  variable is set. Has no effect if Coin was built without support
+  for threads.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.1
+*/
+void
+SoNormalGenerator::setNumThreads(const int num)
+{
+  sonormalgenerator_numthreads = SbMax(num, 0);
+}
+
+/*!
+  Returns the number of threads used to calculate vertex normals.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \sa setNumThreads()
+  \since Coin 4.1
+*/
+int
+SoNormalGenerator::getNumThreads(void)
+{
+  return sonormalgenerator_get_numthreads();
+}
+
 /*!
   Sets the normal at index \a index to \a normal. This method
   is not supported in Coin, and is provided for API compatibility
@@ -395,6 +679,43 @@ SoNormalGenerator::setNormal(const int32_t /* index */,
   COIN_OBSOLETED();
 }
 
+//
+// Returns the index of pt in pointList, adding it if it's not there
+// already.
+//
+int
+SoNormalGenerator::addPoint(const SbVec3f & pt)
+{
+  SoNormalGeneratorP * pimpl = PRIVATE(this);
+  SbList <SbVec3f> & pointList = pimpl->pointList;
+  SbList <int> & pointHash = pimpl->pointHash;
+  int size = pointHash.getLength();
+  if (2 * (pointList.getLength() + 1) > size) {
+    size = SbMax(size * 2, 256);
+    pointHash.truncate(0);
+    pointHash.ensureCapacity(size);
+    int i;
+    for (i = 0; i < size; i++) pointHash.append(-1);
+    for (i = 0; i < pointList.getLength(); i++) {
+      uint32_t h = sonormalgenerator_hash(pointList[i]);
+      while (pointHash[h & (size - 1)] >= 0) h++;
+      pointHash[h & (size - 1)] = i;
+    }
+  }
+
+  uint32_t h = sonormalgenerator_hash(pt);
+  for (;;) {
+    const int idx = pointHash[h & (size - 1)];
+    if (idx < 0) break;
+    if (pointList[idx] == pt) return idx;
+    h++;
+  }
+  const int idx = pointList.getLength();
+  pointList.append(pt);
+  pointHash[h & (size - 1)] = idx;
+  return idx;
+}
+
 //
 // Calculates the face normal to the current face.
 //
@@ -405,7 +726,7 @@ SoNormalGenerator::calcFaceNormal(void)
 
   assert(num >= 3);
   const int * cind = (const int *) this->vertexList.getArrayPtr() + this->currFaceStart;
-  const SbVec3f * coords = this->bsp.getPointsArrayPtr();
+  const SbVec3f * coords = PRIVATE(this)->pointList.getArrayPtr();
   SbVec3f ret;
 
   if (num == 3) { // triangle
@@ -452,3 +773,106 @@ SoNormalGenerator::calcFaceNormal(void)
   }
   return ret;
 }
+
+#undef PRIVATE
+#undef SONORMALGENERATOR_CHUNKSIZE
+
+#ifdef COIN_TEST_SUITE
+
+static void
+add_bumpy_grid(SoNormalGenerator & gen, const int n)
+{
+  // a grid of quads with a ridge along x == n/2
+  for (int y = 0; y < n - 1; y++) {
+    for (int x = 0; x < n - 1; x++) {
+      SbVec3f p[4];
+      const int xs[4] = { x, x + 1, x + 1, x };
+      const int ys[4] = { y, y, y + 1, y + 1 };
+      for (int i = 0; i < 4; i++) {
+        const float dx = float(xs[i] - n / 2);
+        p[i].setValue(float(xs[i]), float(ys[i]), (dx < 0.0f) ? dx : -dx);
+      }
+      gen.quad(p[0], p[1], p[2], p[3]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(generateOnThreads)
+{
+  const int n = 200;
+  const int numthreads = SoNormalGenerator::getNumThreads();
+
+  SoNormalGenerator::setNumThreads(0);
+  SoNormalGenerator single(TRUE);
+  add_bumpy_grid(single, n);
+  single.generate(0.5f);
+
+  SoNormalGenerator::setNumThreads(3);
+  SoNormalGenerator multi(TRUE);
+  add_bumpy_grid(multi, n);
+  multi.generate(0.5f);
+  SoNormalGenerator::setNumThreads(numthreads);
+
+  BOOST_REQUIRE_EQUAL(single.getNumNormals(), (n - 1) * (n - 1) * 4);
+  BOOST_REQUIRE_EQUAL(multi.getNumNormals(), single.getNumNormals());
+  BOOST_CHECK_MESSAGE(memcmp(single.getNormals(), multi.getNormals(),
+                             single.getNumNormals() * sizeof(SbVec3f)) == 0,
+                      "normals differ between one and several threads");
+
+  // the ridge is sharper than the crease angle
+  const float s = float(M_SQRT1_2);
+  BOOST_CHECK(single.getNormal(0).equals(SbVec3f(-s, 0.0f, s), 1.0e-6f));
+  const int ridge = (n / 2) * 4; // first vertex right of the ridge
+  BOOST_CHECK(single.getNormal(ridge).equals(SbVec3f(s, 0.0f, s), 1.0e-6f));
+  BOOST_CHECK(single.getNormal(ridge + 3).equals(SbVec3f(s, 0.0f, s), 1.0e-6f));
+}
+
+#include <Inventor/threads/SbThread.h>
+
+static void *
+generate_bumpy_grid(void * closure)
+{
+  SoNormalGenerator * gen = static_cast<SoNormalGenerator *>(closure);
+  add_bumpy_grid(*gen, 200);
+  gen->generate(0.5f);
+  return NULL;
+}
+
+BOOST_AUTO_TEST_CASE(generateFromSeveralThreads)
+{
+  const int numthreads = SoNormalGenerator::getNumThreads();
+
+  SoNormalGenerator::setNumThreads(0);
+  SoNormalGenerator single(TRUE);
+  (void) generate_bumpy_grid(&single);
+
+  // the generators share the worker threads, but each waits for just
+  // its own work
+  SoNormalGenerator::setNumThreads(2);
+  SoNormalGenerator * gens[3];
+  SbThread * threads[3];
+  int i;
+  for (i = 0; i < 3; i++) {
+    gens[i] = new SoNormalGenerator(TRUE);
+    // reset() must keep the generator usable
+    gens[i]->triangle(SbVec3f(0.0f, 0.0f, 0.0f), SbVec3f(1.0f, 0.0f, 0.0f),
+                      SbVec3f(0.0f, 1.0f, 0.0f));
+    gens[i]->reset(TRUE);
+    threads[i] = SbThread::create(generate_bumpy_grid, gens[i]);
+  }
+  for (i = 0; i < 3; i++) {
+    threads[i]->join();
+    SbThread::destroy(threads[i]);
+  }
+  SoNormalGenerator::setNumThreads(numthreads);
+
+  for (i = 0; i < 3; i++) {
+    BOOST_REQUIRE_EQUAL(gens[i]->getNumNormals(), single.getNumNormals());
+    BOOST_CHECK_MESSAGE(memcmp(single.getNormals(), gens[i]->getNormals(),
+                               single.getNumNormals() * sizeof(SbVec3f)) == 0,
+                        "normals differ between concurrent generators");
+    delete gens[i];
+  }
+}
+
+#endif // COIN_TEST_SUITE
@@ -98,19 +98,6 @@
 
 // *************************************************************************
 
-// Internal class used to store which elements are pushed for a depth.
-// This makes it possible to avoid searching through all elements
-// and testing depth in pop().
-class sostate_pushstore {
-public:
-  sostate_pushstore(void) {
-    this->next = this->prev = NULL;
-  }
-  SbList <int> elements;
-  sostate_pushstore * next;
-  sostate_pushstore * prev;
-};
-
 // class to store private data members
 class SoStateP {
 public:
@@ -118,7 +105,15 @@ public:
   SoElement ** initial;
   int depth;
   SbBool ispopping;
-  class sostate_pushstore * pushstore;
+
+  // The stack indices of the elements pushed at all depths, in the
+  // order they were pushed, and where in this list each depth
+  // starts. pop() only has to look at the tail of the list, and
+  // both lists keep their memory when the state is reused for
+  // another traversal, so push() and pop() don't allocate once the
+  // state has reached its maximum depth.
+  SbList <int> pushed;
+  SbList <int> pushstart;
 };
 
 #define PRIVATE(obj) ((obj)->pimpl)
@@ -171,7 +166,6 @@ SoState::SoState(SoAction * theAction, const SoTypeList & enabledelements)
       element->init(this); // called for first element in state stack
     }
   }
-  PRIVATE(this)->pushstore = new sostate_pushstore;
 }
 
 /*!
@@ -195,14 +189,6 @@ SoState::~SoState(void)
 
   delete[] PRIVATE(this)->initial;
   delete[] this->stack;
-
-  sostate_pushstore * item = PRIVATE(this)->pushstore;
-  while (item->prev) item = item->prev; // go to first item
-  while (item) {
-    sostate_pushstore * next = item->next;
-    delete item;
-    item = next;
-  }
   delete PRIVATE(this);
 }
 
@@ -257,7 +243,7 @@ SoState::getElement(const int stackindex)
     next->push(this);
     this->stack[stackindex] = next;
     element = next;
-    PRIVATE(this)->pushstore->elements.append(stackindex);
+    PRIVATE(this)->pushed.append(stackindex);
   }
   return element;
 }
@@ -274,13 +260,7 @@ SoState::getElement(const int stackindex)
 void
 SoState::push(void)
 {
-  if (PRIVATE(this)->pushstore->next == NULL) {
-    sostate_pushstore * store = new sostate_pushstore;
-    store->prev = PRIVATE(this)->pushstore;
-    PRIVATE(this)->pushstore->next = store;
-  }
-  PRIVATE(this)->pushstore = PRIVATE(this)->pushstore->next;
-  PRIVATE(this)->pushstore->elements.truncate(0);
+  PRIVATE(this)->pushstart.append(PRIVATE(this)->pushed.getLength());
   PRIVATE(this)->depth++;
 }
 
@@ -293,12 +273,15 @@ SoState::push(void)
 void
 SoState::pop(void)
 {
+  assert(PRIVATE(this)->depth > 0);
   PRIVATE(this)->ispopping = TRUE;
   PRIVATE(this)->depth--;
-  int n = PRIVATE(this)->pushstore->elements.getLength();
-  if (n) {
-    const int * array = PRIVATE(this)->pushstore->elements.getArrayPtr();
-    for (int i = n-1; i >= 0; i--) {
+  const int start = PRIVATE(this)->pushstart.pop();
+  const int n = PRIVATE(this)->pushed.getLength();
+  if (n > start) {
+    // pop in the opposite order of the pushes
+    const int * array = PRIVATE(this)->pushed.getArrayPtr();
+    for (int i = n-1; i >= start; i--) {
       int idx = array[i];
       SoElement * elem = this->stack[idx];
       SoElement * prev = elem->nextdown;
@@ -306,9 +289,8 @@ SoState::pop(void)
       prev->pop(this, elem);
       this->stack[idx] = prev;
     }
+    PRIVATE(this)->pushed.truncate(start);
   }
-  PRIVATE(this)->pushstore->elements.truncate(0);
-  PRIVATE(this)->pushstore = PRIVATE(this)->pushstore->prev;
   PRIVATE(this)->ispopping = FALSE;
 }
 
@@ -352,3 +334,38 @@ SoState::setCacheOpen(const SbBool open)
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/elements/SoComplexityElement.h>
+#include <Inventor/elements/SoComplexityTypeElement.h>
+
+BOOST_AUTO_TEST_CASE(pushPopRestoresElements)
+{
+  SoCallbackAction action;
+  SoState * state = action.getState();
+  const float initial = SoComplexityElement::get(state);
+
+  // run twice to check that a state can be reused after a traversal
+  for (int loop = 0; loop < 2; loop++) {
+    for (int i = 0; i < 8; i++) {
+      state->push();
+      SoComplexityElement::set(state, float(i) / 8.0f);
+      if (i & 1) {
+        SoComplexityTypeElement::set(state, SoComplexityTypeElement::OBJECT_SPACE);
+      }
+    }
+    BOOST_CHECK_EQUAL(state->getDepth(), 8);
+    for (int i = 7; i >= 0; i--) {
+      BOOST_CHECK_EQUAL(SoComplexityElement::get(state), float(i) / 8.0f);
+      state->pop();
+    }
+    BOOST_CHECK_EQUAL(state->getDepth(), 0);
+    BOOST_CHECK_EQUAL(SoComplexityElement::get(state), initial);
+    BOOST_CHECK_EQUAL(SoComplexityTypeElement::get(state),
+                      SoComplexityTypeElement::getDefault());
+  }
+}
+
+#endif // COIN_TEST_SUITE
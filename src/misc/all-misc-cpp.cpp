@@ -56,6 +56,7 @@
 #include "SoCompactPathList.cpp"
 #include "SoConfigSettings.cpp"
 #include "SoContextHandler.cpp"
+#include "SoCoordinateChangeLog.cpp"
 #include "SoDB.cpp"
 #include "SoDBP.cpp"
 #include "SoEventManager.cpp"
@@ -65,6 +65,7 @@
 #include <Inventor/elements/SoGLVBOElement.h>
 
 #include "nodes/SoSubNodeP.h"
+#include "misc/SoCoordinateChangeLog.h"
 #include "rendering/SoVBO.h"
 
 /*!
@@ -190,4 +191,20 @@ SoCoordinate3::getPrimitiveCount(SoGetPrimitiveCountAction * action)
   SoCoordinate3::doAction(action);
 }
 
+// Documented in superclass. Overridden to log which coordinates were
+// changed, so that shapes can update their bounding boxes for just
+// those coordinates.
+void
+SoCoordinate3::notify(SoNotList * list)
+{
+  const uint32_t previd = this->getNodeId();
+  int start, num;
+  const SbBool known =
+    SoCoordinateChangeLog::getChangedIndices(list, &this->point, start, num);
+  inherited::notify(list);
+  if (known) {
+    SoCoordinateChangeLog::changed(previd, this->getNodeId(), start, num);
+  }
+}
+
 #undef PRIVATE
@@ -212,6 +212,7 @@
 #include "nodes/SoSubNodeP.h"
 #include "rendering/SoGL.h"
 #include "glue/glp.h"
+#include "io/SoInputP.h"
 #include "io/SoWriterefCounter.h"
 
 #include <Inventor/annex/Profiler/SoProfiler.h>
@@ -383,6 +384,7 @@ SoGroup::readChildren(SoInput * in)
       }
       else {
 	this->addChild((SoNode *)child);
+	SoInputP::nodeRead(in, (SoNode *)child, this);
       }
     }
     else {
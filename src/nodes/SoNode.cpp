@@ -221,6 +221,7 @@ SbUniqueId is not really a class, just a \c typedef.
 #include "nodes/SoUnknownNode.h"
 #include "threads/threadsutilp.h"
 #include "glue/glp.h"
+#include "actions/SoMultiRayPickActionP.h"
 #include "misc/SoDBP.h" // for global envvar COIN_PROFILER
 #include "coindefs.h"   // COIN_CHECK_THREAD
 
@@ -1634,6 +1635,10 @@ init_action_methods(void)
   SoRayPickAction::addMethod(SoSceneTextureCubeMap::getClassTypeId(), SoNode::rayPickS);
   SoRayPickAction::addMethod(SoTextureCubeMap::getClassTypeId(), SoNode::rayPickS);
 
+  // SoMultiRayPickAction needs to pick cameras and shapes with all its rays
+  SoMultiRayPickAction::addMethod(SoCamera::getClassTypeId(), SoMultiRayPickActionP::cameraS);
+  SoMultiRayPickAction::addMethod(SoShape::getClassTypeId(), SoMultiRayPickActionP::shapeS);
+
   SoSearchAction::addMethod(SoNode::getClassTypeId(), SoNode::searchS);
   SoWriteAction::addMethod(SoNode::getClassTypeId(), SoNode::writeS);
 
@@ -87,6 +87,16 @@
 #include <Inventor/system/gl.h>
 #include <Inventor/C/tidbits.h> // coin_getenv()
 #include <Inventor/threads/SbStorage.h>
+#include <Inventor/misc/SoTempPath.h>
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/SoFullPath.h>
+#include <Inventor/fields/SoField.h>
+#include <Inventor/fields/SoFieldData.h>
+#include <Inventor/lists/SbList.h>
+
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/sched.h>
+#endif // HAVE_THREADS
 
 #ifdef COIN_THREADSAFE
 #include <Inventor/threads/SbMutex.h>
@@ -97,6 +107,12 @@
 #include "glue/glp.h"
 #include "rendering/SoGL.h"
 #include "misc/SoDBP.h"
+#include "misc/SbHash.h"
+#include "elements/SoCacheElementP.h"
+#include "SbBasicP.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+#include "actions/SoMultiRayPickActionP.h"
 
 #include <Inventor/annex/Profiler/SoProfiler.h>
 #include "profiler/SoNodeProfiling.h"
@@ -355,6 +371,23 @@ public:
 
   static SbBool doCull(SoSeparatorP * thisp, SoState * state,
                        SbBool (* cullfunc)(SoState *, const SbBox3f &, const SbBool));
+
+  // see SoGetBoundingBoxAction::setNumThreads()
+  static void buildBBoxCaches(SoSeparator * sep, SoGetBoundingBoxAction * action);
+  static SbBool findBBoxCacheUnits(SoState * state, SoTempPath * path,
+                                   SbList<SoTempPath *> & units);
+  static void claimBBoxCacheUnit(SoNode * node, const int unit,
+                                 SbHash<SoNode *, int> & owners,
+                                 SbList<SbBool> & usable);
+  static SbBool hasConnections(SoNode * node);
+  static SbBool isSharedSafe(SoNode * node);
+
+#ifdef HAVE_THREADS
+  static cc_sched * bboxsched;
+  static void * bboxmutex;
+  static void bboxsched_cleanup(void);
+  static void buildbboxcaches_cb(void * closure);
+#endif // HAVE_THREADS
 };
 
 #define PRIVATE(obj) ((obj)->pimpl)
@@ -375,6 +408,282 @@ SoSeparatorP::getGLCacheList(SbBool createifnull)
 
 // *************************************************************************
 
+// Building bounding box caches on several threads.
+//
+// When a separator needs to recalculate its bounding box cache, and
+// the action has threads enabled, the subgraph is first split into
+// units: separators found through plain SoGroup nodes, which have no
+// valid bounding box cache. The units are then applied on worker
+// threads, each with a path from the root of the action, so that the
+// traversal state is the same as it would be for the calling
+// thread. This builds the bounding box caches of the units, which the
+// serial traversal that follows will pick up.
+//
+// Worker threads only read the nodes outside the units, and units
+// which share nodes with each other or have connected fields (which
+// would be evaluated on traversal) are left to the serial traversal.
+
+#ifdef HAVE_THREADS
+
+cc_sched * SoSeparatorP::bboxsched = NULL;
+void * SoSeparatorP::bboxmutex = NULL;
+
+typedef struct {
+  SoTempPath * const * units;
+  int numunits;
+  int next;
+  cc_mutex * mutex;
+  const SbViewportRegion * vp;
+} soseparator_bboxjob;
+
+void
+SoSeparatorP::bboxsched_cleanup(void)
+{
+  if (SoSeparatorP::bboxsched) {
+    cc_sched_destruct(SoSeparatorP::bboxsched);
+    SoSeparatorP::bboxsched = NULL;
+  }
+  CC_MUTEX_DESTRUCT(SoSeparatorP::bboxmutex);
+}
+
+void
+SoSeparatorP::buildbboxcaches_cb(void * closure)
+{
+  soseparator_bboxjob * job = static_cast<soseparator_bboxjob *>(closure);
+
+  SoGetBoundingBoxAction action(*job->vp);
+  action.setNumThreads(0);
+
+  for (;;) {
+    cc_mutex_lock(job->mutex);
+    const int idx = job->next++;
+    cc_mutex_unlock(job->mutex);
+    if (idx >= job->numunits) break;
+    action.apply(job->units[idx]);
+  }
+}
+
+#endif // HAVE_THREADS
+
+// Returns TRUE if node has connected fields, which are evaluated when
+// read.
+SbBool
+SoSeparatorP::hasConnections(SoNode * node)
+{
+  const SoFieldData * fielddata = node->getFieldData();
+  const int numfields = fielddata ? fielddata->getNumFields() : 0;
+  for (int i = 0; i < numfields; i++) {
+    if (fielddata->getField(node, i)->isConnected()) return TRUE;
+  }
+  return FALSE;
+}
+
+// Returns TRUE if several worker threads can traverse node at the same
+// time, off the paths to their units. Shapes and grouping nodes other
+// than plain groups may calculate and cache bounding boxes of their
+// own, so only property nodes qualify. Separators are not traversed
+// off the path.
+SbBool
+SoSeparatorP::isSharedSafe(SoNode * node)
+{
+  if (node->isOfType(SoSeparator::getClassTypeId())) return TRUE;
+  if (node->isOfType(SoShape::getClassTypeId())) return FALSE;
+  if (SoSeparatorP::hasConnections(node)) return FALSE;
+
+  const SoChildList * children = node->getChildren();
+  if (children && node->getTypeId() != SoGroup::getClassTypeId()) return FALSE;
+  const int numchildren = children ? children->getLength() : 0;
+  for (int i = 0; i < numchildren; i++) {
+    if (!SoSeparatorP::isSharedSafe((*children)[i])) return FALSE;
+  }
+  return TRUE;
+}
+
+// Appends paths to the separators without a valid bounding box cache
+// below the tail of path, found through plain SoGroup nodes. Stops
+// and returns FALSE at the first node which is not safe to traverse
+// from several threads, as the separators after it can not be
+// reached without traversing it.
+SbBool
+SoSeparatorP::findBBoxCacheUnits(SoState * state, SoTempPath * path,
+                                 SbList<SoTempPath *> & units)
+{
+  SoNode * tail = path->getTail();
+  const SoChildList * children = tail->getChildren();
+  const int numchildren = children ? children->getLength() : 0;
+  for (int i = 0; i < numchildren; i++) {
+    SoNode * child = (*children)[i];
+    if (child->isOfType(SoSeparator::getClassTypeId())) {
+      SoSeparator * sep = static_cast<SoSeparator *>(child);
+      if (sep->boundingBoxCaching.getValue() == SoSeparator::OFF) continue;
+      SoBoundingBoxCache * cache = PRIVATE(sep)->bboxcache;
+      if (cache && cache->isValid(state)) continue;
+
+      const int len = path->getLength();
+      SoTempPath * unit = new SoTempPath(len + 1);
+      unit->ref();
+      for (int j = 0; j < len; j++) {
+        unit->simpleAppend(path->getNode(j), path->getIndex(j));
+      }
+      unit->simpleAppend(child, i);
+      units.append(unit);
+    }
+    else if (child->getTypeId() == SoGroup::getClassTypeId()) {
+      path->simpleAppend(child, i);
+      const SbBool ok = SoSeparatorP::findBBoxCacheUnits(state, path, units);
+      path->truncate(path->getLength() - 1);
+      if (!ok) return FALSE;
+    }
+    else if (!SoSeparatorP::isSharedSafe(child)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// Records unit as the owner of the nodes in the subgraph below
+// node. Units which share nodes with other units, or which have
+// connected fields, are marked as not usable.
+void
+SoSeparatorP::claimBBoxCacheUnit(SoNode * node, const int unit,
+                                 SbHash<SoNode *, int> & owners,
+                                 SbList<SbBool> & usable)
+{
+  int owner;
+  if (owners.get(node, owner)) {
+    if (owner != unit) {
+      usable[owner] = FALSE;
+      usable[unit] = FALSE;
+    }
+    return;
+  }
+  (void) owners.put(node, unit);
+  if (usable[unit] && SoSeparatorP::hasConnections(node)) {
+    usable[unit] = FALSE;
+  }
+  const SoChildList * children = node->getChildren();
+  const int numchildren = children ? children->getLength() : 0;
+  for (int i = 0; i < numchildren; i++) {
+    SoSeparatorP::claimBBoxCacheUnit((*children)[i], unit, owners, usable);
+  }
+}
+
+// Builds the bounding box caches of the separators below sep on the
+// threads of the action, before sep traverses its children.
+void
+SoSeparatorP::buildBBoxCaches(SoSeparator * sep, SoGetBoundingBoxAction * action)
+{
+#ifdef HAVE_THREADS
+  const int numthreads = action->getNumThreads();
+  SoState * state = action->getState();
+
+  const SoFullPath * curpath = reclassify_cast<const SoFullPath *>(action->getCurPath());
+  const int curlen = curpath->getLength();
+  if (curlen == 0 || curpath->getTail() != sep) return;
+
+  // the path to sep is traversed by all the worker threads
+  for (int i = 0; i < curlen; i++) {
+    SoNode * node = curpath->getNode(i);
+    if (SoSeparatorP::hasConnections(node)) return;
+    if (i + 1 < curlen) {
+      const SoChildList * children = node->getChildren();
+      const int idx = curpath->getIndex(i + 1);
+      for (int j = 0; j < idx; j++) {
+        if (!SoSeparatorP::isSharedSafe((*children)[j])) return;
+      }
+    }
+  }
+
+  SoTempPath * path = new SoTempPath(curlen);
+  path->ref();
+  for (int i = 0; i < curlen; i++) {
+    path->simpleAppend(curpath->getNode(i), curpath->getIndex(i));
+  }
+
+  // split the subgraph into more units than threads, so that the
+  // work is spread evenly even if the units vary in size
+  SbList<SoTempPath *> units;
+  (void) SoSeparatorP::findBBoxCacheUnits(state, path, units);
+  const int wantedunits = numthreads * 4;
+  for (int level = 0; level < 8 && units.getLength() < wantedunits; level++) {
+    SbList<SoTempPath *> next;
+    SbBool expanded = FALSE;
+    for (int i = 0; i < units.getLength(); i++) {
+      const int numfound = next.getLength();
+      (void) SoSeparatorP::findBBoxCacheUnits(state, units[i], next);
+      if (next.getLength() == numfound) {
+        next.append(units[i]);
+        units[i] = NULL;
+      }
+      else {
+        expanded = TRUE;
+      }
+    }
+    for (int i = 0; i < units.getLength(); i++) {
+      if (units[i]) units[i]->unref();
+    }
+    units = next;
+    if (!expanded) break;
+  }
+  path->unref();
+
+  SbList<SoTempPath *> usableunits;
+  if (units.getLength() > 1) {
+    SbHash<SoNode *, int> owners;
+    SbList<SbBool> usable;
+    for (int i = 0; i < units.getLength(); i++) { usable.append(TRUE); }
+    for (int i = 0; i < units.getLength(); i++) {
+      SoSeparatorP::claimBBoxCacheUnit(units[i]->getTail(), i, owners, usable);
+    }
+    for (int i = 0; i < units.getLength(); i++) {
+      if (usable[i]) usableunits.append(units[i]);
+    }
+  }
+
+  if (usableunits.getLength() > 1) {
+    CC_MUTEX_CONSTRUCT(SoSeparatorP::bboxmutex);
+    CC_MUTEX_LOCK(SoSeparatorP::bboxmutex);
+    if (SoSeparatorP::bboxsched == NULL) {
+      SoSeparatorP::bboxsched = cc_sched_construct(numthreads);
+      coin_atexit((coin_atexit_f *) SoSeparatorP::bboxsched_cleanup, CC_ATEXIT_NORMAL);
+    }
+    else if (cc_sched_get_num_threads(SoSeparatorP::bboxsched) < numthreads) {
+      cc_sched_set_num_threads(SoSeparatorP::bboxsched, numthreads);
+    }
+
+    soseparator_bboxjob job;
+    job.units = usableunits.getArrayPtr();
+    job.numunits = usableunits.getLength();
+    job.next = 0;
+    job.mutex = cc_mutex_construct();
+    job.vp = &action->getViewportRegion();
+
+    // each worker thread needs its own invalidated flag, see
+    // SoSeparator::getBoundingBox()
+    SoCacheElementP::beginThreadLocalInvalid();
+    const int numjobs = SbMin(numthreads, job.numunits);
+    for (int i = 0; i < numjobs; i++) {
+      (void) cc_sched_schedule(SoSeparatorP::bboxsched,
+                               SoSeparatorP::buildbboxcaches_cb, &job, 0);
+    }
+    cc_sched_wait_all(SoSeparatorP::bboxsched);
+    SoCacheElementP::endThreadLocalInvalid();
+
+    cc_mutex_destruct(job.mutex);
+    CC_MUTEX_UNLOCK(SoSeparatorP::bboxmutex);
+  }
+
+  for (int i = 0; i < units.getLength(); i++) {
+    units[i]->unref();
+  }
+#else // ! HAVE_THREADS
+  (void) sep;
+  (void) action;
+#endif // ! HAVE_THREADS
+}
+
+// *************************************************************************
+
 SO_NODE_SOURCE(SoSeparator);
 
 /*!
@@ -537,6 +846,12 @@ SoSeparator::getBoundingBox(SoGetBoundingBoxAction * action)
     }
   }
   else {
+    // build caches below this separator on other threads first, unless
+    // a cache above us is being built, which means that has been done
+    if (iscaching && action->getNumThreads() > 0 && !state->isCacheOpen()) {
+      SoSeparatorP::buildBBoxCaches(this, action);
+    }
+
     SbXfBox3f abox = action->getXfBoundingBox();
 
     SbBool storedinvalid = FALSE;
@@ -857,6 +1172,20 @@ ray_intersect(SoRayPickAction * action, const SbBox3f &box)
 void
 SoSeparator::rayPick(SoRayPickAction * action)
 {
+  SoMultiRayPickActionP * multi = SoMultiRayPickActionP::get(action);
+  if (multi) {
+    // only pass on the rays which intersect the bounding box
+    if (this->pickCulling.getValue() == OFF ||
+        !PRIVATE(this)->bboxcache || !PRIVATE(this)->bboxcache->isValid(action->getState())) {
+      SoSeparator::doAction(action);
+    }
+    else if (multi->pushRays(action->getState(), PRIVATE(this)->bboxcache->getProjectedBox())) {
+      SoSeparator::doAction(action);
+      multi->popRays();
+    }
+    return;
+  }
+
   if (this->pickCulling.getValue() == OFF ||
       !PRIVATE(this)->bboxcache || !PRIVATE(this)->bboxcache->isValid(action->getState()) ||
       !action->hasWorldSpaceRay() ||
@@ -113,6 +113,7 @@
 #include <Inventor/errors/SoDebugError.h>
 
 #include "nodes/SoSubNodeP.h"
+#include "misc/SoCoordinateChangeLog.h"
 #include "rendering/SoVBO.h"
 
 /*!
@@ -405,7 +406,7 @@ SoVertexProperty::getPrimitiveCount(SoGetPrimitiveCountAction *action)
 }
 
 // Documented in superclass. Overridden to check for transparency when
-// orderedRGBA changes.
+// orderedRGBA changes, and to log which coordinates were changed.
 void
 SoVertexProperty::notify(SoNotList *list)
 {
@@ -413,7 +414,14 @@ SoVertexProperty::notify(SoNotList *list)
   if (f == &this->orderedRGBA) {
     PRIVATE(this)->checktransparent = TRUE;
   }
+  const uint32_t previd = this->getNodeId();
+  int start, num;
+  const SbBool known =
+    SoCoordinateChangeLog::getChangedIndices(list, &this->vertex, start, num);
   inherited::notify(list);
+  if (known) {
+    SoCoordinateChangeLog::changed(previd, this->getNodeId(), start, num);
+  }
 }
 
 
@@ -67,6 +67,7 @@
 #include <Inventor/elements/SoLazyElement.h>
 #include <Inventor/actions/SoGLRenderAction.h>
 #include <Inventor/actions/SoAudioRenderAction.h>
+#include <Inventor/engines/SoEngine.h>
 #include <Inventor/actions/SoGLRenderAction.h>
 #include <Inventor/sensors/SoOneShotSensor.h>
 #include <Inventor/fields/SoSFTime.h>
@@ -589,6 +590,10 @@ SoRenderManager::render(const SbBool clearwindow, const SbBool clearzbuffer)
   //
   // 20050809 mortene.
 
+  // Evaluate engines on worker threads before they are read during
+  // traversal. Does nothing unless SoEngine::setNumThreads() is set.
+  SoEngine::evaluateDirtyEngines();
+
   if (PRIVATE(this)->scene &&
       // Order is important below, because we don't want to call
       // SoAudioDevice::instance() unless we need to -- as it triggers
@@ -45,6 +45,7 @@
 
 #include <Inventor/elements/SoGLCacheContextElement.h>
 #include <Inventor/misc/SoGLDriverDatabase.h>
+#include <Inventor/C/tidbits.h>
 
 #include "tidbitsp.h"
 #include "rendering/SoVBO.h"
@@ -214,30 +215,29 @@ SoVertexArrayIndexer::endTarget(GLenum targetin)
 /*!
   Closes the indexer. This will reallocate the growable arrays to use as little
   memory as possible. The indexer will also sort triangles and lines to
-  optimize rendering.
+  optimize rendering, unless \a sortprimitives is FALSE.
+
+  Indices that fit in 16 bits are then moved to a separate array,
+  halving the memory and bandwidth needed for them.
 */
 void
-SoVertexArrayIndexer::close(void)
+SoVertexArrayIndexer::close(const SbBool sortprimitives)
 {
   this->indexarray.fit();
   this->countarray.fit();
-  this->ciarray.truncate(0);
 
-  if (this->target != GL_TRIANGLES && this->target != GL_QUADS && this->target != GL_LINES && this->target != GL_POINTS) {
-    const GLint * ptr = this->indexarray.getArrayPtr();
-    for (int i = 0; i < this->countarray.getLength(); i++) {
-      this->ciarray.append(ptr);
-      ptr += (int) this->countarray[i];
+  if (sortprimitives) {
+    if (this->target == GL_TRIANGLES) {
+      this->sort_triangles();
+    }
+    else if (this->target == GL_LINES) {
+      this->sort_lines();
     }
-  }
-  if (this->target == GL_TRIANGLES) {
-    this->sort_triangles();
-  }
-  else if (this->target == GL_LINES) {
-    this->sort_lines();
   }
   // FIXME: sort lines and points
-  if (this->next) this->next->close();
+  this->compactIndices();
+  this->updateTargetPointers();
+  if (this->next) this->next->close(sortprimitives);
 }
 
 /*!
@@ -246,6 +246,11 @@ SoVertexArrayIndexer::close(void)
 void
 SoVertexArrayIndexer::render(const cc_glglue * glue, const SbBool renderasvbo, const uint32_t contextid)
 {
+  const int numshorts = this->shortarray.getLength();
+  const int numints = this->indexarray.getLength();
+  // the 32-bit indices are stored after the 16-bit ones in the VBO
+  const intptr_t intoffset = ((numshorts * sizeof(GLushort) + 3) / 4) * 4;
+
   switch (this->target) {
   case GL_TRIANGLES:
   case GL_QUADS:
@@ -255,53 +260,81 @@ SoVertexArrayIndexer::render(const cc_glglue * glue, const SbBool renderasvbo, c
     if (renderasvbo) {
       if (this->vbo == NULL) {
         this->vbo = new SoVBO(GL_ELEMENT_ARRAY_BUFFER);
-        if (this->use_shorts) {
+        if (this->use_shorts && numshorts == 0) {
+          // indices have been expanded to 32 bits after close()
           GLushort * dst = reinterpret_cast<GLushort*> 
-            (this->vbo->allocBufferData(this->indexarray.getLength()*sizeof(GLushort)));
+            (this->vbo->allocBufferData(numints*sizeof(GLushort)));
           const int32_t * src = this->indexarray.getArrayPtr();
-          for (int i = 0; i < this->indexarray.getLength(); i++) {
+          for (int i = 0; i < numints; i++) {
             dst[i] = static_cast<GLushort> (src[i]);
           }
         }
         else {
-          this->vbo->setBufferData(this->indexarray.getArrayPtr(),
-                                   this->indexarray.getLength()*sizeof(int32_t));
+          char * dst = static_cast<char *>
+            (this->vbo->allocBufferData(intoffset + numints*sizeof(int32_t)));
+          if (numshorts) {
+            memcpy(dst, this->shortarray.getArrayPtr(), numshorts*sizeof(GLushort));
+          }
+          if (numints) {
+            memcpy(dst + intoffset, this->indexarray.getArrayPtr(), numints*sizeof(int32_t));
+          }
         }
       }
       this->vbo->bindBuffer(contextid);
-      cc_glglue_glDrawElements(glue,
-                               this->target,
-                               this->indexarray.getLength(),
-                               this->use_shorts ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, NULL);
+      if (this->use_shorts && numshorts == 0) {
+        cc_glglue_glDrawElements(glue, this->target, numints,
+                                 GL_UNSIGNED_SHORT, NULL);
+      }
+      else {
+        if (numshorts) {
+          cc_glglue_glDrawElements(glue, this->target, numshorts,
+                                   GL_UNSIGNED_SHORT, NULL);
+        }
+        if (numints) {
+          cc_glglue_glDrawElements(glue, this->target, numints,
+                                   GL_UNSIGNED_INT,
+                                   reinterpret_cast<const GLvoid *>(intoffset));
+        }
+      }
       cc_glglue_glBindBuffer(glue, GL_ELEMENT_ARRAY_BUFFER, 0);
     }
     else {
-      const GLint * idxptr = this->indexarray.getArrayPtr();
-      cc_glglue_glDrawElements(glue,
-                               this->target,
-                               this->indexarray.getLength(),
-                               GL_UNSIGNED_INT,
-                               idxptr);
-    }
-    break;
-  default:
-    if (SoGLDriverDatabase::isSupported(glue, SO_GL_MULTIDRAW_ELEMENTS)) {
-      cc_glglue_glMultiDrawElements(glue,
-                                    this->target,
-                                    (GLsizei*) this->countarray.getArrayPtr(),
-                                    GL_UNSIGNED_INT,
-                                    (const GLvoid**) this->ciarray.getArrayPtr(),
-                                    this->countarray.getLength());
-    }
-    else {
-      for (int i = 0; i < this->countarray.getLength(); i++) {
-        const GLsizei * ptr = this->ciarray[i];
-        GLsizei cnt = this->countarray[i];
+      if (numshorts) {
         cc_glglue_glDrawElements(glue,
                                  this->target,
-                                 cnt,
+                                 numshorts,
+                                 GL_UNSIGNED_SHORT,
+                                 this->shortarray.getArrayPtr());
+      }
+      if (numints) {
+        cc_glglue_glDrawElements(glue,
+                                 this->target,
+                                 numints,
                                  GL_UNSIGNED_INT,
-                                 (const GLvoid*) ptr);
+                                 this->indexarray.getArrayPtr());
+      }
+    }
+    break;
+  default:
+    {
+      // targets are only compacted when all the indices fit in 16 bits
+      const GLenum type = numshorts ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+      if (SoGLDriverDatabase::isSupported(glue, SO_GL_MULTIDRAW_ELEMENTS)) {
+        cc_glglue_glMultiDrawElements(glue,
+                                      this->target,
+                                      (GLsizei*) this->countarray.getArrayPtr(),
+                                      type,
+                                      (const GLvoid**) this->ciarray.getArrayPtr(),
+                                      this->countarray.getLength());
+      }
+      else {
+        for (int i = 0; i < this->countarray.getLength(); i++) {
+          cc_glglue_glDrawElements(glue,
+                                   this->target,
+                                   this->countarray[i],
+                                   type,
+                                   this->ciarray[i]);
+        }
       }
     }
     break;
@@ -316,7 +349,7 @@ SoVertexArrayIndexer::render(const cc_glglue * glue, const SbBool renderasvbo, c
 int
 SoVertexArrayIndexer::getNumVertices(void)
 {
-  int count = this->indexarray.getLength();
+  int count = this->getNumIndices();
   if (this->next) count += this->next->getNumVertices();
   return count;
 }
@@ -461,28 +494,165 @@ SoVertexArrayIndexer::sort_lines(void)
 int
 SoVertexArrayIndexer::getNumIndices(void) const
 {
-  return this->indexarray.getLength();
-
+  return this->shortarray.getLength() + this->indexarray.getLength();
 }
 
 /*!
-  Returns a pointer to the index array.
+  Returns a pointer to the index array. If the indices have been
+  compacted to 16 bits, a 32-bit copy is returned instead. The copy
+  is made on the first call, and the arrays used for rendering are
+  left as they are.
 */
 const GLint *
 SoVertexArrayIndexer::getIndices(void) const
 {
-  return this->indexarray.getArrayPtr();
+  const int numshorts = this->shortarray.getLength();
+  if (numshorts == 0) return this->indexarray.getArrayPtr();
+
+  if (this->expandedarray.getLength() == 0) {
+    const int numints = this->indexarray.getLength();
+    this->expandedarray.ensureCapacity(numshorts + numints);
+    const GLushort * sptr = this->shortarray.getArrayPtr();
+    for (int i = 0; i < numshorts; i++) {
+      this->expandedarray.append(static_cast<GLint>(sptr[i]));
+    }
+    const GLint * iptr = this->indexarray.getArrayPtr();
+    for (int i = 0; i < numints; i++) {
+      this->expandedarray.append(iptr[i]);
+    }
+  }
+  return this->expandedarray.getArrayPtr();
 }
 
 /*!
   Returns a pointer to the index array. It's allowed to reorganize
   these indices to change the rendering order. Calling this function
-  will invalidate any VBO caches used by the indexer.
+  will expand compacted indices back to 32 bits for good, and will
+  invalidate any VBO caches used by the indexer.
 */
 GLint *
 SoVertexArrayIndexer::getWriteableIndices(void)
 {
+  this->expandIndices();
   delete this->vbo;
   this->vbo = NULL;
   return (GLint*) this->indexarray.getArrayPtr();
 }
+
+//
+// Moves indices that fit in 16 bits to shortarray. If there are
+// indices that don't, the primitives that only use vertices below
+// 65536 are still moved for the simple targets, which works well
+// since triangles and lines are sorted on vertex indices.
+//
+void
+SoVertexArrayIndexer::compactIndices(void)
+{
+  static int COIN_SPLIT_INDEX_ARRAYS = -1;
+  if (COIN_SPLIT_INDEX_ARRAYS < 0) {
+    const char * env = coin_getenv("COIN_SPLIT_INDEX_ARRAYS");
+    if (env) COIN_SPLIT_INDEX_ARRAYS = atoi(env);
+    else COIN_SPLIT_INDEX_ARRAYS = 1;
+  }
+
+  const int num = this->indexarray.getLength();
+  if (num == 0 || this->shortarray.getLength()) return;
+  this->expandedarray.truncate(0, TRUE);
+  const GLint * src = this->indexarray.getArrayPtr();
+
+  if (this->use_shorts) {
+    this->shortarray.truncate(0);
+    for (int i = 0; i < num; i++) {
+      this->shortarray.append(static_cast<GLushort>(src[i]));
+    }
+    this->shortarray.fit();
+    this->indexarray.truncate(0, TRUE);
+  }
+  else if (COIN_SPLIT_INDEX_ARRAYS) {
+    int n;
+    switch (this->target) {
+    case GL_TRIANGLES: n = 3; break;
+    case GL_QUADS: n = 4; break;
+    case GL_LINES: n = 2; break;
+    case GL_POINTS: n = 1; break;
+    default: return;
+    }
+    SbList <GLint> rest;
+    for (int i = 0; i < num; i += n) {
+      int j;
+      for (j = 0; j < n; j++) {
+        if (src[i+j] >= 65536) break;
+      }
+      if (j == n) {
+        for (j = 0; j < n; j++) {
+          this->shortarray.append(static_cast<GLushort>(src[i+j]));
+        }
+      }
+      else {
+        for (j = 0; j < n; j++) rest.append(src[i+j]);
+      }
+    }
+    if (this->shortarray.getLength()) {
+      this->shortarray.fit();
+      this->indexarray.truncate(0);
+      for (int i = 0; i < rest.getLength(); i++) {
+        this->indexarray.append(rest[i]);
+      }
+      this->indexarray.fit();
+    }
+  }
+}
+
+//
+// Moves the 16-bit indices back to indexarray, for callers that need
+// to modify the indices. Readers use the copy made by getIndices().
+//
+void
+SoVertexArrayIndexer::expandIndices(void)
+{
+  const int numshorts = this->shortarray.getLength();
+  if (numshorts == 0) return;
+
+  SbList <GLint> rest(this->indexarray);
+  this->indexarray.truncate(0);
+  this->indexarray.ensureCapacity(numshorts + rest.getLength());
+  const GLushort * src = this->shortarray.getArrayPtr();
+  for (int i = 0; i < numshorts; i++) {
+    this->indexarray.append(static_cast<GLint>(src[i]));
+  }
+  for (int i = 0; i < rest.getLength(); i++) {
+    this->indexarray.append(rest[i]);
+  }
+  this->shortarray.truncate(0, TRUE);
+  this->expandedarray.truncate(0, TRUE);
+
+  delete this->vbo;
+  this->vbo = NULL;
+  this->updateTargetPointers();
+}
+
+//
+// Sets up the pointers to the start of each target, which are used
+// when rendering targets other than the simple ones.
+//
+void
+SoVertexArrayIndexer::updateTargetPointers(void)
+{
+  this->ciarray.truncate(0);
+
+  if (this->target != GL_TRIANGLES && this->target != GL_QUADS && this->target != GL_LINES && this->target != GL_POINTS) {
+    const int numshorts = this->shortarray.getLength();
+    const GLushort * sptr = this->shortarray.getArrayPtr();
+    const GLint * ptr = this->indexarray.getArrayPtr();
+    for (int i = 0; i < this->countarray.getLength(); i++) {
+      if (numshorts) {
+        this->ciarray.append(sptr);
+        sptr += (int) this->countarray[i];
+      }
+      else {
+        this->ciarray.append(ptr);
+        ptr += (int) this->countarray[i];
+      }
+    }
+  }
+}
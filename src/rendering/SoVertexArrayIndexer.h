@@ -66,7 +66,7 @@ public:
   void targetVertex(GLenum target, const int32_t v);
   void endTarget(GLenum target);
 
-  void close(void);
+  void close(const SbBool sortprimitives = TRUE);
   void render(const cc_glglue * glue, const SbBool renderasvbo, const uint32_t vbocontextid);
 
   int getNumVertices(void);
@@ -78,6 +78,9 @@ private:
   void addIndex(int32_t i);
   void sort_triangles(void);
   void sort_lines(void);
+  void compactIndices(void);
+  void expandIndices(void);
+  void updateTargetPointers(void);
   SoVertexArrayIndexer * getNext(void);
 
   GLenum target;
@@ -85,8 +88,12 @@ private:
 
   int targetcounter;
   SbList <GLsizei> countarray;
-  SbList <const GLint *> ciarray;
+  SbList <const GLvoid *> ciarray;
   SbList <GLint> indexarray;
+  // indices that fit in 16 bits, rendered before the ones in indexarray
+  SbList <GLushort> shortarray;
+  // 32-bit copy of shortarray + indexarray, made by getIndices()
+  mutable SbList <GLint> expandedarray;
   SoVBO * vbo;
   SbBool use_shorts;
 };
@@ -134,6 +134,106 @@
 
 // *************************************************************************
 
+// A binary heap of sensors, so that inserting and removing sensors
+// takes O(log n) time. The heap slot of each sensor is kept in a
+// hash, so that it can be removed without searching, and each entry
+// gets a sequence number, so that sensors with the same priority or
+// trigger time are processed in the order they were scheduled.
+template <class Type>
+class SoSensorHeap {
+public:
+  SoSensorHeap(void) : order(0) { }
+
+  int getLength(void) const { return this->heap.getLength(); }
+  Type * operator[](const int idx) const { return this->heap[idx].sensor; }
+
+  void insert(Type * sensor) {
+    Entry entry;
+    entry.sensor = sensor;
+    entry.order = this->order++;
+    this->heap.append(entry);
+    this->up(this->heap.getLength() - 1);
+  }
+
+  // returns FALSE if the sensor isn't in this heap
+  SbBool remove(Type * sensor) {
+    int idx;
+    if (!this->slots.get(sensor, idx)) return FALSE;
+    (void) this->slots.erase(sensor);
+    const Entry last = this->heap.pop();
+    if (last.sensor != sensor) {
+      this->heap[idx] = last;
+      this->up(this->down(idx));
+    }
+    return TRUE;
+  }
+
+  Type * pop(void) {
+    Type * sensor = this->heap[0].sensor;
+    (void) this->remove(sensor);
+    return sensor;
+  }
+
+private:
+  struct Entry {
+    Type * sensor;
+    uint32_t order;
+  };
+
+  static SbBool isBefore(const Entry & a, const Entry & b) {
+    if (isBefore(a.sensor, b.sensor)) return TRUE;
+    if (isBefore(b.sensor, a.sensor)) return FALSE;
+    // the sequence numbers may wrap around
+    return int32_t(a.order - b.order) < 0;
+  }
+  static SbBool isBefore(const SoDelayQueueSensor * a, const SoDelayQueueSensor * b) {
+    return a->getPriority() < b->getPriority();
+  }
+  static SbBool isBefore(const SoTimerQueueSensor * a, const SoTimerQueueSensor * b) {
+    return a->getTriggerTime() < b->getTriggerTime();
+  }
+
+  void place(const int idx, const Entry & entry) {
+    this->heap[idx] = entry;
+    (void) this->slots.put(entry.sensor, idx);
+  }
+
+  // moves the entry at idx towards the root, and returns its new slot
+  int up(int idx) {
+    const Entry entry = this->heap[idx];
+    while (idx > 0) {
+      const int parent = (idx - 1) / 2;
+      if (!isBefore(entry, this->heap[parent])) break;
+      this->place(idx, this->heap[parent]);
+      idx = parent;
+    }
+    this->place(idx, entry);
+    return idx;
+  }
+
+  // moves the entry at idx towards the leaves, and returns its new slot
+  int down(int idx) {
+    const int n = this->heap.getLength();
+    const Entry entry = this->heap[idx];
+    for (;;) {
+      int child = 2 * idx + 1;
+      if (child >= n) break;
+      if (child + 1 < n && isBefore(this->heap[child+1], this->heap[child])) child++;
+      if (!isBefore(this->heap[child], entry)) break;
+      this->place(idx, this->heap[child]);
+      idx = child;
+    }
+    this->place(idx, entry);
+    return idx;
+  }
+
+  SbList <Entry> heap;
+  SbHash<Type *, int> slots;
+  uint32_t order;
+};
+
+// *************************************************************************
+
 class SoSensorManagerP {
 public:
   SoSensorManagerP(void) : alive(ALIVE_PATTERN) { }
@@ -143,12 +243,12 @@ public:
   SbBool processingimmediatequeue;
 
   // immediatequeue - stores SoDelayQueueSensors with priority 0. FIFO.
-  // delayqueue   - stores SoDelayQueueSensor's in sorted order.
-  // timerqueue - stores SoTimerSensors in sorted order.
+  // delayqueue   - stores SoDelayQueueSensor's in priority order.
+  // timerqueue - stores SoTimerSensors in trigger time order.
 
-  SbList <SoDelayQueueSensor *> immediatequeue;
-  SbList <SoDelayQueueSensor *> delayqueue;
-  SbList <SoTimerQueueSensor *> timerqueue;
+  SoSensorHeap <SoDelayQueueSensor> immediatequeue;
+  SoSensorHeap <SoDelayQueueSensor> delayqueue;
+  SoSensorHeap <SoTimerQueueSensor> timerqueue;
   SbList <SoTimerSensor*> reschedulelist;
 
   // FIXME: from what I can see, the two dicts below are simply used
@@ -297,7 +397,7 @@ SoSensorManager::insertDelaySensor(SoDelayQueueSensor * newentry)
   // strategy.
   if (newentry->getPriority() == 0) {
     LOCK_IMMEDIATE_QUEUE(this);
-    PRIVATE(this)->immediatequeue.append(newentry);
+    PRIVATE(this)->immediatequeue.insert(newentry);
     UNLOCK_IMMEDIATE_QUEUE(this);
   }
   else {
@@ -308,17 +408,7 @@ SoSensorManager::insertDelaySensor(SoDelayQueueSensor * newentry)
     }
 
     LOCK_DELAY_QUEUE(this);
-    SbList <SoDelayQueueSensor *> & delayqueue = PRIVATE(this)->delayqueue;
-
-    // <= in test since the sensors should be processed FIFO for
-    // sensors with equal priority
-    uint32_t newsensorpriority = newentry->getPriority();
-    int pos = 0;
-    while((pos < delayqueue.getLength()) &&
-          (delayqueue[pos]->getPriority() <= newsensorpriority)) {
-      pos++;
-    }
-    delayqueue.insert(newentry, pos);
+    PRIVATE(this)->delayqueue.insert(newentry);
     UNLOCK_DELAY_QUEUE(this);
     this->notifyChanged();
   }
@@ -346,20 +436,8 @@ SoSensorManager::insertTimerSensor(SoTimerQueueSensor * newentry)
   SoSensorManagerP::assertAlive(PRIVATE(this));
   assert(newentry);
 
-  SbList <SoTimerQueueSensor *> & timerqueue = PRIVATE(this)->timerqueue;
-
   LOCK_TIMER_QUEUE(this);
-  int i = 0;
-
-  // <= in test since the sensors should be processed FIFO for sensors
-  // with the same trigger time
-  double newtime = newentry->getTriggerTime().getValue();
-  while ((i < timerqueue.getLength()) &&
-         (timerqueue[i]->getTriggerTime().getValue() <= newtime)) {
-    i++;
-  }
-  timerqueue.insert(newentry, i);
-
+  PRIVATE(this)->timerqueue.insert(newentry);
   UNLOCK_TIMER_QUEUE(this);
 
 #if DEBUG_TIMER_SENSORHANDLING || 0 // debug
@@ -390,28 +468,24 @@ SoSensorManager::removeDelaySensor(SoDelayQueueSensor * entry)
 
   LOCK_DELAY_QUEUE(this);
   // Check "real" queue first..
-  int idx = PRIVATE(this)->delayqueue.find(entry);
-  if (idx != -1) PRIVATE(this)->delayqueue.remove(idx);
+  SbBool found = PRIVATE(this)->delayqueue.remove(entry);
   UNLOCK_DELAY_QUEUE(this);
 
   // ..then the immediate queue.
-  if (idx == -1) {
+  if (!found) {
     LOCK_IMMEDIATE_QUEUE(this);
-    idx = PRIVATE(this)->immediatequeue.find(entry);
-    if (idx != -1) PRIVATE(this)->immediatequeue.remove(idx);
+    found = PRIVATE(this)->immediatequeue.remove(entry);
     UNLOCK_IMMEDIATE_QUEUE(this);
   }
   // ..then the reinsert list
-  if (idx == -1) {
-    if (PRIVATE(this)->reinsertdict.erase(entry)) {
-      idx = 0; // make sure notifyChanged() is called.
-    }
+  if (!found) {
+    found = PRIVATE(this)->reinsertdict.erase(entry) ? TRUE : FALSE;
   }
 
-  if (idx != -1) this->notifyChanged();
+  if (found) this->notifyChanged();
 
 #if COIN_DEBUG
-  if (idx == -1) {
+  if (!found) {
     SoDebugError::postWarning("SoSensorManager::removeDelaySensor",
                               "trying to remove element not in list");
   }
@@ -427,9 +501,7 @@ SoSensorManager::removeTimerSensor(SoTimerQueueSensor * entry)
   SoSensorManagerP::assertAlive(PRIVATE(this));
 
   LOCK_TIMER_QUEUE(this);
-  int idx = PRIVATE(this)->timerqueue.find(entry);
-  if (idx != -1) {
-    PRIVATE(this)->timerqueue.remove(idx);
+  if (PRIVATE(this)->timerqueue.remove(entry)) {
     UNLOCK_TIMER_QUEUE(this);
     this->notifyChanged();
   }
@@ -488,8 +560,7 @@ SoSensorManager::processTimerQueue(void)
                            "process element with triggertime %s",
                            PRIVATE(this)->timerqueue[0]->getTriggerTime().format().getString());
 #endif // debug
-    SoSensor * sensor = PRIVATE(this)->timerqueue[0];
-    PRIVATE(this)->timerqueue.remove(0);
+    SoSensor * sensor = PRIVATE(this)->timerqueue.pop();
     UNLOCK_TIMER_QUEUE(this);
     sensor->trigger();
     LOCK_TIMER_QUEUE(this);
@@ -594,8 +665,7 @@ SoSensorManager::processDelayQueue(SbBool isidle)
                            PRIVATE(this)->delayqueue[0]->getPriority());
 #endif // debug
 
-    SoDelayQueueSensor * sensor = PRIVATE(this)->delayqueue[0];
-    PRIVATE(this)->delayqueue.remove(0);
+    SoDelayQueueSensor * sensor = PRIVATE(this)->delayqueue.pop();
     UNLOCK_DELAY_QUEUE(this);
 
     if (!isidle && sensor->isIdleOnly()) {
@@ -695,8 +765,7 @@ SoSensorManager::processImmediateQueue(void)
     SoDebugError::postInfo("SoSensorManager::processImmediateQueue",
                            "trigger element");
 #endif // debug
-    SoSensor * sensor = PRIVATE(this)->immediatequeue[0];
-    PRIVATE(this)->immediatequeue.remove(0);
+    SoSensor * sensor = PRIVATE(this)->immediatequeue.pop();
     UNLOCK_IMMEDIATE_QUEUE(this);
 
     sensor->trigger();
@@ -915,3 +984,84 @@ SoSensorManager::mergeDelayQueues(void)
 #undef LOCK_RESCHEDULE_LIST
 #undef UNLOCK_RESCHEDULE_LIST
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/sensors/SoAlarmSensor.h>
+#include <Inventor/sensors/SoOneShotSensor.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+static void
+record_trigger(void * data, SoSensor * sensor)
+{
+  static_cast<SbList<SoSensor *> *>(data)->append(sensor);
+}
+
+BOOST_AUTO_TEST_CASE(delayQueueOrder)
+{
+  const int num = 300;
+  SbList<SoSensor *> triggered;
+  SoOneShotSensor * sensors[num];
+  for (int i = 0; i < num; i++) {
+    sensors[i] = new SoOneShotSensor(record_trigger, &triggered);
+    sensors[i]->setPriority((i % 3 == 0) ? 0 : 10 + 10 * ((i * 7) % 5));
+    sensors[i]->schedule();
+  }
+  for (int i = 0; i < num; i += 4) sensors[i]->unschedule();
+
+  SoDB::getSensorManager()->processDelayQueue(TRUE);
+
+  // immediate sensors first, then by priority, and in the order they
+  // were scheduled for equal priorities
+  SbList<SoSensor *> expected;
+  for (uint32_t pri = 0; pri <= 50; pri += 10) {
+    for (int i = 0; i < num; i++) {
+      if ((i % 4 != 0) && sensors[i]->getPriority() == pri) expected.append(sensors[i]);
+    }
+  }
+  BOOST_CHECK_EQUAL(triggered.getLength(), expected.getLength());
+  SbBool sameorder = TRUE;
+  for (int i = 0; i < triggered.getLength() && i < expected.getLength(); i++) {
+    if (triggered[i] != expected[i]) sameorder = FALSE;
+  }
+  BOOST_CHECK_MESSAGE(sameorder, "delay queue sensors triggered in wrong order");
+  for (int i = 0; i < num; i++) {
+    BOOST_CHECK(!sensors[i]->isScheduled());
+    delete sensors[i];
+  }
+}
+
+BOOST_AUTO_TEST_CASE(timerQueueOrder)
+{
+  const int num = 100;
+  SbList<SoSensor *> triggered;
+  SoAlarmSensor * sensors[num];
+  const SbTime now = SbTime::getTimeOfDay();
+  for (int i = 0; i < num; i++) {
+    sensors[i] = new SoAlarmSensor(record_trigger, &triggered);
+    sensors[i]->setTime(now - SbTime(10.0 - (i % 4)));
+    sensors[i]->schedule();
+  }
+  for (int i = 1; i < num; i += 5) sensors[i]->unschedule();
+
+  SoDB::getSensorManager()->processTimerQueue();
+
+  SbList<SoSensor *> expected;
+  for (int t = 0; t < 4; t++) {
+    for (int i = 0; i < num; i++) {
+      if ((i % 5 != 1) && (i % 4 == t)) expected.append(sensors[i]);
+    }
+  }
+  BOOST_CHECK_EQUAL(triggered.getLength(), expected.getLength());
+  SbBool sameorder = TRUE;
+  for (int i = 0; i < triggered.getLength() && i < expected.getLength(); i++) {
+    if (triggered[i] != expected[i]) sameorder = FALSE;
+  }
+  BOOST_CHECK_MESSAGE(sameorder, "timer queue sensors triggered in wrong order");
+  for (int i = 0; i < num; i++) delete sensors[i];
+}
+
+#endif // COIN_TEST_SUITE
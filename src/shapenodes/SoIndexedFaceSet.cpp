@@ -223,6 +223,7 @@
 #include <Inventor/threads/SbMutex.h>
 #include <Inventor/threads/SbRWMutex.h>
 
+#include "caches/SoConvexDataCacheP.h"
 #include "nodes/SoSubNodeP.h"
 #include "tidbitsp.h"
 #include "threads/threadsutilp.h"
@@ -242,6 +243,28 @@
 
 // *************************************************************************
 
+// What a convex cache was built for. An old convex cache with the
+// same key as the current one has the same structure, and can be
+// drawn while a new one is built on a worker thread.
+class SoIndexedFaceSetConvexKey {
+public:
+  SoIndexedFaceSetConvexKey(void)
+    : fieldchanges(0), numcoords(-1), mbind(-1), nbind(-1), tbind(-1),
+      normalsfromcache(FALSE) { }
+  int operator==(const SoIndexedFaceSetConvexKey & key) const {
+    return this->fieldchanges == key.fieldchanges &&
+      this->numcoords == key.numcoords &&
+      this->mbind == key.mbind && this->nbind == key.nbind &&
+      this->tbind == key.tbind &&
+      this->normalsfromcache == key.normalsfromcache;
+  }
+
+  uint32_t fieldchanges;
+  int numcoords;
+  int mbind, nbind, tbind;
+  SbBool normalsfromcache;
+};
+
 class SoIndexedFaceSetP {
 public:
   SoIndexedFaceSetP(void) 
@@ -254,6 +277,29 @@ public:
   SoConvexDataCache * convexCache;
   int concavestatus;
 
+  // convex cache being built on a worker thread, see
+  // SoGLRenderAction::setNumCacheThreads()
+  SoConvexDataCache * pendingconvexcache;
+  SoIndexedFaceSetConvexKey convexkey;
+  SoIndexedFaceSetConvexKey pendingconvexkey;
+  // largest normal index in convexCache
+  int convexmaxnormalidx;
+  // counts changes to the shape's own fields
+  uint32_t fieldchanges;
+
+  void setConvexCache(SoConvexDataCache * cache,
+                      const SoIndexedFaceSetConvexKey & key) {
+    if (this->convexCache) this->convexCache->unref();
+    this->convexCache = cache;
+    this->convexkey = key;
+    this->convexmaxnormalidx = -1;
+    const int32_t * idx = cache->getNormalIndices();
+    const int num = cache->getNumNormalIndices();
+    for (int i = 0; i < num; i++) {
+      if (idx[i] > this->convexmaxnormalidx) this->convexmaxnormalidx = idx[i];
+    }
+  }
+
 #ifdef COIN_THREADSAFE
   // FIXME: a mutex for every instance seems a bit excessive,
   // especially since Microsoft Windows might have rather strict limits on the
@@ -298,6 +344,9 @@ SoIndexedFaceSet::SoIndexedFaceSet()
 {
   PRIVATE(this) = new SoIndexedFaceSetP;
   PRIVATE(this)->convexCache = NULL;
+  PRIVATE(this)->pendingconvexcache = NULL;
+  PRIVATE(this)->convexmaxnormalidx = -1;
+  PRIVATE(this)->fieldchanges = 0;
   PRIVATE(this)->vaindexer = NULL;
   PRIVATE(this)->concavestatus = STATUS_UNKNOWN;
 
@@ -312,6 +361,7 @@ SoIndexedFaceSet::~SoIndexedFaceSet()
 {
   delete PRIVATE(this)->vaindexer;
   if (PRIVATE(this)->convexCache) PRIVATE(this)->convexCache->unref();
+  if (PRIVATE(this)->pendingconvexcache) PRIVATE(this)->pendingconvexcache->unref();
   delete PRIVATE(this);
 }
 
@@ -410,6 +460,9 @@ SoIndexedFaceSet::notify(SoNotList * list)
   if (PRIVATE(this)->convexCache) PRIVATE(this)->convexCache->invalidate();
   PRIVATE(this)->readUnlockConvexCache();
   SoField *f = list->getLastField();
+  // old convex caches can't be used after the shape's own fields
+  // have changed
+  if (f && f != &this->vertexProperty) PRIVATE(this)->fieldchanges++;
   if (f == &this->coordIndex) {
     PRIVATE(this)->concavestatus = STATUS_UNKNOWN;
     LOCK_VAINDEXER(this);
@@ -988,7 +1041,57 @@ SoIndexedFaceSet::useConvexCache(SoAction * action,
   PRIVATE(this)->readUnlockConvexCache();
   PRIVATE(this)->writeLockConvexCache();
 
-  if (PRIVATE(this)->convexCache) PRIVATE(this)->convexCache->unref();
+  // With SoGLRenderAction::setNumCacheThreads(), the old cache is
+  // drawn while the new one is built on a worker thread, as long as
+  // it has the same structure and its normal indices are in range.
+  const int numthreads =
+    static_cast<SoGLRenderAction *>(action)->getNumCacheThreads();
+  SbBool defer = FALSE;
+  SoIndexedFaceSetConvexKey key;
+  if (numthreads > 0) {
+    key.fieldchanges = PRIVATE(this)->fieldchanges;
+    key.numcoords = SoCoordinateElement::getInstance(state)->getNum();
+    key.mbind = SoMaterialBindingElement::get(state);
+    key.nbind = SoNormalBindingElement::get(state);
+    key.tbind = SoTextureCoordinateBindingElement::get(state);
+    key.normalsfromcache = normalsfromcache;
+
+    SoConvexDataCache * pending = PRIVATE(this)->pendingconvexcache;
+    if (pending && SoConvexDataCacheP::isGenerated(pending)) {
+      PRIVATE(this)->pendingconvexcache = NULL;
+      if (PRIVATE(this)->pendingconvexkey == key) {
+        PRIVATE(this)->setConvexCache(pending, key);
+      }
+      else {
+        pending->unref();
+      }
+      pending = NULL;
+    }
+
+    const int numnormals = normalsfromcache ?
+      this->getNormalCache()->getNum() :
+      SoNormalElement::getInstance(state)->getNum();
+    SoConvexDataCache * old = PRIVATE(this)->convexCache;
+    if (old && old->isValid(state)) { // just finished, and up to date
+      PRIVATE(this)->writeUnlockConvexCache();
+      PRIVATE(this)->readLockConvexCache();
+      return TRUE;
+    }
+    defer = old && PRIVATE(this)->convexkey == key &&
+      PRIVATE(this)->convexmaxnormalidx < numnormals;
+    if (defer && pending) {
+      // out of date, so it must not end up in other caches
+      SoCacheElement::invalidate(state);
+      PRIVATE(this)->writeUnlockConvexCache();
+      PRIVATE(this)->readLockConvexCache();
+      return TRUE;
+    }
+    if (pending) {
+      pending->unref();
+      PRIVATE(this)->pendingconvexcache = NULL;
+    }
+  }
+
   SbBool storedinvalid = SoCacheElement::setInvalid(FALSE);
 
   // need to send matrix if we have some weird transformation
@@ -1000,9 +1103,9 @@ SoIndexedFaceSet::useConvexCache(SoAction * action,
 
   // push to create cache dependencies
   state->push();
-  PRIVATE(this)->convexCache = new SoConvexDataCache(state);
-  PRIVATE(this)->convexCache->ref();
-  SoCacheElement::set(state, PRIVATE(this)->convexCache);
+  SoConvexDataCache * convexcache = new SoConvexDataCache(state);
+  convexcache->ref();
+  SoCacheElement::set(state, convexcache);
   if (this->vertexProperty.getValue()) this->vertexProperty.getValue()->doAction(action);
   const SoCoordinateElement * coords;
   const SbVec3f * dummynormals;
@@ -1061,18 +1164,34 @@ SoIndexedFaceSet::useConvexCache(SoAction * action,
   if (mbind == PER_VERTEX_INDEXED && mindices == NULL) {
     mindices = cindices;
   }
-  PRIVATE(this)->convexCache->generate(coords, modelmatrix,
-                              cindices, numindices,
-                              mindices, nindices, tindices,
-                              (SoConvexDataCache::Binding)mbind,
-                              (SoConvexDataCache::Binding)nbind,
-                              (SoConvexDataCache::Binding)tbind);
-
-  PRIVATE(this)->writeUnlockConvexCache();
+  if (defer) SoConvexDataCacheP::deferGenerate(convexcache, this, numthreads);
+  convexcache->generate(coords, modelmatrix,
+                        cindices, numindices,
+                        mindices, nindices, tindices,
+                        (SoConvexDataCache::Binding)mbind,
+                        (SoConvexDataCache::Binding)nbind,
+                        (SoConvexDataCache::Binding)tbind);
 
   state->pop();
   SoCacheElement::setInvalid(storedinvalid);
 
+  if (defer && !SoConvexDataCacheP::isGenerated(convexcache)) {
+    PRIVATE(this)->pendingconvexcache = convexcache;
+    PRIVATE(this)->pendingconvexkey = key;
+    // draw the old cache, which is out of date and must not end up in
+    // other caches
+    SoCacheElement::invalidate(state);
+  }
+  else if (numthreads > 0) {
+    PRIVATE(this)->setConvexCache(convexcache, key);
+  }
+  else {
+    if (PRIVATE(this)->convexCache) PRIVATE(this)->convexCache->unref();
+    PRIVATE(this)->convexCache = convexcache;
+  }
+
+  PRIVATE(this)->writeUnlockConvexCache();
+
   PRIVATE(this)->readLockConvexCache();
 
   return TRUE;
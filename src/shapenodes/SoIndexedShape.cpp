@@ -53,6 +53,7 @@
 #include <Inventor/nodes/SoVertexProperty.h>
 
 #include "nodes/SoSubNodeP.h"
+#include "shapenodes/SoVertexShapeP.h"
 #include "coindefs.h" // COIN_OBSOLETED()
 
 /*!
@@ -163,6 +164,13 @@ SoIndexedShape::computeBBox(SoAction * action, SbBox3f & box, SbVec3f & center)
     const SbVec3f * coords = vpvtx ?
       vp->vertex.getValues(0) :
       coordelem->getArrayPtr3();
+    const uint32_t coordid = vpvtx ? vp->getNodeId() : coordelem->getNodeId();
+    if (SoVertexShapeP::getCoordBBox(this, coordid, coords, numcoords, 0, -1,
+                                     this->coordIndex.getValues(0),
+                                     this->coordIndex.getNum(),
+                                     box, center)) {
+      return;
+    }
 
     const int32_t * ptr = this->coordIndex.getValues(0);
     const int32_t * endptr = ptr + this->coordIndex.getNum();
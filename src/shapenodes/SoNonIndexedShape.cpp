@@ -47,6 +47,7 @@
 #include <Inventor/elements/SoCoordinateElement.h>
 
 #include "nodes/SoSubNodeP.h"
+#include "shapenodes/SoVertexShapeP.h"
 
 /*!  
   \var SoSFInt32 SoNonIndexedShape::startIndex 
@@ -130,7 +131,13 @@ SoNonIndexedShape::computeCoordBBox(SoAction * action, int numVertices,
     const SbVec3f * coords = vpvtx ?
       vp->vertex.getValues(0) :
       coordelem->getArrayPtr3();
-    
+    const uint32_t coordid = vpvtx ? vp->getNodeId() : coordelem->getNodeId();
+    if (SoVertexShapeP::getCoordBBox(this, coordid, coords, numCoords,
+                                     startidx, lastidx, NULL, 0,
+                                     box, center)) {
+      return;
+    }
+
     for (int i = startidx; i <= lastidx; i++) {
       box.extendBy(coords[i]);
       center += coords[i];
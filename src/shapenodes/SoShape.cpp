@@ -120,6 +120,9 @@
 #include "threads/threadsutilp.h"
 #include "tidbitsp.h"
 #include "rendering/SoVBO.h"
+#include "caches/SoRayPickCache.h"
+#include "actions/SoMultiRayPickActionP.h"
+#include "actions/SoRayPickActionP.h"
 #include "coindefs.h" // COIN_OBSOLETED()
 
 // SoShape.cpp grew too big, so I had to move some code into new
@@ -176,16 +179,20 @@ public:
     this->bboxcache = NULL;
     this->pvcache = NULL;
     this->bumprender = NULL;
+    this->pickcache = NULL;
     this->rendercnt = 0;
+    this->pickcnt = 0;
     this->flags = 0;
   }
   ~SoShapeP() {
     if (this->bboxcache) { this->bboxcache->unref(); }
     if (this->pvcache) { this->pvcache->unref(); }
+    if (this->pickcache) { this->pickcache->unref(); }
     delete this->bumprender;
   }
   enum {
     RENDERCNT_BITS = 4,     // bits needed to store rendercnt
+    PICKCNT_BITS = 2,       // bits needed to store pickcnt
     FLAG_BITS = 4           // bits needed to store flags
   };
   enum Flags {
@@ -202,6 +209,52 @@ public:
   uint32_t flags : FLAG_BITS;
   // stores the number of frames rendered with no node changes
   uint32_t rendercnt : RENDERCNT_BITS;
+  // stores the number of picks with no node changes
+  uint32_t pickcnt : PICKCNT_BITS;
+
+  // set while generating primitives for SoShape::rayPick(), when
+  // the ray pick cache is being built or used. It is kept in the
+  // action, since several actions may pick the same shape at once.
+  struct PickState {
+    SoRayPickCache * building;
+    const int * candidates;
+    int numcandidates;
+    int nextcandidate;
+    int triangle;
+    SoMultiRayPickActionP * multi;
+  };
+  // the number of rays from an SoMultiRayPickAction for which a ray
+  // pick cache is created at once
+  enum { MULTIRAY_PICKCACHE_LIMIT = 16 };
+  // guarded by the mutex, like the reference count of the cache
+  SoRayPickCache * pickcache;
+
+  static PickState * getPickState(SoAction * action) {
+    SoRayPickActionP * rp =
+      SoRayPickActionP::get(static_cast<SoRayPickAction *>(action));
+    return static_cast<PickState *>(rp->shapepickstate);
+  }
+  static PickState * setPickState(SoAction * action, PickState * pick) {
+    SoRayPickActionP * rp =
+      SoRayPickActionP::get(static_cast<SoRayPickAction *>(action));
+    PickState * old = static_cast<PickState *>(rp->shapepickstate);
+    rp->shapepickstate = pick;
+    return old;
+  }
+  void unrefPickCache(SoRayPickCache * cache) {
+    this->lock();
+    cache->unref();
+    this->unlock();
+  }
+
+  static SbBool usePickCache(void) {
+    static int use = -1;
+    if (use == -1) {
+      const char * env = coin_getenv("COIN_SOSHAPE_RAYPICK_CACHE");
+      use = env ? atoi(env) : 1;
+    }
+    return use != 0;
+  }
 
   // needed since some VRML97 nodes change the GL state inside the node
   void testSetupShapeHints(SoShape * shape) {
@@ -455,10 +508,104 @@ SoShape::rayPick(SoRayPickAction * action)
   if (this->shouldRayPick(action)) {
     this->computeObjectSpaceRay(action);
 
-    if (!PRIVATE(this)->bboxcache ||
+    // an SoMultiRayPickAction lets the shape test the primitives
+    // against all its rays at once
+    SoMultiRayPickActionP * multi = SoMultiRayPickActionP::get(action);
+    if (multi && !multi->claimShape(this)) multi = NULL;
+
+    if (multi ||
+        !PRIVATE(this)->bboxcache ||
         !PRIVATE(this)->bboxcache->isValid(action->getState()) ||
         soshape_ray_intersect(action, PRIVATE(this)->bboxcache->getProjectedBox())) {
+      SoState * state = action->getState();
+      if (multi) multi->setObjectSpaceRays(state);
+
+      // take a reference, as another thread may replace the cache
+      PRIVATE(this)->lock();
+      SoRayPickCache * cache = PRIVATE(this)->pickcache;
+      if (cache && !cache->isValid(state)) {
+        PRIVATE(this)->pickcache = NULL;
+        cache->unref();
+        cache = NULL;
+      }
+      if (cache) cache->ref();
+      PRIVATE(this)->unlock();
+
+      if (cache) {
+        SoShapeP::PickState pick = { NULL, NULL, 0, 0, 0, multi };
+        if (cache->isUsable() && !multi) {
+          // only the triangles the ray might hit need to be tested, and
+          // if there are none, the primitives need not be generated
+          SbList<int> candidates;
+          cache->findTriangles(action->getLine(), candidates);
+          if (candidates.getLength() > 0) {
+            pick.candidates = candidates.getArrayPtr();
+            pick.numcandidates = candidates.getLength();
+            SoShapeP::PickState * old = SoShapeP::setPickState(action, &pick);
+            this->generatePrimitives(action);
+            SoShapeP::setPickState(action, old);
+          }
+        }
+        else if (!cache->isUsable() || multi->findTriangles(cache)) {
+          SoShapeP::PickState * old = SoShapeP::setPickState(action, &pick);
+          this->generatePrimitives(action);
+          SoShapeP::setPickState(action, old);
+        }
+        PRIVATE(this)->unrefPickCache(cache);
+        return;
+      }
+
+      // only create the cache for shapes which are picked more than
+      // once without changes, or by many rays at once
+      const SbBool manyrays =
+        multi && multi->getNumActiveRays() >= SoShapeP::MULTIRAY_PICKCACHE_LIMIT;
+      PRIVATE(this)->lock();
+      const SbBool build = (PRIVATE(this)->pickcnt >= 1 || manyrays) &&
+        SoShapeP::usePickCache();
+      if (!build) PRIVATE(this)->pickcnt = 1;
+      PRIVATE(this)->unlock();
+      if (!build) {
+        SoShapeP::PickState pick = { NULL, NULL, 0, 0, 0, multi };
+        SoShapeP::PickState * old = SoShapeP::setPickState(action, &pick);
+        this->generatePrimitives(action);
+        SoShapeP::setPickState(action, old);
+        return;
+      }
+
+      // must push state to make cache dependencies work
+      state->push();
+      SbBool storedinvalid = SoCacheElement::setInvalid(FALSE);
+      cache = new SoRayPickCache(state);
+      cache->ref();
+      SoCacheElement::set(state, cache);
+
+      SoShapeP::PickState pick = { cache, NULL, 0, 0, 0, multi };
+      SoShapeP::PickState * old = SoShapeP::setPickState(action, &pick);
       this->generatePrimitives(action);
+      SoShapeP::setPickState(action, old);
+
+      state->pop();
+      SoCacheElement::setInvalid(storedinvalid);
+      cache->close();
+
+      // another thread may have built a cache in the meantime
+      PRIVATE(this)->lock();
+      if (PRIVATE(this)->pickcache == NULL) {
+        PRIVATE(this)->pickcache = cache;
+        cache->ref();
+      }
+      PRIVATE(this)->pickcnt = 0;
+      PRIVATE(this)->unlock();
+
+      // with many rays, the cache is built before picking, so that
+      // each triangle is only tested against the rays which might hit it
+      if (multi && (!cache->isUsable() || multi->findTriangles(cache))) {
+        SoShapeP::PickState multipick = { NULL, NULL, 0, 0, 0, multi };
+        old = SoShapeP::setPickState(action, &multipick);
+        this->generatePrimitives(action);
+        SoShapeP::setPickState(action, old);
+      }
+      PRIVATE(this)->unrefPickCache(cache);
     }
   }
 }
@@ -989,53 +1136,85 @@ SoShape::invokeTriangleCallbacks(SoAction * const action,
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection;
-    SbVec3f barycentric;
-    SbBool front;
+    SoShapeP::PickState * pick = SoShapeP::getPickState(action);
+    if (pick) {
+      if (pick->building) {
+        pick->building->addTriangle(v1->getPoint(), v2->getPoint(), v3->getPoint());
+        // a multi-ray pick builds the cache before picking
+        if (pick->multi) return;
+      }
+      else if (pick->candidates) {
+        // skip the triangles the ray pick cache has ruled out
+        const int triangle = pick->triangle++;
+        if (pick->nextcandidate == pick->numcandidates ||
+            pick->candidates[pick->nextcandidate] != triangle) return;
+        pick->nextcandidate++;
+      }
+    }
+
+    // with an SoMultiRayPickAction, the triangle is tested against
+    // each of the rays which might hit it
+    int numrays = 1;
+    const int * rays = NULL;
+    if (pick && pick->multi) {
+      numrays = pick->multi->findRays(pick->triangle++, v1->getPoint(),
+                                      v2->getPoint(), v3->getPoint());
+      rays = pick->multi->getFoundRays();
+    }
+
+    for (int i = 0; i < numrays; i++) {
+      if (rays && pick->multi->selectRay(rays[i])) {
+        this->computeObjectSpaceRay(ra);
+      }
 
-    if (ra->intersect(v1->getPoint(), v2->getPoint(), v3->getPoint(),
-                      intersection, barycentric, front)) {
+      SbVec3f intersection;
+      SbVec3f barycentric;
+      SbBool front;
 
-      if (ra->isBetweenPlanes(intersection)) {
-        if (SoShapeHintsElement::getVertexOrdering(ra->getState()) ==
-            SoShapeHintsElement::CLOCKWISE) {
-          front = !front;
-        }
-        SoPickedPoint * pp = ra->addIntersection(intersection, front);
-        if (pp) {
-          pp->setDetail(this->createTriangleDetail(ra, v1, v2, v3, pp), this);
-          // calculate normal at picked point
-          SbVec3f n =
-            v1->getNormal() * barycentric[0] +
-            v2->getNormal() * barycentric[1] +
-            v3->getNormal() * barycentric[2];
-          n.normalize();
-          pp->setObjectNormal(n);
-
-          // calculate texture coordinate at picked point
-          SbVec4f tc =
-            v1->getTextureCoords() * barycentric[0] +
-            v2->getTextureCoords() * barycentric[1] +
-            v3->getTextureCoords() * barycentric[2];
-
-          pp->setObjectTextureCoords(tc);
-
-          // material index need to be approximated, since there is no
-          // way to average material indices :( This makes it
-          // impossible to fully support color per vertex. An
-          // extension to the OIV API would perhaps be a good idea
-          // here? Maybe calculate the rgba value for diffuse and
-          // transparency and set it in SoPickedPoint?
-          float maxval = barycentric[0];
-          const SoPrimitiveVertex * maxv = v1;
-          if (barycentric[1] > maxval) {
-            maxv = v2;
-            maxval = barycentric[1];
+      if (ra->intersect(v1->getPoint(), v2->getPoint(), v3->getPoint(),
+                        intersection, barycentric, front)) {
+
+        if (ra->isBetweenPlanes(intersection)) {
+          if (SoShapeHintsElement::getVertexOrdering(ra->getState()) ==
+              SoShapeHintsElement::CLOCKWISE) {
+            front = !front;
           }
-          if (barycentric[2] > maxval) {
-            maxv = v3;
+          SoPickedPoint * pp = ra->addIntersection(intersection, front);
+          if (pp) {
+            pp->setDetail(this->createTriangleDetail(ra, v1, v2, v3, pp), this);
+            // calculate normal at picked point
+            SbVec3f n =
+              v1->getNormal() * barycentric[0] +
+              v2->getNormal() * barycentric[1] +
+              v3->getNormal() * barycentric[2];
+            n.normalize();
+            pp->setObjectNormal(n);
+
+            // calculate texture coordinate at picked point
+            SbVec4f tc =
+              v1->getTextureCoords() * barycentric[0] +
+              v2->getTextureCoords() * barycentric[1] +
+              v3->getTextureCoords() * barycentric[2];
+
+            pp->setObjectTextureCoords(tc);
+
+            // material index need to be approximated, since there is no
+            // way to average material indices :( This makes it
+            // impossible to fully support color per vertex. An
+            // extension to the OIV API would perhaps be a good idea
+            // here? Maybe calculate the rgba value for diffuse and
+            // transparency and set it in SoPickedPoint?
+            float maxval = barycentric[0];
+            const SoPrimitiveVertex * maxv = v1;
+            if (barycentric[1] > maxval) {
+              maxv = v2;
+              maxval = barycentric[1];
+            }
+            if (barycentric[2] > maxval) {
+              maxv = v3;
+            }
+            pp->setMaterialIndex(maxv->getMaterialIndex());
           }
-          pp->setMaterialIndex(maxv->getMaterialIndex());
         }
       }
     }
@@ -1100,35 +1279,54 @@ SoShape::invokeLineSegmentCallbacks(SoAction * const action,
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection;
-    if (ra->intersect(v1->getPoint(), v2->getPoint(), intersection)) {
-      if (ra->isBetweenPlanes(intersection)) {
-        SoPickedPoint * pp = ra->addIntersection(intersection);
-        if (pp) {
-          pp->setDetail(this->createLineSegmentDetail(ra, v1, v2, pp), this);
-          float total = (v2->getPoint()-v1->getPoint()).length();
-          float len1 = 1.0f;
-          float len2 = 0.0f;
-          if (total > 0.0f) {
-            len1 = (intersection-v1->getPoint()).length();
-            len2 = (intersection-v2->getPoint()).length();
-            len1 /= total;
-            len2 /= total;
-          }
-          SbVec3f n =
-            v1->getNormal() * len1 +
-            v2->getNormal() * len2;
-          n.normalize();
-          pp->setObjectNormal(n);
-
-          SbVec4f tc =
-            v1->getTextureCoords() * len1 +
-            v2->getTextureCoords() * len2;
-          pp->setObjectTextureCoords(tc);
-          pp->setMaterialIndex(len1 >= len2 ?
-                               v1->getMaterialIndex() :
-                               v2->getMaterialIndex());
+    SoShapeP::PickState * pick = SoShapeP::getPickState(action);
+    if (pick && pick->building) {
+      pick->building->addLineOrPoint();
+      if (pick->multi) return;
+    }
+
+    int numrays = 1;
+    const int * rays = NULL;
+    if (pick && pick->multi) {
+      numrays = pick->multi->getNumActiveRays();
+      rays = pick->multi->getActiveRays();
+    }
+
+    for (int i = 0; i < numrays; i++) {
+      if (rays && pick->multi->selectRay(rays[i])) {
+        this->computeObjectSpaceRay(ra);
+      }
 
+      SbVec3f intersection;
+      if (ra->intersect(v1->getPoint(), v2->getPoint(), intersection)) {
+        if (ra->isBetweenPlanes(intersection)) {
+          SoPickedPoint * pp = ra->addIntersection(intersection);
+          if (pp) {
+            pp->setDetail(this->createLineSegmentDetail(ra, v1, v2, pp), this);
+            float total = (v2->getPoint()-v1->getPoint()).length();
+            float len1 = 1.0f;
+            float len2 = 0.0f;
+            if (total > 0.0f) {
+              len1 = (intersection-v1->getPoint()).length();
+              len2 = (intersection-v2->getPoint()).length();
+              len1 /= total;
+              len2 /= total;
+            }
+            SbVec3f n =
+              v1->getNormal() * len1 +
+              v2->getNormal() * len2;
+            n.normalize();
+            pp->setObjectNormal(n);
+
+            SbVec4f tc =
+              v1->getTextureCoords() * len1 +
+              v2->getTextureCoords() * len2;
+            pp->setObjectTextureCoords(tc);
+            pp->setMaterialIndex(len1 >= len2 ?
+                                 v1->getMaterialIndex() :
+                                 v2->getMaterialIndex());
+
+          }
         }
       }
     }
@@ -1174,15 +1372,34 @@ SoShape::invokePointCallbacks(SoAction * const action,
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection = v->getPoint();
-    if (ra->intersect(intersection)) {
-      if (ra->isBetweenPlanes(intersection)) {
-        SoPickedPoint * pp = ra->addIntersection(intersection);
-        if (pp) {
-          pp->setDetail(this->createPointDetail(ra, v, pp), this);
-          pp->setObjectNormal(v->getNormal());
-          pp->setObjectTextureCoords(v->getTextureCoords());
-          pp->setMaterialIndex(v->getMaterialIndex());
+    SoShapeP::PickState * pick = SoShapeP::getPickState(action);
+    if (pick && pick->building) {
+      pick->building->addLineOrPoint();
+      if (pick->multi) return;
+    }
+
+    int numrays = 1;
+    const int * rays = NULL;
+    if (pick && pick->multi) {
+      numrays = pick->multi->getNumActiveRays();
+      rays = pick->multi->getActiveRays();
+    }
+
+    for (int i = 0; i < numrays; i++) {
+      if (rays && pick->multi->selectRay(rays[i])) {
+        this->computeObjectSpaceRay(ra);
+      }
+
+      SbVec3f intersection = v->getPoint();
+      if (ra->intersect(intersection)) {
+        if (ra->isBetweenPlanes(intersection)) {
+          SoPickedPoint * pp = ra->addIntersection(intersection);
+          if (pp) {
+            pp->setDetail(this->createPointDetail(ra, v, pp), this);
+            pp->setObjectNormal(v->getNormal());
+            pp->setObjectTextureCoords(v->getTextureCoords());
+            pp->setMaterialIndex(v->getMaterialIndex());
+          }
         }
       }
     }
@@ -1428,8 +1645,12 @@ SoShape::notify(SoNotList * nl)
   if (PRIVATE(this)->pvcache) {
     PRIVATE(this)->pvcache->invalidate();
   }
+  if (PRIVATE(this)->pickcache) {
+    PRIVATE(this)->pickcache->invalidate();
+  }
   PRIVATE(this)->flags &= ~SoShapeP::SHOULD_BBOX_CACHE;
   PRIVATE(this)->rendercnt = 0;
+  PRIVATE(this)->pickcnt = 0;
   PRIVATE(this)->unlock();
 }
 
@@ -1789,3 +2010,172 @@ SoShape::validatePVCache(SoGLRenderAction * action)
 
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SoPickedPoint.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/actions/SoRayPickAction.h>
+#include <Inventor/details/SoFaceDetail.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoPointSet.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoVertexProperty.h>
+
+// counts how many times the primitives are generated
+class SoCountingFaceSet : public SoIndexedFaceSet {
+public:
+  SoCountingFaceSet(void) : numgenerated(0) { }
+  int numgenerated;
+protected:
+  virtual void generatePrimitives(SoAction * action) {
+    this->numgenerated++;
+    SoIndexedFaceSet::generatePrimitives(action);
+  }
+};
+
+BOOST_AUTO_TEST_CASE(rayPickRepeated)
+{
+  // a grid of 20x20 quads in the z=0 plane, with the quad at (5, 5)
+  // left out
+  const int n = 21;
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < n; x++) {
+      coords->point.set1Value(y * n + x, SbVec3f(float(x), float(y), 0.0f));
+    }
+  }
+  root->addChild(coords);
+  SoCountingFaceSet * faceset = new SoCountingFaceSet;
+  int idx = 0;
+  for (int y = 0; y < n - 1; y++) {
+    for (int x = 0; x < n - 1; x++) {
+      if (x == 5 && y == 5) continue;
+      const int32_t quad[] = { y * n + x, y * n + x + 1, (y + 1) * n + x + 1, (y + 1) * n + x, -1 };
+      faceset->coordIndex.setValues(idx, 5, quad);
+      idx += 5;
+    }
+  }
+  root->addChild(faceset);
+
+  SoRayPickAction rp(SbViewportRegion(100, 100));
+  // picking several times creates and uses the ray pick cache
+  for (int i = 0; i < 4; i++) {
+    if (i == 3) {
+      // moving the geometry must invalidate the cache
+      coords->point.set1Value(7 * n + 3, SbVec3f(3.0f, 7.0f, 1.0f));
+    }
+    rp.setRay(SbVec3f(3.25f, 7.5f, 10.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+    faceset->numgenerated = 0;
+    rp.apply(root);
+    BOOST_CHECK_EQUAL(faceset->numgenerated, 1);
+    SoPickedPoint * pp = rp.getPickedPoint();
+    BOOST_REQUIRE(pp != NULL);
+    const SbVec3f p = pp->getPoint();
+    BOOST_CHECK_MESSAGE(SbVec2f(p[0] - 3.25f, p[1] - 7.5f).length() < 1.0e-4f,
+                        "wrong intersection point");
+    BOOST_CHECK_MESSAGE((i == 3) ? (p[2] > 0.1f) : (fabs(p[2]) < 1.0e-4f),
+                        "intersection point not on the geometry");
+    const SoFaceDetail * detail = static_cast<const SoFaceDetail *>(pp->getDetail());
+    BOOST_REQUIRE(detail != NULL);
+    BOOST_CHECK_EQUAL(detail->getFaceIndex(), 7 * (n - 1) + 3 - 1);
+
+    rp.setRay(SbVec3f(5.5f, 5.5f, 10.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+    faceset->numgenerated = 0;
+    rp.apply(root);
+    BOOST_CHECK_MESSAGE(rp.getPickedPoint() == NULL, "picked through the hole");
+    // the first pick after a change goes without the cache and the
+    // second one builds it. A miss is then found from the cache alone,
+    // without generating the primitives or rebuilding the cache.
+    BOOST_CHECK_EQUAL(faceset->numgenerated, (i == 1 || i == 2) ? 0 : 1);
+  }
+
+  root->unref();
+}
+
+static void
+check_bbox(SoNode * root, const SoMFVec3f & coords,
+           const int32_t * indices, const int numindices)
+{
+  SbBox3f box;
+  SbVec3f center(0.0f, 0.0f, 0.0f);
+  for (int i = 0; i < numindices; i++) {
+    box.extendBy(coords[indices[i]]);
+    center += coords[indices[i]];
+  }
+  center /= float(numindices);
+
+  SoGetBoundingBoxAction bba(SbViewportRegion(100, 100));
+  bba.apply(root);
+  BOOST_CHECK_MESSAGE(bba.getBoundingBox() == box, "wrong bounding box");
+  BOOST_CHECK_MESSAGE((bba.getCenter() - center).length() < 1.0e-4f,
+                      "wrong bounding box center");
+}
+
+BOOST_AUTO_TEST_CASE(bboxAfterCoordinateEdits)
+{
+  const int n = 16;
+  const int32_t coordindex[] = { 0, 1, 2, -1, 2, 3, 4, 5, -1, 7, 8, 9, -1, 9, 10, 11, 12, 13, 14, -1 };
+  int32_t used[n];
+  int numused = 0;
+  for (int i = 0; i < int(sizeof(coordindex) / sizeof(coordindex[0])); i++) {
+    if (coordindex[i] >= 0) used[numused++] = coordindex[i];
+  }
+  int32_t range[n];
+  for (int i = 0; i < 10; i++) range[i] = i + 2;
+
+  SoSeparator * indexedroot = new SoSeparator;
+  indexedroot->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  SoIndexedFaceSet * faceset = new SoIndexedFaceSet;
+  faceset->coordIndex.setValues(0, sizeof(coordindex) / sizeof(coordindex[0]), coordindex);
+  indexedroot->addChild(coords);
+  indexedroot->addChild(faceset);
+
+  SoSeparator * pointroot = new SoSeparator;
+  pointroot->ref();
+  SoVertexProperty * vp = new SoVertexProperty;
+  SoPointSet * pointset = new SoPointSet;
+  pointset->vertexProperty = vp;
+  pointset->startIndex = 2;
+  pointset->numPoints = 10;
+  pointroot->addChild(pointset);
+
+  for (int i = 0; i < n; i++) {
+    const SbVec3f v(float(i % 4), float(i / 4), 0.0f);
+    coords->point.set1Value(i, v);
+    vp->vertex.set1Value(i, v);
+  }
+
+  // edits that move points out, in and around, also the unused
+  // ones, checked against the box of all the used points
+  uint32_t seed = 1;
+  for (int edit = 0; edit < 200; edit++) {
+    seed = seed * 1103515245 + 12345;
+    const int idx = int((seed >> 16) % n);
+    SbVec3f v = coords->point[idx];
+    const float step = (edit % 3 == 0) ? -2.0f : 1.0f;
+    v[(seed >> 8) % 3] += step * float(int((seed >> 4) % 5) - 2);
+    coords->point.set1Value(idx, v);
+    vp->vertex.set1Value(idx, v);
+
+    check_bbox(indexedroot, coords->point, used, numused);
+    check_bbox(pointroot, vp->vertex, range, 10);
+  }
+
+  // changing the shape itself must not use the old box
+  faceset->coordIndex.set1Value(0, 15);
+  used[0] = 15;
+  check_bbox(indexedroot, coords->point, used, numused);
+  pointset->startIndex = 5;
+  for (int i = 0; i < 10; i++) range[i] = i + 5;
+  check_bbox(pointroot, vp->vertex, range, 10);
+
+  indexedroot->unref();
+  pointroot->unref();
+}
+
+#endif // COIN_TEST_SUITE
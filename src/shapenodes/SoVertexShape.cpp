@@ -56,12 +56,21 @@
 #include <Inventor/elements/SoCoordinateElement.h>
 #include <Inventor/elements/SoCreaseAngleElement.h>
 #include <Inventor/elements/SoGLShapeHintsElement.h>
+#include <Inventor/elements/SoNormalBindingElement.h>
 #include <Inventor/elements/SoNormalElement.h>
 #include <Inventor/misc/SoState.h>
 #include <Inventor/nodes/SoVertexProperty.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/misc/SoNotification.h>
+#include <Inventor/threads/SbMutex.h>
 #include <Inventor/threads/SbRWMutex.h>
+#include <Inventor/SbBox3f.h>
+#include <Inventor/SbVec3d.h>
 
+#include "caches/SoNormalCacheP.h"
 #include "nodes/SoSubNodeP.h"
+#include "shapenodes/SoVertexShapeP.h"
+#include "misc/SoCoordinateChangeLog.h"
 #include "tidbitsp.h"
 
 // *************************************************************************
@@ -88,37 +97,365 @@
 
 // *************************************************************************
 
-class SoVertexShapeP {
+// Keeps the bounding box and center of the coordinates used by a
+// shape, and a copy of those coordinates, so that the box can be
+// updated for just the coordinates in the changes from the
+// SoCoordinateChangeLog. The center is kept as a weighted sum. For
+// the box, we keep which coordinates are at its sides, so that it is
+// only recalculated when one of those moves inwards.
+//
+// Non-indexed shapes use each coordinate from first to last once, so
+// for those we only copy that range and keep no weights.
+class SoVertexShapeCoordBBox {
 public:
-  SoNormalCache * normalcache;
-
-  // we can use a per-instance mutex here instead of this class-wide
-  // one, but we go for the class-wide one since at least Microsoft Windows
-  // might have a rather strict limit on the total amount of mutex
-  // resources a process / user can hold at any one time.
-  //
-  // i haven't looked too hard at the affected code regions in the
-  // sub-classes, however. it might be that a class-wide lock can
-  // cause significantly less efficient execution in a multi-threaded
-  // environment. if so, we will have to come up with something better
-  // than just a class-wide lock (a mutex pool or something, i
-  // suppose).
-  //
-  // -mortene.
-  static SbRWMutex * normalcachemutex;
+  static size_t getBytes(const int numcoords, const int first, const int last,
+                         const int32_t * indices) {
+    if (indices) return size_t(numcoords) * (sizeof(SbVec3f) + sizeof(int));
+    return size_t(last + 1 - first) * sizeof(SbVec3f);
+  }
+  size_t getBytes(void) const {
+    return getBytes(this->numcoords, this->first, this->last, this->indices);
+  }
 
-  static void cleanup(void);
+  SbBool matches(const int numcoords, const int first, const int last,
+                 const int32_t * indices, const int numindices) const {
+    return
+      (this->numcoords == numcoords) &&
+      (this->first == first) && (this->last == last) &&
+      (this->indices == indices) && (this->numindices == numindices);
+  }
+  SbBool compute(const SbVec3f * coords, const int numcoords,
+                 const int first, const int last,
+                 const int32_t * indices, const int numindices);
+  void update(const SbVec3f * coords, const SbList<int> & ranges);
+  void get(SbBox3f & box, SbVec3f & center) const;
+
+  uint32_t coordid;
+
+private:
+  // the coordinates we have a copy of are from lo to hi-1
+  int lo(void) const { return this->indices ? 0 : this->first; }
+  int hi(void) const { return this->indices ? this->numcoords : this->last + 1; }
+  int weight(const int idx) const {
+    return this->indices ? this->weights[idx] : 1;
+  }
+  void extendBy(const int idx, const SbVec3f & v);
+  void computeBox(void);
+
+  int numcoords;
+  int first;
+  int last;
+  const int32_t * indices;
+  int numindices;
+
+  SbList<SbVec3f> values;
+  SbList<int> weights;
+
+  SbBox3f box;
+  int sides[6];
+  SbVec3d sum;
+  int count;
 };
 
+// Returns FALSE if an index is out of bounds. Such shapes are left to
+// the regular code, which will report the error.
+SbBool
+SoVertexShapeCoordBBox::compute(const SbVec3f * coords, const int numcoords,
+                                const int first, const int last,
+                                const int32_t * indices, const int numindices)
+{
+  this->numcoords = numcoords;
+  this->first = first;
+  this->last = last;
+  this->indices = indices;
+  this->numindices = numindices;
+
+  this->values.truncate(0);
+  this->weights.truncate(0);
+  if (!indices && last >= numcoords) return FALSE;
+  int i;
+  for (i = this->lo(); i < this->hi(); i++) {
+    this->values.append(coords[i]);
+  }
+  this->count = 0;
+  if (indices) {
+    for (i = 0; i < numcoords; i++) this->weights.append(0);
+    for (i = 0; i < numindices; i++) {
+      const int idx = indices[i];
+      if (idx >= numcoords) return FALSE;
+      if (idx >= 0) {
+        this->weights[idx]++;
+        this->count++;
+      }
+    }
+  }
+  else {
+    this->count = last + 1 - first;
+  }
+
+  this->sum.setValue(0.0, 0.0, 0.0);
+  for (i = this->lo(); i < this->hi(); i++) {
+    const int w = this->weight(i);
+    if (w) this->sum += SbVec3d(coords[i]) * double(w);
+  }
+  this->computeBox();
+  return TRUE;
+}
+
+void
+SoVertexShapeCoordBBox::update(const SbVec3f * coords, const SbList<int> & ranges)
+{
+  SbBool inwards = FALSE;
+  const int lo = this->lo();
+  for (int r = 0; r < ranges.getLength(); r += 2) {
+    const int end = SbMin(ranges[r] + ranges[r+1], this->hi());
+    for (int i = SbMax(ranges[r], lo); i < end; i++) {
+      const SbVec3f oldv = this->values[i - lo];
+      const SbVec3f & newv = coords[i];
+      this->values[i - lo] = newv;
+      const int w = this->weight(i);
+      if (w == 0 || oldv == newv) continue;
+
+      this->sum += (SbVec3d(newv) - SbVec3d(oldv)) * double(w);
+      for (int a = 0; a < 3; a++) {
+        if ((this->sides[a] == i && newv[a] > oldv[a]) ||
+            (this->sides[a+3] == i && newv[a] < oldv[a])) {
+          inwards = TRUE;
+        }
+      }
+      if (!inwards) this->extendBy(i, newv);
+    }
+  }
+  if (inwards) this->computeBox();
+}
+
+void
+SoVertexShapeCoordBBox::get(SbBox3f & box, SbVec3f & center) const
+{
+  box = this->box;
+  center.setValue(0.0f, 0.0f, 0.0f);
+  if (this->count) center.setValue(this->sum / double(this->count));
+}
+
+void
+SoVertexShapeCoordBBox::extendBy(const int idx, const SbVec3f & v)
+{
+  if (this->box.isEmpty()) {
+    this->box.setBounds(v, v);
+    for (int a = 0; a < 6; a++) this->sides[a] = idx;
+    return;
+  }
+  SbVec3f & minpt = this->box.getMin();
+  SbVec3f & maxpt = this->box.getMax();
+  for (int a = 0; a < 3; a++) {
+    if (v[a] < minpt[a]) { minpt[a] = v[a]; this->sides[a] = idx; }
+    if (v[a] > maxpt[a]) { maxpt[a] = v[a]; this->sides[a+3] = idx; }
+  }
+}
+
+void
+SoVertexShapeCoordBBox::computeBox(void)
+{
+  this->box.makeEmpty();
+  const int lo = this->lo();
+  for (int i = lo; i < this->hi(); i++) {
+    if (this->weight(i)) this->extendBy(i, this->values[i - lo]);
+  }
+}
+
+// *************************************************************************
+
 // called by atexit
 void
 SoVertexShapeP::cleanup(void)
 {
   delete SoVertexShapeP::normalcachemutex;
   SoVertexShapeP::normalcachemutex = NULL;
+  delete SoVertexShapeP::coordbboxmutex;
+  SoVertexShapeP::coordbboxmutex = NULL;
 }
 
 SbRWMutex * SoVertexShapeP::normalcachemutex = NULL;
+SbMutex * SoVertexShapeP::coordbboxmutex = NULL;
+size_t SoVertexShapeP::coordbboxbytes = 0;
+
+// Upper limit for the memory used by the coordinate copies of all
+// SoVertexShapeCoordBBox instances. Shapes which would go over it
+// just calculate their bounding boxes the regular way.
+#define SOVERTEXSHAPE_COORDBBOX_MAXBYTES (64 * 1024 * 1024)
+
+// Calculates the bounding box and center of the coordinates used by
+// shape, like SoNonIndexedShape::computeCoordBBox() (with indices
+// NULL) or SoIndexedShape::computeBBox() would. Returns FALSE if the
+// shape should calculate them itself.
+//
+// The box is only kept for shapes with coordinates which have been
+// changed with ranged edits, like SoMField::set1Value(), and only as
+// long as the total size of the coordinate copies stays below
+// SOVERTEXSHAPE_COORDBBOX_MAXBYTES. While such edits go on, only the
+// edited coordinates are visited.
+SbBool
+SoVertexShapeP::getCoordBBox(SoVertexShape * shape, const uint32_t coordid,
+                             const SbVec3f * coords, const int numcoords,
+                             const int first, const int last,
+                             const int32_t * indices, const int numindices,
+                             SbBox3f & box, SbVec3f & center)
+{
+  SoVertexShapeP * thisp = shape->pimpl;
+  // quick check without locking, for the common case of a shape whose
+  // coordinates are not being edited
+  if (thisp->coordbbox == NULL && !SoCoordinateChangeLog::isChanged(coordid)) {
+    return FALSE;
+  }
+
+  if (SoVertexShapeP::coordbboxmutex) SoVertexShapeP::coordbboxmutex->lock();
+  SoVertexShapeCoordBBox * bbox = thisp->coordbbox;
+  SbBool ok = FALSE;
+  if (bbox && bbox->matches(numcoords, first, last, indices, numindices)) {
+    SbList<int> ranges;
+    if (SoCoordinateChangeLog::getChanges(bbox->coordid, coordid, ranges)) {
+      bbox->update(coords, ranges);
+      ok = TRUE;
+    }
+  }
+  if (!ok && SoCoordinateChangeLog::isChanged(coordid)) {
+    size_t bytes = SoVertexShapeP::coordbboxbytes;
+    if (bbox) bytes -= bbox->getBytes();
+    bytes += SoVertexShapeCoordBBox::getBytes(numcoords, first, last, indices);
+    if (bytes <= SOVERTEXSHAPE_COORDBBOX_MAXBYTES) {
+      if (bbox == NULL) bbox = thisp->coordbbox = new SoVertexShapeCoordBBox;
+      ok = bbox->compute(coords, numcoords, first, last, indices, numindices);
+      SoVertexShapeP::coordbboxbytes = bytes;
+    }
+  }
+  if (ok) {
+    bbox->coordid = coordid;
+    bbox->get(box, center);
+  }
+  else {
+    SoVertexShapeP::deleteCoordBBox(thisp);
+  }
+  if (SoVertexShapeP::coordbboxmutex) SoVertexShapeP::coordbboxmutex->unlock();
+  return ok;
+}
+
+#undef SOVERTEXSHAPE_COORDBBOX_MAXBYTES
+
+// Deletes the coordinate bounding box of thisp, if any. Must be
+// called with coordbboxmutex locked.
+void
+SoVertexShapeP::deleteCoordBBox(SoVertexShapeP * thisp)
+{
+  if (thisp->coordbbox == NULL) return;
+  SoVertexShapeP::coordbboxbytes -= thisp->coordbbox->getBytes();
+  delete thisp->coordbbox;
+  thisp->coordbbox = NULL;
+}
+
+// Forgets the coordinate bounding box of shape. Called when the
+// shape's own fields change, since the box depends on them.
+void
+SoVertexShapeP::resetCoordBBox(SoVertexShape * shape)
+{
+  SoVertexShapeP * thisp = shape->pimpl;
+  if (thisp->coordbbox == NULL) return;
+  if (SoVertexShapeP::coordbboxmutex) SoVertexShapeP::coordbboxmutex->lock();
+  SoVertexShapeP::deleteCoordBBox(thisp);
+  if (SoVertexShapeP::coordbboxmutex) SoVertexShapeP::coordbboxmutex->unlock();
+}
+
+// Creates a normal cache for shape. With numthreads > 0, normals
+// generated by the SoNormalCache::generatePer*() methods are
+// generated on a worker thread.
+SoNormalCache *
+SoVertexShapeP::createNormalCache(SoVertexShape * shape, SoState * state,
+                                  const int numthreads)
+{
+  SbBool storeinvalid = SoCacheElement::setInvalid(FALSE);
+
+  state->push(); // need to push for cache dependencies
+  SoNormalCache * nc = new SoNormalCache(state);
+  nc->ref();
+  SoCacheElement::set(state, nc);
+  if (numthreads > 0) SoNormalCacheP::deferGenerate(nc, shape, numthreads);
+  //
+  // See if the node supports the Coin-way of generating normals
+  //
+  if (!shape->generateDefaultNormals(state, nc)) {
+    // FIXME: implement SoNormalBundle
+    if (shape->generateDefaultNormals(state, (SoNormalBundle *)NULL)) {
+      // FIXME: set generator in normal cache
+    }
+  }
+  SoNormalCacheP::deferGenerate(nc, NULL, 0);
+  state->pop(); // don't forget this pop
+
+  SoCacheElement::setInvalid(storeinvalid);
+  return nc;
+}
+
+// Called with the normal cache write locked when it is invalid. If
+// the old normal cache can be drawn while a new one is generated on a
+// worker thread, makes sure generating has started, and returns TRUE
+// with the cache to draw in normalcache. Returns FALSE if the caller
+// should generate the normals itself.
+SbBool
+SoVertexShapeP::useOldNormalCache(SoVertexShape * shape, SoState * state,
+                                  const int numthreads)
+{
+  SoVertexShapeP * thisp = shape->pimpl;
+  SoVertexShapeNormalCacheKey key;
+  SoVertexShapeP::getNormalCacheKey(shape, state, key);
+
+  SoNormalCache * pending = thisp->pendingnormalcache;
+  if (pending && SoNormalCacheP::isGenerated(pending)) {
+    thisp->pendingnormalcache = NULL;
+    if (thisp->pendingnormalcachekey == key) {
+      if (thisp->normalcache) thisp->normalcache->unref();
+      thisp->normalcache = pending;
+      thisp->normalcachekey = key;
+      if (pending->isValid(state)) return TRUE;
+      // the coordinates have changed again, so draw these normals
+      // while the next ones are generated
+    }
+    else {
+      pending->unref();
+    }
+    pending = NULL;
+  }
+
+  if (thisp->normalcache == NULL || !(thisp->normalcachekey == key)) {
+    if (pending) {
+      pending->unref();
+      thisp->pendingnormalcache = NULL;
+    }
+    return FALSE;
+  }
+
+  if (pending == NULL) {
+    pending = SoVertexShapeP::createNormalCache(shape, state, numthreads);
+    if (SoNormalCacheP::isGenerated(pending)) { // not deferred
+      thisp->normalcache->unref();
+      thisp->normalcache = pending;
+      return TRUE;
+    }
+    thisp->pendingnormalcache = pending;
+    thisp->pendingnormalcachekey = key;
+  }
+  // the normals are out of date, so they must not end up in other
+  // caches
+  SoCacheElement::invalidate(state);
+  return TRUE;
+}
+
+void
+SoVertexShapeP::getNormalCacheKey(SoVertexShape * shape, SoState * state,
+                                  SoVertexShapeNormalCacheKey & key)
+{
+  key.fieldchanges = shape->pimpl->fieldchanges;
+  key.numcoords = SoCoordinateElement::getInstance(state)->getNum();
+  key.binding = SoNormalBindingElement::get(state);
+}
 
 #define PRIVATE(obj) ((obj)->pimpl)
 
@@ -139,6 +476,7 @@ SoVertexShape::initClass(void)
 
 #ifdef COIN_THREADSAFE
   SoVertexShapeP::normalcachemutex = new SbRWMutex(SbRWMutex::READ_PRECEDENCE);
+  SoVertexShapeP::coordbboxmutex = new SbMutex;
 #endif // COIN_THREADSAFE
 
   coin_atexit((coin_atexit_f *)SoVertexShapeP::cleanup, CC_ATEXIT_NORMAL);
@@ -151,6 +489,9 @@ SoVertexShape::SoVertexShape(void)
 {
   PRIVATE(this) = new SoVertexShapeP;
   PRIVATE(this)->normalcache = NULL;
+  PRIVATE(this)->pendingnormalcache = NULL;
+  PRIVATE(this)->fieldchanges = 0;
+  PRIVATE(this)->coordbbox = NULL;
 
   SO_NODE_INTERNAL_CONSTRUCTOR(SoVertexShape);
 
@@ -163,6 +504,8 @@ SoVertexShape::SoVertexShape(void)
 SoVertexShape::~SoVertexShape()
 {
   if (PRIVATE(this)->normalcache) PRIVATE(this)->normalcache->unref();
+  if (PRIVATE(this)->pendingnormalcache) PRIVATE(this)->pendingnormalcache->unref();
+  SoVertexShapeP::resetCoordBBox(this);
   delete PRIVATE(this);
 }
 
@@ -175,6 +518,13 @@ SoVertexShape::notify(SoNotList * nl)
   this->readLockNormalCache();
   if (PRIVATE(this)->normalcache) PRIVATE(this)->normalcache->invalidate();
   this->readUnlockNormalCache();
+  SoField * f = nl->getLastField();
+  if (f != &this->vertexProperty) {
+    SoVertexShapeP::resetCoordBBox(this);
+    // old normal caches can't be used after the shape's own fields
+    // have changed
+    if (f) PRIVATE(this)->fieldchanges++;
+  }
   inherited::notify(nl);
 }
 
@@ -280,26 +630,20 @@ SoVertexShape::generateAndReadLockNormalCache(SoState * const state)
   }
   this->readUnlockNormalCache();
   this->writeLockNormalCache();
-  
-  SbBool storeinvalid = SoCacheElement::setInvalid(FALSE);
-  
-  if (PRIVATE(this)->normalcache) PRIVATE(this)->normalcache->unref();
-  state->push(); // need to push for cache dependencies
-  PRIVATE(this)->normalcache = new SoNormalCache(state);
-  PRIVATE(this)->normalcache->ref();
-  SoCacheElement::set(state, PRIVATE(this)->normalcache);
-  //
-  // See if the node supports the Coin-way of generating normals
-  //
-  if (!generateDefaultNormals(state, PRIVATE(this)->normalcache)) {
-    // FIXME: implement SoNormalBundle
-    if (generateDefaultNormals(state, (SoNormalBundle *)NULL)) {
-      // FIXME: set generator in normal cache
+
+  SoAction * action = state->getAction();
+  const int numthreads =
+    action->isOfType(SoGLRenderAction::getClassTypeId()) ?
+    static_cast<SoGLRenderAction *>(action)->getNumCacheThreads() : 0;
+
+  if (numthreads == 0 ||
+      !SoVertexShapeP::useOldNormalCache(this, state, numthreads)) {
+    if (PRIVATE(this)->normalcache) PRIVATE(this)->normalcache->unref();
+    PRIVATE(this)->normalcache = SoVertexShapeP::createNormalCache(this, state, 0);
+    if (numthreads > 0) {
+      SoVertexShapeP::getNormalCacheKey(this, state, PRIVATE(this)->normalcachekey);
     }
   }
-  state->pop(); // don't forget this pop
-  
-  SoCacheElement::setInvalid(storeinvalid);
   this->writeUnlockNormalCache();
   this->readLockNormalCache();
   return PRIVATE(this)->normalcache;
@@ -387,3 +731,273 @@ SoVertexShape::writeUnlockNormalCache(void)
 // *************************************************************************
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/caches/SoNormalCache.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoShapeHints.h>
+#include <Inventor/sensors/SoNodeSensor.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+// The normal cache tests below traverse with an SoGLRenderAction
+// without an OpenGL context, so the nodes in them must not make any
+// OpenGL calls.
+
+class SoNoGLCoordinate3 : public SoCoordinate3 {
+public:
+  virtual void GLRender(SoGLRenderAction * action) { this->doAction(action); }
+};
+
+// keeps the normal cache it was drawn with, and the normal of each
+// vertex from it
+class SoNormalCacheFaceSet : public SoIndexedFaceSet {
+public:
+  SoNormalCacheFaceSet(void) : normalcache(NULL) { }
+  virtual void GLRender(SoGLRenderAction * action) {
+    SoNormalCache * nc = this->generateAndReadLockNormalCache(action->getState());
+    this->normalcache = nc;
+    this->normals.truncate(0);
+    const SbVec3f * normals = nc->getNormals();
+    const int32_t * indices = nc->getIndices();
+    const int num = indices ? nc->getNumIndices() : nc->getNum();
+    for (int i = 0; i < num; i++) {
+      const int idx = indices ? indices[i] : i;
+      if (idx >= 0) this->normals.append(normals[idx]);
+    }
+    this->readUnlockNormalCache();
+  }
+  const SoNormalCache * normalcache;
+  SbList<SbVec3f> normals;
+};
+
+// only traverses, without the OpenGL setup of SoGLRenderAction
+class SoNoGLRenderAction : public SoGLRenderAction {
+public:
+  SoNoGLRenderAction(const int numthreads)
+    : SoGLRenderAction(SbViewportRegion(100, 100)) {
+    this->setNumCacheThreads(numthreads);
+  }
+protected:
+  virtual void beginTraversal(SoNode * node) { this->traverse(node); }
+};
+
+// A grid of quads, with every other column of points at height z. It
+// is big enough that generating its normals on a worker thread takes a while.
+#define NORMALCACHE_GRID_SIZE 200
+
+static SoNormalCacheFaceSet *
+normalcache_make_grid(SoGroup * root, SoCoordinate3 * coords)
+{
+  const int n = NORMALCACHE_GRID_SIZE;
+  SoShapeHints * hints = new SoShapeHints;
+  hints->creaseAngle = 0.5f;
+  SoNormalCacheFaceSet * faceset = new SoNormalCacheFaceSet;
+  faceset->coordIndex.setNum((n - 1) * (n - 1) * 5);
+  int32_t * idx = faceset->coordIndex.startEditing();
+  for (int y = 0; y < n - 1; y++) {
+    for (int x = 0; x < n - 1; x++) {
+      *idx++ = y * n + x;
+      *idx++ = y * n + x + 1;
+      *idx++ = (y + 1) * n + x + 1;
+      *idx++ = (y + 1) * n + x;
+      *idx++ = -1;
+    }
+  }
+  faceset->coordIndex.finishEditing();
+  root->addChild(hints);
+  root->addChild(coords);
+  root->addChild(faceset);
+  return faceset;
+}
+
+static void
+normalcache_set_height(SoCoordinate3 * coords, const float z)
+{
+  const int n = NORMALCACHE_GRID_SIZE;
+  coords->point.setNum(n * n);
+  SbVec3f * pts = coords->point.startEditing();
+  for (int i = 0; i < n * n; i++) {
+    pts[i].setValue(float(i % n), float(i / n), ((i % n) & 1) ? z : 0.0f);
+  }
+  coords->point.finishEditing();
+}
+
+// the normals of the grid, generated without worker threads
+static SbList<SbVec3f>
+normalcache_expected(SoCoordinate3 * coords)
+{
+  SoGroup * root = new SoGroup;
+  root->ref();
+  SoNormalCacheFaceSet * faceset = normalcache_make_grid(root, coords);
+  SoNoGLRenderAction action(0);
+  action.apply(root);
+  SbList<SbVec3f> normals = faceset->normals;
+  root->unref();
+  return normals;
+}
+
+static SbBool
+normalcache_equal(const SbList<SbVec3f> & a, const SbList<SbVec3f> & b)
+{
+  if (a.getLength() != b.getLength()) return FALSE;
+  for (int i = 0; i < a.getLength(); i++) {
+    if (!a[i].equals(b[i], 1.0e-6f)) return FALSE;
+  }
+  return TRUE;
+}
+
+static int normalcache_numtouched = 0;
+
+static void
+normalcache_touched_cb(void *, SoSensor *)
+{
+  normalcache_numtouched++;
+}
+
+// Waits for the finished cache build jobs to touch their nodes.
+static SbBool
+normalcache_wait_touched(void)
+{
+  for (int i = 0; i < 10000 && normalcache_numtouched == 0; i++) {
+    SbTime::sleep(1);
+    SoDB::getSensorManager()->processDelayQueue(FALSE);
+  }
+  return normalcache_numtouched > 0;
+}
+
+BOOST_AUTO_TEST_CASE(normalCacheOnWorkerThread)
+{
+  SoGroup * root = new SoGroup;
+  root->ref();
+  SoNoGLCoordinate3 * coords = new SoNoGLCoordinate3;
+  normalcache_set_height(coords, 0.5f);
+  SoNormalCacheFaceSet * faceset = normalcache_make_grid(root, coords);
+  SoNodeSensor sensor(normalcache_touched_cb, NULL);
+  sensor.setPriority(0);
+  sensor.attach(faceset);
+
+  // the first cache is always generated before drawing
+  SoNoGLRenderAction action(2);
+  action.apply(root);
+  const SoNormalCache * first = faceset->normalcache;
+  const SbList<SbVec3f> oldnormals = faceset->normals;
+  BOOST_CHECK_MESSAGE(normalcache_equal(oldnormals, normalcache_expected(coords)),
+                      "wrong normals in the first cache");
+
+  // Moving the points keeps the structure, so the old normals are
+  // drawn while the new ones are generated. The job could in theory
+  // finish before the shape checks it, and the new normals would then
+  // be drawn right away.
+  normalcache_set_height(coords, -1.0f);
+  const SbList<SbVec3f> newnormals = normalcache_expected(coords);
+  BOOST_REQUIRE(!normalcache_equal(oldnormals, newnormals));
+  normalcache_numtouched = 0;
+  action.apply(root);
+  if (faceset->normalcache == first) {
+    BOOST_CHECK_MESSAGE(normalcache_equal(faceset->normals, oldnormals),
+                        "the stale cache was changed while a job was pending");
+  }
+  else {
+    BOOST_CHECK_MESSAGE(normalcache_equal(faceset->normals, newnormals),
+                        "wrong normals from a finished job");
+  }
+
+  // The shape is touched when the job is done, and then draws the
+  // new normals. Unless Coin is built with COIN_THREADSAFE, the job
+  // was run at once.
+  if (faceset->normalcache == first) {
+    BOOST_CHECK_MESSAGE(normalcache_wait_touched(), "the shape was not touched");
+  }
+  action.apply(root);
+  BOOST_CHECK(faceset->normalcache != first);
+  BOOST_CHECK_MESSAGE(normalcache_equal(faceset->normals, newnormals),
+                      "wrong normals from the worker thread");
+
+  sensor.detach();
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(normalCacheKeyMismatch)
+{
+  SoGroup * root = new SoGroup;
+  root->ref();
+  SoNoGLCoordinate3 * coords = new SoNoGLCoordinate3;
+  normalcache_set_height(coords, 0.5f);
+  SoNormalCacheFaceSet * faceset = normalcache_make_grid(root, coords);
+  SoNoGLRenderAction action(2);
+  action.apply(root);
+
+  // after a change to the shape's own fields, the old normals can't
+  // be used, so the new ones are generated before drawing
+  faceset->coordIndex.set1Value(0, faceset->coordIndex[0]);
+  normalcache_set_height(coords, -1.0f);
+  action.apply(root);
+  BOOST_CHECK_MESSAGE(normalcache_equal(faceset->normals, normalcache_expected(coords)),
+                      "old normals drawn after the shape changed");
+
+  // the same goes for a change in the number of coordinates
+  normalcache_set_height(coords, 0.5f);
+  coords->point.set1Value(coords->point.getNum(), SbVec3f(0.0f, 0.0f, 0.0f));
+  action.apply(root);
+  BOOST_CHECK_MESSAGE(normalcache_equal(faceset->normals, normalcache_expected(coords)),
+                      "old normals drawn after the number of coordinates changed");
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(normalCacheShapeDestroyed)
+{
+  SoNoGLCoordinate3 * coords = new SoNoGLCoordinate3;
+  coords->ref();
+  normalcache_set_height(coords, 0.5f);
+  SoNoGLRenderAction action(1);
+
+  // Start jobs for two shapes on one worker thread and destroy the
+  // shapes. The first job is waited for if it has started, and the
+  // second one is cancelled. Neither may touch its node afterwards.
+  SoGroup * roots[3];
+  SoNormalCacheFaceSet * facesets[3];
+  int i;
+  for (i = 0; i < 3; i++) {
+    roots[i] = new SoGroup;
+    roots[i]->ref();
+    facesets[i] = normalcache_make_grid(roots[i], coords);
+    action.apply(roots[i]);
+  }
+  normalcache_set_height(coords, -1.0f);
+  for (i = 0; i < 2; i++) {
+    action.apply(roots[i]);
+    roots[i]->unref();
+  }
+  SbTime::sleep(10);
+  SoDB::getSensorManager()->processDelayQueue(FALSE);
+
+  // the worker thread must still be usable
+  SoNodeSensor sensor(normalcache_touched_cb, NULL);
+  sensor.setPriority(0);
+  sensor.attach(facesets[2]);
+  normalcache_numtouched = 0;
+  const SoNormalCache * old = facesets[2]->normalcache;
+  action.apply(roots[2]);
+  if (facesets[2]->normalcache == old) {
+    BOOST_CHECK_MESSAGE(normalcache_wait_touched(), "the shape was not touched");
+  }
+  action.apply(roots[2]);
+  BOOST_CHECK_MESSAGE(normalcache_equal(facesets[2]->normals, normalcache_expected(coords)),
+                      "wrong normals after other shapes were destroyed");
+
+  sensor.detach();
+  roots[2]->unref();
+  coords->unref();
+}
+
+#undef NORMALCACHE_GRID_SIZE
+
+#endif // COIN_TEST_SUITE
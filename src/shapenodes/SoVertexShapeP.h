@@ -0,0 +1,119 @@
+#ifndef COIN_SOVERTEXSHAPEP_H
+#define COIN_SOVERTEXSHAPEP_H
+
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif // !COIN_INTERNAL
+
+#include <Inventor/SbBasic.h>
+
+class SbBox3f;
+class SbMutex;
+class SbRWMutex;
+class SbVec3f;
+class SoNormalCache;
+class SoState;
+class SoVertexShape;
+class SoVertexShapeCoordBBox;
+
+// What a normal cache was built for. An old normal cache with the
+// same key as the current one has the same structure, and can be
+// drawn while a new one is built on a worker thread.
+class SoVertexShapeNormalCacheKey {
+public:
+  SoVertexShapeNormalCacheKey(void) : fieldchanges(0), numcoords(-1), binding(-1) { }
+  int operator==(const SoVertexShapeNormalCacheKey & key) const {
+    return this->fieldchanges == key.fieldchanges &&
+      this->numcoords == key.numcoords && this->binding == key.binding;
+  }
+
+  uint32_t fieldchanges;
+  int numcoords;
+  int binding;
+};
+
+class SoVertexShapeP {
+public:
+  SoNormalCache * normalcache;
+
+  // normal cache being built on a worker thread, see
+  // SoGLRenderAction::setNumCacheThreads()
+  SoNormalCache * pendingnormalcache;
+  SoVertexShapeNormalCacheKey normalcachekey;
+  SoVertexShapeNormalCacheKey pendingnormalcachekey;
+  // counts changes to the shape's own fields
+  uint32_t fieldchanges;
+
+  // bounding box of the coordinates, kept up to date from the
+  // SoCoordinateChangeLog while the coordinates are being edited
+  SoVertexShapeCoordBBox * coordbbox;
+
+  // we can use a per-instance mutex here instead of this class-wide
+  // one, but we go for the class-wide one since at least Microsoft Windows
+  // might have a rather strict limit on the total amount of mutex
+  // resources a process / user can hold at any one time.
+  //
+  // i haven't looked too hard at the affected code regions in the
+  // sub-classes, however. it might be that a class-wide lock can
+  // cause significantly less efficient execution in a multi-threaded
+  // environment. if so, we will have to come up with something better
+  // than just a class-wide lock (a mutex pool or something, i
+  // suppose).
+  //
+  // -mortene.
+  static SbRWMutex * normalcachemutex;
+  static SbMutex * coordbboxmutex;
+  // bytes held by all coordbbox instances, guarded by coordbboxmutex
+  static size_t coordbboxbytes;
+
+  static void cleanup(void);
+
+  static SbBool getCoordBBox(SoVertexShape * shape, const uint32_t coordid,
+                             const SbVec3f * coords, const int numcoords,
+                             const int first, const int last,
+                             const int32_t * indices, const int numindices,
+                             SbBox3f & box, SbVec3f & center);
+  static void resetCoordBBox(SoVertexShape * shape);
+  static void deleteCoordBBox(SoVertexShapeP * thisp);
+
+  static SoNormalCache * createNormalCache(SoVertexShape * shape, SoState * state,
+                                           const int numthreads);
+  static SbBool useOldNormalCache(SoVertexShape * shape, SoState * state,
+                                  const int numthreads);
+  static void getNormalCacheKey(SoVertexShape * shape, SoState * state,
+                                SoVertexShapeNormalCacheKey & key);
+};
+
+#endif // !COIN_SOVERTEXSHAPEP_H
@@ -129,6 +129,7 @@
 #include "nodes/SoSubNodeP.h"
 #include "glue/glp.h"
 #include "profiler/SoNodeProfiling.h"
+#include "actions/SoMultiRayPickActionP.h"
 
 #include <cstdlib> // strtol(), rand()
 #include <climits> // LONG_MIN, LONG_MAX
@@ -499,6 +500,20 @@ ray_intersect(SoRayPickAction * action, const SbBox3f & box)
 void
 SoVRMLGroup::rayPick(SoRayPickAction * action)
 {
+  SoMultiRayPickActionP * multi = SoMultiRayPickActionP::get(action);
+  if (multi) {
+    // only pass on the rays which intersect the bounding box
+    if (this->pickCulling.getValue() == OFF ||
+        !PRIVATE(this)->bboxcache || !PRIVATE(this)->bboxcache->isValid(action->getState())) {
+      SoVRMLGroup::doAction(action);
+    }
+    else if (multi->pushRays(action->getState(), PRIVATE(this)->bboxcache->getProjectedBox())) {
+      SoVRMLGroup::doAction(action);
+      multi->popRays();
+    }
+    return;
+  }
+
   if (this->pickCulling.getValue() == OFF ||
       !PRIVATE(this)->bboxcache || !PRIVATE(this)->bboxcache->isValid(action->getState()) ||
       !action->hasWorldSpaceRay() ||
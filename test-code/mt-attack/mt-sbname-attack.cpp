@@ -0,0 +1,124 @@
+/**************************************************************************\
+ * Copyright (c) Kongsberg Oil & Gas Technologies AS
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+\**************************************************************************/
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SbName.h>
+#include <Inventor/SbString.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/threads/SbThread.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+// This application measures how SbName construction scales with the
+// number of threads. Each thread creates SbName instances from a set
+// of strings, where most of the names already exist, like they do
+// when a scene is parsed. A few names per thread are new, so adding
+// names is exercised as well.
+//
+// Run it with an increasing number of threads, like:
+//
+// $ for i in 1 2 4 8; do ./mt-sbname-attack $i; done
+//
+// With uncontended lookups, the time should stay about the same as
+// long as there are free cores.
+
+static const int NUMNAMES = 1000;
+static const int NUMLOOPS = 2000;
+
+static SbString * names = NULL;
+
+class thread_data {
+public:
+  int thread_number;
+  const char * check;
+};
+
+static void * thread_callback(void * closure)
+{
+  thread_data * data = (thread_data *) closure;
+
+  for (int loop = 0; loop < NUMLOOPS; loop++) {
+    for (int i = 0; i < NUMNAMES; i++) {
+      SbName name(names[i].getString());
+      if (name.getString() == NULL) { data->check = NULL; }
+    }
+    if ((loop % 100) == 0) {
+      SbString s;
+      s.sprintf("thread%d_loop%d", data->thread_number, loop);
+      SbName name(s);
+      data->check = name.getString();
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char ** argv)
+{
+  const int numthreads = (argc > 1) ? atoi(argv[1]) : 4;
+  if (numthreads < 1) {
+    printf("specify a positive number of threads\n");
+    return -1;
+  }
+
+  SoDB::init();
+
+  names = new SbString[NUMNAMES];
+  for (int i = 0; i < NUMNAMES; i++) {
+    names[i].sprintf("name_%d", i);
+    (void) SbName(names[i]);
+  }
+
+  thread_data * data = new thread_data[numthreads];
+  SbThread ** threads = new SbThread*[numthreads];
+
+  const SbTime start = SbTime::getTimeOfDay();
+  for (int i = 0; i < numthreads; i++) {
+    data[i].thread_number = i;
+    data[i].check = NULL;
+    threads[i] = SbThread::create(thread_callback, &data[i]);
+  }
+  for (int i = 0; i < numthreads; i++) {
+    threads[i]->join();
+    SbThread::destroy(threads[i]);
+  }
+  const double elapsed = (SbTime::getTimeOfDay() - start).getValue();
+
+  const double numcreated = double(numthreads) * NUMLOOPS * NUMNAMES;
+  printf("%d threads: %.3f s, %.1f million names per second\n",
+         numthreads, elapsed, numcreated / elapsed / 1.0e6);
+
+  delete[] threads;
+  delete[] data;
+  delete[] names;
+  return 0;
+}
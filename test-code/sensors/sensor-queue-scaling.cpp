@@ -0,0 +1,94 @@
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/sensors/SoAlarmSensor.h>
+#include <Inventor/sensors/SoOneShotSensor.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+// This application measures how the sensor queues scale with the
+// number of scheduled sensors. Each frame, all the delay sensors are
+// scheduled, every other one is unscheduled and scheduled again, like
+// sensors on fields that are edited more than once, and then the delay
+// queue is processed. The same is done for alarm sensors in the timer
+// queue.
+//
+// Run it with an increasing number of sensors, like:
+//
+// $ for i in 1000 10000 100000; do ./sensor-queue-scaling $i; done
+//
+// The time per sensor should grow about logarithmically with the
+// number of sensors.
+
+static const int NUMFRAMES = 10;
+
+static int numtriggered = 0;
+
+static void
+sensor_cb(void *, SoSensor *)
+{
+  numtriggered++;
+}
+
+int main(int argc, char ** argv)
+{
+  const int numsensors = (argc > 1) ? atoi(argv[1]) : 10000;
+  if (numsensors < 1) {
+    printf("specify a positive number of sensors\n");
+    return -1;
+  }
+
+  SoDB::init();
+  SoSensorManager * sm = SoDB::getSensorManager();
+
+  SoOneShotSensor ** delaysensors = new SoOneShotSensor*[numsensors];
+  SoAlarmSensor ** alarmsensors = new SoAlarmSensor*[numsensors];
+  for (int i = 0; i < numsensors; i++) {
+    delaysensors[i] = new SoOneShotSensor(sensor_cb, NULL);
+    // a handful of different priorities
+    delaysensors[i]->setPriority(50 + (i % 7) * 10);
+    alarmsensors[i] = new SoAlarmSensor(sensor_cb, NULL);
+  }
+
+  SbTime start = SbTime::getTimeOfDay();
+  for (int frame = 0; frame < NUMFRAMES; frame++) {
+    for (int i = 0; i < numsensors; i++) delaysensors[i]->schedule();
+    for (int i = 0; i < numsensors; i += 2) {
+      delaysensors[i]->unschedule();
+      delaysensors[i]->schedule();
+    }
+    sm->processDelayQueue(TRUE);
+  }
+  const double delaytime = (SbTime::getTimeOfDay() - start).getValue();
+
+  start = SbTime::getTimeOfDay();
+  for (int frame = 0; frame < NUMFRAMES; frame++) {
+    const SbTime now = SbTime::getTimeOfDay();
+    for (int i = 0; i < numsensors; i++) {
+      // spread the trigger times out, all in the past
+      alarmsensors[i]->setTime(now - SbTime(double((i * 7919) % numsensors) * 1.0e-6 + 1.0));
+      alarmsensors[i]->schedule();
+    }
+    for (int i = 0; i < numsensors; i += 2) {
+      alarmsensors[i]->unschedule();
+      alarmsensors[i]->schedule();
+    }
+    sm->processTimerQueue();
+  }
+  const double timertime = (SbTime::getTimeOfDay() - start).getValue();
+
+  const double numops = double(NUMFRAMES) * numsensors;
+  printf("%d sensors: delay queue %.3f s (%.1f ns per sensor), "
+         "timer queue %.3f s (%.1f ns per sensor), %d triggered\n",
+         numsensors, delaytime, delaytime / numops * 1.0e9,
+         timertime, timertime / numops * 1.0e9, numtriggered);
+
+  for (int i = 0; i < numsensors; i++) {
+    delete delaysensors[i];
+    delete alarmsensors[i];
+  }
+  delete[] delaysensors;
+  delete[] alarmsensors;
+  return 0;
+}